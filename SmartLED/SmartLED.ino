@@ -3,7 +3,14 @@
 // Есть вопросы? Пишите: sergey@getbyte.ru
 
 #include <stdint.h>
+// по умолчанию клиенты вебсокетов опрашиваются в loop(). Событийный сервер (без опроса клиентов в loop()) включается
+// раскомментированием строки ниже, нужна библиотека ESPAsyncTCP (в libraries/ ее нет, ставится отдельно). Команды
+// тогда принимаются в обработчиках TCP и выполняются в loop() через очередь (WEBSOCKET_QUEUE_SIZE в smartled.h),
+// отправка медленному клиенту ограничена так же, как при опросе (WEBSOCKETS_SEND_QUEUE_SIZE в WebSockets.h).
+// На компьютере событийный сервер собирается с переносом ESPAsyncTCP из tools/host/async (make -C tools/host bench)
+//#include <ESPAsyncTCP.h>
 #include "smartled.h"
+#include "mqtt.h"
 #include <ESP8266WiFi.h>
 #include <WiFiClient.h>
 #include <ESP8266WebServer.h>
@@ -13,6 +20,13 @@
 
 #define PIXEL_COUNT 60
 #define PIN_PIXEL 2
+// для матрицы задайте ее размеры (тогда PIXEL_COUNT не используется), для ленты оставьте 0
+#define MATRIX_WIDTH 0
+#define MATRIX_HEIGHT 0
+// размеры одного модуля, если матрица собрана из нескольких модулей, иначе 0
+#define MATRIX_TILE_WIDTH 0
+#define MATRIX_TILE_HEIGHT 0
+#define MATRIX_FLAGS LayoutSerpentine
 
 typedef struct AccessPoint
 {
@@ -26,12 +40,60 @@ const AccessPoint ap[] = {
 };
 int apCount = 2;
 const char* host = "room";
+/// распределенный вывод: эффект считается на PIXEL_COUNT пикселей своей ленты и пиксели ведомых,
+/// ведомые (режим dmx, протокол DDP) получают свои участки по порядку. Только для ленты, не для матрицы
+RelayTarget relayTargets[] = {
+    {IPAddress(192, 168, 1, 51), 150, 0},
+    {IPAddress(192, 168, 1, 52), 150, 0}
+};
+/// количество используемых ведомых из relayTargets, 0 - распределенный вывод выключен
+const uint8_t relayCount = 0;
+/// синхронизация кадров: один контроллер SRLeader, остальные SRFollower (SRNone - выключена)
+#define SYNC_ROLE SRNone
+/// брокер MQTT, пустая строка - MQTT не используется. Топики: smartled/<host>/set/<параметр>
+/// (set/mode - смена режима), smartled/<host>/state (retained JSON), smartled/<host>/status
+const char* mqttBroker = "";
+/// изменения за этот интервал публикуются одним сообщением состояния, мс
+#define MQTT_PUBLISH_INTERVAL 250
+#define MQTT_TOPIC_SIZE 48
+/// срок кэширования сжатых статических файлов в браузере (30 дней)
+#define STATIC_CACHE_CONTROL "public, max-age=2592000"
+/// страница проверяется при каждой загрузке (ответ 304 без тела), чтобы новая версия интерфейса появлялась сразу
+#define PAGE_CACHE_CONTROL "no-cache"
+/// заголовки запроса, которые сервер должен сохранить для handleFileRead
+const char* collectedHeaders[] = {"Accept-Encoding", "If-None-Match"};
+/// одновременно отдаваемые по частям файлы, при нехватке файл отдается целиком
+#define FILE_TRANSFERS 2
+/// байт файла за один проход loop()
+#define FILE_CHUNK_SIZE 1024
+/// клиент, не принимающий данные столько мс, больше не обслуживается
+#define FILE_TRANSFER_TIMEOUT 5000
+/// максимальный размер тела запроса HTTP API (JSON) и имени/значения параметра формы
+#define API_BODY_SIZE 256
+#define API_OPTION_SIZE 64
 
 ESP8266WebServer server(80);
 MDNSResponder mdns;
 
 SmartLED* smart;
 
+typedef struct FileTransfer
+{
+    File file;
+    WiFiClient client;
+    uint32_t lastProgress;
+} FileTransfer;
+
+FileTransfer transfers[FILE_TRANSFERS];
+
+MqttClient mqtt;
+char mqttSetTopic[MQTT_TOPIC_SIZE];     ///< фильтр подписки на команды (.../set/+)
+char mqttStateTopic[MQTT_TOPIC_SIZE];
+char mqttStatusTopic[MQTT_TOPIC_SIZE];
+uint32_t mqttPublishedChanges;          ///< SmartLED::changeCount() на момент последней публикации состояния
+uint32_t mqttPublishedSession;          ///< сессия MQTT, в которой состояние уже опубликовано
+uint32_t mqttLastPublish;               ///< время последней публикации состояния, мс
+
 String getContentType(String filename){
   if(server.hasArg("download")) return "application/octet-stream";
   else if(filename.endsWith(".htm")) return "text/html";
@@ -45,31 +107,282 @@ String getContentType(String filename){
   return "text/plain";
 }
 
-void handleRoot()
+/// отправляет заголовки ответа, тело файла уходит частями из handleFileTransfers(), чтобы эффекты не замирали на время загрузки
+void streamFileAsync(File& file, const String& contentType)
 {
-    String path = "/index.html";
-    String contentType = getContentType(path);
-    if (SPIFFS.exists(path))
+    FileTransfer* transfer = NULL;
+    for (int i = 0; (i < FILE_TRANSFERS) && !transfer; i++)
     {
-        File file = SPIFFS.open(path, "r");
-        size_t sent = server.streamFile(file, contentType);
+        if (!transfers[i].file)
+            transfer = &transfers[i];
+    }
+    if (!transfer || (file.size() == 0))
+    {
+        server.streamFile(file, contentType);
         file.close();
+        return;
+    }
+    server.setContentLength(file.size());
+    if (String(file.name()).endsWith(".gz"))
+        server.sendHeader("Content-Encoding", "gzip");
+    server.send(200, contentType, "");
+    transfer->file = file;
+    transfer->client = server.client();
+    transfer->lastProgress = millis();
+}
+
+/// каждому файлу не больше FILE_CHUNK_SIZE байт и не больше, чем TCP примет без ожидания
+void handleFileTransfers()
+{
+    uint8_t buffer[FILE_CHUNK_SIZE];
+    for (int i = 0; i < FILE_TRANSFERS; i++)
+    {
+        FileTransfer& transfer = transfers[i];
+        if (!transfer.file)
+            continue;
+        bool connected = transfer.client.connected();
+        size_t room = connected ? transfer.client.availableForWrite() : 0;
+        if (room > sizeof(buffer))
+            room = sizeof(buffer);
+        if (room > 0)
+        {
+            size_t length = transfer.file.read(buffer, room);
+            size_t written = (length > 0) ? transfer.client.write(buffer, length) : 0;
+            /// непринятый остаток будет прочитан снова
+            if (written < length)
+                transfer.file.seek(transfer.file.position() - (length - written));
+            if (written > 0)
+                transfer.lastProgress = millis();
+        }
+        if (!connected || (transfer.file.position() >= transfer.file.size()) || (millis() - transfer.lastProgress > FILE_TRANSFER_TIMEOUT))
+        {
+            transfer.file.close();
+            transfer.client = WiFiClient();
+        }
+    }
+}
+
+void handleStats()
+{
+    char stats[768];
+    profiler.toJson(stats, sizeof(stats));
+    server.send(200, "application/json", stats);
+}
+
+/// записанные команды вебсокета, строка на команду: "время_мс\tклиент\tкоманда"
+void handleCapture()
+{
+    server.sendHeader("Content-Disposition", "attachment; filename=capture.txt");
+    server.setContentLength(smart->capture.write(NULL));
+    server.send(200, "text/plain", "");
+    WiFiClient client = server.client();
+    smart->capture.write(&client);
+}
+
+void handleCaptureClear()
+{
+    smart->capture.clear();
+    server.send(200, "text/plain", "OK");
+}
+
+/// состояние пишется прямо в сокет: первый проход JsonWriter только считает длину для Content-Length
+void sendJsonState()
+{
+    JsonWriter counter(NULL);
+    smart->writeState(counter);
+    server.setContentLength(counter.length());
+    server.send(200, "application/json", "");
+    WiFiClient client = server.client();
+    JsonWriter json(&client);
+    smart->writeState(json);
+    json.flush();
+}
+
+void sendJsonError(const char* message)
+{
+    char error[96];
+    snprintf(error, sizeof(error), "{\"error\":\"%s\"}", message);
+    server.send(400, "application/json", error);
+}
+
+/// тело запроса копируется в буфер на стеке, JsonObjectReader разбирает его на месте
+bool readJsonBody(char* body, size_t size)
+{
+    if (!server.hasArg("plain"))
+        return false;
+    const String& plain = server.arg("plain");
+    if (plain.length() >= size)
+        return false;
+    memcpy(body, plain.c_str(), plain.length() + 1);
+    return true;
+}
+
+void handleApiState()
+{
+    sendJsonState();
+}
+
+/// {"mode":"rainbow"} в теле запроса или параметр формы mode
+void handleApiMode()
+{
+    char body[API_BODY_SIZE];
+    char* modeName = NULL;
+    if (server.hasArg("mode"))
+    {
+        server.arg("mode").toCharArray(body, sizeof(body));
+        modeName = body;
+    } else if (readJsonBody(body, sizeof(body)))
+    {
+        JsonObjectReader reader(body);
+        char* key;
+        char* value;
+        while (reader.next(key, value))
+            if (strcmp(key, "mode") == 0)
+                modeName = value;
+        if (reader.error())
+        {
+            sendJsonError("malformed JSON");
+            return;
+        }
+    }
+    if (!modeName || (smart->findMode(modeName) == MIMAX))
+    {
+        sendJsonError("unknown mode");
+        return;
+    }
+    smart->selectMode(modeName);
+    sendJsonState();
+}
+
+/// {"speed":10,"colorMax":[255,0,0]} в теле запроса или параметры формы, как у setOption по вебсокету
+void handleApiOptions()
+{
+    char body[API_BODY_SIZE];
+    if (readJsonBody(body, sizeof(body)))
+    {
+        JsonObjectReader reader(body);
+        char* key;
+        char* value;
+        /// значения до ошибки разбора уже применены, как и при последовательных командах по вебсокету
+        while (reader.next(key, value))
+            smart->setOption(key, value);
+        if (reader.error())
+        {
+            sendJsonError("malformed JSON");
+            return;
+        }
+    } else
+    {
+        char option[API_OPTION_SIZE];
+        for (int i = 0; i < server.args(); i++)
+        {
+            if (server.argName(i) == "plain")
+                continue;
+            server.argName(i).toCharArray(option, sizeof(option));
+            server.arg(i).toCharArray(body, sizeof(body));
+            smart->setOption(option, body);
+        }
+    }
+    sendJsonState();
+}
+
+/// команда MQTT: имя параметра - последний уровень топика, значение в том же текстовом виде, что и по вебсокету
+void mqttMessage(char* topic, char* payload, uint16_t length)
+{
+    char* option = strrchr(topic, '/');
+    if (!option)
+        return;
+    option++;
+    if (strcmp(option, "mode") == 0)
+    {
+        if (smart->findMode(payload) != MIMAX)
+            smart->selectMode(payload);
+    } else
+        smart->setOption(option, payload);
+}
+
+/// состояние публикуется не чаще MQTT_PUBLISH_INTERVAL, серия быстрых изменений дает одну публикацию
+void handleMqtt()
+{
+    mqtt.loop();
+    if (!mqtt.connected())
+        return;
+    if (mqttPublishedSession != mqtt.sessions)
+    {
+        mqtt.publish(mqttStatusTopic, "online", true);
+    } else if ((mqttPublishedChanges == smart->changeCount()) || (millis() - mqttLastPublish < MQTT_PUBLISH_INTERVAL))
+    {
+        return;
     }
+    JsonWriter counter(NULL);
+    smart->writeState(counter);
+    Print* output = mqtt.beginPublish(mqttStateTopic, counter.length(), true);
+    if (!output)
+        return;
+    JsonWriter json(output);
+    smart->writeState(json);
+    json.flush();
+    mqttPublishedSession = mqtt.sessions;
+    mqttPublishedChanges = smart->changeCount();
+    mqttLastPublish = millis();
+}
+
+/// ETag сжатого файла: CRC32 и длина исходных данных из последних 8 байт gzip, файл не читается целиком
+String gzipETag(File& file)
+{
+    uint8_t trailer[8];
+    size_t size = file.size();
+    if ((size < 18) || !file.seek(size - sizeof(trailer)) || (file.read(trailer, sizeof(trailer)) != sizeof(trailer)))
+        return String();
+    file.seek(0);
+    char etag[20];
+    snprintf(etag, sizeof(etag), "\"%08x%08x\"",
+             trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((uint32_t) trailer[3] << 24),
+             trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | ((uint32_t) trailer[7] << 24));
+    return String(etag);
 }
 
 bool handleFileRead(String path)
 {
     String contentType = getContentType(path);
+    /// сжатые копии готовит tools/gzip-data.sh, браузер повторно запрашивает их только по истечении срока кэша,
+    /// а страницу (PAGE_CACHE_CONTROL) проверяет по ETag при каждой загрузке
+    String gzPath = path + ".gz";
+    if ((server.header("Accept-Encoding").indexOf("gzip") >= 0) && SPIFFS.exists(gzPath))
+    {
+        File file = SPIFFS.open(gzPath, "r");
+        String etag = gzipETag(file);
+        server.sendHeader("Cache-Control", (contentType == "text/html") ? PAGE_CACHE_CONTROL : STATIC_CACHE_CONTROL);
+        server.sendHeader("Vary", "Accept-Encoding");
+        if (etag.length() > 0)
+        {
+            server.sendHeader("ETag", etag);
+            if (server.header("If-None-Match").indexOf(etag) >= 0)
+            {
+                file.close();
+                server.send(304);
+                return true;
+            }
+        }
+        streamFileAsync(file, contentType);
+        return true;
+    }
     if (SPIFFS.exists(path))
     {
         File file = SPIFFS.open(path, "r");
-        size_t sent = server.streamFile(file, contentType);
-        file.close();
+        streamFileAsync(file, contentType);
         return true;
     }
     return false;
 }
 
+/// страница отдается тем же путем, что и остальные файлы: index.html.gz, ETag и 304 при повторном запросе
+void handleRoot()
+{
+    if (!handleFileRead("/index.html"))
+        server.send(404, "text/plain", "FileNotFound");
+}
+
 void setup(void)
 {
     Serial.begin(115200);
@@ -116,14 +429,45 @@ void setup(void)
     Serial.print(", IP address: ");
     Serial.println(WiFi.localIP());
 
-    smart = new SmartLED(PIXEL_COUNT, PIN_PIXEL, NEO_GRB, true);
+#if MATRIX_WIDTH > 0
+    MatrixLayout layout = {MATRIX_WIDTH, MATRIX_HEIGHT, MATRIX_TILE_WIDTH, MATRIX_TILE_HEIGHT, MATRIX_FLAGS};
+    smart = new SmartLED(layout, PIN_PIXEL, NEO_GRB, true);
+#else
+    uint16_t virtualPixels = PIXEL_COUNT;
+    for (uint8_t i = 0; i < relayCount; i++)
+        virtualPixels += relayTargets[i].pixels;
+    smart = new SmartLED(virtualPixels, PIN_PIXEL, NEO_GRB, true);
+    if (relayCount > 0)
+        smart->beginRelay(PIXEL_COUNT, relayTargets, relayCount);
+#endif
     
 
+    smart->beginSync(SYNC_ROLE);
+
+    profiler.calibrate();
+
     mdns.begin(host, WiFi.localIP());
+
+    if (mqttBroker[0])
+    {
+        snprintf(mqttSetTopic, sizeof(mqttSetTopic), "smartled/%s/set/+", host);
+        snprintf(mqttStateTopic, sizeof(mqttStateTopic), "smartled/%s/state", host);
+        snprintf(mqttStatusTopic, sizeof(mqttStatusTopic), "smartled/%s/status", host);
+        mqtt.begin(mqttBroker, MQTT_PORT, host, mqttStatusTopic);
+        mqtt.subscribe(mqttSetTopic);
+        mqtt.onMessage(mqttMessage);
+    }
     
     server.on("/", handleRoot);
     server.on("/index.html", handleRoot);
+    server.on("/stats", handleStats);
+    server.on("/api/state", HTTP_GET, handleApiState);
+    server.on("/capture", HTTP_GET, handleCapture);
+    server.on("/capture", HTTP_DELETE, handleCaptureClear);
+    server.on("/api/mode", HTTP_POST, handleApiMode);
+    server.on("/api/options", HTTP_PATCH, handleApiOptions);
 
+    server.collectHeaders(collectedHeaders, sizeof(collectedHeaders) / sizeof(collectedHeaders[0]));
     server.onNotFound([]()
     {
         if (!handleFileRead(server.uri()))
@@ -135,8 +479,16 @@ void setup(void)
 
 void loop(void)
 {
+    uint32_t loopStart = profiler.begin();
+    uint32_t phaseStart = profiler.begin();
     server.handleClient();
+    handleFileTransfers();
+    profiler.end(PPHandleClient, phaseStart);
+    phaseStart = profiler.begin();
+    handleMqtt();
+    profiler.end(PPMqtt, phaseStart);
     smart->process();
+    profiler.end(PPLoop, loopStart);
     delay(2);
 }
-
+
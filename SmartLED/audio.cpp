@@ -0,0 +1,228 @@
+#include "audio.h"
+
+/// синус в формате Q15 для углов 2 * pi * i / 512, i = 0..128 (четверть периода)
+const int16_t sineQ15[129] PROGMEM = {
+    0, 402, 804, 1206, 1608, 2009, 2410, 2811, 3212, 3612, 4011, 4410,
+    4808, 5205, 5602, 5998, 6393, 6786, 7179, 7571, 7962, 8351, 8739, 9126,
+    9512, 9896, 10278, 10659, 11039, 11417, 11793, 12167, 12539, 12910, 13279, 13645,
+    14010, 14372, 14732, 15090, 15446, 15800, 16151, 16499, 16846, 17189, 17530, 17869,
+    18204, 18537, 18868, 19195, 19519, 19841, 20159, 20475, 20787, 21096, 21403, 21705,
+    22005, 22301, 22594, 22884, 23170, 23452, 23731, 24007, 24279, 24547, 24811, 25072,
+    25329, 25582, 25832, 26077, 26319, 26556, 26790, 27019, 27245, 27466, 27683, 27896,
+    28105, 28310, 28510, 28706, 28898, 29085, 29268, 29447, 29621, 29791, 29956, 30117,
+    30273, 30424, 30571, 30714, 30852, 30985, 31113, 31237, 31356, 31470, 31580, 31685,
+    31785, 31880, 31971, 32057, 32137, 32213, 32285, 32351, 32412, 32469, 32521, 32567,
+    32609, 32646, 32678, 32705, 32728, 32745, 32757, 32765, 32767
+};
+
+/**
+ * Синус в формате Q15
+ * @param k угол в единицах 2 * pi / 512
+ * @return значение синуса
+ */
+static int16_t sinQ15(uint16_t k)
+{
+    uint16_t idx = k & 127;
+    switch ((k >> 7) & 3)
+    {
+        case 0: return (int16_t) pgm_read_word(&sineQ15[idx]);
+        case 1: return (int16_t) pgm_read_word(&sineQ15[128 - idx]);
+        case 2: return -(int16_t) pgm_read_word(&sineQ15[idx]);
+        default: return -(int16_t) pgm_read_word(&sineQ15[128 - idx]);
+    }
+}
+
+/**
+ * Косинус в формате Q15
+ * @param k угол в единицах 2 * pi / 512
+ * @return значение косинуса
+ */
+static int16_t cosQ15(uint16_t k)
+{
+    return sinQ15(k + 128);
+}
+
+AudioAnalyzer::AudioAnalyzer(uint8_t pin)
+{
+    adcPin = pin;
+    head = 0;
+    fresh = 0;
+    gaps = 0;
+    level = 0;
+    beat = false;
+    sensitivity = 50;
+    fftMicros = 0;
+    bassAverage = 0;
+    dcLevel = 512L << 16;
+    nextSample = 0;
+    memset(ring, 0, sizeof (ring));
+    memset(band, 0, sizeof (band));
+    memset(bandPeak, 0, sizeof (bandPeak));
+    /// границы полос: от 1-го частотного отсчета до N/2 в логарифмическом масштабе,
+    /// каждая полоса содержит хотя бы один отсчет
+    bandEdge[0] = 1;
+    for (int b = 1; b <= AUDIO_BANDS; b++)
+    {
+        uint16_t edge = (uint16_t) (pow(AUDIO_FFT_SIZE / 2, (float) b / AUDIO_BANDS) + 0.5);
+        bandEdge[b] = (edge > bandEdge[b - 1]) ? edge : bandEdge[b - 1] + 1;
+        if (bandEdge[b] > AUDIO_FFT_SIZE / 2)
+            bandEdge[b] = AUDIO_FFT_SIZE / 2;
+    }
+}
+
+bool AudioAnalyzer::capture()
+{
+    uint32_t period = (uint32_t) ESP.getCpuFreqMHz() * 1000000UL / AUDIO_SAMPLE_RATE;
+    uint32_t deadline = ESP.getCycleCount() + (uint32_t) ESP.getCpuFreqMHz() * AUDIO_CAPTURE_BUDGET;
+    while (true)
+    {
+        uint32_t cycles = ESP.getCycleCount();
+        /// опоздание больше периода (остальная часть loop(), прерывание сети или таймера):
+        /// пропущенные отсчеты уже не снять, оцифровка продолжается с текущего
+        if ((int32_t) (cycles - nextSample) >= (int32_t) period)
+        {
+            nextSample = cycles;
+            gaps++;
+        }
+        /// отсчет, который придется ждать дольше бюджета, снимет следующий вызов
+        if ((int32_t) (nextSample - deadline) >= 0)
+            break;
+        while ((int32_t) (ESP.getCycleCount() - nextSample) < 0)
+            ;
+        nextSample += period;
+        int32_t raw = (int32_t) analogRead(adcPin) << 16;
+        dcLevel += (raw - dcLevel) >> 8;
+        store((raw - dcLevel) >> 16);
+    }
+    return fresh >= AUDIO_FFT_SIZE;
+}
+
+void AudioAnalyzer::store(int16_t sample)
+{
+    ring[head] = sample;
+    head = (head + 1) & (AUDIO_RING_SIZE - 1);
+    if (fresh < AUDIO_RING_SIZE)
+        fresh++;
+}
+
+void AudioAnalyzer::push(const int16_t* samples, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+        store(samples[i]);
+}
+
+bool AudioAnalyzer::analyze()
+{
+    if (fresh < AUDIO_FFT_SIZE)
+        return false;
+    fresh = 0;
+    uint16_t end = head;
+    uint32_t start = micros();
+
+    /// последнее полное окно, отсчеты сверх него (push() большими кусками) пропускаются
+    uint16_t pos = (end - AUDIO_FFT_SIZE) & (AUDIO_RING_SIZE - 1);
+    uint32_t energy = 0;
+    for (uint16_t n = 0; n < AUDIO_FFT_SIZE; n++)
+    {
+        int16_t sample = ring[(pos + n) & (AUDIO_RING_SIZE - 1)];
+        energy += ((int32_t) sample * sample) >> AUDIO_FFT_LOG2;
+        /// окно Ханна: sin^2(pi * n / N) = (1 - cos(2 * pi * n / N)) / 2
+        int32_t w = (32768L - cosQ15(n << (9 - AUDIO_FFT_LOG2))) >> 1;
+        re[n] = ((int32_t) constrain(sample, -2047, 2047) * 16 * w) >> 15;
+        im[n] = 0;
+    }
+    fft(re, im, AUDIO_FFT_LOG2);
+
+    uint16_t bass = 0;
+    for (int b = 0; b < AUDIO_BANDS; b++)
+    {
+        uint16_t peak = 0;
+        for (uint16_t k = bandEdge[b]; k < bandEdge[b + 1]; k++)
+        {
+            uint16_t a = abs(re[k]);
+            uint16_t c = abs(im[k]);
+            /// приближенный модуль: max + min / 2
+            uint16_t mag = (a > c) ? a + (c >> 1) : c + (a >> 1);
+            if (mag > peak)
+                peak = mag;
+        }
+        int16_t value = ((int16_t) log8((uint32_t) peak * sensitivity) - 64) * 2;
+        value = constrain(value, 0, 255);
+        if (b < 2)
+            bass += value;
+        /// автоматическая регулировка: медленно спадающий максимум полосы
+        bandPeak[b] -= bandPeak[b] >> 6;
+        if (value > bandPeak[b])
+            bandPeak[b] = value;
+        uint16_t norm = (bandPeak[b] < 64) ? 64 : bandPeak[b];
+        band[b] = (value * 255) / norm;
+    }
+
+    int16_t vu = ((int16_t) log8(energy * sensitivity) - 64) * 2;
+    level = constrain(vu, 0, 255);
+
+    /// удар - резкий рост энергии низких частот относительно среднего
+    uint16_t bassScaled = bass << 4;
+    beat = (bass > 40) && (bassScaled > bassAverage + (bassAverage >> 2) + (16 << 4));
+    bassAverage = (bassAverage * 7 + bassScaled) >> 3;
+
+    fftMicros = micros() - start;
+    return true;
+}
+
+void AudioAnalyzer::fft(int16_t* re, int16_t* im, uint8_t log2n)
+{
+    uint16_t n = 1 << log2n;
+    /// перестановка в бит-реверсном порядке
+    for (uint16_t i = 1, j = 0; i < n; i++)
+    {
+        uint16_t bitMask = n >> 1;
+        while (j & bitMask)
+        {
+            j &= ~bitMask;
+            bitMask >>= 1;
+        }
+        j |= bitMask;
+        if (i < j)
+        {
+            int16_t t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (uint8_t stage = 1; stage <= log2n; stage++)
+    {
+        uint16_t span = 1 << stage;
+        uint16_t half = span >> 1;
+        uint16_t step = 512 >> stage;
+        for (uint16_t j = 0; j < half; j++)
+        {
+            int32_t wr = cosQ15(j * step);
+            int32_t wi = -sinQ15(j * step);
+            for (uint16_t k = j; k < n; k += span)
+            {
+                uint16_t t = k + half;
+                int32_t tr = (wr * re[t] - wi * im[t]) >> 15;
+                int32_t ti = (wr * im[t] + wi * re[t]) >> 15;
+                re[t] = (re[k] - tr) >> 1;
+                im[t] = (im[k] - ti) >> 1;
+                re[k] = (re[k] + tr) >> 1;
+                im[k] = (im[k] + ti) >> 1;
+            }
+        }
+    }
+}
+
+uint8_t AudioAnalyzer::log8(uint32_t value)
+{
+    if (value == 0)
+        return 0;
+    uint8_t msb = 31;
+    while (!(value & (1UL << msb)))
+        msb--;
+    uint8_t fraction = (msb >= 3) ? (value >> (msb - 3)) & 0x07 : (value << (3 - msb)) & 0x07;
+    return msb * 8 + fraction;
+}
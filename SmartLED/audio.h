@@ -0,0 +1,99 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <Arduino.h>
+
+/// размер окна БПФ (log2): 8 - 256 отсчетов, 9 - 512 отсчетов
+#ifndef AUDIO_FFT_LOG2
+#define AUDIO_FFT_LOG2 8
+#endif
+#define AUDIO_FFT_SIZE (1 << AUDIO_FFT_LOG2)
+/// размер кольцевого буфера между оцифровкой и анализом, должен быть степенью двойки
+#define AUDIO_RING_SIZE (AUDIO_FFT_SIZE * 2)
+/// количество полос спектра (полосы распределены логарифмически)
+#define AUDIO_BANDS 16
+/// частота оцифровки АЦП, Гц
+#define AUDIO_SAMPLE_RATE 8000
+/// время оцифровки за один вызов capture() (проход loop()), мкс: остальное время loop() обслуживает сеть и эффект
+#ifndef AUDIO_CAPTURE_BUDGET
+#define AUDIO_CAPTURE_BUDGET 2000
+#endif
+
+/** класс для анализа звука: оцифровка из loop() с шагом по счетчику тактов
+ * в кольцевой буфер (за проход - только отсчеты, которые приходятся на
+ * AUDIO_CAPTURE_BUDGET мкс), БПФ в целых числах с окном Ханна, разбиение спектра на
+ * логарифмические полосы, уровень и детектор ударов. Окно собирается из кусков
+ * соседних проходов loop(), анализируется каждое новое полное окно
+ */
+class AudioAnalyzer
+{
+public:
+    /**
+     * Конструктор класса
+     * @param pin аналоговый вход, к которому подключен микрофон
+     */
+    AudioAnalyzer(uint8_t pin = A0);
+    /**
+     * Оцифровать отсчеты АЦП с частотой AUDIO_SAMPLE_RATE, которые приходятся на
+     * ближайшие AUDIO_CAPTURE_BUDGET мкс. Вызывается на каждом проходе loop():
+     * analogRead нельзя выполнять в прерывании, пока идет работа с флешем.
+     * Ожидание отсчетов - по счетчику тактов, отсчеты, пропущенные между
+     * вызовами, не восполняются: оцифровка продолжается с текущего
+     * @return true, если с прошлого анализа накопилось полное окно
+     */
+    bool capture();
+    /**
+     * Добавить отсчеты из внешнего источника (например, I2S или сети) вместо
+     * capture(). Отсчеты считаются идущими подряд
+     * @param samples массив отсчетов со знаком
+     * @param count количество отсчетов
+     */
+    void push(const int16_t* samples, uint16_t count);
+    /**
+     * Выполнить анализ, если с прошлого анализа накопилось полное окно
+     * (AUDIO_FFT_SIZE отсчетов). Выполняется не более одного БПФ за вызов
+     * @return true, если значения полос обновились
+     */
+    bool analyze();
+    /**
+     * Преобразование Фурье в целых числах (по основанию 2, на месте). На каждом
+     * этапе данные делятся на 2, чтобы не было переполнения
+     * @param re действительная часть
+     * @param im мнимая часть
+     * @param log2n log2 от количества отсчетов, не более 9
+     */
+    static void fft(int16_t* re, int16_t* im, uint8_t log2n);
+    uint8_t band[AUDIO_BANDS];          ///< уровни полос спектра, 0..255
+    uint8_t level;                      ///< общий уровень сигнала, 0..255
+    bool beat;                          ///< обнаружен удар (сбрасывается при следующем анализе)
+    uint8_t sensitivity;                ///< чувствительность, 1..100
+    uint32_t fftMicros;                 ///< время последнего анализа, мкс
+    uint32_t gaps;                      ///< количество разрывов оцифровки (между проходами loop() и из-за прерываний)
+
+private:
+    int16_t ring[AUDIO_RING_SIZE];      ///< кольцевой буфер отсчетов
+    uint16_t head;                      ///< позиция записи в кольцевой буфер
+    uint16_t fresh;                     ///< отсчетов с начала последнего анализа
+    int16_t re[AUDIO_FFT_SIZE];         ///< рабочий буфер БПФ, действительная часть
+    int16_t im[AUDIO_FFT_SIZE];         ///< рабочий буфер БПФ, мнимая часть
+    uint16_t bandEdge[AUDIO_BANDS + 1]; ///< границы полос в номерах частотных отсчетов
+    uint16_t bandPeak[AUDIO_BANDS];     ///< медленно спадающий максимум каждой полосы (АРУ)
+    uint16_t bassAverage;               ///< средняя энергия низких частот для детектора ударов
+    int32_t dcLevel;                    ///< постоянная составляющая сигнала АЦП (формат 16.16)
+    uint32_t nextSample;                ///< такт следующего отсчета capture()
+    uint8_t adcPin;                     ///< аналоговый вход
+
+    /**
+     * Записать отсчет в кольцевой буфер
+     */
+    void store(int16_t sample);
+
+    /**
+     * Логарифм для отображения: 8 уровней на каждое удвоение
+     * @param value значение
+     * @return значение в логарифмической шкале
+     */
+    static uint8_t log8(uint32_t value);
+};
+
+#endif /* AUDIO_H */
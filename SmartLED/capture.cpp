@@ -0,0 +1,83 @@
+#include "capture.h"
+
+/// заголовок записи: время (4 байта), номер клиента, длина команды
+#define CAPTURE_HEADER 6
+
+CommandCapture::CommandCapture()
+{
+    clear();
+}
+
+void CommandCapture::clear()
+{
+    head = 0;
+    tail = 0;
+    used = 0;
+    recorded = 0;
+    overwritten = 0;
+}
+
+void CommandCapture::put(uint8_t value)
+{
+    buffer[head] = value;
+    head = (head + 1) % CAPTURE_BUFFER_SIZE;
+    used++;
+}
+
+void CommandCapture::dropOldest()
+{
+    uint16_t size = CAPTURE_HEADER + get(tail + 5);
+    tail = (tail + size) % CAPTURE_BUFFER_SIZE;
+    used -= size;
+    overwritten++;
+}
+
+void CommandCapture::record(uint8_t num, const uint8_t* data, size_t length)
+{
+    if (length > CAPTURE_COMMAND_MAX)
+        length = CAPTURE_COMMAND_MAX;
+    while (used + CAPTURE_HEADER + length > CAPTURE_BUFFER_SIZE)
+        dropOldest();
+    uint32_t time = millis();
+    put(time >> 24);
+    put(time >> 16);
+    put(time >> 8);
+    put(time);
+    put(num);
+    put(length);
+    for (size_t i = 0; i < length; i++)
+        put(data[i]);
+    recorded++;
+}
+
+size_t CommandCapture::write(Print* output)
+{
+    size_t total = 0;
+    /// строка собирается целиком: команда после экранирования не длиннее CAPTURE_COMMAND_MAX * 2
+    char line[24 + CAPTURE_COMMAND_MAX * 2];
+    for (uint16_t position = tail, left = used; left > 0; )
+    {
+        uint32_t time = ((uint32_t) get(position) << 24) | ((uint32_t) get(position + 1) << 16) |
+                        ((uint32_t) get(position + 2) << 8) | get(position + 3);
+        uint8_t length = get(position + 5);
+        size_t lineLength = snprintf(line, sizeof (line), "%lu\t%u\t", (unsigned long) time, get(position + 4));
+        for (uint8_t i = 0; i < length; i++)
+        {
+            char c = get(position + CAPTURE_HEADER + i);
+            const char* escaped = (c == '\t') ? "\\t" : (c == '\n') ? "\\n" : (c == '\r') ? "\\r" : (c == '\\') ? "\\\\" : NULL;
+            if (escaped)
+            {
+                line[lineLength++] = escaped[0];
+                line[lineLength++] = escaped[1];
+            } else
+                line[lineLength++] = c;
+        }
+        line[lineLength++] = '\n';
+        if (output)
+            output->write((const uint8_t*) line, lineLength);
+        total += lineLength;
+        position = (position + CAPTURE_HEADER + length) % CAPTURE_BUFFER_SIZE;
+        left -= CAPTURE_HEADER + length;
+    }
+    return total;
+}
@@ -0,0 +1,57 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <Arduino.h>
+
+/// размер кольцевого буфера записи команд, байт
+#define CAPTURE_BUFFER_SIZE 2048
+/// максимальная длина записываемой команды, длинные команды обрезаются
+#define CAPTURE_COMMAND_MAX 255
+
+/** запись входящих команд вебсокета с временем и номером клиента в кольцевой
+ * буфер: новые записи вытесняют самые старые, так что в буфере всегда последние
+ * команды перед проблемой. Выгружается текстом, строка на команду:
+ * "время_мс\tклиент\tкоманда", символы \t, \n, \r и \\ в команде экранируются
+ */
+class CommandCapture
+{
+public:
+    /**
+     * Конструктор класса
+     */
+    CommandCapture();
+    /**
+     * Записать команду
+     * @param num номер клиента
+     * @param data текст команды
+     * @param length длина команды
+     */
+    void record(uint8_t num, const uint8_t* data, size_t length);
+    /**
+     * Очистить буфер
+     */
+    void clear();
+    /**
+     * Выгрузить записи от старых к новым
+     * @param output куда писать текст, NULL - только посчитать длину
+     * @return длина текста
+     */
+    size_t write(Print* output);
+    uint32_t recorded;                  ///< количество записанных команд
+    uint32_t overwritten;               ///< количество команд, вытесненных новыми
+
+private:
+    uint8_t buffer[CAPTURE_BUFFER_SIZE];///< записи: время (4 байта), клиент, длина, текст
+    uint16_t head;                      ///< позиция следующей записи
+    uint16_t tail;                      ///< позиция самой старой записи
+    uint16_t used;                      ///< занято байт
+
+    void put(uint8_t value);
+    uint8_t get(uint16_t position) { return buffer[position % CAPTURE_BUFFER_SIZE]; }
+    /**
+     * Удалить самую старую запись
+     */
+    void dropOldest();
+};
+
+#endif /* CAPTURE_H */
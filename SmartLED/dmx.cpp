@@ -0,0 +1,308 @@
+#include "dmx.h"
+
+/// идентификатор пакета E1.31 (ACN Packet Identifier)
+const uint8_t sacnIdentifier[12] PROGMEM = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+/// идентификатор пакета Art-Net
+const uint8_t artnetIdentifier[8] PROGMEM = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+
+DmxReceiver::DmxReceiver()
+{
+    protocols = 0;
+    firstUniverse = 1;
+    universe = 0;
+    data = NULL;
+    length = 0;
+    offset = 0;
+    push = false;
+    lastPacket = 0;
+    received = 0;
+    dropped = 0;
+    late = 0;
+    frames = 0;
+    fps = 0;
+    ddpSequence = 0;
+    fpsStart = 0;
+    fpsFrames = 0;
+    terminated = false;
+    dataFrame = 0;
+    frameBytes = 0;
+    memset(sequence, 0xFF, sizeof (sequence));
+}
+
+void DmxReceiver::begin(uint16_t first, uint8_t prot)
+{
+    stop();
+    firstUniverse = first;
+    protocols = prot;
+    memset(sequence, 0xFF, sizeof (sequence));
+    ddpSequence = 0;
+    dataFrame = 0;
+    frameBytes = 0;
+    /// мультикаст подключается только для первого универса, остальные можно передавать адресно
+    if (protocols & DPSacn)
+        sacn.beginMulticast(WiFi.localIP(), IPAddress(239, 255, firstUniverse >> 8, firstUniverse & 0xFF), DMX_SACN_PORT);
+    if (protocols & DPArtNet)
+        artnet.begin(DMX_ARTNET_PORT);
+    if (protocols & DPDdp)
+        ddp.begin(DMX_DDP_PORT);
+}
+
+void DmxReceiver::stop()
+{
+    if (protocols & DPSacn)
+        sacn.stop();
+    if (protocols & DPArtNet)
+        artnet.stop();
+    if (protocols & DPDdp)
+        ddp.stop();
+    protocols = 0;
+}
+
+bool DmxReceiver::read()
+{
+    uint16_t size;
+    while ((protocols & DPSacn) && ((size = receive(sacn)) > 0))
+    {
+        if (parseSacn(size))
+            return true;
+    }
+    while ((protocols & DPArtNet) && ((size = receive(artnet)) > 0))
+    {
+        if (parseArtNet(size))
+            return true;
+    }
+    return false;
+}
+
+bool DmxReceiver::readDdp(uint8_t* frame, uint32_t frameSize)
+{
+    int size;
+    while ((protocols & DPDdp) && ((size = ddp.parsePacket()) > 0))
+    {
+        /// версия 1, запросы и ответы (флаги Q и R) не обрабатываются
+        if ((size < DMX_DDP_HEADER) || (ddp.read(packet, DMX_DDP_HEADER) != DMX_DDP_HEADER) ||
+            ((packet[0] & 0xC0) != 0x40) || (packet[0] & 0x06))
+        {
+            dropped++;
+            continue;
+        }
+        uint16_t header = DMX_DDP_HEADER;
+        /// флаг T - после заголовка идет временная метка, DdpSender передает в ней номер кадра
+        bool hasFrame = packet[0] & 0x10;
+        uint32_t frameNumber = 0;
+        if (hasFrame)
+        {
+            if ((size < DMX_DDP_HEADER + 4) || (ddp.read(&packet[DMX_DDP_HEADER], 4) != 4))
+            {
+                dropped++;
+                continue;
+            }
+            header += 4;
+            frameNumber = ((uint32_t) packet[10] << 24) | ((uint32_t) packet[11] << 16) | (packet[12] << 8) | packet[13];
+        }
+        uint8_t seq = packet[1] & 0x0F;
+        if ((seq != 0) && (ddpSequence != 0))
+        {
+            /// номера идут по кругу от 1 до 15
+            uint8_t diff = (seq + 15 - ddpSequence) % 15;
+            if ((diff == 0) || (diff > 7))
+            {
+                late++;
+                continue;
+            }
+            dropped += diff - 1;
+        }
+        if (seq != 0)
+            ddpSequence = seq;
+        uint32_t start = ((uint32_t) packet[4] << 24) | ((uint32_t) packet[5] << 16) | (packet[6] << 8) | packet[7];
+        uint16_t count = (packet[8] << 8) | packet[9];
+        if (count > size - header)
+            count = size - header;
+        offset = start;
+        length = 0;
+        if (start < frameSize)
+        {
+            length = (count < frameSize - start) ? count : frameSize - start;
+            length = ddp.read(&frame[start], length);
+        }
+        push = packet[0] & 0x01;
+        if (hasFrame && (count > 0))
+        {
+            if (frameNumber != dataFrame)
+            {
+                dataFrame = frameNumber;
+                frameBytes = 0;
+            }
+            frameBytes += count;
+        }
+        /// push чужого кадра или push без данных, в смещении которого DdpSender передает размер
+        /// кадра, при потерянной части данных отвергается: вызывающий переносит кадр в ленту
+        /// только по push, поэтому на ней остается предыдущий кадр
+        if (hasFrame && push && ((frameNumber != dataFrame) || ((count == 0) && (start != 0) && (start != frameBytes))))
+        {
+            push = false;
+            late++;
+        }
+        received++;
+        lastPacket = millis();
+        terminated = false;
+        if (push)
+        {
+            frames++;
+            fpsFrames++;
+            if (lastPacket - fpsStart >= 1000)
+            {
+                fps = (fpsFrames * 1000UL) / (lastPacket - fpsStart);
+                fpsFrames = 0;
+                fpsStart = lastPacket;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+uint16_t DmxReceiver::receive(WiFiUDP& udp)
+{
+    int size;
+    /// слишком большой пакет не может быть нашим, его остаток отбрасывается следующим parsePacket
+    while ((size = udp.parsePacket()) > DMX_PACKET_MAX)
+        dropped++;
+    return (size > 0) ? udp.read(packet, size) : 0;
+}
+
+bool DmxReceiver::parseSacn(uint16_t size)
+{
+    /// корневой уровень: идентификатор и вектор VECTOR_ROOT_E131_DATA, уровень
+    /// кадра: вектор VECTOR_E131_DATA_PACKET, уровень DMP: вектор и стартовый код 0
+    if ((size < 126) || (memcmp_P(&packet[4], sacnIdentifier, sizeof (sacnIdentifier)) != 0) ||
+        (packet[21] != 0x04) || (packet[43] != 0x02) || (packet[117] != 0x02) || (packet[125] != 0))
+    {
+        dropped++;
+        return false;
+    }
+    universe = (packet[113] << 8) | packet[114];
+    if ((universe < firstUniverse) || (universe >= firstUniverse + DMX_UNIVERSES_MAX))
+        return false;
+    /// бит 6 опций - источник прекращает передачу
+    if (packet[112] & 0x40)
+    {
+        terminated = true;
+        return false;
+    }
+    if (!checkSequence(packet[111]))
+        return false;
+    uint16_t count = ((packet[123] << 8) | packet[124]) - 1;
+    length = (count < size - 126) ? count : size - 126;
+    if (length > DMX_CHANNELS)
+        length = DMX_CHANNELS;
+    data = &packet[126];
+    return true;
+}
+
+bool DmxReceiver::parseArtNet(uint16_t size)
+{
+    /// OpDmx = 0x5000, передается младшим байтом вперед
+    if ((size < 18) || (memcmp_P(packet, artnetIdentifier, sizeof (artnetIdentifier)) != 0) ||
+        (packet[8] != 0x00) || (packet[9] != 0x50))
+    {
+        /// пакеты ArtPoll и прочие служебные не считаются ошибками
+        return false;
+    }
+    /// адреса портов Art-Net начинаются с 0, универсы sACN - с 1: порт 0 соответствует универсу 1
+    universe = (((packet[15] & 0x7F) << 8) | packet[14]) + 1;
+    if ((universe < firstUniverse) || (universe >= firstUniverse + DMX_UNIVERSES_MAX))
+        return false;
+    /// нулевой номер - источник не использует порядковые номера
+    if (!checkSequence(packet[12], packet[12] != 0))
+        return false;
+    uint16_t count = (packet[16] << 8) | packet[17];
+    length = (count < size - 18) ? count : size - 18;
+    if (length > DMX_CHANNELS)
+        length = DMX_CHANNELS;
+    data = &packet[18];
+    return true;
+}
+
+bool DmxReceiver::checkSequence(uint8_t seq, bool useSequence)
+{
+    uint16_t& last = sequence[universe - firstUniverse];
+    int8_t diff = seq - last;
+    /// после паузы источник мог перезапуститься, поэтому первый пакет принимается всегда
+    bool fresh = (last > 0xFF) || ((millis() - lastPacket) > 1000);
+    if ((useSequence) && (!fresh) && (diff <= 0) && (diff > -20))
+    {
+        late++;
+        return false;
+    }
+    if ((useSequence) && (!fresh) && (diff > 1))
+        dropped += diff - 1;
+    last = seq;
+    received++;
+    lastPacket = millis();
+    terminated = false;
+    return true;
+}
+
+DdpSender::DdpSender()
+{
+    frames = 0;
+    packets = 0;
+    pixelsPerSecond = 0;
+    rateStart = millis();
+    ratePixels = 0;
+    /// тип данных RGB по 8 бит, устройство по умолчанию (1)
+    header[2] = 0x0B;
+    header[3] = 0x01;
+}
+
+void DdpSender::send(RelayTarget& target, const uint8_t* data, uint32_t frame)
+{
+    uint32_t size = target.pixels * 3;
+    for (uint32_t offset = 0; offset < size; offset += DMX_DDP_PAYLOAD)
+    {
+        uint16_t length = (size - offset < DMX_DDP_PAYLOAD) ? size - offset : DMX_DDP_PAYLOAD;
+        sendPacket(target, 0, offset, &data[offset], length, frame);
+    }
+    ratePixels += target.pixels;
+}
+
+void DdpSender::push(RelayTarget* targets, uint8_t count, uint32_t frame)
+{
+    /// пакеты push идут подряд, после данных всех ведомых: ленты переключаются почти одновременно.
+    /// в смещении пакета без данных передается размер кадра для проверки его полноты
+    for (uint8_t i = 0; i < count; i++)
+        sendPacket(targets[i], 0x01, targets[i].pixels * 3, NULL, 0, frame);
+    frames++;
+    uint32_t now = millis();
+    if (now - rateStart >= 1000)
+    {
+        pixelsPerSecond = (ratePixels * 1000ULL) / (now - rateStart);
+        ratePixels = 0;
+        rateStart = now;
+    }
+}
+
+void DdpSender::sendPacket(RelayTarget& target, uint8_t flags, uint32_t offset, const uint8_t* data, uint16_t length, uint32_t frame)
+{
+    /// номера идут по кругу от 1 до 15, у каждого ведомого свой счетчик
+    target.sequence = (target.sequence % 15) + 1;
+    header[0] = 0x40 | 0x10 | flags;
+    header[1] = target.sequence;
+    header[4] = offset >> 24;
+    header[5] = offset >> 16;
+    header[6] = offset >> 8;
+    header[7] = offset;
+    header[8] = length >> 8;
+    header[9] = length;
+    header[10] = frame >> 24;
+    header[11] = frame >> 16;
+    header[12] = frame >> 8;
+    header[13] = frame;
+    udp.beginPacket(target.ip, DMX_DDP_PORT);
+    udp.write(header, sizeof (header));
+    if (length > 0)
+        udp.write(data, length);
+    udp.endPacket();
+    packets++;
+}
@@ -0,0 +1,188 @@
+#ifndef DMX_H
+#define DMX_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+/// порт протокола E1.31 (sACN)
+#define DMX_SACN_PORT 5568
+/// порт протокола Art-Net
+#define DMX_ARTNET_PORT 6454
+/// порт протокола DDP
+#define DMX_DDP_PORT 4048
+/// размер заголовка DDP (без временной метки)
+#define DMX_DDP_HEADER 10
+/// данных в одном пакете DDP, байт (480 пикселей, как у большинства источников)
+#define DMX_DDP_PAYLOAD 1440
+/// максимальный размер принимаемого пакета (пакет sACN с 512 каналами)
+#define DMX_PACKET_MAX 638
+/// количество каналов в одном универсе
+#define DMX_CHANNELS 512
+/// количество универсов подряд, принимаемых одним приемником
+#define DMX_UNIVERSES_MAX 8
+
+/** флаги принимаемых протоколов
+ */
+typedef enum
+{
+    DPSacn          = 0x01,             ///< E1.31 (sACN), мультикаст первого универса и юникаст
+    DPArtNet        = 0x02,             ///< Art-Net (ArtDmx), широковещательные и адресные пакеты
+    DPDdp           = 0x04              ///< DDP, произвольные участки ленты без деления на универсы
+} DmxProtocol;
+
+/** приемник DMX по сети: разбор пакетов sACN и Art-Net прямо в буфере приема,
+ * прием DDP сразу в буфер собираемого кадра, проверка порядковых номеров и учет времени 
+ * последнего пакета
+ */
+class DmxReceiver
+{
+public:
+    /**
+     * Конструктор класса
+     */
+    DmxReceiver();
+    /**
+     * Открыть сокеты для приема
+     * @param firstUniverse первый принимаемый универс sACN (с 1), следующие DMX_UNIVERSES_MAX - 1 тоже принимаются.
+     * Art-Net принимается с адреса порта firstUniverse - 1
+     * @param protocols принимаемые протоколы (DmxProtocol)
+     */
+    void begin(uint16_t firstUniverse, uint8_t protocols);
+    /**
+     * Закрыть сокеты
+     */
+    void stop();
+    /**
+     * Прочитать из сети очередной пакет с данными одного из наших универсов.
+     * Пакеты других универсов, устаревшие и некорректные пакеты пропускаются.
+     * Данные не копируются: data указывает внутрь буфера приема и действительна
+     * до следующего вызова
+     * @return true, если принят пакет с данными
+     */
+    bool read();
+    /**
+     * Прочитать из сети очередной пакет DDP. Данные читаются из сокета сразу в 
+     * буфер кадра по смещению из пакета, то, что не помещается в кадр, отбрасывается.
+     * Устаревшие пакеты (по порядковому номеру) не применяются. Буфер кадра не
+     * должен быть буфером ленты: кадр показывается только при push
+     * @param frame буфер кадра (по 3 байта на пиксель)
+     * @param frameSize размер буфера кадра, байт
+     * @return true, если принят пакет с данными, offset и length описывают записанный участок
+     */
+    bool readDdp(uint8_t* frame, uint32_t frameSize);
+    uint16_t universe;                  ///< универс последнего принятого пакета (для Art-Net - адрес порта + 1)
+    const uint8_t* data;                ///< значения каналов последнего пакета (без стартового кода)
+    uint16_t length;                    ///< количество каналов в последнем пакете (для DDP - байт)
+    uint32_t offset;                    ///< смещение данных последнего пакета DDP в кадре, байт
+    bool push;                          ///< последний пакет DDP завершает кадр, ленту нужно показать
+    uint32_t lastPacket;                ///< время приема последнего пакета, мс
+    uint32_t received;                  ///< количество принятых пакетов с данными
+    uint32_t dropped;                   ///< количество некорректных и потерянных (по разрыву порядковых номеров) пакетов
+    uint32_t late;                      ///< количество пакетов, пришедших позже следующих за ними
+    uint32_t frames;                    ///< количество показанных кадров DDP
+    uint16_t fps;                       ///< частота кадров DDP за последнюю секунду
+    bool terminated;                    ///< источник сообщил о прекращении передачи (sACN)
+    uint32_t dataFrame;                 ///< номер кадра последних данных DDP (из временной метки)
+    uint32_t frameBytes;                ///< байт данных кадра dataFrame, принятых на текущий момент
+
+private:
+    WiFiUDP sacn;                       ///< сокет sACN
+    WiFiUDP artnet;                     ///< сокет Art-Net
+    WiFiUDP ddp;                        ///< сокет DDP
+    uint8_t protocols;                  ///< открытые протоколы
+    uint16_t firstUniverse;             ///< первый принимаемый универс
+    uint16_t sequence[DMX_UNIVERSES_MAX];///< последний порядковый номер по каждому универсу (0xFFFF - пакетов еще не было)
+    uint8_t ddpSequence;                ///< последний порядковый номер DDP (1..15, 0 - не используется)
+    uint32_t fpsStart;                  ///< начало интервала подсчета частоты кадров, мс
+    uint16_t fpsFrames;                 ///< количество кадров в текущем интервале
+    uint8_t packet[DMX_PACKET_MAX];     ///< буфер приема
+
+    /**
+     * Прочитать пакет из сокета в буфер приема
+     * @param udp сокет
+     * @return размер пакета, 0 - пакетов нет
+     */
+    uint16_t receive(WiFiUDP& udp);
+    /**
+     * Разобрать пакет E1.31 в буфере приема
+     * @param size размер пакета
+     * @return true, если пакет содержит данные нашего универса
+     */
+    bool parseSacn(uint16_t size);
+    /**
+     * Разобрать пакет ArtDmx в буфере приема
+     * @param size размер пакета
+     * @return true, если пакет содержит данные нашего универса
+     */
+    bool parseArtNet(uint16_t size);
+    /**
+     * Проверить порядковый номер пакета. Пакет считается устаревшим, если его
+     * номер отстает от последнего не более чем на 20 (как в E1.31), пропуск
+     * номеров учитывается как потеря пакетов
+     * @param seq порядковый номер пакета
+     * @param useSequence false, если источник не использует порядковые номера
+     * @return true, если пакет можно применить
+     */
+    bool checkSequence(uint8_t seq, bool useSequence = true);
+};
+
+/** ведомый контроллер распределенного вывода: адрес и количество пикселей его
+ * участка виртуальной ленты
+ */
+typedef struct
+{
+    IPAddress ip;                       ///< адрес ведомого (режим dmx с протоколом DDP)
+    uint16_t pixels;                    ///< количество пикселей ведомого
+    uint8_t sequence;                   ///< последний порядковый номер DDP, отправленный ведомому
+} RelayTarget;
+
+/** отправка участков кадра по DDP: данные уходят пакетами по DMX_DDP_PAYLOAD
+ * байт без флага push, номер кадра передается во временной метке. Кадр
+ * показывается отдельным пакетом push с тем же номером и размером кадра в поле
+ * смещения, ведомый, не получивший кадр полностью, его не показывает
+ */
+class DdpSender
+{
+public:
+    /**
+     * Конструктор класса
+     */
+    DdpSender();
+    /**
+     * Отправить участок кадра ведомому, ленту он не показывает до push()
+     * @param target ведомый
+     * @param data данные (по 3 байта на пиксель)
+     * @param frame номер кадра
+     */
+    void send(RelayTarget& target, const uint8_t* data, uint32_t frame);
+    /**
+     * Показать кадр у всех ведомых
+     * @param targets ведомые
+     * @param count количество ведомых
+     * @param frame номер кадра
+     */
+    void push(RelayTarget* targets, uint8_t count, uint32_t frame);
+    uint32_t frames;                    ///< количество отправленных кадров
+    uint32_t packets;                   ///< количество отправленных пакетов
+    uint32_t pixelsPerSecond;           ///< пикселей в секунду по всем ведомым за последнюю секунду
+
+private:
+    WiFiUDP udp;
+    uint32_t rateStart;                 ///< начало интервала подсчета пикселей, мс
+    uint32_t ratePixels;                ///< пикселей отправлено в текущем интервале
+    uint8_t header[DMX_DDP_HEADER + 4]; ///< заголовок пакета с временной меткой
+
+    /**
+     * Отправить один пакет DDP
+     * @param target ведомый
+     * @param flags флаги первого байта (кроме версии и T)
+     * @param offset смещение данных в кадре ведомого, байт
+     * @param data данные
+     * @param length длина данных, байт
+     * @param frame номер кадра
+     */
+    void sendPacket(RelayTarget& target, uint8_t flags, uint32_t offset, const uint8_t* data, uint16_t length, uint32_t frame);
+};
+
+#endif /* DMX_H */
@@ -0,0 +1,286 @@
+#include "json.h"
+
+JsonWriter::JsonWriter(Print* output)
+{
+    this->output = output;
+    total = 0;
+    used = 0;
+    needComma = false;
+}
+
+void JsonWriter::write(const char* data, size_t length)
+{
+    total += length;
+    if (!output)
+        return;
+    while (length > 0)
+    {
+        size_t part = sizeof(buffer) - used;
+        if (part > length)
+            part = length;
+        memcpy(&buffer[used], data, part);
+        used += part;
+        data += part;
+        length -= part;
+        if (used == sizeof(buffer))
+            flush();
+    }
+}
+
+void JsonWriter::flush()
+{
+    if (output && (used > 0))
+        output->write((const uint8_t*) buffer, used);
+    used = 0;
+}
+
+void JsonWriter::writeKey(const char* key)
+{
+    if (needComma)
+        write(",", 1);
+    needComma = true;
+    if (key)
+    {
+        writeString(key);
+        write(":", 1);
+    }
+}
+
+void JsonWriter::writeString(const char* text)
+{
+    write("\"", 1);
+    const char* start = text;
+    for (; *text; text++)
+    {
+        uint8_t c = *text;
+        if ((c == '"') || (c == '\\') || (c < 0x20))
+        {
+            write(start, text - start);
+            char escaped[8];
+            if (c < 0x20)
+                write(escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", c));
+            else
+            {
+                escaped[0] = '\\';
+                escaped[1] = c;
+                write(escaped, 2);
+            }
+            start = text + 1;
+        }
+    }
+    write(start, text - start);
+    write("\"", 1);
+}
+
+void JsonWriter::beginObject(const char* key)
+{
+    writeKey(key);
+    write("{", 1);
+    needComma = false;
+}
+
+void JsonWriter::endObject()
+{
+    write("}", 1);
+    needComma = true;
+}
+
+void JsonWriter::value(const char* key, int32_t value)
+{
+    char number[12];
+    writeKey(key);
+    write(number, snprintf(number, sizeof(number), "%d", value));
+}
+
+void JsonWriter::value(const char* key, bool value)
+{
+    writeKey(key);
+    write(value ? "true" : "false");
+}
+
+void JsonWriter::value(const char* key, const char* value)
+{
+    writeKey(key);
+    writeString(value);
+}
+
+void JsonWriter::array(const char* key, const int32_t* values, uint8_t count)
+{
+    char number[12];
+    writeKey(key);
+    write("[", 1);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+            write(",", 1);
+        write(number, snprintf(number, sizeof(number), "%d", values[i]));
+    }
+    write("]", 1);
+}
+
+JsonObjectReader::JsonObjectReader(char* json)
+{
+    pos = json;
+    failed = false;
+    started = false;
+}
+
+void JsonObjectReader::skipSpaces()
+{
+    while ((*pos == ' ') || (*pos == '\t') || (*pos == '\r') || (*pos == '\n'))
+        pos++;
+}
+
+char* JsonObjectReader::parseString()
+{
+    if (*pos != '"')
+        return NULL;
+    char* start = ++pos;
+    char* out = start;
+    /// текст сдвигается на место escape-последовательностей, \u не поддерживается
+    while (*pos && (*pos != '"'))
+    {
+        char c = *pos++;
+        if (c == '\\')
+        {
+            c = *pos;
+            if (!c)
+                return NULL;
+            pos++;
+            switch (c)
+            {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case '"':
+                case '\\':
+                case '/': break;
+                default: return NULL;
+            }
+        }
+        *out++ = c;
+    }
+    if (*pos != '"')
+        return NULL;
+    pos++;
+    *out = 0;
+    return start;
+}
+
+char* JsonObjectReader::parseToken()
+{
+    char* start = pos;
+    while ((*pos == '-') || (*pos == '+') || (*pos == '.') || isalnum((unsigned char) *pos))
+        pos++;
+    size_t length = pos - start;
+    if (length == 0)
+        return NULL;
+    /// значение сдвигается на место двоеточия или пробела перед ним, чтобы не затереть разделитель после него
+    char* value = start - 1;
+    if ((length == 4) && (strncmp(start, "true", 4) == 0))
+        strcpy(value, "1");
+    else if ((length == 5) && (strncmp(start, "false", 5) == 0))
+        strcpy(value, "0");
+    else if ((length == 4) && (strncmp(start, "null", 4) == 0))
+        return NULL;
+    else
+    {
+        memmove(value, start, length);
+        value[length] = 0;
+    }
+    return value;
+}
+
+char* JsonObjectReader::parseArray()
+{
+    char* value = pos;
+    char* out = pos;
+    pos++;
+    skipSpaces();
+    if (*pos == ']')
+    {
+        pos++;
+        *out = 0;
+        return value;
+    }
+    /// числа переписываются с начала массива через ';', результат короче исходного текста
+    while (true)
+    {
+        skipSpaces();
+        char* start = pos;
+        while ((*pos == '-') || (*pos == '+') || isdigit((unsigned char) *pos))
+            pos++;
+        if (pos == start)
+            return NULL;
+        memmove(out, start, pos - start);
+        out += pos - start;
+        skipSpaces();
+        if (*pos == ',')
+        {
+            *out++ = ';';
+            pos++;
+        } else if (*pos == ']')
+        {
+            pos++;
+            *out = 0;
+            return value;
+        } else
+            return NULL;
+    }
+}
+
+bool JsonObjectReader::next(char*& key, char*& value)
+{
+    if (failed || !pos)
+        return false;
+    skipSpaces();
+    if (!started)
+    {
+        started = true;
+        if (*pos != '{')
+        {
+            failed = true;
+            return false;
+        }
+        pos++;
+        skipSpaces();
+        if (*pos == '}')
+        {
+            pos = NULL;
+            return false;
+        }
+    }
+    key = parseString();
+    if (key)
+        skipSpaces();
+    if (!key || (*pos != ':'))
+    {
+        failed = true;
+        return false;
+    }
+    pos++;
+    skipSpaces();
+    if (*pos == '"')
+        value = parseString();
+    else if (*pos == '[')
+        value = parseArray();
+    else
+        value = parseToken();
+    if (!value)
+    {
+        failed = true;
+        return false;
+    }
+    skipSpaces();
+    /// после последнего поля разбор закончен, остаток текста не проверяется
+    if (*pos == ',')
+        pos++;
+    else if (*pos == '}')
+        pos = NULL;
+    else
+    {
+        failed = true;
+        return false;
+    }
+    return true;
+}
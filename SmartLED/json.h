@@ -0,0 +1,95 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <Arduino.h>
+
+/// размер буфера JsonWriter: данные уходят в сокет порциями такого размера
+#define JSON_BUFFER_SIZE 128
+
+/** потоковая запись JSON: текст собирается в небольшом буфере и сразу уходит
+ * в Print (например, WiFiClient), без String и выделений памяти. Без Print
+ * только считается длина, чтобы заранее отправить Content-Length
+ */
+class JsonWriter
+{
+public:
+    /**
+     * Конструктор класса
+     * @param output куда писать JSON, NULL - только считать длину
+     */
+    JsonWriter(Print* output);
+    /**
+     * Открыть объект
+     * @param key имя поля во внешнем объекте, NULL - для корневого объекта
+     */
+    void beginObject(const char* key = NULL);
+    /**
+     * Закрыть объект
+     */
+    void endObject();
+    void value(const char* key, int32_t value);
+    void value(const char* key, bool value);
+    void value(const char* key, const char* value);
+    /**
+     * Записать массив чисел
+     * @param key имя поля
+     * @param values числа
+     * @param count количество чисел
+     */
+    void array(const char* key, const int32_t* values, uint8_t count);
+    /**
+     * Отправить остаток буфера
+     */
+    void flush();
+    /**
+     * Количество записанных байт
+     */
+    size_t length() { return total; }
+private:
+    Print* output;                      ///< получатель данных, NULL - только подсчет длины
+    size_t total;                       ///< байт записано с начала
+    uint8_t used;                       ///< байт в буфере
+    bool needComma;                     ///< перед следующим полем нужна запятая
+    char buffer[JSON_BUFFER_SIZE];
+
+    void write(const char* data, size_t length);
+    void write(const char* text) { write(text, strlen(text)); }
+    void writeKey(const char* key);
+    void writeString(const char* text);
+};
+
+/** разбор плоского JSON-объекта на месте, без выделения памяти. Значения
+ * приводятся к виду, который понимает SmartLED::setOption: строки без кавычек,
+ * true/false - 1/0, массивы чисел - через точку с запятой ("[255,0,0]" - "255;0;0")
+ */
+class JsonObjectReader
+{
+public:
+    /**
+     * Конструктор класса
+     * @param json текст объекта, изменяется при разборе
+     */
+    JsonObjectReader(char* json);
+    /**
+     * Получить следующую пару имя-значение
+     * @param key имя поля
+     * @param value значение поля
+     * @return false, если поля закончились или JSON некорректен (см. error())
+     */
+    bool next(char*& key, char*& value);
+    /**
+     * Признак ошибки разбора
+     */
+    bool error() { return failed; }
+private:
+    char* pos;                          ///< текущая позиция разбора
+    bool failed;                        ///< JSON некорректен
+    bool started;                       ///< открывающая скобка уже пройдена
+
+    void skipSpaces();
+    char* parseString();
+    char* parseToken();
+    char* parseArray();
+};
+
+#endif
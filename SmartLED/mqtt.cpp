@@ -0,0 +1,343 @@
+#include "mqtt.h"
+
+/// типы пакетов MQTT (старшие 4 бита первого байта)
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_PINGREQ 0xC0
+
+MqttClient::MqttClient()
+{
+    host = NULL;
+    port = MQTT_PORT;
+    clientId = NULL;
+    willTopic = NULL;
+    subscriptionCount = 0;
+    callback = NULL;
+    accepted = false;
+    resolved = false;
+    retryInterval = MQTT_RECONNECT_INTERVAL;
+    lastConnect = 0;
+    lastSent = 0;
+    lastReceived = 0;
+    lastPing = 0;
+    packetId = 1;
+    rxState = 0;
+    txUsed = 0;
+    txOverflow = false;
+    sessions = 0;
+    received = 0;
+    published = 0;
+    dropped = 0;
+}
+
+void MqttClient::begin(const char* h, uint16_t p, const char* id, const char* will)
+{
+    host = h;
+    port = p;
+    clientId = id;
+    willTopic = will;
+    resolved = false;
+    retryInterval = MQTT_RECONNECT_INTERVAL;
+    /// ограничивает и установку соединения, и запись в сокет
+    client.setTimeout(MQTT_CONNECT_TIMEOUT);
+    /// первая попытка подключения - на ближайшем проходе loop()
+    lastConnect = millis() - retryInterval;
+}
+
+bool MqttClient::subscribe(const char* topic)
+{
+    if (subscriptionCount >= MQTT_SUBSCRIPTIONS_MAX)
+        return false;
+    subscriptions[subscriptionCount++] = topic;
+    if (connected())
+        sendSubscribe();
+    return true;
+}
+
+void MqttClient::loop()
+{
+    if (!host)
+        return;
+    uint32_t now = millis();
+    if (!client.connected())
+    {
+        accepted = false;
+        if (now - lastConnect >= retryInterval)
+            connect();
+        return;
+    }
+    /// за один проход разбирается все, что уже пришло, но ожидания данных нет
+    while (client.available() > 0)
+    {
+        if (rxState == 0)
+        {
+            rxHeader = client.read();
+            rxLength = 0;
+            rxShift = 0;
+            rxRead = 0;
+            rxState = 1;
+            continue;
+        }
+        if (rxState == 1)
+        {
+            uint8_t lengthByte = client.read();
+            rxLength |= (uint32_t) (lengthByte & 0x7F) << rxShift;
+            rxShift += 7;
+            if (lengthByte & 0x80)
+            {
+                /// длина занимает не больше 4 байт, иначе поток испорчен
+                if (rxShift > 21)
+                {
+                    client.stop();
+                    return;
+                }
+                continue;
+            }
+            rxState = 2;
+        } else
+        {
+            uint32_t part = rxLength - rxRead;
+            uint32_t available = client.available();
+            if (part > available)
+                part = available;
+            if (rxLength <= MQTT_BUFFER_SIZE)
+                client.read(&buffer[rxRead], part);
+            else
+            {
+                /// пакет не помещается в буфер, читаем его впустую
+                uint8_t skip[32];
+                if (part > sizeof (skip))
+                    part = sizeof (skip);
+                client.read(skip, part);
+            }
+            rxRead += part;
+        }
+        if (rxRead == rxLength)
+        {
+            rxState = 0;
+            lastReceived = millis();
+            if (rxLength <= MQTT_BUFFER_SIZE)
+                handlePacket();
+            else
+                dropped++;
+        }
+    }
+    now = millis();
+    /// PINGREQ нужен и при частой публикации: без входящих пакетов соединение считается
+    /// потерянным, поэтому молчащего брокера опрашиваем раз в половину keep alive
+    if (accepted && ((now - lastSent >= MQTT_KEEPALIVE * 500UL) ||
+        ((now - lastReceived >= MQTT_KEEPALIVE * 500UL) && (now - lastPing >= MQTT_KEEPALIVE * 500UL))))
+    {
+        putHeader(MQTT_PINGREQ, 0);
+        sendTx();
+        lastPing = now;
+    }
+    /// брокер отвечает на PINGREQ, долгое молчание означает потерянное соединение
+    if (now - lastReceived >= MQTT_KEEPALIVE * 1500UL)
+    {
+        client.stop();
+        accepted = false;
+    }
+}
+
+void MqttClient::connect()
+{
+    lastConnect = millis();
+    accepted = false;
+    rxState = 0;
+    if (!resolved)
+    {
+        /// адрес в виде чисел разбирается без DNS, соединение - на следующем проходе loop()
+        if (brokerIP.fromString(host))
+            resolved = true;
+        else if (WiFi.hostByName(host, brokerIP, MQTT_CONNECT_TIMEOUT) == 1)
+        {
+            resolved = true;
+            lastConnect -= retryInterval;
+            return;
+        } else
+        {
+            backoff();
+            return;
+        }
+    }
+    if (!client.connect(brokerIP, port))
+    {
+        /// брокер мог сменить адрес, при следующей попытке имя ищется заново
+        resolved = false;
+        backoff();
+        return;
+    }
+    /// пакеты собираются целиком, ждать накопления данных (алгоритм Нейгла) незачем
+    client.setNoDelay(true);
+    lastSent = millis();
+    lastReceived = lastSent;
+    lastPing = lastSent;
+    uint8_t flags = 0x02;               ///< clean session
+    uint32_t length = 10 + 2 + strlen(clientId);
+    if (willTopic)
+    {
+        flags |= 0x24;                  ///< will flag и will retain, QoS 0
+        length += 2 + strlen(willTopic) + 2 + 7;
+    }
+    putHeader(MQTT_CONNECT, length);
+    putString("MQTT");
+    put(4);                             ///< версия протокола 3.1.1
+    put(flags);
+    put(MQTT_KEEPALIVE >> 8);
+    put(MQTT_KEEPALIVE & 0xFF);
+    putString(clientId);
+    if (willTopic)
+    {
+        putString(willTopic);
+        putString("offline");
+    }
+    if (!sendTx())
+        client.stop();
+}
+
+void MqttClient::backoff()
+{
+    retryInterval = (retryInterval < MQTT_RECONNECT_MAX / 2) ? retryInterval * 2 : MQTT_RECONNECT_MAX;
+}
+
+void MqttClient::sendSubscribe()
+{
+    if (subscriptionCount == 0)
+        return;
+    uint32_t length = 2;
+    for (uint8_t i = 0; i < subscriptionCount; i++)
+        length += 2 + strlen(subscriptions[i]) + 1;
+    putHeader(MQTT_SUBSCRIBE, length);
+    put(packetId >> 8);
+    put(packetId & 0xFF);
+    for (uint8_t i = 0; i < subscriptionCount; i++)
+    {
+        putString(subscriptions[i]);
+        put(0);                         ///< QoS 0
+    }
+    if (++packetId == 0)
+        packetId = 1;
+    sendTx();
+}
+
+void MqttClient::handlePacket()
+{
+    switch (rxHeader & 0xF0)
+    {
+        case MQTT_CONNACK:
+            if ((rxLength >= 2) && (buffer[1] == 0))
+            {
+                accepted = true;
+                retryInterval = MQTT_RECONNECT_INTERVAL;
+                sessions++;
+                sendSubscribe();
+            } else
+            {
+                client.stop();
+                backoff();
+            }
+            break;
+        case MQTT_PUBLISH:
+            handlePublish();
+            break;
+        default:
+            /// SUBACK и PINGRESP только обновляют время последнего входящего пакета
+            break;
+    }
+}
+
+void MqttClient::handlePublish()
+{
+    if (rxLength < 2)
+        return;
+    uint16_t topicLength = (buffer[0] << 8) | buffer[1];
+    /// подписки с QoS 0, но при QoS > 0 после топика идет идентификатор пакета
+    uint32_t payloadStart = 2 + topicLength + (((rxHeader >> 1) & 0x03) ? 2 : 0);
+    if (payloadStart > rxLength)
+        return;
+    /// топик сдвигается на место своей длины, чтобы завершить его нулем, не затирая сообщение
+    memmove(buffer, &buffer[2], topicLength);
+    buffer[topicLength] = 0;
+    buffer[rxLength] = 0;
+    received++;
+    if (callback)
+        callback((char*) buffer, (char*) &buffer[payloadStart], rxLength - payloadStart);
+}
+
+bool MqttClient::publish(const char* topic, const char* payload, bool retain)
+{
+    if (!connected())
+        return false;
+    size_t payloadLength = strlen(payload);
+    putHeader(MQTT_PUBLISH | (retain ? 0x01 : 0x00), 2 + strlen(topic) + payloadLength);
+    putString(topic);
+    put((const uint8_t*) payload, payloadLength);
+    if (!sendTx())
+        return false;
+    published++;
+    return true;
+}
+
+Print* MqttClient::beginPublish(const char* topic, uint32_t length, bool retain)
+{
+    if (!connected())
+        return NULL;
+    putHeader(MQTT_PUBLISH | (retain ? 0x01 : 0x00), 2 + strlen(topic) + length);
+    putString(topic);
+    if (!sendTx())
+        return NULL;
+    published++;
+    return &client;
+}
+
+void MqttClient::putHeader(uint8_t header, uint32_t length)
+{
+    txUsed = 0;
+    txOverflow = false;
+    put(header);
+    /// длина остатка пакета: по 7 бит, старший бит - признак продолжения
+    do
+    {
+        uint8_t lengthByte = length & 0x7F;
+        length >>= 7;
+        if (length > 0)
+            lengthByte |= 0x80;
+        put(lengthByte);
+    } while (length > 0);
+}
+
+void MqttClient::put(const uint8_t* data, size_t length)
+{
+    if (txUsed + length > sizeof (txBuffer))
+    {
+        txOverflow = true;
+        return;
+    }
+    memcpy(&txBuffer[txUsed], data, length);
+    txUsed += length;
+}
+
+void MqttClient::putString(const char* text)
+{
+    size_t length = strlen(text);
+    put(length >> 8);
+    put(length & 0xFF);
+    put((const uint8_t*) text, length);
+}
+
+bool MqttClient::sendTx()
+{
+    if (txOverflow || !client.connected())
+        return false;
+    lastSent = millis();
+    if (client.write(txBuffer, txUsed) != txUsed)
+    {
+        client.stop();
+        accepted = false;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,152 @@
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+
+/// стандартный порт брокера MQTT
+#define MQTT_PORT 1883
+/// интервал keep alive, с: при отсутствии исходящих или входящих пакетов отправляется PINGREQ
+#define MQTT_KEEPALIVE 15
+/// пауза между попытками подключения к брокеру, мс; после каждой неудачи удваивается до MQTT_RECONNECT_MAX.
+/// Попытка выполняет не больше одной блокирующей операции (поиск адреса или TCP-соединение), поэтому
+/// при недоступном брокере loop() и лента стоят не дольше MQTT_CONNECT_TIMEOUT раз в паузу:
+/// 250 мс раз в 5 с сначала, 250 мс раз в 80 с в худшем установившемся случае
+#define MQTT_RECONNECT_INTERVAL 5000
+/// наибольшая пауза между попытками подключения, мс
+#define MQTT_RECONNECT_MAX 80000
+/// предельное время поиска адреса брокера и установки TCP-соединения, мс
+#define MQTT_CONNECT_TIMEOUT 250
+/// размер буфера входящего пакета, пакеты длиннее пропускаются
+#define MQTT_BUFFER_SIZE 256
+/// размер буфера исходящего пакета: заголовок, топик и короткое сообщение
+#define MQTT_TX_BUFFER_SIZE 128
+/// количество подписок, восстанавливаемых при каждом подключении
+#define MQTT_SUBSCRIPTIONS_MAX 4
+
+/** обработчик входящего сообщения, topic и payload завершаются нулем и
+ * действительны только до возврата из обработчика
+ */
+typedef void (*MqttCallback)(char* topic, char* payload, uint16_t length);
+
+/** минимальный клиент MQTT 3.1.1 (QoS 0): входящие пакеты собираются в
+ * фиксированном буфере без блокировки loop(), исходящие собираются в небольшом
+ * фиксированном буфере и уходят в сокет одной записью, длинные сообщения
+ * передаются через beginPublish() частями
+ */
+class MqttClient
+{
+public:
+    /**
+     * Конструктор класса
+     */
+    MqttClient();
+    /**
+     * Задать брокер и параметры сессии, подключение выполняется в loop()
+     * @param host адрес брокера
+     * @param port порт брокера
+     * @param clientId идентификатор клиента
+     * @param willTopic топик, в который брокер опубликует "offline" (retained) при обрыве связи, NULL - без завещания
+     */
+    void begin(const char* host, uint16_t port, const char* clientId, const char* willTopic);
+    /**
+     * Добавить подписку. Строка не копируется и должна существовать все время работы клиента
+     * @param topic фильтр топиков
+     * @return false, если подписок слишком много
+     */
+    bool subscribe(const char* topic);
+    /**
+     * Задать обработчик входящих сообщений
+     */
+    void onMessage(MqttCallback callback) { this->callback = callback; }
+    /**
+     * Обработать входящие пакеты, поддержать соединение или переподключиться
+     */
+    void loop();
+    /**
+     * Опубликовать короткое сообщение
+     * @param topic топик
+     * @param payload текст сообщения
+     * @param retain сохранить сообщение на брокере
+     * @return false, если нет соединения или топик с сообщением не помещаются в буфер
+     */
+    bool publish(const char* topic, const char* payload, bool retain);
+    /**
+     * Начать публикацию сообщения заранее известной длины. Ровно length байт
+     * нужно записать в возвращенный Print до следующего вызова loop()
+     * @param topic топик
+     * @param length длина сообщения, байт
+     * @param retain сохранить сообщение на брокере
+     * @return куда писать сообщение, NULL - нет соединения или топик не помещается в буфер
+     */
+    Print* beginPublish(const char* topic, uint32_t length, bool retain);
+    /**
+     * Соединение установлено и принято брокером
+     */
+    bool connected() { return accepted && client.connected(); }
+    uint32_t sessions;                  ///< количество сессий, принятых брокером (для повторной публикации состояния)
+    uint32_t received;                  ///< количество принятых сообщений
+    uint32_t published;                 ///< количество отправленных сообщений
+    uint32_t dropped;                   ///< количество пропущенных входящих пакетов (длиннее буфера)
+
+private:
+    WiFiClient client;
+    const char* host;
+    uint16_t port;
+    const char* clientId;
+    const char* willTopic;
+    const char* subscriptions[MQTT_SUBSCRIPTIONS_MAX];
+    uint8_t subscriptionCount;
+    MqttCallback callback;
+    bool accepted;                      ///< получен CONNACK без ошибки
+    IPAddress brokerIP;                 ///< адрес брокера, найденный по имени
+    bool resolved;                      ///< brokerIP действителен
+    uint32_t retryInterval;             ///< текущая пауза между попытками подключения, мс
+    uint32_t lastConnect;               ///< время последней попытки подключения, мс
+    uint32_t lastSent;                  ///< время последнего исходящего пакета, мс
+    uint32_t lastReceived;              ///< время последнего входящего пакета, мс
+    uint32_t lastPing;                  ///< время последнего PINGREQ, мс
+    uint16_t packetId;                  ///< идентификатор следующего пакета SUBSCRIBE
+    /// состояние разбора входящего пакета
+    uint8_t rxState;                    ///< 0 - первый байт, 1 - длина, 2 - тело
+    uint8_t rxHeader;                   ///< первый байт пакета (тип и флаги)
+    uint8_t rxShift;                    ///< сдвиг очередного байта длины
+    uint32_t rxLength;                  ///< длина тела пакета
+    uint32_t rxRead;                    ///< прочитано байт тела
+    uint8_t buffer[MQTT_BUFFER_SIZE + 1]; ///< тело входящего пакета, +1 байт для завершающего нуля сообщения
+    uint8_t txBuffer[MQTT_TX_BUFFER_SIZE]; ///< собираемый исходящий пакет
+    uint8_t txUsed;                     ///< байт в txBuffer
+    bool txOverflow;                    ///< пакет не поместился в txBuffer
+
+    /**
+     * Одна попытка подключения: поиск адреса брокера, если он еще не известен,
+     * иначе TCP-соединение и CONNECT. Каждый шаг ограничен MQTT_CONNECT_TIMEOUT
+     */
+    void connect();
+    /**
+     * Попытка не удалась: удвоить паузу перед следующей
+     */
+    void backoff();
+    void sendSubscribe();
+    void handlePacket();
+    void handlePublish();
+    /**
+     * Начать исходящий пакет: первый байт и длина остатка пакета
+     * @param header первый байт (тип и флаги)
+     * @param length длина остатка пакета
+     */
+    void putHeader(uint8_t header, uint32_t length);
+    void put(const uint8_t* data, size_t length);
+    void put(uint8_t value) { put(&value, 1); }
+    /**
+     * Добавить строку с двухбайтовой длиной впереди
+     */
+    void putString(const char* text);
+    /**
+     * Отправить собранный пакет
+     * @return false, если пакет не поместился в буфер или соединения нет
+     */
+    bool sendTx();
+};
+
+#endif /* MQTT_H */
@@ -0,0 +1,23 @@
+#include "prng.h"
+
+void FastRandom::fill(uint8_t* data, size_t length)
+{
+    while (length >= 4)
+    {
+        uint32_t value = next();
+        memcpy(data, &value, 4);
+        data += 4;
+        length -= 4;
+    }
+    if (length > 0)
+    {
+        uint32_t value = next();
+        memcpy(data, &value, length);
+    }
+}
+
+void FastRandom::fill(uint8_t* data, size_t length, uint8_t howsmall, uint8_t howbig)
+{
+    for (size_t i = 0; i < length; i++)
+        data[i] = range(howsmall, howbig);
+}
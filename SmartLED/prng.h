@@ -0,0 +1,103 @@
+#ifndef PRNG_H
+#define PRNG_H
+
+#include <Arduino.h>
+
+/** быстрый генератор псевдослучайных чисел для эффектов (xorshift32): три сдвига
+ * и три исключающих ИЛИ на число вместо деления в random(). Диапазон получается
+ * умножением (метод Лемира) без смещения распределения, деление выполняется только
+ * в редком случае отбраковки. С одним зерном эффект повторяется кадр в кадр
+ */
+class FastRandom
+{
+public:
+    /**
+     * Конструктор класса
+     * @param value зерно
+     */
+    FastRandom(uint32_t value = 1) { seed(value); }
+    /**
+     * Задать зерно. Нулевое состояние у xorshift недопустимо, зерно перемешивается с константой
+     * @param value зерно
+     */
+    void seed(uint32_t value)
+    {
+        state = value ^ 0x9E3779B9UL;
+        if (state == 0)
+            state = 1;
+    }
+    /**
+     * Следующее 32-битное число
+     */
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+    /**
+     * Число от 0 до howbig - 1, как random(howbig)
+     * @param howbig граница диапазона (не включается), 0 и меньше - результат 0
+     */
+    int32_t range(int32_t howbig)
+    {
+        return (howbig > 0) ? below(howbig) : 0;
+    }
+    /**
+     * Число от howsmall до howbig - 1, как random(howsmall, howbig)
+     * @param howsmall нижняя граница
+     * @param howbig верхняя граница (не включается), при howbig <= howsmall результат howsmall
+     */
+    int32_t range(int32_t howsmall, int32_t howbig)
+    {
+        return (howbig > howsmall) ? howsmall + (int32_t) below(howbig - howsmall) : howsmall;
+    }
+    /**
+     * Событие с вероятностью percent из 100, замена random(100) < percent
+     */
+    bool chance(uint8_t percent)
+    {
+        return below(100) < percent;
+    }
+    /**
+     * Заполнить буфер случайными байтами, по 4 байта за шаг генератора
+     * @param data буфер
+     * @param length длина буфера
+     */
+    void fill(uint8_t* data, size_t length);
+    /**
+     * Заполнить буфер случайными байтами из диапазона (например, компоненты цвета)
+     * @param data буфер
+     * @param length длина буфера
+     * @param howsmall нижняя граница
+     * @param howbig верхняя граница (не включается)
+     */
+    void fill(uint8_t* data, size_t length, uint8_t howsmall, uint8_t howbig);
+
+private:
+    uint32_t state;                     ///< состояние генератора, не 0
+
+    /**
+     * Число от 0 до bound - 1 без смещения: старшая половина произведения на bound,
+     * значения из неполного последнего интервала отбрасываются
+     * @param bound граница диапазона, больше 0
+     */
+    uint32_t below(uint32_t bound)
+    {
+        uint64_t product = (uint64_t) next() * bound;
+        uint32_t low = (uint32_t) product;
+        if (low < bound)
+        {
+            uint32_t threshold = (0 - bound) % bound;
+            while (low < threshold)
+            {
+                product = (uint64_t) next() * bound;
+                low = (uint32_t) product;
+            }
+        }
+        return product >> 32;
+    }
+};
+
+#endif /* PRNG_H */
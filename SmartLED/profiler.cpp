@@ -0,0 +1,119 @@
+#include "profiler.h"
+
+LoopProfiler profiler;
+
+/// названия участков для JSON, в порядке ProfilePhase
+const char* const phaseNames[PPMAX] = { "loop", "handleClient", "webSocket", "modifier", "effect", "show", "autosave", "mqtt", "command" };
+
+LoopProfiler::LoopProfiler()
+{
+    overheadCycles = 0;
+    reset();
+}
+
+void LoopProfiler::end(ProfilePhase phase, uint32_t start)
+{
+    uint32_t cycles = ESP.getCycleCount() - start;
+    PhaseStats& s = stats[phase];
+    /// номер интервала: 4 интервала на каждое удвоение, значения до 3 тактов - отдельно
+    uint8_t bucket = cycles;
+    if (cycles >= PROFILER_SUBBUCKETS)
+    {
+        uint8_t msb = 31 - __builtin_clz(cycles);
+        bucket = msb * PROFILER_SUBBUCKETS + ((cycles >> (msb - 2)) & (PROFILER_SUBBUCKETS - 1));
+    }
+    /// при переполнении интервала вся гистограмма уменьшается вдвое, форма распределения сохраняется
+    if (s.histogram[bucket] == 0xFFFF)
+    {
+        for (int i = 0; i < PROFILER_BUCKETS; i++)
+            s.histogram[i] >>= 1;
+    }
+    s.histogram[bucket]++;
+    s.count++;
+    if (cycles > s.max)
+        s.max = cycles;
+}
+
+void LoopProfiler::frame()
+{
+    if (commandPending)
+    {
+        end(PPCommand, commandStart);
+        commandPending = false;
+    }
+    fpsFrames++;
+    uint32_t now = millis();
+    if (now - fpsStart >= 1000)
+    {
+        fps = (fpsFrames * 1000UL) / (now - fpsStart);
+        fpsFrames = 0;
+        fpsStart = now;
+    }
+}
+
+void LoopProfiler::command()
+{
+    if (commandPending)
+        return;
+    commandStart = ESP.getCycleCount();
+    commandPending = true;
+}
+
+uint32_t LoopProfiler::percentile(ProfilePhase phase, uint8_t percent)
+{
+    PhaseStats& s = stats[phase];
+    uint32_t total = 0;
+    for (int i = 0; i < PROFILER_BUCKETS; i++)
+        total += s.histogram[i];
+    if (total == 0)
+        return 0;
+    uint32_t target = (total * percent + 99) / 100;
+    uint32_t sum = 0;
+    for (int i = 0; i < PROFILER_BUCKETS; i++)
+    {
+        sum += s.histogram[i];
+        if (sum >= target)
+        {
+            /// нижняя граница интервала
+            if (i < PROFILER_SUBBUCKETS)
+                return toMicros(i);
+            uint8_t msb = i / PROFILER_SUBBUCKETS;
+            return toMicros((uint32_t) (PROFILER_SUBBUCKETS + i % PROFILER_SUBBUCKETS) << (msb - 2));
+        }
+    }
+    return toMicros(s.max);
+}
+
+void LoopProfiler::calibrate()
+{
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < 32; i++)
+        end(PPLoop, begin());
+    overheadCycles = (ESP.getCycleCount() - start) / 32;
+    reset();
+}
+
+void LoopProfiler::reset()
+{
+    memset(stats, 0, sizeof (stats));
+    fps = 0;
+    fpsFrames = 0;
+    fpsStart = millis();
+    missedDeadlines = 0;
+    commandPending = false;
+}
+
+size_t LoopProfiler::toJson(char* buffer, size_t size)
+{
+    size_t len = snprintf(buffer, size, "{\"fps\":%u,\"missed\":%u,\"overheadCycles\":%u,\"cpuMHz\":%u,\"phases\":{",
+                          fps, missedDeadlines, overheadCycles, ESP.getCpuFreqMHz());
+    for (int i = 0; (i < PPMAX) && (len < size); i++)
+    {
+        len += snprintf(&buffer[len], size - len, "%s\"%s\":{\"count\":%u,\"p50\":%u,\"p99\":%u,\"max\":%u}",
+                        (i > 0) ? "," : "", phaseNames[i], stats[i].count,
+                        percentile((ProfilePhase) i, 50), percentile((ProfilePhase) i, 99), toMicros(stats[i].max));
+    }
+    if (len < size)
+        len += snprintf(&buffer[len], size - len, "}}");
+    return (len < size) ? len : size - 1;
+}
@@ -0,0 +1,114 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+
+/// количество интервалов гистограммы на каждое удвоение времени
+#define PROFILER_SUBBUCKETS 4
+/// количество интервалов гистограммы (32 удвоения счетчика тактов)
+#define PROFILER_BUCKETS (32 * PROFILER_SUBBUCKETS)
+
+/** измеряемые участки главного цикла
+ */
+typedef enum
+{
+    PPLoop          = 0,                ///< весь проход loop() без задержки в конце
+    PPHandleClient,                     ///< обработка HTTP-запросов (server.handleClient())
+    PPWebSocket,                        ///< обработка вебсокета (webSocket->loop())
+    PPModifier,                         ///< шаг модификатора
+    PPEffect,                           ///< шаг эффекта
+    PPShow,                             ///< вывод данных в ленту (strip->show())
+    PPAutosave,                         ///< автосохранение настроек
+    PPMqtt,                             ///< обработка MQTT (mqtt.loop() и публикация состояния)
+    PPCommand,                          ///< от приема команды до вывода следующего кадра в ленту
+    PPMAX                               ///< количество участков
+} ProfilePhase;
+
+/** статистика одного участка
+ */
+typedef struct
+{
+    uint32_t count;                     ///< количество измерений
+    uint32_t max;                       ///< максимальное время, тактов
+    uint16_t histogram[PROFILER_BUCKETS]; ///< гистограмма времени в логарифмической шкале
+} PhaseStats;
+
+/** профилировщик главного цикла: время участков считается в тактах процессора и
+ * складывается в логарифмическую гистограмму, по которой оцениваются перцентили
+ */
+class LoopProfiler
+{
+public:
+    /**
+     * Конструктор класса
+     */
+    LoopProfiler();
+    /**
+     * Начать измерение участка
+     * @return отметка времени для end(), такты
+     */
+    uint32_t begin() { return ESP.getCycleCount(); }
+    /**
+     * Завершить измерение участка
+     * @param phase участок
+     * @param start отметка времени, полученная от begin()
+     */
+    void end(ProfilePhase phase, uint32_t start);
+    /**
+     * Отметить вывод кадра в ленту (для расчета частоты кадров)
+     */
+    void frame();
+    /**
+     * Отметить прием команды (смена режима или параметра). Время до ближайшего
+     * кадра попадает в участок PPCommand, команды до этого кадра не учитываются
+     */
+    void command();
+    /**
+     * Отметить шаг эффекта, выполненный с опозданием больше чем на кадр
+     */
+    void missed() { missedDeadlines++; }
+    /**
+     * Оценить перцентиль времени участка
+     * @param phase участок
+     * @param percent перцентиль, от 1 до 100
+     * @return время, мкс
+     */
+    uint32_t percentile(ProfilePhase phase, uint8_t percent);
+    /**
+     * Измерить собственные затраты пары begin()/end() и сбросить статистику
+     */
+    void calibrate();
+    /**
+     * Сбросить статистику
+     */
+    void reset();
+    /**
+     * Сформировать статистику в формате JSON
+     * @param buffer буфер для строки
+     * @param size размер буфера
+     * @return длина строки
+     */
+    size_t toJson(char* buffer, size_t size);
+    uint16_t fps;                       ///< частота вывода кадров за последнюю секунду
+    uint32_t missedDeadlines;           ///< количество опозданий эффекта больше чем на кадр
+    uint32_t overheadCycles;            ///< затраты на одно измерение, тактов
+
+private:
+    PhaseStats stats[PPMAX];            ///< статистика участков
+    uint32_t fpsStart;                  ///< начало интервала подсчета частоты кадров, мс
+    uint16_t fpsFrames;                 ///< количество кадров в текущем интервале
+    uint32_t commandStart;              ///< время приема первой команды, еще не выведенной в ленту, такты
+    bool commandPending;                ///< есть команда, еще не выведенная в ленту
+
+    /**
+     * Перевести такты в микросекунды
+     * @param cycles количество тактов
+     * @return время, мкс
+     */
+    static uint32_t toMicros(uint32_t cycles) { return cycles / ESP.getCpuFreqMHz(); }
+};
+
+/// профилировщик главного цикла, общий для скетча и SmartLED
+extern LoopProfiler profiler;
+
+#endif /* PROFILER_H */
@@ -2,31 +2,156 @@
 
 SmartLED* led = NULL;
 
-bool splitValueString(char* src, char* option, char* value)
+/// встроенные палитры, каждая заканчивается точкой с позицией 255
+const PaletteKey paletteRainbow[] PROGMEM = {
+    {0, 255, 0, 0}, {43, 255, 255, 0}, {85, 0, 255, 0}, {128, 0, 255, 255}, 
+    {171, 0, 0, 255}, {213, 255, 0, 255}, {255, 255, 0, 0}
+};
+const PaletteKey paletteFire[] PROGMEM = {
+    {0, 0, 0, 0}, {85, 255, 0, 0}, {170, 255, 255, 0}, {255, 255, 255, 255}
+};
+const PaletteKey paletteOcean[] PROGMEM = {
+    {0, 0, 0, 32}, {96, 0, 64, 160}, {176, 0, 192, 255}, {216, 128, 255, 255}, {255, 0, 0, 32}
+};
+const PaletteKey paletteForest[] PROGMEM = {
+    {0, 0, 32, 0}, {80, 32, 128, 0}, {160, 96, 192, 32}, {208, 0, 96, 32}, {255, 0, 32, 0}
+};
+const PaletteKey paletteParty[] PROGMEM = {
+    {0, 85, 0, 171}, {64, 255, 0, 85}, {128, 255, 170, 0}, {192, 0, 170, 85}, {255, 85, 0, 171}
+};
+const PaletteKey* const builtinPalettes[PIMAX] PROGMEM = {
+    NULL, paletteRainbow, paletteFire, paletteOcean, paletteForest, paletteParty
+};
+
+/// четверть периода синуса, 128 + 127 * sin(i * pi / 128)
+const uint8_t sineQuarter[65] PROGMEM = {
+    128, 131, 134, 137, 140, 144, 147, 150, 153, 156, 159, 162, 165, 168, 171, 174, 
+    177, 179, 182, 185, 188, 191, 193, 196, 199, 201, 204, 206, 209, 211, 213, 216, 
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 239, 240, 241, 243, 244, 
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255, 255
+};
+
+/// шрифт 5x7 для символов с кодами 32..95, каждый символ - 5 столбцов, младший бит сверху
+const uint8_t font5x7[64 * 5] PROGMEM = {
+    0x00,0x00,0x00,0x00,0x00, 0x00,0x00,0x5F,0x00,0x00, 0x00,0x07,0x00,0x07,0x00, 0x14,0x7F,0x14,0x7F,0x14, // ' ' ! " #
+    0x24,0x2A,0x7F,0x2A,0x12, 0x23,0x13,0x08,0x64,0x62, 0x36,0x49,0x55,0x22,0x50, 0x00,0x05,0x03,0x00,0x00, // $ % & '
+    0x00,0x1C,0x22,0x41,0x00, 0x00,0x41,0x22,0x1C,0x00, 0x08,0x2A,0x1C,0x2A,0x08, 0x08,0x08,0x3E,0x08,0x08, // ( ) * +
+    0x00,0x50,0x30,0x00,0x00, 0x08,0x08,0x08,0x08,0x08, 0x00,0x60,0x60,0x00,0x00, 0x20,0x10,0x08,0x04,0x02, // , - . /
+    0x3E,0x51,0x49,0x45,0x3E, 0x00,0x42,0x7F,0x40,0x00, 0x42,0x61,0x51,0x49,0x46, 0x21,0x41,0x45,0x4B,0x31, // 0 1 2 3
+    0x18,0x14,0x12,0x7F,0x10, 0x27,0x45,0x45,0x45,0x39, 0x3C,0x4A,0x49,0x49,0x30, 0x01,0x71,0x09,0x05,0x03, // 4 5 6 7
+    0x36,0x49,0x49,0x49,0x36, 0x06,0x49,0x49,0x29,0x1E, 0x00,0x36,0x36,0x00,0x00, 0x00,0x56,0x36,0x00,0x00, // 8 9 : ;
+    0x08,0x14,0x22,0x41,0x00, 0x14,0x14,0x14,0x14,0x14, 0x00,0x41,0x22,0x14,0x08, 0x02,0x01,0x51,0x09,0x06, // < = > ?
+    0x32,0x49,0x79,0x41,0x3E, 0x7E,0x11,0x11,0x11,0x7E, 0x7F,0x49,0x49,0x49,0x36, 0x3E,0x41,0x41,0x41,0x22, // @ A B C
+    0x7F,0x41,0x41,0x22,0x1C, 0x7F,0x49,0x49,0x49,0x41, 0x7F,0x09,0x09,0x01,0x01, 0x3E,0x41,0x41,0x51,0x32, // D E F G
+    0x7F,0x08,0x08,0x08,0x7F, 0x00,0x41,0x7F,0x41,0x00, 0x20,0x40,0x41,0x3F,0x01, 0x7F,0x08,0x14,0x22,0x41, // H I J K
+    0x7F,0x40,0x40,0x40,0x40, 0x7F,0x02,0x04,0x02,0x7F, 0x7F,0x04,0x08,0x10,0x7F, 0x3E,0x41,0x41,0x41,0x3E, // L M N O
+    0x7F,0x09,0x09,0x09,0x06, 0x3E,0x41,0x51,0x21,0x5E, 0x7F,0x09,0x19,0x29,0x46, 0x46,0x49,0x49,0x49,0x31, // P Q R S
+    0x01,0x01,0x7F,0x01,0x01, 0x3F,0x40,0x40,0x40,0x3F, 0x1F,0x20,0x40,0x20,0x1F, 0x7F,0x20,0x18,0x20,0x7F, // T U V W
+    0x63,0x14,0x08,0x14,0x63, 0x03,0x04,0x78,0x04,0x03, 0x61,0x51,0x49,0x45,0x43, 0x00,0x7F,0x41,0x41,0x00, // X Y Z [
+    0x02,0x04,0x08,0x10,0x20, 0x00,0x41,0x41,0x7F,0x00, 0x04,0x02,0x01,0x02,0x04, 0x40,0x40,0x40,0x40,0x40  // \ ] ^ _
+};
+
+/**
+ * Синус для 8-битного угла (256 - полный период)
+ * @param theta угол
+ * @return значение от 1 до 255, 128 соответствует нулю
+ */
+uint8_t sin8(uint8_t theta)
 {
-    char* part = strtok (src, ":");
-    if (part != 0)
+    uint8_t idx = theta & 0x3F;
+    switch (theta >> 6)
     {
-        strcpy(option, part);
-        part = strtok (NULL, ":");
-        if (part != 0)
-            strcpy(value, part);
-        else
-            return false;
-    } else 
-    {
-        return false;
+        case 0: return pgm_read_byte(&sineQuarter[idx]);
+        case 1: return pgm_read_byte(&sineQuarter[64 - idx]);
+        case 2: return 256 - pgm_read_byte(&sineQuarter[idx]);
+        default: return 256 - pgm_read_byte(&sineQuarter[64 - idx]);
     }
+}
+
+/** разбор "параметр:значение" на месте, без копирования: строка делится по первому ':',
+ * так что значение (например, текст) может само содержать ':'
+ * @param src строка команды, должна заканчиваться нулем
+ * @param option указатель на имя параметра внутри src
+ * @param value указатель на значение внутри src
+ * @return false, если имя или значение пустые
+ */
+bool splitValueString(char* src, char*& option, char*& value)
+{
+    char* separator = strchr(src, ':');
+    if (!separator || (separator == src) || (separator[1] == 0))
+        return false;
+    *separator = 0;
+    option = src;
+    value = separator + 1;
     return true;
 }
 
+/** разбор "a;b;c" без изменения строки, пустые части пропускаются
+ * @param valueString строка значения
+ * @param values три числа
+ * @return true, если частей ровно три
+ */
+bool splitTriple(const char* valueString, int32_t* values)
+{
+    uint8_t count = 0;
+    while (*valueString)
+    {
+        if (*valueString == ';')
+        {
+            valueString++;
+            continue;
+        }
+        if (count == 3)
+            return false;
+        values[count++] = atol(valueString);
+        valueString += strcspn(valueString, ";");
+    }
+    return count == 3;
+}
+
+/// значения параметров уходят клиенту вебсокета сообщениями "секция:параметр:значение"
+class WebSocketSink : public ValueSink
+{
+public:
+    WebSocketSink(SmartLED* led, uint8_t num) : led(led), num(num) {}
+    void value(const char* section, const char* option, int32_t value) { led->sendValue(num, section, option, value); }
+    void value(const char* section, const char* option, bool value) { led->sendValue(num, section, option, value); }
+    void value(const char* section, const char* option, RGBColor value) { led->sendValue(num, section, option, value); }
+    void value(const char* section, const char* option, RGBValue value) { led->sendValue(num, section, option, value); }
+    void value(const char* section, const char* option, const char* value) { led->sendValue(num, section, option, value); }
+private:
+    SmartLED* led;
+    uint8_t num;
+};
+
+/// значения параметров становятся полями объекта секции, цвета - массивами [r,g,b]
+class JsonSink : public ValueSink
+{
+public:
+    JsonSink(JsonWriter& json) : json(json) {}
+    void value(const char* section, const char* option, int32_t value) { json.value(option, value); }
+    void value(const char* section, const char* option, bool value) { json.value(option, value); }
+    void value(const char* section, const char* option, RGBColor value)
+    {
+        int32_t rgb[3] = { value.r, value.g, value.b };
+        json.array(option, rgb, 3);
+    }
+    void value(const char* section, const char* option, RGBValue value)
+    {
+        int32_t rgb[3] = { value.r, value.g, value.b };
+        json.array(option, rgb, 3);
+    }
+    void value(const char* section, const char* option, const char* value) { json.value(option, value); }
+private:
+    JsonWriter& json;
+};
+
 void webSocketEvent(uint8_t num, WStype_t type, uint8_t * buffer, size_t len)
 {
-    char incoming[len+2];
-    memset(incoming, 0, len+2);
-    memcpy(incoming, (char*)buffer, len);
-    char optionName[24];
-    char optionValue[24];
+    /// библиотека отдает текст в собственном буфере с нулем в конце, команды разбираются прямо в нем
+    char* command = (char*) buffer;
+    char* optionName;
+    char* optionValue;
     IPAddress ip = led->remoteIP(num);
     switch(type) 
     {
@@ -38,25 +163,30 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * buffer, size_t len)
             led->sendTXT(num, "Connected");
             led->sendCurrentValues(num);
             break;
+        case WStype_DROPPED:
+            /// клиент не успевал принимать и пропустил часть изменений, отправляем текущее состояние целиком
+            Serial.printf("[%u] Send queue overflow, resync\n", num);
+            led->sendCurrentValues(num);
+            break;
         case WStype_TEXT:
-            switch (buffer[0])
+            led->capture.record(num, buffer, len);
+            /// пустое сообщение приходит без буфера
+            if (len == 0)
+                break;
+            switch (command[0])
             {
-                case '#': led->selectMode((const char *) &incoming[1]);
+                case '#': led->selectMode(&command[1]);
                           Serial.print("New mode selected :");
                           Serial.println(led->mode());
                           led->sendTXT(num, "selectMode done");
                           break;
-                case '$': memset(optionName, 0, sizeof(optionName));
-                          memset(optionValue, 0, sizeof(optionValue));
-                          if (!splitValueString((char *) &incoming[1], optionName, optionValue)) 
+                case '$': if (!splitValueString(&command[1], optionName, optionValue))
                               return;
                           led->setOption(optionName, optionValue);
                           Serial.printf("[$] Option %s done\n", optionName, optionValue);
                           led->sendTXT(num, "setOption done");
                           break;
-                case '@': memset(optionName, 0, sizeof(optionName));
-                          memset(optionValue, 0, sizeof(optionValue));
-                          if (!splitValueString((char *) &incoming[1], optionName, optionValue)) 
+                case '@': if (!splitValueString(&command[1], optionName, optionValue))
                               return;
                           led->setOption(optionName, optionValue);
                           Serial.printf("[@] Option %s done\n", optionName, optionValue);
@@ -64,6 +194,25 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * buffer, size_t len)
                           break;
                 case '?': led->dump();
                           break;
+                case '!': {
+                              /// "!кадров" - контрольные суммы, "!кадров:режим:кадр" - еще и пиксели одного кадра
+                              char* dumpMode = strchr(&command[1], ':');
+                              char* dumpFrame = (dumpMode) ? strchr(dumpMode + 1, ':') : NULL;
+                              if (dumpFrame)
+                              {
+                                  *dumpFrame++ = 0;
+                                  led->sendFrameDigest(num, atoi(&command[1]), led->findMode(dumpMode + 1), atoi(dumpFrame));
+                              } else
+                                  led->sendFrameDigest(num, atoi(&command[1]));
+                          }
+                          break;
+                case '%': {
+                              char stats[768];
+                              profiler.toJson(stats, sizeof(stats));
+                              led->sendTXT(num, stats);
+                              led->sendMemory(num);
+                          }
+                          break;
                 default:
                           Serial.println("Unknown operation");
                           break;
@@ -72,53 +221,251 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * buffer, size_t len)
     }
 }
 
-SmartLED::SmartLED(uint8_t pCount, uint8_t pPin, neoPixelType colorScheme, bool ue)
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+/** событие вебсокета, отложенное до loop(). В событийном режиме библиотека вызывает
+ * обработчик из обработчиков TCP (контекст SYS), где нельзя уступать управление
+ * (yield() приводит к панике), писать EEPROM и долго отправлять ответы, поэтому там
+ * событие только копируется в очередь, а webSocketEvent выполняется из process()
+ */
+typedef struct
+{
+    uint8_t num;                        ///< номер клиента
+    WStype_t type;                      ///< тип события
+    uint16_t length;                    ///< длина данных
+    uint8_t data[WEBSOCKET_QUEUE_COMMAND + 1]; ///< данные события с нулем в конце
+} QueuedEvent;
+
+QueuedEvent eventQueue[WEBSOCKET_QUEUE_SIZE];
+/// очередь с одним писателем (SYS) и одним читателем (loop()), которые не вытесняют друг друга
+volatile uint8_t eventHead = 0;         ///< следующий свободный элемент
+volatile uint8_t eventTail = 0;         ///< следующий необработанный элемент
+/// клиенты, чьи команды не поместились в очередь: им отправляется текущее состояние целиком
+volatile uint32_t eventResync = 0;
+
+void queueWebSocketEvent(uint8_t num, WStype_t type, uint8_t * buffer, size_t len)
+{
+    if ((type != WStype_TEXT) && (type != WStype_CONNECTED) && (type != WStype_DISCONNECTED) && (type != WStype_DROPPED))
+        return;
+    uint8_t next = (eventHead + 1) % WEBSOCKET_QUEUE_SIZE;
+    if ((next == eventTail) || ((type == WStype_TEXT) && (len > WEBSOCKET_QUEUE_COMMAND)))
+    {
+        eventResync |= 1UL << num;
+        return;
+    }
+    QueuedEvent& event = eventQueue[eventHead];
+    /// для остальных событий данные - только адрес подключения, его можно обрезать
+    if (len > WEBSOCKET_QUEUE_COMMAND)
+        len = WEBSOCKET_QUEUE_COMMAND;
+    event.num = num;
+    event.type = type;
+    event.length = len;
+    if (len > 0)
+        memcpy(event.data, buffer, len);
+    event.data[len] = 0;
+    eventHead = next;
+}
+
+void processWebSocketQueue()
+{
+    while (eventTail != eventHead)
+    {
+        QueuedEvent& event = eventQueue[eventTail];
+        webSocketEvent(event.num, event.type, event.data, event.length);
+        eventTail = (eventTail + 1) % WEBSOCKET_QUEUE_SIZE;
+    }
+    for (uint8_t num = 0; eventResync; num++)
+        if (eventResync & (1UL << num))
+        {
+            eventResync &= ~(1UL << num);
+            Serial.printf("[%u] Command queue overflow, resync\n", num);
+            led->sendCurrentValues(num);
+        }
+}
+#endif
+
+SmartLED::SmartLED(uint16_t pCount, uint8_t pPin, neoPixelType colorScheme, bool ue)
+{
+    MatrixLayout layout = {pCount, 1, 0, 0, LayoutRows};
+    buildLayout(layout);
+    initialize(pPin, colorScheme, ue);
+};
+
+SmartLED::SmartLED(const MatrixLayout& layout, uint8_t pPin, neoPixelType colorScheme, bool ue)
+{
+    buildLayout(layout);
+    initialize(pPin, colorScheme, ue);
+};
+
+void SmartLED::initialize(uint8_t pPin, neoPixelType colorScheme, bool ue)
 {
     defaultSpeed = 100;
     modifier = 0;
     zeroSpeed = 0;
-    pixelCount = pCount;
-    strip = new Adafruit_NeoPixel(pCount, pPin, colorScheme);
+    effectTime = 0;
+    audio = NULL;
+    dmx = NULL;
+    ddpFrame = NULL;
+    dmxActive = false;
+    changes = 0;
+    syncSteps = 0;
+    lastStep = 0;
+    syncChanges = 0;
+    syncCycleMode = MIMAX;
+    syncTrim = 0;
+    effectSeed = 0;
+    relay = NULL;
+    relayTargets = NULL;
+    relayCount = 0;
+    localPixels = pixelCount;
+    relayFrame = 0;
+    pixelPin = pPin;
+    strip = ws_new<Adafruit_NeoPixel>(WSmem_app, pixelCount, pPin, colorScheme);
+    /// порядок цветов кодируется в colorScheme так же, как его разбирает Adafruit_NeoPixel
+    stripOffset[0] = (colorScheme >> 4) & 0x03;
+    stripOffset[1] = (colorScheme >> 2) & 0x03;
+    stripOffset[2] = colorScheme & 0x03;
+    stripPacked = (((colorScheme >> 6) & 0x03) == stripOffset[0]);
     strip->begin();
-    readyLeds = (RGBColor*) malloc(sizeof (RGBColor) * pCount);
-    modSettings.leds = (RGBColor*) malloc(sizeof (RGBColor) * pCount);
-    fLeds = (RGBFloat*) malloc(sizeof (RGBFloat) * pCount);
+    readyLeds = (RGBColor*) ws_malloc(sizeof (RGBColor) * pixelCount, WSmem_app);
+    modSettings.leds = (RGBColor*) ws_malloc(sizeof (RGBColor) * pixelCount, WSmem_app);
+    fLeds = (RGBFloat*) ws_malloc(sizeof (RGBFloat) * pixelCount, WSmem_app);
+    heat = (uint8_t*) ws_malloc(pixelCount, WSmem_app);
     useEEPROM = ue;
     setDefaultValues();
     nextUpdate = millis() + refreshRate;
+    nextTelemetry = millis() + telemetryPeriod;
     needToUpdate = false;
+    frameUnchanged = false;
     microsOverflow = false;
     led = this;
     
-    webSocket = new WebSocketsServer(81);
+    webSocket = ws_new<WebSocketsServer>(WSmem_app, 81, "", "arduino", WEBSOCKET_CLIENTS);
+    /// длинные сообщения (профиль, телеметрия) уходят сжатыми, если браузер поддерживает permessage-deflate
+    webSocket->enableDeflate();
     webSocket->begin();
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    webSocket->onEvent(queueWebSocketEvent);
+#else
     webSocket->onEvent(webSocketEvent);
+#endif
     
     strip->show();
-};
+}
+
+void SmartLED::buildLayout(const MatrixLayout& layout)
+{
+    pixelCount = layout.width * layout.height;
+    uint8_t rotation = layout.flags & LayoutRotateMask;
+    bool swapped = (rotation == LayoutRotate90) || (rotation == LayoutRotate270);
+    matrixWidth = swapped ? layout.height : layout.width;
+    matrixHeight = swapped ? layout.width : layout.height;
+    xyMap = (uint16_t*) ws_malloc(sizeof (uint16_t) * pixelCount, WSmem_app);
+    
+    uint16_t tw = (layout.tileWidth > 0) ? layout.tileWidth : layout.width;
+    uint16_t th = (layout.tileHeight > 0) ? layout.tileHeight : layout.height;
+    uint16_t tilesX = layout.width / tw;
+    for (uint16_t py = 0; py < layout.height; py++)
+    {
+        for (uint16_t px = 0; px < layout.width; px++)
+        {
+            /// номер модуля и координаты пикселя внутри него
+            uint16_t tx = px / tw, ty = py / th;
+            uint16_t ux = px % tw, uy = py % th;
+            if ((layout.flags & LayoutTileSerpentine) && (ty & 1))
+                tx = tilesX - 1 - tx;
+            uint16_t idx;
+            if (layout.flags & LayoutColumns)
+            {
+                if ((layout.flags & LayoutSerpentine) && (ux & 1))
+                    uy = th - 1 - uy;
+                idx = ux * th + uy;
+            } else
+            {
+                if ((layout.flags & LayoutSerpentine) && (uy & 1))
+                    ux = tw - 1 - ux;
+                idx = uy * tw + ux;
+            }
+            idx += (ty * tilesX + tx) * tw * th;
+            /// координаты пикселя после поворота матрицы
+            uint16_t x, y;
+            switch (rotation)
+            {
+                case LayoutRotate90:
+                    x = layout.height - 1 - py;
+                    y = px;
+                    break;
+                case LayoutRotate180:
+                    x = layout.width - 1 - px;
+                    y = layout.height - 1 - py;
+                    break;
+                case LayoutRotate270:
+                    x = py;
+                    y = layout.width - 1 - px;
+                    break;
+                default:
+                    x = px;
+                    y = py;
+                    break;
+            }
+            xyMap[y * matrixWidth + x] = idx;
+        }
+    }
+}
 
 SmartLED::~SmartLED() 
 {
-    delete webSocket;
-    delete strip;
-    free(readyLeds);
-    free(modSettings.leds);
-    free(fLeds);
+    ws_delete(webSocket);
+    ws_delete(strip);
+    ws_free(readyLeds);
+    ws_free(modSettings.leds);
+    ws_free(fLeds);
+    ws_free(xyMap);
+    ws_free(heat);
+    ws_delete(audio);
+    ws_delete(dmx);
+    ws_free(ddpFrame);
+    ws_delete(relay);
 };
 
 void SmartLED::selectModeByID(ModeID mID)
 {
+    /// при переходе в режим dmx запоминаем эффект, к которому нужно вернуться без пакетов
+    if ((mID == MIDmx) && (settings.mode < MIDmx))
+        settings.dmx.fallback = settings.mode;
+    if ((mID != MIDmx) && (dmx))
+    {
+        ws_delete(dmx);
+        dmx = NULL;
+        ws_free(ddpFrame);
+        ddpFrame = NULL;
+    }
     settings.mode = (ModeID) mID;
     effect = modes[settings.mode].effect;
+    seedEffect();
     settings.specialMode = (mID < MICycle) ? MIOff : mID;
     (this->*effect)(true);
     lastSaved = millis();
     needToSave = true;
+    changes++;
     modSettings.effectPaused = false;
     modifier = 0;
 }
 
+void SmartLED::seedEffect()
+{
+    rng.seed((effectSeed != 0) ? effectSeed : ESP.random());
+}
+
 void SmartLED::selectMode(const char* modeName)
+{
+    profiler.command();
+    ModeID mID = findMode(modeName);
+    if (mID == MIMAX)
+        mID = MIOff;
+    selectModeByID(mID);
+}
+
+ModeID SmartLED::findMode(const char* modeName)
 {
     int i;
     for (i = 0; i < MIMAX; i++)
@@ -126,9 +473,7 @@ void SmartLED::selectMode(const char* modeName)
         if (strcmp(modeName, modes[i].modeName) == 0)
             break;
     }
-    if (i == MIMAX)
-        i = MIOff;
-    selectModeByID((ModeID) i);
+    return (ModeID) i;
 }
 
 ModeID SmartLED::mode()
@@ -139,8 +484,9 @@ ModeID SmartLED::mode()
 uint32_t SmartLED::calculateStep(uint8_t speed, uint16_t stepBase)
 {
     needToUpdate = true;
-    uint32_t maxStep = ((stepBase == 0) ? modes[settings.mode].stepBase : stepBase) * 100 + 1000;
-    uint32_t result = micros() + (maxStep - (speed * modes[settings.mode].stepBase));
+    ModeID running = runningMode();
+    uint32_t maxStep = ((stepBase == 0) ? modes[running].stepBase : stepBase) * 100 + 1000;
+    uint32_t result = micros() + (maxStep - (speed * modes[running].stepBase));
     if (micros() > result)
     {
         microsOverflow = true;
@@ -148,9 +494,23 @@ uint32_t SmartLED::calculateStep(uint8_t speed, uint16_t stepBase)
     return result;
 }
 
+ModeID SmartLED::runningMode()
+{
+    if ((settings.mode == MIDmx) && (!dmxActive))
+        return (settings.dmx.fallback < MIDmx) ? (ModeID) settings.dmx.fallback : MIOff;
+    return settings.mode;
+}
+
 void SmartLED::process()
 {
+    uint32_t phaseStart = profiler.begin();
+#if (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    /// данные разбираются в обработчиках TCP, здесь выполняются накопленные ими команды
+    processWebSocketQueue();
+#else
     webSocket->loop();
+#endif
+    profiler.end(PPWebSocket, phaseStart);
     uint32_t currentMicros = micros();
     if (microsOverflow)
     {
@@ -162,7 +522,9 @@ void SmartLED::process()
     /// модификатор можно выполнять только если указатель не нулевой, и уже пришло время для следующего шага
     if ((modifier) && (currentMicros > nextStep) && (!microsOverflow))
     {
+        phaseStart = profiler.begin();
         (this->*modifier)();
+        profiler.end(PPModifier, phaseStart);
         currentMicros = micros();
     }
     if ((!modSettings.effectPaused) && (millis() > settings.cycle.nextChange) && (!microsOverflow))
@@ -176,19 +538,279 @@ void SmartLED::process()
         }
         currentMicros = micros();
     }
+    if ((settings.mode == MIDmx) && (dmx))
+        receiveDmx();
+    /// звук оцифровывается понемногу на каждом проходе, а не только в шаге эффекта
+    if ((settings.mode == MIAudio) && (audio))
+        audio->capture();
+    if (frameSync.role != SRNone)
+    {
+        processSync();
+        currentMicros = micros();
+    }
     /// эффект можно выполнять только в том случае, если скорость эффекта не нулевая, 
     /// пришло время для следующего шага и при этом эффект временно не заблокирован модификатором
     if ((*effectSpeed != 0) && (currentMicros > nextStep) && (!modSettings.effectPaused) && (!microsOverflow))
     {
+        if (currentMicros - nextStep > refreshRate * 1000)
+            profiler.missed();
+        bool pendingUpdate = needToUpdate;
+        phaseStart = profiler.begin();
         (this->*effect)(false);
+        profiler.end(PPEffect, phaseStart);
         nextStep = calculateStep(abs(*effectSpeed));
+        if (frameUnchanged)
+        {
+            needToUpdate = pendingUpdate;
+            frameUnchanged = false;
+        }
+        syncSteps++;
+        lastStep = currentMicros;
+        if (frameSync.role == SRFollower)
+            nextStep -= syncTrim;
     }
     if (needToUpdate)
     {
+        if (relay)
+            sendRelay();
+        phaseStart = profiler.begin();
         strip->show();
+        profiler.end(PPShow, phaseStart);
+        profiler.frame();
         needToUpdate = false;
     }
+    phaseStart = profiler.begin();
     autosave();
+    profiler.end(PPAutosave, phaseStart);
+    if (millis() > nextTelemetry)
+    {
+        sendMemory(allClients);
+        nextTelemetry = millis() + telemetryPeriod;
+    }
+}
+
+void SmartLED::sendFrameDigest(uint8_t num, uint16_t frames, ModeID dumpMode, uint16_t dumpFrame)
+{
+    if (frames > DIGEST_FRAMES_MAX)
+        frames = DIGEST_FRAMES_MAX;
+    size_t messageSize = 32 + frames * 9;
+    size_t dumpSize = 48 + pixelCount * 6;
+    Configuration* saved = (Configuration*) ws_malloc(sizeof (Configuration), WSmem_app);
+    char* message = (char*) ws_malloc(messageSize, WSmem_app);
+    if ((!saved) || (!message))
+    {
+        ws_free(saved);
+        ws_free(message);
+        sendTXT(num, "digest:error:no memory");
+        return;
+    }
+    memcpy(saved, &settings, sizeof (Configuration));
+    bool savedNeedToSave = needToSave;
+    uint32_t savedLastSaved = lastSaved;
+    for (int m = MIOff; m < MIAudio; m++)
+    {
+        resetDigest((ModeID) m);
+        size_t length = snprintf(message, messageSize, "digest:%s:", modes[m].modeName);
+        for (uint16_t frame = 0; frame < frames; frame++)
+        {
+            uint32_t hash = stepDigest();
+            length += snprintf(&message[length], messageSize - length, "%s%08x", (frame > 0) ? ";" : "", hash);
+            if ((m == dumpMode) && (frame == dumpFrame))
+            {
+                /// кадр для поиска первого отличающегося пикселя уходит раньше строки сумм
+                char* dump = (char*) ws_malloc(dumpSize, WSmem_app);
+                if (dump)
+                {
+                    size_t dumpLength = snprintf(dump, dumpSize, "frame:%s:%u:", modes[m].modeName, frame);
+                    for (uint16_t i = 0; i < pixelCount; i++)
+                        dumpLength += snprintf(&dump[dumpLength], dumpSize - dumpLength, "%02x%02x%02x", readyLeds[i].r, readyLeds[i].g, readyLeds[i].b);
+                    sendTXT(num, dump);
+                    ws_free(dump);
+                }
+            }
+        }
+        sendTXT(num, message);
+        yield();
+    }
+    memcpy(&settings, saved, sizeof (Configuration));
+    ws_free(saved);
+    ws_free(message);
+    effectSeed = 0;
+    selectModeByID((settings.specialMode > MIOff) ? settings.specialMode : settings.mode);
+    needToSave = savedNeedToSave;
+    lastSaved = savedLastSaved;
+}
+
+void SmartLED::resetDigest(ModeID mID)
+{
+    /// одинаковое начальное состояние: нулевые буферы, параметры по умолчанию, то же зерно
+    memset(&settings, 0, sizeof (Configuration));
+    memset(readyLeds, 0, sizeof (RGBColor) * pixelCount);
+    memset(modSettings.leds, 0, sizeof (RGBColor) * pixelCount);
+    memset(fLeds, 0, sizeof (RGBFloat) * pixelCount);
+    memset(heat, 0, pixelCount);
+    effectTime = 0;
+    palettePhase = 0;
+    bool savedUseEEPROM = useEEPROM;
+    useEEPROM = false;
+    setDefaultValues();
+    useEEPROM = savedUseEEPROM;
+    effectSeed = DIGEST_SEED;
+    selectModeByID(mID);
+}
+
+uint32_t SmartLED::stepDigest()
+{
+    /// время следующего шага считается наступившим, дальше - как в process()
+    nextStep = micros() - 1;
+    microsOverflow = false;
+    if (modifier)
+        (this->*modifier)();
+    if ((!modSettings.effectPaused) && (millis() > settings.cycle.nextChange))
+    {
+        switch (settings.specialMode)
+        {
+            case MICycle: makeCycle(false);
+                break;
+            case MIShedule: makeShedule(false);
+                break;
+        }
+    }
+    if ((*effectSpeed != 0) && (micros() > nextStep) && (!modSettings.effectPaused))
+        (this->*effect)(false);
+    uint32_t hash = 2166136261UL;
+    const uint8_t* bytes = (const uint8_t*) readyLeds;
+    for (uint32_t i = 0; i < sizeof (RGBColor) * pixelCount; i++)
+        hash = (hash ^ bytes[i]) * 16777619UL;
+    return hash;
+}
+
+void SmartLED::beginSync(SyncRole role)
+{
+    frameSync.begin(role);
+    syncCycleMode = MIMAX;
+    syncTrim = 0;
+}
+
+void SmartLED::processSync()
+{
+    if (frameSync.role == SRLeader)
+    {
+        if ((millis() - frameSync.lastSent < SYNC_INTERVAL) && (syncChanges == changes))
+            return;
+        syncChanges = changes;
+        SyncState state;
+        state.mode = settings.mode;
+        state.specialMode = settings.specialMode;
+        state.direct = settings.direct;
+        state.steps = syncSteps;
+        state.period = nextStep - lastStep;
+        state.age = micros() - lastStep;
+        state.palettePhase = palettePhase;
+        state.effectTime = effectTime;
+        frameSync.send(state);
+        return;
+    }
+    if (!frameSync.read())
+    {
+        /// без ведущего цикл режимов снова идет по своему таймеру
+        if ((settings.specialMode == MICycle) && (millis() - frameSync.lastPacket > SYNC_TIMEOUT) &&
+            (settings.cycle.nextChange - millis() > settings.cycle.period * 1000UL))
+            settings.cycle.nextChange = millis() + (settings.cycle.period * 1000);
+        return;
+    }
+    const SyncState& leader = frameSync.leader;
+    if ((leader.mode >= MIMAX) || (leader.specialMode >= MIMAX))
+        return;
+    ModeID leaderControl = (ModeID) ((leader.specialMode == MIOff) ? leader.mode : leader.specialMode);
+    ModeID control = (settings.specialMode == MIOff) ? settings.mode : settings.specialMode;
+    if (leaderControl != control)
+    {
+        selectModeByID(leaderControl);
+        syncTrim = 0;
+    }
+    if (leader.mode != settings.mode)
+    {
+        if (settings.specialMode == MICycle)
+        {
+            /// смена режима в цикле идет обычным путем (с затуханием), следующий режим задает ведущий
+            syncCycleMode = (ModeID) leader.mode;
+            settings.cycle.nextChange = 0;
+        } else
+            selectModeByID((ModeID) leader.mode);
+        syncTrim = 0;
+        return;
+    }
+    if (settings.specialMode == MICycle)
+        settings.cycle.nextChange = 0xFFFFFFFF;
+    if ((*effectSpeed == 0) || (modSettings.effectPaused) || (leader.period == 0))
+        return;
+    uint32_t now = micros();
+    int32_t period = leader.period;
+    int32_t stepDiff = leader.steps - syncSteps;
+    /// положение часов ведущего и ведомого в мкс, ведущий продвинулся еще и за время от приема пакета
+    int32_t error = (int32_t) (leader.age + (now - frameSync.receivedMicros)) - (int32_t) (now - lastStep);
+    bool resync = (abs(stepDiff) > SYNC_RESYNC_STEPS);
+    if (!resync)
+    {
+        error += stepDiff * period;
+        resync = (abs(error) > SYNC_RESYNC_STEPS * period);
+    }
+    frameSync.error = error;
+    if (resync)
+    {
+        syncSteps = leader.steps;
+        palettePhase = leader.palettePhase;
+        effectTime = leader.effectTime;
+        settings.direct = leader.direct;
+        lastStep = now - (leader.age + (now - frameSync.receivedMicros));
+        nextStep = lastStep + period;
+        microsOverflow = (nextStep < lastStep);
+        syncTrim = 0;
+        return;
+    }
+    /// ПИ-регулятор: половина ошибки исправляется сдвигом следующего шага, восьмая часть
+    /// накапливается в поправке длительности шага (разная нагрузка циклов, уход кварцев)
+    int32_t limit = period * SYNC_SLEW / 100;
+    syncTrim = constrain(syncTrim + error / 8, -limit, limit);
+    nextStep -= constrain(error / 2, -limit, limit);
+    /// при равном числе шагов фаза эффекта должна совпадать, расхождение (случайная смена направления) переносится
+    if ((stepDiff == 0) && ((palettePhase != leader.palettePhase) || (effectTime != leader.effectTime) || (settings.direct != leader.direct)))
+    {
+        palettePhase = leader.palettePhase;
+        effectTime = leader.effectTime;
+        settings.direct = leader.direct;
+    }
+}
+
+void SmartLED::beginRelay(uint16_t local, RelayTarget* targets, uint8_t count)
+{
+    if (local > pixelCount)
+        local = pixelCount;
+    /// участки, не помещающиеся в виртуальную ленту, отбрасываются
+    uint32_t total = local;
+    uint8_t used = 0;
+    while ((used < count) && (total + targets[used].pixels <= pixelCount))
+        total += targets[used++].pixels;
+    localPixels = local;
+    relayTargets = targets;
+    relayCount = used;
+    strip->updateLength(localPixels);
+    if ((relayCount > 0) && (!relay))
+        relay = ws_new<DdpSender>(WSmem_app);
+}
+
+void SmartLED::sendRelay()
+{
+    relayFrame++;
+    uint32_t offset = localPixels;
+    /// данные берутся прямо из readyLeds, по 3 байта на пиксель, как их ждет приемник DDP
+    for (uint8_t i = 0; i < relayCount; i++)
+    {
+        relay->send(relayTargets[i], (const uint8_t*) &readyLeds[offset], relayFrame);
+        offset += relayTargets[i].pixels;
+    }
+    relay->push(relayTargets, relayCount, relayFrame);
 }
 
 IPAddress SmartLED::remoteIP(uint8_t num)
@@ -198,7 +820,46 @@ IPAddress SmartLED::remoteIP(uint8_t num)
 
 void SmartLED::sendTXT(uint8_t num, const char* txt)
 {
-    webSocket->sendTXT(num, txt);
+    if (num == allClients)
+        webSocket->broadcastTXT(txt);
+    else
+        webSocket->sendTXT(num, txt);
+}
+
+void SmartLED::sendPrepared(uint8_t num, char* frame, int length)
+{
+    if (length > 79)
+        length = 79;
+    if (num == allClients)
+        webSocket->broadcastTXT(frame, length, true);
+    else
+        webSocket->sendTXT(num, frame, length, true);
+}
+
+void SmartLED::sendMemory(uint8_t num)
+{
+    const WSmemStats_t& lib = ws_memStats(WSmem_library);
+    const WSmemStats_t& app = ws_memStats(WSmem_app);
+    sendValue(num, "memory", "heap", (int32_t) ESP.getFreeHeap());
+    sendValue(num, "memory", "largestBlock", (int32_t) ws_largestFreeBlock());
+    sendValue(num, "memory", "wsAllocs", (int32_t) lib.allocs);
+    sendValue(num, "memory", "wsFrees", (int32_t) lib.frees);
+    sendValue(num, "memory", "wsFailures", (int32_t) lib.failures);
+    sendValue(num, "memory", "wsBytes", (int32_t) lib.bytes);
+    sendValue(num, "memory", "wsHighWater", (int32_t) lib.highWater);
+    sendValue(num, "memory", "appBytes", (int32_t) app.bytes);
+    sendValue(num, "memory", "appHighWater", (int32_t) app.highWater);
+    sendValue(num, "memory", "appFailures", (int32_t) app.failures);
+    uint32_t hits = 0, misses = 0;
+    for (uint8_t i = 0; i < WEBSOCKETS_POOL_COUNT; i++)
+    {
+        hits += ws_poolStats(i).hits;
+        misses += ws_poolStats(i).misses;
+    }
+    sendValue(num, "memory", "poolHits", (int32_t) hits);
+    sendValue(num, "memory", "poolMisses", (int32_t) misses);
+    sendValue(num, "memory", "poolOversized", (int32_t) ws_poolOversized());
+    sendValue(num, "memory", "wsClientBytes", (int32_t) sizeof (WSclient_t));
 }
 
 void SmartLED::sendCurrentValues(uint8_t num)
@@ -210,66 +871,148 @@ void SmartLED::sendCurrentValues(uint8_t num)
     sendSection(num, MISnowflake);
     sendSection(num, MIStroboscope);
     sendSection(num, MIPulse);
+    sendSection(num, MIPlasma);
+    sendSection(num, MIFire);
+    sendSection(num, MIText);
+    sendSection(num, MIAudio);
+    sendSection(num, MIDmx);
     sendSection(num, MICycle);
 }
 
 void SmartLED::sendSection(uint8_t num, ModeID sectionID)
+{
+    WebSocketSink sink(this, num);
+    writeSection(sink, sectionID);
+}
+
+void SmartLED::writeState(JsonWriter& json)
+{
+    JsonSink sink(json);
+    json.beginObject();
+    json.value("mode", modes[settings.mode].modeName);
+    json.beginObject("sections");
+    for (int i = MIWaves; i <= MICycle; i++)
+    {
+        json.beginObject(modes[i].modeName);
+        writeSection(sink, (ModeID) i);
+        json.endObject();
+    }
+    json.endObject();
+    if (frameSync.role != SRNone)
+    {
+        json.beginObject("sync");
+        json.value("role", (int32_t) frameSync.role);
+        json.value("received", (int32_t) frameSync.received);
+        json.value("dropped", (int32_t) frameSync.dropped);
+        json.value("error", frameSync.error);
+        json.endObject();
+    }
+    if (relay)
+    {
+        json.beginObject("relay");
+        json.value("targets", (int32_t) relayCount);
+        json.value("frames", (int32_t) relay->frames);
+        json.value("packets", (int32_t) relay->packets);
+        json.value("pixelsPerSecond", (int32_t) relay->pixelsPerSecond);
+        json.endObject();
+    }
+    json.endObject();
+}
+
+void SmartLED::writeSection(ValueSink& sink, ModeID sectionID)
 {
     char optName[16];
     switch (sectionID)
     {
         case MIWaves:
-            sendValue(num, modes[sectionID].modeName, "colorMin", settings.waves.colorMin);
-            sendValue(num, modes[sectionID].modeName, "colorMax", settings.waves.colorMax);
-            sendValue(num, modes[sectionID].modeName, "count", settings.waves.count);
-            sendValue(num, modes[sectionID].modeName, "speed", settings.waves.speed);
+            sink.value(modes[sectionID].modeName, "colorMin", settings.waves.colorMin);
+            sink.value(modes[sectionID].modeName, "colorMax", settings.waves.colorMax);
+            sink.value(modes[sectionID].modeName, "count", settings.waves.count);
+            sink.value(modes[sectionID].modeName, "speed", settings.waves.speed);
             break;
         case MIRainbow:
             memset(optName, 0, 16);
-            sendValue(num, modes[sectionID].modeName, "count", settings.rainbow.count);
-            sendValue(num, modes[sectionID].modeName, "reverse", settings.rainbow.reverse);
-            sendValue(num, modes[sectionID].modeName, "speed", settings.rainbow.speed);
+            sink.value(modes[sectionID].modeName, "count", settings.rainbow.count);
+            sink.value(modes[sectionID].modeName, "reverse", settings.rainbow.reverse);
+            sink.value(modes[sectionID].modeName, "speed", settings.rainbow.speed);
+            sink.value(modes[sectionID].modeName, "palette", settings.rainbow.palette);
             for (int i = 0; i < 10; i++)
             {
                 sprintf(optName, "color%d", i);
-                sendValue(num, modes[sectionID].modeName, optName, settings.rainbow.color[i]);
+                sink.value(modes[sectionID].modeName, optName, settings.rainbow.color[i]);
             }
             break;
         case MILines:
             memset(optName, 0, 16);
-            sendValue(num, modes[sectionID].modeName, "count", settings.lines.count);
-            sendValue(num, modes[sectionID].modeName, "reverse", settings.lines.reverse);
-            sendValue(num, modes[sectionID].modeName, "multiColor", settings.lines.multiColor);
-            sendValue(num, modes[sectionID].modeName, "speed", settings.lines.speed);
+            sink.value(modes[sectionID].modeName, "count", settings.lines.count);
+            sink.value(modes[sectionID].modeName, "reverse", settings.lines.reverse);
+            sink.value(modes[sectionID].modeName, "multiColor", settings.lines.multiColor);
+            sink.value(modes[sectionID].modeName, "speed", settings.lines.speed);
             for (int i = 0; i < 10; i++)
             {
                 sprintf(optName, "color%d", i);
-                sendValue(num, modes[sectionID].modeName, optName, settings.lines.color[i]);
+                sink.value(modes[sectionID].modeName, optName, settings.lines.color[i]);
             }
             break;
         case MISnowflake:
-            sendValue(num, modes[sectionID].modeName, "count", settings.snowflake.count);
-            sendValue(num, modes[sectionID].modeName, "color", settings.snowflake.color);
-            sendValue(num, modes[sectionID].modeName, "flakeSize", settings.snowflake.flakeSize);
-            sendValue(num, modes[sectionID].modeName, "multiColor", settings.snowflake.multiColor);
-            sendValue(num, modes[sectionID].modeName, "fading", settings.snowflake.fading);
+            sink.value(modes[sectionID].modeName, "count", settings.snowflake.count);
+            sink.value(modes[sectionID].modeName, "color", settings.snowflake.color);
+            sink.value(modes[sectionID].modeName, "flakeSize", settings.snowflake.flakeSize);
+            sink.value(modes[sectionID].modeName, "multiColor", settings.snowflake.multiColor);
+            sink.value(modes[sectionID].modeName, "fading", settings.snowflake.fading);
             break;
         case MIStroboscope:
-            sendValue(num, modes[sectionID].modeName, "count", settings.stroboscope.count);
-            sendValue(num, modes[sectionID].modeName, "color", settings.stroboscope.color);
-            sendValue(num, modes[sectionID].modeName, "multiColor", settings.stroboscope.multiColor);
+            sink.value(modes[sectionID].modeName, "count", settings.stroboscope.count);
+            sink.value(modes[sectionID].modeName, "color", settings.stroboscope.color);
+            sink.value(modes[sectionID].modeName, "multiColor", settings.stroboscope.multiColor);
             break;
         case MISnake:
-            sendValue(num, modes[sectionID].modeName, "count", settings.snake.count);
-            sendValue(num, modes[sectionID].modeName, "color", settings.snake.color);
-            sendValue(num, modes[sectionID].modeName, "multiColor", settings.snake.multiColor);
-            sendValue(num, modes[sectionID].modeName, "reverse", settings.snake.reverse);
-            sendValue(num, modes[sectionID].modeName, "speed", settings.snake.speed);
+            sink.value(modes[sectionID].modeName, "count", settings.snake.count);
+            sink.value(modes[sectionID].modeName, "color", settings.snake.color);
+            sink.value(modes[sectionID].modeName, "multiColor", settings.snake.multiColor);
+            sink.value(modes[sectionID].modeName, "reverse", settings.snake.reverse);
+            sink.value(modes[sectionID].modeName, "speed", settings.snake.speed);
             break;
         case MIPulse:
-            sendValue(num, modes[sectionID].modeName, "colorMin", settings.pulse.colorMin);
-            sendValue(num, modes[sectionID].modeName, "colorMax", settings.pulse.colorMax);
-            sendValue(num, modes[sectionID].modeName, "speed", settings.pulse.speed);
+            sink.value(modes[sectionID].modeName, "colorMin", settings.pulse.colorMin);
+            sink.value(modes[sectionID].modeName, "colorMax", settings.pulse.colorMax);
+            sink.value(modes[sectionID].modeName, "speed", settings.pulse.speed);
+            break;
+        case MIPlasma:
+            sink.value(modes[sectionID].modeName, "palette", settings.plasma.palette);
+            sink.value(modes[sectionID].modeName, "scale", settings.plasma.scale);
+            sink.value(modes[sectionID].modeName, "speed", settings.plasma.speed);
+            break;
+        case MIFire:
+            sink.value(modes[sectionID].modeName, "cooling", settings.fire.cooling);
+            sink.value(modes[sectionID].modeName, "sparking", settings.fire.sparking);
+            sink.value(modes[sectionID].modeName, "speed", settings.fire.speed);
+            break;
+        case MIText:
+            sink.value(modes[sectionID].modeName, "text", settings.text.text);
+            sink.value(modes[sectionID].modeName, "color", settings.text.color);
+            sink.value(modes[sectionID].modeName, "speed", settings.text.speed);
+            break;
+        case MIAudio:
+            sink.value(modes[sectionID].modeName, "style", settings.audio.style);
+            sink.value(modes[sectionID].modeName, "palette", settings.audio.palette);
+            sink.value(modes[sectionID].modeName, "sensitivity", settings.audio.sensitivity);
+            sink.value(modes[sectionID].modeName, "speed", settings.audio.speed);
+            break;
+        case MIDmx:
+            sink.value(modes[sectionID].modeName, "universe", settings.dmx.universe);
+            sink.value(modes[sectionID].modeName, "address", settings.dmx.address);
+            sink.value(modes[sectionID].modeName, "protocols", settings.dmx.protocols);
+            sink.value(modes[sectionID].modeName, "timeout", settings.dmx.timeout);
+            sink.value(modes[sectionID].modeName, "fallback", modes[settings.dmx.fallback].modeName);
+            if (dmx)
+            {
+                sink.value(modes[sectionID].modeName, "received", (int32_t) dmx->received);
+                sink.value(modes[sectionID].modeName, "dropped", (int32_t) dmx->dropped);
+                sink.value(modes[sectionID].modeName, "late", (int32_t) dmx->late);
+                sink.value(modes[sectionID].modeName, "frames", (int32_t) dmx->frames);
+                sink.value(modes[sectionID].modeName, "fps", (int32_t) dmx->fps);
+            }
             break;
         case MICycle:
 
@@ -285,42 +1028,53 @@ void SmartLED::sendSection(uint8_t num, ModeID sectionID)
 
 void SmartLED::sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, int32_t value)
 {
-    char sendStr[80];
-    memset(sendStr, 0, sizeof(sendStr));
-    sprintf(sendStr, "%s:%s:%d", sectionTxt, optionTxt, value);
-    sendTXT(num, sendStr);
+    char sendStr[WEBSOCKETS_MAX_HEADER_SIZE + 80];
+    int length = snprintf(&sendStr[WEBSOCKETS_MAX_HEADER_SIZE], 80, "%s:%s:%d", sectionTxt, optionTxt, value);
+    sendPrepared(num, sendStr, length);
 }
 
 void SmartLED::sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, bool value)
 {
-    char sendStr[80];
-    memset(sendStr, 0, sizeof(sendStr));
-    sprintf(sendStr, "%s:%s:%s", sectionTxt, optionTxt, value ? "true" : "false");
-    sendTXT(num, sendStr);
+    char sendStr[WEBSOCKETS_MAX_HEADER_SIZE + 80];
+    int length = snprintf(&sendStr[WEBSOCKETS_MAX_HEADER_SIZE], 80, "%s:%s:%s", sectionTxt, optionTxt, value ? "true" : "false");
+    sendPrepared(num, sendStr, length);
 }
 
 void SmartLED::sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, RGBColor value)
 {
-    char sendStr[80];
-    memset(sendStr, 0, sizeof(sendStr));
-    sprintf(sendStr, "%s:%s:%d;%d;%d", sectionTxt, optionTxt, value.r, value.g, value.b);
-    sendTXT(num, sendStr);
+    char sendStr[WEBSOCKETS_MAX_HEADER_SIZE + 80];
+    int length = snprintf(&sendStr[WEBSOCKETS_MAX_HEADER_SIZE], 80, "%s:%s:%d;%d;%d", sectionTxt, optionTxt, value.r, value.g, value.b);
+    sendPrepared(num, sendStr, length);
 }
 
 void SmartLED::sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, RGBValue value)
 {
-    char sendStr[80];
-    memset(sendStr, 0, sizeof(sendStr));
-    sprintf(sendStr, "%s:%s:%d;%d;%d", sectionTxt, optionTxt, value.r, value.g, value.b);
-    sendTXT(num, sendStr);
+    char sendStr[WEBSOCKETS_MAX_HEADER_SIZE + 80];
+    int length = snprintf(&sendStr[WEBSOCKETS_MAX_HEADER_SIZE], 80, "%s:%s:%d;%d;%d", sectionTxt, optionTxt, value.r, value.g, value.b);
+    sendPrepared(num, sendStr, length);
 }
 
 void SmartLED::sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, RGBFloat value)
 {
-    char sendStr[80];
-    memset(sendStr, 0, sizeof(sendStr));
-    sprintf(sendStr, "%s:%s:%d;%d;%d", sectionTxt, optionTxt, (int32_t)value.r, (int32_t)value.g, (int32_t)value.b);
-    sendTXT(num, sendStr);
+    char sendStr[WEBSOCKETS_MAX_HEADER_SIZE + 80];
+    int length = snprintf(&sendStr[WEBSOCKETS_MAX_HEADER_SIZE], 80, "%s:%s:%d;%d;%d", sectionTxt, optionTxt, (int32_t)value.r[0], (int32_t)value.g[0], (int32_t)value.b[0]);
+    sendPrepared(num, sendStr, length);
+}
+
+void SmartLED::sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, const char* value)
+{
+    char sendStr[WEBSOCKETS_MAX_HEADER_SIZE + 80];
+    int length = snprintf(&sendStr[WEBSOCKETS_MAX_HEADER_SIZE], 80, "%s:%s:%s", sectionTxt, optionTxt, value);
+    sendPrepared(num, sendStr, length);
+}
+
+void SmartLED::setPixelXY(int16_t x, int16_t y, RGBColor color)
+{
+    if ((x < 0) || (y < 0) || (x >= matrixWidth) || (y >= matrixHeight))
+        return;
+    uint16_t i = XY(x, y);
+    readyLeds[i] = color;
+    strip->setPixelColor(i, strip->Color(color.r, color.g, color.b));
 }
 
 void SmartLED::ledsToZero()
@@ -328,6 +1082,126 @@ void SmartLED::ledsToZero()
     memset(readyLeds, 0, sizeof (RGBColor) * pixelCount);
 }
 
+void SmartLED::fillGradient(uint8_t from, uint8_t to, RGBColor c1, RGBColor c2)
+{
+    uint16_t length = to - from;
+    if (length == 0)
+    {
+        palette[from] = c1;
+        return;
+    }
+    for (uint16_t i = 0; i <= length; i++)
+    {
+        palette[from + i].r = c1.r + ((int16_t) (c2.r - c1.r) * (int16_t) i) / (int16_t) length;
+        palette[from + i].g = c1.g + ((int16_t) (c2.g - c1.g) * (int16_t) i) / (int16_t) length;
+        palette[from + i].b = c1.b + ((int16_t) (c2.b - c1.b) * (int16_t) i) / (int16_t) length;
+    }
+}
+
+void SmartLED::compilePalette(const RGBColor* keys, uint8_t count)
+{
+    if (count < 2)
+    {
+        fillGradient(0, 255, keys[0], keys[0]);
+        return;
+    }
+    /// ключевая точка i находится в позиции i * 256 / count, после последней 
+    /// точки градиент возвращается к первой
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t from = ((uint16_t) i << 8) / count;
+        uint8_t to = (i == count - 1) ? 255 : (((uint16_t) (i + 1) << 8) / count) - 1;
+        RGBColor next = keys[(i + 1) % count];
+        RGBColor last;
+        last.r = keys[i].r + ((int16_t) (next.r - keys[i].r) * (to - from)) / (to - from + 1);
+        last.g = keys[i].g + ((int16_t) (next.g - keys[i].g) * (to - from)) / (to - from + 1);
+        last.b = keys[i].b + ((int16_t) (next.b - keys[i].b) * (to - from)) / (to - from + 1);
+        fillGradient(from, to, keys[i], last);
+    }
+}
+
+void SmartLED::compilePalette(PaletteID paletteID)
+{
+    if ((paletteID == PICustom) || (paletteID >= PIMAX))
+    {
+        compilePalette(settings.rainbow.color, settings.rainbow.count);
+        return;
+    }
+    const PaletteKey* keys = (const PaletteKey*) pgm_read_ptr(&builtinPalettes[paletteID]);
+    PaletteKey current, next;
+    memcpy_P(&current, keys, sizeof (PaletteKey));
+    do
+    {
+        keys++;
+        memcpy_P(&next, keys, sizeof (PaletteKey));
+        fillGradient(current.pos, next.pos, RGBColor({current.r, current.g, current.b}), RGBColor({next.r, next.g, next.b}));
+        current = next;
+    } while (current.pos < 255);
+}
+
+void SmartLED::renderPalette(uint16_t phase)
+{
+    uint16_t step = (uint16_t) ((65536UL + pixelCount / 2) / pixelCount);
+    for (int i = 0; i < pixelCount; i++)
+    {
+        readyLeds[i] = palette[phase >> 8];
+        phase += step;
+    }
+    writeStrip();
+}
+
+void SmartLED::renderChannel(uint8_t* plane, uint16_t phase, uint16_t step, uint8_t low, uint8_t high, uint8_t count)
+{
+    /// половины палитры, как их считают compilePalette и fillGradient: low + (rise * x) / 127 и
+    /// high - (rise * x) / 127, x = 0..127. Знак наклона вынесен из цикла, деление заменено
+    /// умножением в 16 битах: ((n * 33027) >> 16) >> 6 == n / 127 для n до 253 * 127
+    int16_t rise = ((int16_t) (high - low) * 127) / 128;
+    uint16_t slope = abs(rise);
+    bool down = (rise < 0);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        uint8_t index = phase >> 8;
+        uint16_t n = (uint16_t) ((index & 127) * slope);
+        uint8_t delta = (uint16_t) (((uint32_t) n * 33027) >> 16) >> 6;
+        bool second = index & 128;
+        plane[i] = (second ? high : low) + ((second != down) ? -delta : delta);
+        phase += step;
+    }
+}
+
+void SmartLED::interleaveChannels(RGBColor* target, const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        target[i].r = r[i];
+        target[i].g = g[i];
+        target[i].b = b[i];
+    }
+}
+
+void SmartLED::writeStrip()
+{
+    /// при ведомых распределенного вывода у ленты только первые localPixels пикселей
+    uint16_t count = strip->numPixels();
+    if (!stripPacked || (strip->getBrightness() != 255))
+    {
+        for (uint16_t i = 0; i < count; i++)
+            strip->setPixelColor(i, readyLeds[i].r, readyLeds[i].g, readyLeds[i].b);
+        return;
+    }
+    uint8_t* pixels = strip->getPixels();
+    const uint8_t* source = &readyLeds[0].r;
+    uint8_t r = stripOffset[0], g = stripOffset[1], b = stripOffset[2];
+    for (uint16_t i = count; i > 0; i--)
+    {
+        pixels[r] = source[0];
+        pixels[g] = source[1];
+        pixels[b] = source[2];
+        pixels += 3;
+        source += sizeof (RGBColor);
+    }
+}
+
 void SmartLED::autosave()
 {
     if (!useEEPROM)
@@ -366,7 +1240,12 @@ bool SmartLED::loadSettings()
     memcpy(&settings, eeprom_buffer, sizeof (settings));
     memcpy(&sheduler, &eeprom_buffer[sizeof (settings)], sizeof (sheduler));
     if ((settings.headerSize != sizeof (settings)) || (settings.shedulerSize != sizeof (sheduler)))
+    {
+        /// EEPROM стерта (0xFF) или записана другой версией: параметры, у которых нет значений по умолчанию, обнуляются
+        memset(&settings, 0, sizeof (settings));
+        memset(&sheduler, 0, sizeof (sheduler));
         return false;
+    }
     if (settings.mode >= MIMAX)
         settings.mode = MIOff;
     if (settings.specialMode > MIOff)
@@ -381,12 +1260,15 @@ void SmartLED::setDefaultValues()
 {
     if (loadSettings())
         return;
+    /// параметры без явного значения по умолчанию (цвета линий, флаги цикла) - нулевые, а не мусор из кучи
+    memset(&settings, 0, sizeof (Configuration));
     
     settings.waves.count = RGBColor({1, 1, 1});
 
     settings.rainbow.count = 2;
     settings.rainbow.speed = 1;
     settings.rainbow.reverse = false;
+    settings.rainbow.palette = PICustom;
 
     settings.lines.count = 2;
     settings.lines.speed = 1;
@@ -408,6 +1290,29 @@ void SmartLED::setDefaultValues()
 
     settings.pulse.speed = 1;
 
+    settings.plasma.palette = PIRainbow;
+    settings.plasma.scale = 16;
+    settings.plasma.speed = 50;
+
+    settings.fire.cooling = 55;
+    settings.fire.sparking = 120;
+    settings.fire.speed = 70;
+
+    strcpy(settings.text.text, "SMARTLED");
+    settings.text.color = RGBColor({255, 255, 255});
+    settings.text.speed = 70;
+
+    settings.audio.style = ASSpectrum;
+    settings.audio.palette = PIRainbow;
+    settings.audio.sensitivity = 50;
+    settings.audio.speed = 90;
+
+    settings.dmx.universe = 1;
+    settings.dmx.address = 1;
+    settings.dmx.protocols = DPSacn | DPArtNet | DPDdp;
+    settings.dmx.timeout = 5;
+    settings.dmx.fallback = MIOff;
+
     settings.cycle.period = 60;
     settings.cycle.nextChange = millis() + (settings.cycle.period * 1000);
     settings.cycle.current = MIRainbow;
@@ -418,36 +1323,20 @@ void SmartLED::setDefaultValues()
     selectModeByID(MIOff);
 }
 
-RGBColor SmartLED::parseColorValue(char* valueString)
+RGBColor SmartLED::parseColorValue(const char* valueString)
 {
-    uint8_t clr[3];
-    uint8_t i = 0;
-    char* part = strtok (valueString, ";");
-    while (part != 0)
-    {
-        clr[i] = (uint8_t) atol(part);
-        part = strtok (NULL, ";");
-        i++;
-    }
-    if (i != 3) 
+    int32_t clr[3];
+    if (!splitTriple(valueString, clr))
         return RGBColor({0, 0, 0});
-    return RGBColor({clr[0], clr[1], clr[2]});
+    return RGBColor({(uint8_t) clr[0], (uint8_t) clr[1], (uint8_t) clr[2]});
 }
 
-RGBValue SmartLED::parseSignedValue(char* valueString)
+RGBValue SmartLED::parseSignedValue(const char* valueString)
 {
-    int16_t clr[3];
-    uint8_t i = 0;
-    char* part = strtok (valueString, ";");
-    while (part != 0)
-    {
-        clr[i] = (int16_t) atol(part);
-        part = strtok (NULL, ";");
-        i++;
-    }
-    if (i != 3) 
+    int32_t clr[3];
+    if (!splitTriple(valueString, clr))
         return RGBValue({0, 0, 0});
-    return RGBValue({clr[0], clr[1], clr[2]});
+    return RGBValue({(int16_t) clr[0], (int16_t) clr[1], (int16_t) clr[2]});
 }
 
 int32_t SmartLED::parseSingleValue(const char* valueString)
@@ -459,7 +1348,7 @@ void SmartLED::generateLine(int idx)
 {
     if (settings.lines.reverse)
     {
-        settings.position = (random(100) % 2 == 0) ? -1 : pixelCount;
+        settings.position = (rng.range(2) == 0) ? -1 : pixelCount;
     } else
     {
         settings.position = (settings.lines.speed < 0) ? pixelCount : -1;
@@ -467,9 +1356,7 @@ void SmartLED::generateLine(int idx)
     settings.step = (settings.position < 0) ? 1 : -1;
     if (settings.lines.multiColor)
     {
-        settings.currentColor.r = random(0, 255);
-        settings.currentColor.g = random(0, 255);
-        settings.currentColor.b = random(0, 255);
+        rng.fill((uint8_t*) &settings.currentColor, sizeof (RGBColor), 0, 255);
     } else
         settings.currentColor = settings.lines.color[idx];
 }
@@ -478,13 +1365,13 @@ void SmartLED::addSnowflake()
 {
     if (settings.snowflake.flakeSize >= (pixelCount / 2))
         settings.snowflake.flakeSize = pixelCount / 2 - 1;
-    uint16_t pos = random(settings.snowflake.flakeSize, pixelCount - settings.snowflake.flakeSize);
+    uint16_t pos = rng.range(settings.snowflake.flakeSize, pixelCount - settings.snowflake.flakeSize);
     RGBFloat tmpColor;
     if (settings.snowflake.multiColor)
     {
-        tmpColor.r[0] = random(10, 255);
-        tmpColor.g[0] = random(10, 255);
-        tmpColor.b[0] = random(10, 255);
+        tmpColor.r[0] = rng.range(10, 255);
+        tmpColor.g[0] = rng.range(10, 255);
+        tmpColor.b[0] = rng.range(10, 255);
     } else
     {
         tmpColor.r[0] = settings.snowflake.color.r;
@@ -517,12 +1404,12 @@ void SmartLED::addSnowflake()
 
 void SmartLED::addStroboscope()
 {
-    uint16_t pos = random(pixelCount);
+    uint16_t pos = rng.range(pixelCount);
     if (settings.stroboscope.multiColor)
     {
-        readyLeds[pos].r = random(1, 10) * 25;
-        readyLeds[pos].g = random(1, 10) * 25;
-        readyLeds[pos].b = random(1, 10) * 25;
+        readyLeds[pos].r = rng.range(1, 10) * 25;
+        readyLeds[pos].g = rng.range(1, 10) * 25;
+        readyLeds[pos].b = rng.range(1, 10) * 25;
     } else
     {
         readyLeds[pos] = settings.stroboscope.color;
@@ -601,205 +1488,52 @@ void SmartLED::makeWaves(bool isDefault)
 {
     if (isDefault)
     {
-        uint32_t beginTime = micros();
-        float rLength = ((float) pixelCount / (float) settings.waves.count.r) / 2.;
-        float gLength = ((float) pixelCount / (float) settings.waves.count.g) / 2.;
-        float bLength = ((float) pixelCount / (float) settings.waves.count.b) / 2.;
-        float rAmp = settings.waves.colorMax.r - settings.waves.colorMin.r;
-        float gAmp = settings.waves.colorMax.g - settings.waves.colorMin.g;
-        float bAmp = settings.waves.colorMax.b - settings.waves.colorMin.b;
-        int rPeriod, gPeriod, bPeriod;
-        float rCurrent, gCurrent, bCurrent;
-        float rDiscrets = 101 - abs(settings.waves.speed.r);
-        float gDiscrets = 101 - abs(settings.waves.speed.g);
-        float bDiscrets = 101 - abs(settings.waves.speed.b);
-        for (int i = 0; i < pixelCount; i++)
+        const uint8_t* count = &settings.waves.count.r;
+        const int16_t* speed = &settings.waves.speed.r;
+        for (int c = 0; c < 3; c++)
         {
-            rCurrent = rAmp * ((float) i / rLength);
-            rPeriod = floor(i / rLength);
-            fLeds[i].r[0] = (rPeriod % 2 == 0) ? settings.waves.colorMin.r + rCurrent - rPeriod * rAmp : settings.waves.colorMin.r - rCurrent + (rPeriod - 1) * rAmp + 2 * rAmp;
-            fLeds[i].r[1] = fLeds[i].r[0] / rDiscrets;
-            gCurrent = gAmp * ((float) i / gLength);
-            gPeriod = floor(i / gLength);
-            fLeds[i].g[0] = (gPeriod % 2 == 0) ? settings.waves.colorMin.g + gCurrent - gPeriod * gAmp : settings.waves.colorMin.g - gCurrent + (gPeriod - 1) * gAmp + 2 * gAmp;
-            fLeds[i].g[1] = fLeds[i].g[0] / gDiscrets;
-            bCurrent = bAmp * ((float) i / bLength);
-            bPeriod = floor(i / bLength);
-            fLeds[i].b[0] = (bPeriod % 2 == 0) ? settings.waves.colorMin.b + bCurrent - bPeriod * bAmp : settings.waves.colorMin.b - bCurrent + (bPeriod - 1) * bAmp + 2 * bAmp;
-            fLeds[i].b[1] = fLeds[i].b[0] / bDiscrets;
-            strip->setPixelColor(i, strip->Color((uint8_t) fLeds[i].r[0], (uint8_t) fLeds[i].g[0], (uint8_t) fLeds[i].b[0]));
+            uint32_t pixelStep = (65536UL * (count[c] ? count[c] : 1)) / pixelCount;
+            waveStep[c] = (uint16_t) pixelStep;
+            wavePhase[c] = 0;
+            /// положительная скорость двигает волну вправо: пиксель получает значение 
+            /// соседа слева, т.е. смещение палитры уменьшается
+            int16_t discrets = 101 - constrain(abs(speed[c]), 0, 100);
+            waveShift[c] = (speed[c] == 0) ? 0 : ((speed[c] > 0) ? -1 : 1) * (int32_t) (pixelStep / discrets);
         }
-        moving[0] = moving[1] = moving[2] = 0;
         effectSpeed = &defaultSpeed;
         nextStep = calculateStep(abs(*effectSpeed));
         modifier = 0;
-        return;
-    }
-    float *prevColor, *prevColorOffset;
-    float *color, *colorOffset;
-    if (settings.waves.speed.r != 0)                            // нужно двигать этот цвет вправо или влево
-    {
-        if (settings.waves.speed.r > 0)                         // смещение вправо?
-        {
-            moving[0]++;                                        // увеличить счетчик
-        } else if (settings.waves.speed.r < 0)                  // иначе уменьшить
-        {
-            moving[0]--;
-        }
-        int8_t delta = (settings.waves.speed.r > 0) ? -1 : 1;   // посчитаем смещение относительно текущего индекса
-        if (settings.waves.speed.r < 0)                         // и начнем "смещать"
-            for (int i = 0; i < pixelCount; i++)
-            {
-                color = &(fLeds[i].r[0]);
-                prevColor = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].r[0]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].r[0]) : &(fLeds[i + delta].r[0]);
-                prevColorOffset = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].r[1]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].r[1]) : &(fLeds[i + delta].r[1]);
-                colorOffset = &(fLeds[i].r[1]);
-                *color = *color - *colorOffset + *prevColorOffset;
-                if (*color < 0) *color = 0.01;
-            } else
-            for (int i = (pixelCount - 1); i >= 0; i--)
-            {
-                color = &(fLeds[i].r[0]);
-                prevColor = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].r[0]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].r[0]) : &(fLeds[i + delta].r[0]);
-                prevColorOffset = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].r[1]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].r[1]) : &(fLeds[i + delta].r[1]);
-                colorOffset = &(fLeds[i].r[1]);
-                *color = *color - *colorOffset + *prevColorOffset;
-                if (*color < 0) *color = 0.01;
-            }
-        if (abs(moving[0]) == (101 - abs(settings.waves.speed.r))) // счетчик достиг значения скорости?
-        {
-            moving[0] = 0;                                      // обнулить
-            float discrets = 101 - abs(settings.waves.speed.r); // и снова вычислить кол-во дискретов
-            for (int i = 0; i < pixelCount; i++)                // рассчитать смещение каждого индекса по дискретизации
-            {
-                fLeds[i].r[1] = fLeds[i].r[0] / discrets;       // и запомнить его во втором элементе массива этого цвета
-            }
-        }
-    }
-    if (settings.waves.speed.g != 0)                            // нужно двигать этот цвет вправо или влево
-    {
-        if (settings.waves.speed.g > 0)                         // смещение вправо?
-        {
-            moving[1]++;                                        // увеличить счетчик
-        } else if (settings.waves.speed.g < 0)                  // иначе уменьшить
-        {
-            moving[1]--;
-        }
-        int8_t delta = (settings.waves.speed.g > 0) ? -1 : 1;   // посчитаем смещение относительно текущего индекса
-        if (settings.waves.speed.g < 0)                         // и начнем "смещать"
-            for (int i = 0; i < pixelCount; i++)
-            {
-                color = &(fLeds[i].g[0]);
-                prevColor = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].g[0]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].g[0]) : &(fLeds[i + delta].g[0]);
-                prevColorOffset = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].g[1]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].g[1]) : &(fLeds[i + delta].g[1]);
-                colorOffset = &(fLeds[i].g[1]);
-                *color = *color - *colorOffset + *prevColorOffset;
-                if (*color < 0) *color = 0.01;
-            } else
-            for (int i = (pixelCount - 1); i >= 0; i--)
-            {
-                color = &(fLeds[i].g[0]);
-                prevColor = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].g[0]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].g[0]) : &(fLeds[i + delta].g[0]);
-                prevColorOffset = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].g[1]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].g[1]) : &(fLeds[i + delta].g[1]);
-                colorOffset = &(fLeds[i].g[1]);
-                *color = *color - *colorOffset + *prevColorOffset;
-                if (*color < 0) *color = 0.01;
-            }
-        if (abs(moving[1]) == (101 - abs(settings.waves.speed.g))) // счетчик достиг значения скорости?
-        {
-            moving[1] = 0;                                      // обнулить
-            float discrets = 101 - abs(settings.waves.speed.g); // и снова вычислить кол-во дискретов
-            for (int i = 0; i < pixelCount; i++)                // рассчитать смещение каждого индекса по дискретизации
-            {
-                fLeds[i].g[1] = fLeds[i].g[0] / discrets;       // и запомнить его во втором элементе массива этого цвета
-            }
-        }
-    }
-    if (settings.waves.speed.b != 0)                            // нужно двигать этот цвет вправо или влево
+    } else
     {
-        if (settings.waves.speed.b > 0)                         // смещение вправо?
-        {
-            moving[2]++;                                        // увеличить счетчик
-        } else if (settings.waves.speed.b < 0)                  // иначе уменьшить
-        {
-            moving[2]--;
-        }
-        int8_t delta = (settings.waves.speed.b > 0) ? -1 : 1;   // посчитаем смещение относительно текущего индекса
-        if (settings.waves.speed.b < 0)                         // и начнем "смещать"
-            for (int i = 0; i < pixelCount; i++)
-            {
-                color = &(fLeds[i].b[0]);
-                prevColor = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].b[0]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].b[0]) : &(fLeds[i + delta].b[0]);
-                prevColorOffset = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].b[1]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].b[1]) : &(fLeds[i + delta].b[1]);
-                colorOffset = &(fLeds[i].b[1]);
-                *color = *color - *colorOffset + *prevColorOffset;
-                if (*color < 0) *color = 0.01;
-            } else
-            for (int i = (pixelCount - 1); i >= 0; i--)
-            {
-                color = &(fLeds[i].b[0]);
-                prevColor = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].b[0]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].b[0]) : &(fLeds[i + delta].b[0]);
-                prevColorOffset = ((i == 0)&&(delta < 0)) ? &(fLeds[pixelCount - 1].b[1]) : ((i == (pixelCount - 1))&&(delta > 0)) ? &(fLeds[0].b[1]) : &(fLeds[i + delta].b[1]);
-                colorOffset = &(fLeds[i].b[1]);
-                *color = *color - *colorOffset + *prevColorOffset;
-                if (*color < 0) *color = 0.01;
-            }
-        if (abs(moving[2]) == (101 - abs(settings.waves.speed.b))) // счетчик достиг значения скорости?
-        {
-            moving[2] = 0;                                      // обнулить
-            float discrets = 101 - abs(settings.waves.speed.b); // и снова вычислить кол-во дискретов
-            for (int i = 0; i < pixelCount; i++)                // рассчитать смещение каждого индекса по дискретизации
-            {
-                fLeds[i].b[1] = fLeds[i].b[0] / discrets;       // и запомнить его во втором элементе массива этого цвета
-            }
-        }
+        for (int c = 0; c < 3; c++)
+            wavePhase[c] += waveShift[c];
     }
-    for (int i = 0; i < pixelCount; i++)
+    /// волна каждого цвета - это треугольник от минимума до максимума и обратно со своим
+    /// смещением; каналы считаются плоскостями по WAVE_TILE пикселей и собираются в readyLeds
+    uint8_t planes[3][WAVE_TILE];
+    const uint8_t* low = &settings.waves.colorMin.r;
+    const uint8_t* high = &settings.waves.colorMax.r;
+    for (uint16_t first = 0; first < pixelCount; first += WAVE_TILE)
     {
-        readyLeds[i].r = (uint8_t) fLeds[i].r[0];
-        readyLeds[i].g = (uint8_t) fLeds[i].g[0];
-        readyLeds[i].b = (uint8_t) fLeds[i].b[0];
-        strip->setPixelColor(i, strip->Color(readyLeds[i].r, readyLeds[i].g, readyLeds[i].b));
+        uint8_t count = (pixelCount - first < WAVE_TILE) ? pixelCount - first : WAVE_TILE;
+        for (uint8_t c = 0; c < 3; c++)
+            renderChannel(planes[c], wavePhase[c] + first * waveStep[c], waveStep[c], low[c], high[c], count);
+        interleaveChannels(&readyLeds[first], planes[0], planes[1], planes[2], count);
     }
+    writeStrip();
 }
 
 void SmartLED::makeRainbow(bool isDefault)
 {
     if (isDefault)
     {
-        ledsToZero();
-        int sectionLength = pixelCount / (settings.rainbow.count);
-        RGBFloat currentPos;
-        currentPos.r[0] = settings.rainbow.color[0].r;
-        currentPos.g[0] = settings.rainbow.color[0].g;
-        currentPos.b[0] = settings.rainbow.color[0].b;
-        uint8_t nextPos = 0;
-        for (int i = 0; i < pixelCount; i++)
-        {
-            if ((i % sectionLength == 0) && ((pixelCount - i + 1) > sectionLength))
-            {
-                currentPos.r[0] = settings.rainbow.color[nextPos].r;
-                currentPos.g[0] = settings.rainbow.color[nextPos].g;
-                currentPos.b[0] = settings.rainbow.color[nextPos].b;
-                nextPos++;
-                if (nextPos >= settings.rainbow.count)
-                {
-                    nextPos = 0;
-                    sectionLength = pixelCount - i + 1;
-                }
-                currentPos.r[1] = (settings.rainbow.color[nextPos].r - currentPos.r[0]) / sectionLength;
-                currentPos.g[1] = (settings.rainbow.color[nextPos].g - currentPos.g[0]) / sectionLength;
-                currentPos.b[1] = (settings.rainbow.color[nextPos].b - currentPos.b[0]) / sectionLength;
-            } else
-            {
-                currentPos.r[0] += currentPos.r[1];
-                currentPos.g[0] += currentPos.g[1];
-                currentPos.b[0] += currentPos.b[1];
-            }
-            readyLeds[i].r = (currentPos.r[0] > 0) ? currentPos.r[0] : 0;
-            readyLeds[i].g = (currentPos.g[0] > 0) ? currentPos.g[0] : 0;
-            readyLeds[i].b = (currentPos.b[0] > 0) ? currentPos.b[0] : 0;
-        }
+        if (settings.rainbow.count < 2)
+            settings.rainbow.count = 2;
+        if (settings.rainbow.count > 10)
+            settings.rainbow.count = 10;
+        compilePalette((PaletteID) settings.rainbow.palette);
+        palettePhase = 0;
+        renderPalette(palettePhase);
         effectSpeed = &settings.rainbow.speed;
         settings.direct = (settings.rainbow.speed < 0) ? -1 : 1;
         nextStep = calculateStep(abs(*effectSpeed));
@@ -807,19 +1541,16 @@ void SmartLED::makeRainbow(bool isDefault)
         modifier = 0;
         return;
     }
-    modSettings.modifierVisible = true;
-    modSettings.effectPaused = true;
-    modSettings.currentDiscret = 0;
-    if (settings.rainbow.reverse && (random(100) < 2))
+    /// у ведомого направление меняет только ведущий
+    if (settings.rainbow.reverse && (frameSync.role != SRFollower) && (rng.chance(2)))
     {
         settings.rainbow.speed *= -1;
         settings.direct = (settings.rainbow.speed < 0) ? -1 : 1;
     }
-    modifier = &SmartLED::modifierMoving;
-    modSettings.discretization = 4;
-    modSettings.modifierSpeed = *effectSpeed;
-
-    nextStep = calculateStep(abs(*effectSpeed));
+    /// за один шаг радуга смещается на четверть пикселя, как раньше при плавном сдвиге модификатором
+    uint16_t quarterPixel = (uint16_t) (65536UL / pixelCount) >> 2;
+    palettePhase -= settings.direct * (int16_t) (quarterPixel ? quarterPixel : 1);
+    renderPalette(palettePhase);
 }
 
 void SmartLED::makeLines(bool isDefault)
@@ -841,23 +1572,22 @@ void SmartLED::makeLines(bool isDefault)
     {
         if (settings.lines.reverse)
         {
-            settings.position = (random(100) % 2 == 0) ? -1 : pixelCount;
+            settings.position = (rng.range(2) == 0) ? -1 : pixelCount;
             settings.step = (settings.position < 0) ? 1 : -1;
         } else
         {
-            if (settings.position == 0)
-                settings.position = pixelCount;
-            else
-                settings.position = -1;
+            /// новая линия начинается с того же края, по направлению шага (на ленте из одного диода
+            /// первый и последний пиксель совпадают, поэтому по номеру пикселя край не определить)
+            settings.position = (settings.step > 0) ? -1 : pixelCount;
         }
         settings.effectCreating++;
         if (settings.effectCreating >= settings.lines.count)
             settings.effectCreating = 0;
         if (settings.lines.multiColor)
         {
-            settings.currentColor.r = random(0, 255);
-            settings.currentColor.g = random(settings.currentColor.g / 2, 255) - settings.currentColor.g / 2;
-            settings.currentColor.b = random(settings.currentColor.g / 2, 255) - settings.currentColor.g / 2;
+            settings.currentColor.r = rng.range(0, 255);
+            settings.currentColor.g = rng.range(settings.currentColor.g / 2, 255) - settings.currentColor.g / 2;
+            settings.currentColor.b = rng.range(settings.currentColor.g / 2, 255) - settings.currentColor.g / 2;
         } else
             settings.currentColor = settings.lines.color[settings.effectCreating];
     }
@@ -904,7 +1634,7 @@ void SmartLED::makeStroboscope(bool isDefault)
         modifier = 0;
         return;
     }
-    if (++settings.effectCreating > ((600) / settings.stroboscope.count))
+    if (++settings.effectCreating > ((600) / ((settings.stroboscope.count > 0) ? settings.stroboscope.count : 1)))
     {
         addStroboscope();
         settings.effectCreating = 0;
@@ -927,7 +1657,10 @@ void SmartLED::makeSnake(bool isDefault)
 {
     if (isDefault)
     {
-        int snakeLength = pixelCount / settings.snake.count;
+        /// змеек не меньше одной и не больше, чем пикселей
+        int snakeLength = (settings.snake.count > 0) ? pixelCount / settings.snake.count : pixelCount;
+        if (snakeLength == 0)
+            snakeLength = 1;
         RGBColor tmp;
         for (int i = 0; i < pixelCount; i++)
         {
@@ -935,9 +1668,9 @@ void SmartLED::makeSnake(bool isDefault)
             {
                 if (settings.snake.multiColor)
                 {
-                    tmp.r = random(10, 255);
-                    tmp.g = random(10, 255);
-                    tmp.b = random(10, 255);
+                    tmp.r = rng.range(10, 255);
+                    tmp.g = rng.range(10, 255);
+                    tmp.b = rng.range(10, 255);
                 } else
                     tmp = settings.snake.color;
                 readyLeds[i] = tmp;
@@ -963,7 +1696,7 @@ void SmartLED::makeSnake(bool isDefault)
             modifierInvert();
         return;
     }
-    if (settings.snake.reverse && (random(*effectSpeed * 100) < 10))
+    if (settings.snake.reverse && (rng.range(*effectSpeed * 100) < 10))
     {
         settings.direct *= -1;
         modifier = &SmartLED::modifierInvert;
@@ -1010,19 +1743,279 @@ void SmartLED::makePulse(bool isDefault)
     }
 }
 
+void SmartLED::makePlasma(bool isDefault)
+{
+    if (isDefault)
+    {
+        compilePalette((PaletteID) settings.plasma.palette);
+        effectSpeed = &settings.plasma.speed;
+        nextStep = calculateStep(abs(*effectSpeed));
+        modifier = 0;
+        return;
+    }
+    effectTime += (settings.plasma.speed < 0) ? -1 : 1;
+    uint8_t t1 = effectTime;
+    uint8_t t2 = effectTime >> 1;
+    uint8_t scale = settings.plasma.scale;
+    for (uint16_t y = 0; y < matrixHeight; y++)
+    {
+        uint8_t sy = sin8(y * scale + t2);
+        for (uint16_t x = 0; x < matrixWidth; x++)
+        {
+            uint16_t v = sin8(x * scale + t1) + sy + sin8(((x + y) * scale >> 1) + t1);
+            uint16_t i = XY(x, y);
+            readyLeds[i] = palette[(uint8_t) (v / 3 + t2)];
+            strip->setPixelColor(i, strip->Color(readyLeds[i].r, readyLeds[i].g, readyLeds[i].b));
+        }
+    }
+}
+
+void SmartLED::makeFire(bool isDefault)
+{
+    if (isDefault)
+    {
+        compilePalette(PIFire);
+        memset(heat, 0, pixelCount);
+        ledsToZero();
+        effectSpeed = &settings.fire.speed;
+        nextStep = calculateStep(abs(*effectSpeed));
+        modifier = 0;
+        return;
+    }
+    /// на матрице огонь горит в каждом столбце снизу вверх, на ленте - вдоль всей ленты
+    uint16_t columns = (matrixHeight > 1) ? matrixWidth : 1;
+    uint16_t rows = (matrixHeight > 1) ? matrixHeight : matrixWidth;
+    uint16_t maxCooling = (settings.fire.cooling * 10) / rows + 2;
+    for (uint16_t c = 0; c < columns; c++)
+    {
+        uint8_t* h = &heat[c * rows];
+        for (uint16_t r = 0; r < rows; r++)
+        {
+            uint16_t cool = rng.range(0, maxCooling);
+            h[r] = (h[r] > cool) ? h[r] - cool : 0;
+        }
+        for (int r = rows - 1; r >= 2; r--)
+            h[r] = (h[r - 1] + h[r - 2] + h[r - 2]) / 3;
+        if (rng.range(255) < settings.fire.sparking)
+        {
+            uint16_t r = rng.range((rows < 3) ? rows : 3);
+            uint16_t spark = h[r] + rng.range(160, 255);
+            h[r] = (spark > 255) ? 255 : spark;
+        }
+        for (uint16_t r = 0; r < rows; r++)
+        {
+            RGBColor color = palette[(h[r] * 240) >> 8];
+            if (matrixHeight > 1)
+                setPixelXY(c, matrixHeight - 1 - r, color);
+            else
+                setPixelXY(r, 0, color);
+        }
+    }
+}
+
+void SmartLED::makeText(bool isDefault)
+{
+    if (isDefault)
+    {
+        settings.position = matrixWidth;
+        effectSpeed = &settings.text.speed;
+        nextStep = calculateStep(abs(*effectSpeed));
+        modifier = 0;
+        return;
+    }
+    ledsToZero();
+    for (int i = 0; i < pixelCount; i++)
+        strip->setPixelColor(i, 0);
+    uint16_t length = strlen(settings.text.text);
+    int16_t top = ((int16_t) matrixHeight - 7) / 2;
+    for (uint16_t k = 0; k < length; k++)
+    {
+        int16_t cx = settings.position + k * 6;
+        if ((cx >= (int16_t) matrixWidth) || (cx + 5 < 0))
+            continue;
+        char ch = settings.text.text[k];
+        if ((ch >= 'a') && (ch <= 'z'))
+            ch -= 'a' - 'A';
+        if ((ch < ' ') || (ch > '_'))
+            ch = '?';
+        for (uint8_t col = 0; col < 5; col++)
+        {
+            uint8_t bits = pgm_read_byte(&font5x7[(ch - ' ') * 5 + col]);
+            for (uint8_t row = 0; row < 7; row++)
+                if (bits & (1 << row))
+                    setPixelXY(cx + col, top + row, settings.text.color);
+        }
+    }
+    if (--settings.position < -(int16_t) (length * 6))
+        settings.position = matrixWidth;
+}
+
+void SmartLED::makeAudio(bool isDefault)
+{
+    if (isDefault)
+    {
+        if (!audio)
+            audio = ws_new<AudioAnalyzer>(WSmem_app);
+        audio->sensitivity = settings.audio.sensitivity;
+        compilePalette((PaletteID) settings.audio.palette);
+        settings.position = 0;
+        ledsToZero();
+        effectSpeed = &settings.audio.speed;
+        nextStep = calculateStep(abs(*effectSpeed));
+        modifier = 0;
+        return;
+    }
+    /// окно оцифровывается в process(), кадр меняется только по новому окну
+    if (!audio->analyze())
+    {
+        frameUnchanged = true;
+        return;
+    }
+    switch (settings.audio.style)
+    {
+        case ASSpectrum:
+            for (uint16_t x = 0; x < matrixWidth; x++)
+            {
+                uint8_t b = (uint32_t) x * AUDIO_BANDS / matrixWidth;
+                RGBColor color = palette[b * (256 / AUDIO_BANDS)];
+                if (matrixHeight > 1)
+                {
+                    /// столбец высотой по уровню полосы, цвет по высоте
+                    uint16_t h = ((uint16_t) audio->band[b] * matrixHeight + 128) >> 8;
+                    for (uint16_t y = 0; y < matrixHeight; y++)
+                        setPixelXY(x, matrixHeight - 1 - y, (y < h) ? palette[(y * 255) / (matrixHeight - 1)] : RGBColor({0, 0, 0}));
+                } else
+                {
+                    /// сегмент ленты цвета полосы с яркостью по уровню
+                    uint8_t v = audio->band[b];
+                    setPixelXY(x, 0, RGBColor({(uint8_t) ((color.r * v) >> 8), (uint8_t) ((color.g * v) >> 8), (uint8_t) ((color.b * v) >> 8)}));
+                }
+            }
+            break;
+        case ASBeat:
+            /// на удар - полная яркость и сдвиг палитры, затем плавное затухание
+            if (audio->beat)
+            {
+                settings.position = 255;
+                effectTime += 32;
+            } else if (settings.position > 0)
+                settings.position -= (settings.position >> 3) + 1;
+            for (uint16_t x = 0; x < matrixWidth; x++)
+            {
+                RGBColor color = palette[(uint8_t) (effectTime + (x * 256) / matrixWidth)];
+                color.r = (color.r * settings.position) >> 8;
+                color.g = (color.g * settings.position) >> 8;
+                color.b = (color.b * settings.position) >> 8;
+                for (uint16_t y = 0; y < matrixHeight; y++)
+                    setPixelXY(x, y, color);
+            }
+            break;
+        case ASLevel:
+        {
+            /// индикатор быстро растет и медленно спадает
+            if (audio->level > settings.position)
+                settings.position = audio->level;
+            else if (settings.position > 0)
+                settings.position -= (settings.position >> 4) + 1;
+            uint16_t lit = ((uint32_t) settings.position * matrixWidth) >> 8;
+            for (uint16_t x = 0; x < matrixWidth; x++)
+            {
+                RGBColor color = (x < lit) ? palette[(x * 255) / matrixWidth] : RGBColor({0, 0, 0});
+                for (uint16_t y = 0; y < matrixHeight; y++)
+                    setPixelXY(x, y, color);
+            }
+            break;
+        }
+    }
+}
+
+void SmartLED::makeDmx(bool isDefault)
+{
+    if (isDefault)
+    {
+        if (!dmx)
+            dmx = ws_new<DmxReceiver>(WSmem_app);
+        if ((!ddpFrame) && (settings.dmx.protocols & DPDdp))
+        {
+            ddpFrame = (uint8_t*) ws_malloc(sizeof (RGBColor) * pixelCount, WSmem_app);
+            if (ddpFrame)
+                memset(ddpFrame, 0, sizeof (RGBColor) * pixelCount);
+        }
+        dmx->begin(settings.dmx.universe, settings.dmx.protocols);
+        dmxActive = false;
+        (this->*modes[runningMode()].effect)(true);
+        return;
+    }
+    /// при приеме пульта лента меняется только в receiveDmx, шаг режима ее не показывает
+    if (dmxActive)
+        frameUnchanged = true;
+    else
+        (this->*modes[runningMode()].effect)(false);
+}
+
+void SmartLED::receiveDmx()
+{
+    uint16_t offset = settings.dmx.address - 1;
+    uint16_t perUniverse = (DMX_CHANNELS - offset) / 3;
+    bool received = false;
+    while (dmx->read())
+    {
+        received = true;
+        uint16_t first = (dmx->universe - settings.dmx.universe) * perUniverse;
+        for (uint16_t i = 0; (offset + i * 3 + 2 < dmx->length) && (i < perUniverse) && (first + i < pixelCount); i++)
+        {
+            const uint8_t* ch = &dmx->data[offset + i * 3];
+            readyLeds[first + i] = RGBColor({ch[0], ch[1], ch[2]});
+            strip->setPixelColor(first + i, strip->Color(ch[0], ch[1], ch[2]));
+        }
+        /// лента обновится в конце этого же прохода process()
+        needToUpdate = true;
+    }
+    /// DDP собирается в отдельном кадре: неполный или отвергнутый кадр не попадает
+    /// в readyLeds, на ленте остается предыдущий
+    while ((ddpFrame) && (dmx->readDdp(ddpFrame, sizeof (RGBColor) * pixelCount)))
+    {
+        received = true;
+        if (dmx->push)
+        {
+            memcpy(readyLeds, ddpFrame, sizeof (RGBColor) * pixelCount);
+            writeStrip();
+            needToUpdate = true;
+        }
+    }
+    if ((received) && (!dmxActive))
+    {
+        /// эффект останавливается, лента полностью под управлением пульта
+        dmxActive = true;
+        modifier = 0;
+        modSettings.effectPaused = false;
+        effectSpeed = &defaultSpeed;
+    }
+    if ((dmxActive) && ((dmx->terminated) || ((millis() - dmx->lastPacket) > settings.dmx.timeout * 1000UL)))
+    {
+        dmxActive = false;
+        (this->*modes[runningMode()].effect)(true);
+    }
+}
+
 void SmartLED::makeCycle(bool isDefault)
 {
     if (isDefault)
     {
-        if ((settings.cycle.current >= (uint8_t) MICycle) || (settings.cycle.current <= (uint8_t) MIOff))
+        if ((settings.cycle.current >= (uint8_t) MICycleLast) || (settings.cycle.current <= (uint8_t) MIOff))
             settings.cycle.current = (uint8_t) MIWaves;
         settings.cycle.nextChange = millis() + (settings.cycle.period * 1000);
-        if (settings.cycle.isRandom)
-            settings.cycle.current = random(MIOff + 1, MICycle - 1);
+        /// ведомый переключает цикл только вслед за ведущим, свой таймер работает лишь без пакетов
+        if ((frameSync.role == SRFollower) && (syncCycleMode > MIOff) && (syncCycleMode < MICycleLast))
+        {
+            settings.cycle.current = syncCycleMode;
+            syncCycleMode = MIMAX;
+        } else if (settings.cycle.isRandom)
+            settings.cycle.current = random(MIOff + 1, MICycleLast);
         else
         {
             settings.cycle.current++;
-            if ((settings.cycle.current >= (uint8_t) MICycle) || (settings.cycle.current <= (uint8_t) MIOff))
+            if ((settings.cycle.current >= (uint8_t) MICycleLast) || (settings.cycle.current <= (uint8_t) MIOff))
                 settings.cycle.current = (uint8_t) MIWaves;
         }
         if (settings.cycle.fading > 0)
@@ -1031,6 +2024,8 @@ void SmartLED::makeCycle(bool isDefault)
         }
         effect = modes[settings.cycle.current].effect;
         settings.mode = (ModeID)settings.cycle.current;
+        seedEffect();
+        changes++;
         modSettings.effectPaused = false;
         modifier = 0;
         (this->*effect)(true);
@@ -1058,6 +2053,7 @@ void SmartLED::makeShedule(bool isDefault)
 
 void SmartLED::setOption(char* option, char* strVal)
 {
+    profiler.command();
     ModeID controlMode = (settings.specialMode == MIOff) ? settings.mode : settings.specialMode;
     switch (controlMode)
     {
@@ -1088,8 +2084,13 @@ void SmartLED::setOption(char* option, char* strVal)
             } else if (strcmp(option, "rainbowRev") == 0)
             {
                 settings.rainbow.reverse = parseSingleValue(strVal);
-            } else
+            } else if (strcmp(option, "palette") == 0)
+            {
+                settings.rainbow.palette = constrain(parseSingleValue(strVal), PICustom, PIMAX - 1);
+                (this->*effect)(true);
+            } else if (strncmp(option, "color", 5) == 0)
             {
+                /// "color0".."color9", после совпадения префикса option[5] - цифра или конец строки
                 for (int i = 0; i < 10; i++)
                     if (option[5] == i + 48)
                     {
@@ -1115,8 +2116,9 @@ void SmartLED::setOption(char* option, char* strVal)
             } else if (strcmp(option, "linesRev") == 0)
             {
                 settings.lines.reverse = parseSingleValue(strVal);
-            } else
+            } else if (strncmp(option, "color", 5) == 0)
             {
+                /// "color0".."color9", после совпадения префикса option[5] - цифра или конец строки
                 for (int i = 0; i < 10; i++)
                     if (option[5] == i + 48)
                     {
@@ -1192,6 +2194,80 @@ void SmartLED::setOption(char* option, char* strVal)
                 settings.pulse.speed = parseSingleValue(strVal);
             }
             break;
+        case MIPlasma:
+            if (strcmp(option, "palette") == 0)
+            {
+                settings.plasma.palette = constrain(parseSingleValue(strVal), PICustom, PIMAX - 1);
+                (this->*effect)(true);
+            } else if (strcmp(option, "scale") == 0)
+            {
+                settings.plasma.scale = parseSingleValue(strVal);
+            } else if (strcmp(option, "speed") == 0)
+            {
+                settings.plasma.speed = parseSingleValue(strVal);
+            }
+            break;
+        case MIFire:
+            if (strcmp(option, "cooling") == 0)
+            {
+                settings.fire.cooling = parseSingleValue(strVal);
+            } else if (strcmp(option, "sparking") == 0)
+            {
+                settings.fire.sparking = parseSingleValue(strVal);
+            } else if (strcmp(option, "speed") == 0)
+            {
+                settings.fire.speed = parseSingleValue(strVal);
+            }
+            break;
+        case MIText:
+            if (strcmp(option, "text") == 0)
+            {
+                strncpy(settings.text.text, strVal, sizeof (settings.text.text) - 1);
+                settings.text.text[sizeof (settings.text.text) - 1] = 0;
+                (this->*effect)(true);
+            } else if (strcmp(option, "color") == 0)
+            {
+                settings.text.color = parseColorValue(strVal);
+            } else if (strcmp(option, "speed") == 0)
+            {
+                settings.text.speed = parseSingleValue(strVal);
+            }
+            break;
+        case MIAudio:
+            if (strcmp(option, "style") == 0)
+            {
+                settings.audio.style = constrain(parseSingleValue(strVal), ASSpectrum, ASMAX - 1);
+                (this->*effect)(true);
+            } else if (strcmp(option, "palette") == 0)
+            {
+                settings.audio.palette = constrain(parseSingleValue(strVal), PICustom, PIMAX - 1);
+                (this->*effect)(true);
+            } else if (strcmp(option, "sensitivity") == 0)
+            {
+                settings.audio.sensitivity = constrain(parseSingleValue(strVal), 1, 100);
+                (this->*effect)(true);
+            } else if (strcmp(option, "speed") == 0)
+            {
+                settings.audio.speed = parseSingleValue(strVal);
+            }
+            break;
+        case MIDmx:
+            if (strcmp(option, "universe") == 0)
+            {
+                settings.dmx.universe = constrain(parseSingleValue(strVal), 1, 63999);
+                (this->*effect)(true);
+            } else if (strcmp(option, "address") == 0)
+            {
+                settings.dmx.address = constrain(parseSingleValue(strVal), 1, DMX_CHANNELS - 2);
+            } else if (strcmp(option, "protocols") == 0)
+            {
+                settings.dmx.protocols = parseSingleValue(strVal) & (DPSacn | DPArtNet | DPDdp);
+                (this->*effect)(true);
+            } else if (strcmp(option, "timeout") == 0)
+            {
+                settings.dmx.timeout = constrain(parseSingleValue(strVal), 1, 255);
+            }
+            break;
         case MICycle:
             if (strcmp(option, "period") == 0)
             {
@@ -1214,6 +2290,7 @@ void SmartLED::setOption(char* option, char* strVal)
     }
     lastSaved = millis();
     needToSave = true;
+    changes++;
 }
 
 void SmartLED::mirrorToArray()
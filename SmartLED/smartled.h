@@ -4,6 +4,26 @@
 #include <Adafruit_NeoPixel.h>
 #include <WebSocketsServer.h>
 #include <EEPROM.h>
+#include "audio.h"
+#include "capture.h"
+#include "dmx.h"
+#include "json.h"
+#include "prng.h"
+#include "profiler.h"
+#include "sync.h"
+
+/// максимальное количество одновременно подключенных клиентов вебсокета
+#define WEBSOCKET_CLIENTS 16
+/// событий вебсокета в очереди от обработчиков TCP до loop() (только событийный режим)
+#define WEBSOCKET_QUEUE_SIZE 8
+/// наибольшая длина команды в очереди, более длинные отбрасываются (только событийный режим)
+#define WEBSOCKET_QUEUE_COMMAND 96
+/// максимальное количество кадров на эффект при расчете контрольных сумм
+#define DIGEST_FRAMES_MAX 64
+/// зерно генератора эффектов для воспроизводимых кадров
+#define DIGEST_SEED 12345
+/// пикселей в плоскостях каналов волн за один проход (буферы на стеке: 3 * WAVE_TILE байт)
+#define WAVE_TILE 128
 
 class SmartLED;
 
@@ -20,9 +40,15 @@ typedef enum
 //    MIIntersects,                       ///< пересечения
     MISnake,                            ///< змейка
     MIPulse,                            ///< пульс
+    MIPlasma,                           ///< плазма (для матриц)
+    MIFire,                             ///< огонь (для матриц)
+    MIText,                             ///< бегущая строка (для матриц)
+    MIAudio,                            ///< реакция на звук (микрофон на аналоговом входе)
+    MIDmx,                              ///< управление по сети от пульта (sACN, Art-Net, DDP)
     MICycle,                            ///< спец.режим - автоматическое переключение режимов
     MIShedule,                          ///< спец.режим - планировщик режимов
-    MIMAX                               ///< максимальный доступный режим
+    MIMAX,                              ///< максимальный доступный режим
+    MICycleLast     = MIAudio           ///< граница эффектов цикла: звук и dmx управляются извне и в цикл не входят
 } ModeID;
 
 /// объявление типа указателя на метод-эффект
@@ -47,6 +73,53 @@ typedef struct
   uint8_t r, g, b;
 } RGBColor;
 
+/** ключевая точка встроенной палитры (хранится во flash)
+ */
+typedef struct 
+{
+  uint8_t pos;                          ///< позиция точки в палитре, от 0 до 255
+  uint8_t r, g, b;                      ///< цвет точки
+} PaletteKey;
+
+/** перечисление встроенных палитр
+ */
+typedef enum 
+{
+    PICustom        = 0,                ///< палитра из ключевых точек, заданных пользователем
+    PIRainbow,                          ///< радуга
+    PIFire,                             ///< огонь
+    PIOcean,                            ///< океан
+    PIForest,                           ///< лес
+    PIParty,                            ///< вечеринка
+    PIMAX                               ///< количество палитр
+} PaletteID;
+
+/** флаги раскладки светодиодной матрицы
+ */
+typedef enum 
+{
+    LayoutRows      = 0x00,             ///< пиксели подключены построчно, каждая строка слева направо
+    LayoutSerpentine = 0x01,            ///< четные строки (столбцы) идут в одну сторону, нечетные - в обратную
+    LayoutColumns   = 0x02,             ///< пиксели подключены по столбцам, а не по строкам
+    LayoutRotate90  = 0x04,             ///< матрица повернута на 90 градусов по часовой стрелке
+    LayoutRotate180 = 0x08,             ///< матрица повернута на 180 градусов
+    LayoutRotate270 = 0x0C,             ///< матрица повернута на 270 градусов
+    LayoutRotateMask = 0x0C,            ///< маска для флагов поворота
+    LayoutTileSerpentine = 0x10         ///< модули в нечетных рядах подключены справа налево
+} LayoutFlags;
+
+/** описание раскладки светодиодной матрицы. Размеры задаются так, как матрица 
+ * подключена (до поворота)
+ */
+typedef struct 
+{
+  uint16_t width;                       ///< ширина всей матрицы, пикс.
+  uint16_t height;                      ///< высота всей матрицы, пикс.
+  uint8_t tileWidth;                    ///< ширина одного модуля, 0 - матрица из одного модуля
+  uint8_t tileHeight;                   ///< высота одного модуля, 0 - матрица из одного модуля
+  uint8_t flags;                        ///< флаги раскладки (LayoutFlags)
+} MatrixLayout;
+
 /** три знаковых целых, каждое применительно к соответствующему цвету
  */
 typedef struct 
@@ -114,6 +187,7 @@ typedef struct
   uint8_t count;                        ///< количество используемых ключевых точек, от 2 до 10
   int8_t speed;                         ///< скорость движения радуги
   bool reverse;                         ///< разрешить случайное изменение направления движения радуги
+  uint8_t palette;                      ///< встроенная палитра (PICustom - использовать ключевые точки)
 } StripRainbow;
 
 /** параметры эффекта линий
@@ -184,6 +258,64 @@ typedef struct
   int8_t speed;                         ///< скорость изменения цвета
 } StripPulse;
 
+/** параметры эффекта плазмы
+ */
+typedef struct 
+{
+  uint8_t palette;                      ///< палитра плазмы (PaletteID)
+  uint8_t scale;                        ///< масштаб узора
+  int8_t speed;                         ///< скорость изменения узора
+} StripPlasma;
+
+/** параметры эффекта огня
+ */
+typedef struct 
+{
+  uint8_t cooling;                      ///< скорость остывания пламени
+  uint8_t sparking;                     ///< частота появления новых искр
+  int8_t speed;                         ///< скорость горения
+} StripFire;
+
+/** параметры эффекта бегущей строки
+ */
+typedef struct 
+{
+  char text[24];                        ///< отображаемый текст
+  RGBColor color;                       ///< цвет текста
+  int8_t speed;                         ///< скорость движения строки
+} StripText;
+
+/** варианты отображения звука
+ */
+typedef enum 
+{
+    ASSpectrum      = 0,                ///< спектр: столбцы на матрице, цветные сегменты на ленте
+    ASBeat,                             ///< вспышка всей ленты на каждый удар
+    ASLevel,                            ///< индикатор уровня сигнала
+    ASMAX                               ///< количество вариантов
+} AudioStyle;
+
+/** параметры эффекта реакции на звук
+ */
+typedef struct 
+{
+  uint8_t style;                        ///< вариант отображения (AudioStyle)
+  uint8_t palette;                      ///< палитра (PaletteID)
+  uint8_t sensitivity;                  ///< чувствительность, от 1 до 100
+  int8_t speed;                         ///< частота обновления изображения
+} StripAudio;
+
+/** параметры приема DMX по сети
+ */
+typedef struct 
+{
+  uint16_t universe;                    ///< первый универс ленты (sACN, для Art-Net адрес порта на 1 меньше), следующие универсы продолжают ленту
+  uint16_t address;                     ///< адрес первого канала в каждом универсе, от 1
+  uint8_t protocols;                    ///< принимаемые протоколы (DmxProtocol)
+  uint8_t timeout;                      ///< время без пакетов до возврата к предыдущему эффекту, сек.
+  uint8_t fallback;                     ///< эффект, работающий при отсутствии пакетов (ModeID)
+} StripDmx;
+
 /** параметры работы модификаторов
  */
 typedef struct
@@ -209,6 +341,11 @@ typedef struct
     StripIntersects intersects;         ///< параметры пересечений
     StripSnake snake;                   ///< параметры змейки
     StripPulse pulse;                   ///< параметры пульса
+    StripPlasma plasma;                 ///< параметры плазмы
+    StripFire fire;                     ///< параметры огня
+    StripText text;                     ///< параметры бегущей строки
+    StripAudio audio;                   ///< параметры реакции на звук
+    StripDmx dmx;                       ///< параметры приема DMX
     StripCycle cycle;                   ///< параметры автосмены режимов
     
     uint32_t effectCreating;            ///< счетчик для создания нового элемента эффекта 
@@ -221,6 +358,18 @@ typedef struct
     uint16_t shedulerSize;              ///< размер области памяти с запланированными эффектами
 } Configuration;
 
+/** получатель значений параметров секции: клиент вебсокета или JSON-ответ HTTP API
+ */
+class ValueSink
+{
+public:
+    virtual void value(const char* section, const char* option, int32_t value) = 0;
+    virtual void value(const char* section, const char* option, bool value) = 0;
+    virtual void value(const char* section, const char* option, RGBColor value) = 0;
+    virtual void value(const char* section, const char* option, RGBValue value) = 0;
+    virtual void value(const char* section, const char* option, const char* value) = 0;
+};
+
 /** класс для работы с лентой
  */
 class SmartLED
@@ -233,7 +382,15 @@ public:
      * @param colorScheme цветовая схема библиотеки NeoPixel
      * @param ue TODO признак необходимости хранения параметров в EEPROM 
      */
-    SmartLED(uint8_t pCount, uint8_t pPin, neoPixelType colorScheme = NEO_RGB, bool ue = true);
+    SmartLED(uint16_t pCount, uint8_t pPin, neoPixelType colorScheme = NEO_RGB, bool ue = true);
+    /**
+     * Конструктор класса для светодиодной матрицы
+     * @param layout раскладка матрицы
+     * @param pPin номер пина, на котором висит матрица
+     * @param colorScheme цветовая схема библиотеки NeoPixel
+     * @param ue TODO признак необходимости хранения параметров в EEPROM 
+     */
+    SmartLED(const MatrixLayout& layout, uint8_t pPin, neoPixelType colorScheme = NEO_RGB, bool ue = true);
     /**
      * Деструктор класса
      */
@@ -243,11 +400,31 @@ public:
      * @param mID индекс нового режима работы ленты
      */
     void selectModeByID(ModeID mID);
+    /**
+     * Включить синхронизацию кадров с другими контроллерами
+     * @param role роль контроллера, SRNone - выключить синхронизацию
+     */
+    void beginSync(SyncRole role);
+    /**
+     * Включить распределенный вывод: эффект считается на всю виртуальную ленту,
+     * в свою ленту выводятся первые local пикселей, остальные участками по DDP
+     * уходят ведомым (режим dmx). Только для ленты, не для матрицы
+     * @param local количество пикселей собственной ленты
+     * @param targets ведомые в порядке их участков, массив должен существовать все время работы
+     * @param count количество ведомых
+     */
+    void beginRelay(uint16_t local, RelayTarget* targets, uint8_t count);
     /**
      * Выбор нового режима работы по имени
      * @param modeName имя нового режима
      */
     void selectMode(const char* modeName);
+    /**
+     * Найти режим по имени
+     * @param modeName имя режима
+     * @return индекс режима, MIMAX - режима с таким именем нет
+     */
+    ModeID findMode(const char* modeName);
     /**
      * Установить новое значение параметра. Значения можно задавать только параметрам, имеющимся в текущем режиме
      * @param option имя параметра в текстовом виде
@@ -259,6 +436,11 @@ public:
      * @return режим работы
      */
     ModeID mode();
+    /**
+     * Счетчик изменений режима и параметров (из любого источника: вебсокет, HTTP, MQTT, цикл режимов)
+     * @return количество изменений с момента запуска
+     */
+    uint32_t changeCount() { return changes; }
     /**
      * обновить данные в соответствии с заданным режимом и (или) модификатором, отправить их в ленту и при необходимости обновить ее
      */
@@ -271,21 +453,84 @@ public:
     IPAddress remoteIP(uint8_t num);
     /**
      * Отправить простой текст клиенту
-     * @param num номер клиента
+     * @param num номер клиента, allClients - всем подключенным клиентам
      * @param txt отправляемый текст
      */
     void sendTXT(uint8_t num, const char* txt);
+    /**
+     * Отправить контрольные суммы кадров эффектов для сравнения с эталоном (например, до и после
+     * рефакторинга). Каждый эффект, не зависящий от внешних данных (до audio), запускается с параметрами
+     * по умолчанию и зерном генератора DIGEST_SEED, шаги выполняются так же, как в process(), вместе с модификаторами.
+     * На каждый эффект уходит сообщение "digest:режим:хеш1;хеш2;...", хеш - FNV-1a по readyLeds.
+     * Рабочие настройки после расчета восстанавливаются, эффект перезапускается. На компьютере те же кадры
+     * сравнивает с сохраненным эталоном тест tools/host (make check)
+     * @param num клиент
+     * @param frames количество кадров на эффект, не больше DIGEST_FRAMES_MAX
+     * @param dumpMode режим, кадр которого нужно отправить целиком ("frame:режим:кадр:RRGGBB..."), MIMAX - не нужно
+     * @param dumpFrame номер этого кадра (с 0)
+     */
+    void sendFrameDigest(uint8_t num, uint16_t frames, ModeID dumpMode = MIMAX, uint16_t dumpFrame = 0);
+    /**
+     * Подготовить расчет эталонных кадров: нулевые буферы, параметры по умолчанию без EEPROM, зерно
+     * генератора DIGEST_SEED, затем запустить режим. Рабочие настройки сохраняет и восстанавливает
+     * вызывающий (sendFrameDigest, тест эталонных кадров в tools/host)
+     * @param mID режим
+     */
+    void resetDigest(ModeID mID);
+    /**
+     * Рассчитать следующий кадр так же, как в process() (модификатор, смена режима цикла, эффект), считая,
+     * что время следующего шага наступило. В ленту кадр не отправляется
+     * @return хеш FNV-1a по readyLeds
+     */
+    uint32_t stepDigest();
+    /**
+     * Последний рассчитанный кадр, pixels() цветов в порядке диодов ленты
+     */
+    const RGBColor* frame() { return readyLeds; }
+    /**
+     * Количество диодов в ленте (вместе с пикселями ведомых)
+     */
+    uint16_t pixels() { return pixelCount; }
+    /**
+     * Отправить статистику памяти: свободная куча, наибольший свободный блок, учет
+     * выделений библиотеки вебсокетов и самой программы и попадания в пулы блоков. Раз в telemetryPeriod
+     * статистика рассылается всем клиентам
+     * @param num номер клиента, allClients - всем подключенным клиентам
+     */
+    void sendMemory(uint8_t num);
     /**
      * Отправить текущие значения клиенту
      * @param num номер клиента
      */
     void sendCurrentValues(uint8_t num);
     void sendSection(uint8_t num, ModeID sectionID);
+    /**
+     * Записать текущий режим и параметры всех секций в JSON (для HTTP API)
+     * @param json объект для записи
+     */
+    void writeState(JsonWriter& json);
     void sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, int32_t value);
     void sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, bool value);
     void sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, RGBColor value);
     void sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, RGBValue value);
     void sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, RGBFloat value);
+    void sendValue(uint8_t num, const char *sectionTxt, const char* optionTxt, const char* value);
+    /**
+     * Получить индекс пикселя в ленте по его координатам на матрице. Для обычной 
+     * ленты матрица имеет высоту 1
+     * @param x координата по горизонтали (после поворота)
+     * @param y координата по вертикали (после поворота)
+     * @return индекс пикселя в ленте
+     */
+    uint16_t XY(uint16_t x, uint16_t y) { return xyMap[y * matrixWidth + x]; }
+    /**
+     * Ширина матрицы после поворота
+     */
+    uint16_t width() { return matrixWidth; }
+    /**
+     * Высота матрицы после поворота
+     */
+    uint16_t height() { return matrixHeight; }
     /**
      * дамп определенной области памяти
      * @param begin начало области памяти
@@ -296,12 +541,36 @@ public:
      * Сделать дамп памяти
      */
     void dump();
+    /**
+     * Ядро волн: один канал для count пикселей подряд в плоскость канала. Волна - треугольник
+     * от low до high и обратно, значения совпадают с палитрой compilePalette из двух точек
+     * {low, high}, но считаются без чтения палитры (выборка байтов по индексу не векторизуется).
+     * Возврат к началу палитры - переполнение uint16_t смещения, в цикле нет ветвлений и
+     * деления, и он векторизуется (make -C tools/host vec)
+     * @param plane плоскость канала
+     * @param phase смещение первого пикселя по палитре (формат 8.8)
+     * @param step приращение смещения на пиксель (формат 8.8)
+     * @param low значение канала в начале палитры
+     * @param high значение канала в середине палитры
+     * @param count количество пикселей, не более WAVE_TILE
+     */
+    static void renderChannel(uint8_t* plane, uint16_t phase, uint16_t step, uint8_t low, uint8_t high, uint8_t count);
+    /**
+     * Собрать плоскости каналов в пиксели
+     * @param target пиксели
+     * @param r, g, b плоскости каналов
+     * @param count количество пикселей
+     */
+    static void interleaveChannels(RGBColor* target, const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t count);
+    static const uint8_t allClients = 0xFF; ///< номер клиента для рассылки всем клиентам
     EffectPtr effect;                   ///< указатель на текущий метод-эффект
     ModifierPtr modifier;               ///< указатель на текущий метод-модификатор
+    CommandCapture capture;             ///< запись входящих команд вебсокета для воспроизведения
    
 private:
     const uint32_t refreshRate = 20;    ///< частота перерисовки ленты, не менее мс
-    const LightMode modes[10] = {
+    const uint32_t telemetryPeriod = 10000; ///< период рассылки статистики памяти, мс
+    const LightMode modes[MIMAX] = {
         { MIOff, "off", 1000, &SmartLED::makeOff },
         { MIWaves, "waves", 1000, &SmartLED::makeWaves },
         { MIRainbow, "rainbow", 1000, &SmartLED::makeRainbow },
@@ -311,6 +580,11 @@ private:
     //    { MIIntersects, "intersects", 1000, &makeIntersects },
         { MISnake, "snake", 1000, &SmartLED::makeSnake },
         { MIPulse, "pulse", 1000, &SmartLED::makePulse },
+        { MIPlasma, "plasma", 1000, &SmartLED::makePlasma },
+        { MIFire, "fire", 1000, &SmartLED::makeFire },
+        { MIText, "text", 1000, &SmartLED::makeText },
+        { MIAudio, "audio", 1000, &SmartLED::makeAudio },
+        { MIDmx, "dmx", 1000, &SmartLED::makeDmx },
         { MICycle, "cycle", 1000, &SmartLED::makeCycle },
         { MIShedule, "shedule", 1000, &SmartLED::makeShedule }
     };
@@ -320,6 +594,7 @@ private:
     uint32_t lastSaved;                 ///< время последнего сохранения настроек, мс
     uint32_t nextUpdate;                ///< время следующего обновления ленты, мс
     uint32_t nextStep;                  ///< время выполнения следующего шага, мс
+    uint32_t nextTelemetry;             ///< время следующей рассылки статистики памяти, мс
     uint16_t pixelCount;                ///< количество диодов в ленте
     int8_t defaultSpeed;                ///< скорость по умолчанию для тех эффектов, в которых напрямую управлять скоростью нельзя (например, волны)
     int8_t zeroSpeed;                   ///< скорость для выключенного состояния (0)
@@ -328,14 +603,79 @@ private:
     bool needToSave;                    ///< признак необходимости сохранения настроек
     bool microsOverflow;
     bool needToUpdate;                  ///< признак необходимости обновления ленты
+    bool frameUnchanged;                ///< эффект на этом шаге не изменил кадр, обновлять ленту не нужно
     bool useEEPROM;                     ///< TODO признак использования EEPROM
     RGBColor *readyLeds;                ///< массив с целочисленными данными, готовыми для отправки в ленту (FIXME - от него нужно избавиться, основным должен быть след.массив)
     RGBFloat *fLeds;                    ///< массив с дробными данными (для корректного расчета некоторых эффектов и модификаторов)
+    uint16_t *xyMap;                    ///< таблица соответствия координат матрицы индексам пикселей
+    uint16_t matrixWidth;               ///< ширина матрицы после поворота (для ленты - количество пикселей)
+    uint16_t matrixHeight;              ///< высота матрицы после поворота (для ленты - 1)
+    uint8_t *heat;                      ///< температура каждого пикселя для эффекта огня
+    uint16_t effectTime;                ///< счетчик шагов для эффектов, зависящих от времени
+    AudioAnalyzer *audio;               ///< анализатор звука, создается при первом включении режима audio
+    DmxReceiver *dmx;                   ///< приемник DMX, существует только в режиме dmx
+    uint8_t *ddpFrame;                  ///< кадр DDP, собираемый из пакетов до push (по 3 байта на пиксель), только в режиме dmx
+    bool dmxActive;                     ///< пакеты DMX приходят, эффект не выполняется
+    uint32_t changes;                   ///< счетчик изменений режима и параметров
+    FrameSync frameSync;                ///< синхронизация кадров с другими контроллерами
+    uint32_t syncSteps;                 ///< количество выполненных шагов эффекта (часы эффекта для синхронизации)
+    uint32_t lastStep;                  ///< время последнего шага эффекта, мкс
+    uint32_t syncChanges;               ///< changes на момент последней рассылки ведущим
+    ModeID syncCycleMode;               ///< режим, на который ведущий переключил цикл (MIMAX - нет)
+    int32_t syncTrim;                   ///< поправка длительности шага ведомого (интегральная часть подстройки), мкс
+    DdpSender *relay;                   ///< отправка участков виртуальной ленты, существует только при распределенном выводе
+    RelayTarget *relayTargets;          ///< ведомые распределенного вывода
+    uint8_t relayCount;                 ///< количество ведомых
+    uint16_t localPixels;               ///< пикселей собственной ленты, остальные принадлежат ведомым
+    uint32_t relayFrame;                ///< номер последнего отправленного кадра
+    FastRandom rng;                     ///< генератор случайных чисел эффектов
+    uint32_t effectSeed;                ///< зерно генератора при запуске эффекта, 0 - случайное
     Configuration settings;             ///< рабочие настройки
     StripSheduler sheduler;             ///< настройки планировщика
     
-    int8_t moving[3];                   ///< массив переменных для расчета движения волн
+    RGBColor palette[256];              ///< скомпилированная палитра (градиент из 256 цветов)
+    uint16_t palettePhase;              ///< текущее смещение палитры по ленте (формат 8.8)
+    uint16_t wavePhase[3];              ///< смещение волны каждого цвета по палитре (формат 8.8)
+    uint16_t waveStep[3];               ///< приращение индекса палитры на один пиксель для каждого цвета
+    int32_t waveShift[3];               ///< изменение смещения волны каждого цвета за один шаг эффекта
+    uint8_t stripOffset[3];             ///< позиции r, g, b внутри пикселя в буфере ленты (порядок цветов ленты)
+    bool stripPacked;                   ///< лента из трех байт на пиксель, буфер можно заполнять напрямую
 
+    /**
+     * Общая часть конструкторов: создание ленты, буферов и вебсокета
+     * @param pPin номер пина, на котором висит лента
+     * @param colorScheme цветовая схема библиотеки NeoPixel
+     * @param ue признак необходимости хранения параметров в EEPROM
+     */
+    void initialize(uint8_t pPin, neoPixelType colorScheme, bool ue);
+    /**
+     * Заполнить таблицу xyMap по раскладке матрицы. Выполняется один раз при создании объекта
+     * @param layout раскладка матрицы
+     */
+    void buildLayout(const MatrixLayout& layout);
+    /**
+     * Установить цвет пикселя матрицы по координатам. Пиксели за пределами матрицы игнорируются
+     * @param x координата по горизонтали
+     * @param y координата по вертикали
+     * @param color цвет пикселя
+     */
+    void setPixelXY(int16_t x, int16_t y, RGBColor color);
+    /**
+     * Отправить текст, подготовленный с запасом под заголовок кадра: текст начинается
+     * с frame[WEBSOCKETS_MAX_HEADER_SIZE], заголовок записывается перед ним, и кадр 
+     * уходит одним пакетом без выделения памяти и копирования
+     * @param num номер клиента, allClients - всем подключенным клиентам
+     * @param frame буфер кадра
+     * @param length длина текста (без запаса под заголовок)
+     */
+    void sendPrepared(uint8_t num, char* frame, int length);
+    /**
+     * Передать значения параметров секции получателю. Общая часть отправки по
+     * вебсокету и HTTP API
+     * @param sink получатель значений
+     * @param sectionID секция (режим)
+     */
+    void writeSection(ValueSink& sink, ModeID sectionID);
     /**
      * Рассчитать время следующей активации эффекта или модификатора
      * @param speed скорость выполнения эффекта или модификатора (обычно число от 1 до 100)
@@ -343,24 +683,60 @@ private:
      * @return рассчетное время в микросекундах
      */
     uint32_t calculateStep(uint8_t speed, uint16_t stepBase = 0);
+    /**
+     * Режим, эффект которого сейчас выполняется: в режиме dmx без пакетов это
+     * эффект возврата, его шаг и рассчитывается
+     * @return идентификатор режима
+     */
+    ModeID runningMode();
     /**
      * Разобрать строку на три беззнаковых целых числа, и поместить их в структуру типа RGBColor
      * @param valueString строка вида "123;45;67"
-     * @return структура типа RGBColor
+     * @return структура типа RGBColor, при другом количестве чисел - черный
      */
-    RGBColor parseColorValue(char* valueString);
+    RGBColor parseColorValue(const char* valueString);
     /**
      * Разобрать строку на три знаковых целых числа, и поместить их в структуру типа RGBValue
      * @param valueString строка вида "123;-45;6789"
      * @return структура типа RGBValue
      */
-    RGBValue parseSignedValue(char* valueString);
+    RGBValue parseSignedValue(const char* valueString);
     /**
      * Преобразовать строку в число
      * @param valueString строка
      * @return число
      */
     int32_t parseSingleValue(const char* valueString);
+    /**
+     * Скомпилировать палитру из равномерно распределенных ключевых точек. Градиент 
+     * замыкается: после последней точки цвет плавно возвращается к первой
+     * @param keys массив ключевых точек
+     * @param count количество ключевых точек
+     */
+    void compilePalette(const RGBColor* keys, uint8_t count);
+    /**
+     * Скомпилировать встроенную палитру из flash
+     * @param paletteID идентификатор встроенной палитры
+     */
+    void compilePalette(PaletteID paletteID);
+    /**
+     * Заполнить участок палитры линейным переходом между двумя цветами
+     * @param from начальный индекс палитры
+     * @param to конечный индекс палитры (включительно)
+     * @param c1 цвет в начале участка
+     * @param c2 цвет в конце участка
+     */
+    void fillGradient(uint8_t from, uint8_t to, RGBColor c1, RGBColor c2);
+    /**
+     * Отобразить палитру на ленту: вся палитра укладывается на ленту один раз
+     * @param phase смещение палитры (формат 8.8)
+     */
+    void renderPalette(uint16_t phase);
+    /**
+     * Перенести readyLeds в буфер ленты. Без белого канала и без яркости библиотеки
+     * байты раскладываются сразу в порядке цветов ленты, иначе через setPixelColor
+     */
+    void writeStrip();
     /**
      * Обнулить массив данных для ленты
      */
@@ -399,7 +775,7 @@ private:
     void makeOff(bool isDefault);
     /**
      * Метод эффекта волн. Движение волны каждого цвета рассчитывается независимо 
-     * от других, затем для каждого пикселя формируется необходимый цвет
+     * от других, каждый канал ленты заполняется отдельным проходом renderChannel
      * @param isDefault true, если метод запущен первый раз
      */
     void makeWaves(bool isDefault);
@@ -444,6 +820,58 @@ private:
      * @param isDefault true, если метод запущен первый раз
      */
     void makePulse(bool isDefault);
+    /**
+     * Метод эффекта плазмы. Цвет каждого пикселя матрицы определяется суммой 
+     * нескольких синусоид от координат и времени, пропущенной через палитру
+     * @param isDefault true, если метод запущен первый раз
+     */
+    void makePlasma(bool isDefault);
+    /**
+     * Метод эффекта огня. В каждом столбце матрицы снизу появляются искры, 
+     * тепло поднимается вверх и остывает; на ленте огонь идет вдоль всей ленты
+     * @param isDefault true, если метод запущен первый раз
+     */
+    void makeFire(bool isDefault);
+    /**
+     * Метод эффекта бегущей строки. Текст шрифтом 5x7 движется справа налево
+     * @param isDefault true, если метод запущен первый раз
+     */
+    void makeText(bool isDefault);
+    /**
+     * Метод эффекта реакции на звук. Сигнал с микрофона раскладывается на полосы 
+     * спектра, которые отображаются столбцами, вспышками на удар или индикатором уровня
+     * @param isDefault true, если метод запущен первый раз
+     */
+    void makeAudio(bool isDefault);
+    /**
+     * Метод режима управления по сети. Данные каналов выводятся на ленту при приеме
+     * (см. receiveDmx), а пока пакетов нет - работает предыдущий эффект
+     * @param isDefault true, если метод запущен первый раз
+     */
+    void makeDmx(bool isDefault);
+    /**
+     * Принять все пришедшие пакеты DMX и разложить каналы по пикселям: по 3 канала
+     * на пиксель начиная с settings.dmx.address, каждый универс продолжает ленту.
+     * Пакеты DDP собираются в ddpFrame по своему смещению, в ленту кадр переносится
+     * целиком только по принятому флагу push.
+     * При отсутствии пакетов дольше settings.dmx.timeout включает предыдущий эффект
+     */
+    void receiveDmx();
+    /**
+     * Ведущий: разослать состояние часов эффекта раз в SYNC_INTERVAL и сразу при
+     * изменениях. Ведомый: повторить смену режима ведущего и подстроить время
+     * следующего шага под его часы. Малое рассогласование исправляется плавно, не
+     * больше SYNC_SLEW % шага за пакет, большое - переносом часов и фазы эффекта
+     */
+    void processSync();
+    /**
+     * Разослать ведомым их участки кадра и затем показать кадр у всех сразу
+     */
+    void sendRelay();
+    /**
+     * Задать зерно генератора эффекта при его запуске: effectSeed или случайное (аппаратный генератор)
+     */
+    void seedEffect();
     /**
      * Метод эффекта автосмены режимов. С заданной периодичностью меняет текущий
      * режим работы ленты
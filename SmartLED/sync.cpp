@@ -0,0 +1,121 @@
+#include "sync.h"
+
+/// идентификатор пакета синхронизации
+const uint8_t syncIdentifier[4] PROGMEM = { 'S', 'L', 'S', 'Y' };
+/// версия формата пакета
+#define SYNC_VERSION 1
+/// мультикаст-группа синхронизации
+#define SYNC_GROUP IPAddress(239, 255, 83, 76)
+
+/// числа в пакете передаются старшим байтом вперед, как в DDP и E1.31
+static void put16(uint8_t* p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xFF;
+}
+
+static void put32(uint8_t* p, uint32_t value)
+{
+    put16(p, value >> 16);
+    put16(&p[2], value & 0xFFFF);
+}
+
+static uint16_t get16(const uint8_t* p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return ((uint32_t) get16(p) << 16) | get16(&p[2]);
+}
+
+FrameSync::FrameSync()
+{
+    role = SRNone;
+    memset(&leader, 0, sizeof (leader));
+    receivedMicros = 0;
+    lastPacket = 0;
+    lastSent = 0;
+    received = 0;
+    dropped = 0;
+    error = 0;
+    sequence = 0;
+    hasSequence = false;
+}
+
+void FrameSync::begin(SyncRole r)
+{
+    stop();
+    role = r;
+    hasSequence = false;
+    if (role == SRFollower)
+        udp.beginMulticast(WiFi.localIP(), SYNC_GROUP, SYNC_PORT);
+}
+
+void FrameSync::stop()
+{
+    if (role == SRFollower)
+        udp.stop();
+    role = SRNone;
+}
+
+void FrameSync::send(const SyncState& state)
+{
+    if (role != SRLeader)
+        return;
+    memcpy_P(packet, syncIdentifier, sizeof (syncIdentifier));
+    packet[4] = SYNC_VERSION;
+    packet[5] = state.mode;
+    packet[6] = state.specialMode;
+    packet[7] = state.direct;
+    put16(&packet[8], sequence++);
+    put32(&packet[10], state.steps);
+    put32(&packet[14], state.period);
+    put32(&packet[18], state.age);
+    put16(&packet[22], state.palettePhase);
+    put16(&packet[24], state.effectTime);
+    put16(&packet[26], 0);
+    udp.beginPacketMulticast(SYNC_GROUP, SYNC_PORT, WiFi.localIP());
+    udp.write(packet, sizeof (packet));
+    udp.endPacket();
+    lastSent = millis();
+}
+
+bool FrameSync::read()
+{
+    bool result = false;
+    int size;
+    /// применяется только последний пакет из накопившихся, время берется на момент его приема
+    while ((role == SRFollower) && ((size = udp.parsePacket()) > 0))
+    {
+        if ((size < SYNC_PACKET_SIZE) || (udp.read(packet, sizeof (packet)) != sizeof (packet)) ||
+            (memcmp_P(packet, syncIdentifier, sizeof (syncIdentifier)) != 0) || (packet[4] != SYNC_VERSION))
+        {
+            dropped++;
+            continue;
+        }
+        uint16_t seq = get16(&packet[8]);
+        /// пакет с тем же или чуть меньшим номером пришел не по порядку, большой скачок назад - перезапуск ведущего
+        if (hasSequence && ((int16_t) (seq - sequence) <= 0) && ((int16_t) (seq - sequence) > -100))
+        {
+            dropped++;
+            continue;
+        }
+        sequence = seq;
+        hasSequence = true;
+        leader.mode = packet[5];
+        leader.specialMode = packet[6];
+        leader.direct = (int8_t) packet[7];
+        leader.steps = get32(&packet[10]);
+        leader.period = get32(&packet[14]);
+        leader.age = get32(&packet[18]);
+        leader.palettePhase = get16(&packet[22]);
+        leader.effectTime = get16(&packet[24]);
+        receivedMicros = micros();
+        lastPacket = millis();
+        received++;
+        result = true;
+    }
+    return result;
+}
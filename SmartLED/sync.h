@@ -0,0 +1,90 @@
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+/// порт синхронизации кадров
+#define SYNC_PORT 21400
+/// размер пакета синхронизации
+#define SYNC_PACKET_SIZE 28
+/// период рассылки состояния ведущим, мс
+#define SYNC_INTERVAL 100
+/// ведомый без пакетов столько мс работает сам по себе
+#define SYNC_TIMEOUT 2000
+/// подстройка ведомого: не больше стольких процентов шага за пакет (фаза) и за шаг (частота)
+#define SYNC_SLEW 25
+/// рассогласование больше стольких шагов исправляется переносом часов, а не подстройкой
+#define SYNC_RESYNC_STEPS 4
+
+/** роль контроллера в синхронизации кадров
+ */
+typedef enum
+{
+    SRNone          = 0,                ///< синхронизация выключена
+    SRLeader,                           ///< рассылает часы эффекта и смену режимов
+    SRFollower                          ///< подстраивает шаги эффекта под ведущего
+} SyncRole;
+
+/** состояние часов эффекта ведущего на момент отправки пакета
+ */
+typedef struct
+{
+    uint8_t mode;                       ///< текущий режим (эффект)
+    uint8_t specialMode;                ///< особый режим (цикл, расписание) или MIOff
+    int8_t direct;                      ///< направление движения эффекта
+    uint32_t steps;                     ///< количество шагов эффекта с момента запуска
+    uint32_t period;                    ///< длительность текущего шага, мкс
+    uint32_t age;                       ///< время от последнего шага до отправки, мкс
+    uint16_t palettePhase;              ///< смещение палитры по ленте (радуга)
+    uint16_t effectTime;                ///< счетчик эффектов, зависящих от времени (плазма, огонь)
+} SyncState;
+
+/** обмен состоянием часов эффекта между контроллерами по мультикасту UDP:
+ * ведущий периодически рассылает SyncState, ведомые принимают последний из
+ * пришедших пакетов, устаревшие (по порядковому номеру) пропускаются
+ */
+class FrameSync
+{
+public:
+    /**
+     * Конструктор класса
+     */
+    FrameSync();
+    /**
+     * Открыть сокет
+     * @param role роль контроллера
+     */
+    void begin(SyncRole role);
+    /**
+     * Закрыть сокет
+     */
+    void stop();
+    /**
+     * Разослать состояние (только для ведущего)
+     * @param state состояние часов эффекта
+     */
+    void send(const SyncState& state);
+    /**
+     * Прочитать пакеты ведущего, пришедшие с прошлого вызова
+     * @return true, если принят новый пакет, состояние в leader
+     */
+    bool read();
+    SyncRole role;                      ///< роль контроллера
+    SyncState leader;                   ///< последнее принятое состояние ведущего
+    uint32_t receivedMicros;            ///< время приема последнего пакета, мкс
+    uint32_t lastPacket;                ///< время приема последнего пакета, мс
+    uint32_t lastSent;                  ///< время отправки последнего пакета, мс
+    uint32_t received;                  ///< количество принятых пакетов
+    uint32_t dropped;                   ///< количество некорректных и устаревших пакетов
+    int32_t error;                      ///< последнее рассогласование с ведущим, мкс (больше 0 - ведомый отстает)
+
+private:
+    WiFiUDP udp;
+    uint16_t sequence;                  ///< номер следующего (ведущий) или последнего принятого (ведомый) пакета
+    bool hasSequence;                   ///< ведомый уже принимал пакеты
+    uint8_t packet[SYNC_PACKET_SIZE];   ///< буфер пакета
+};
+
+#endif /* SYNC_H */
@@ -211,7 +211,29 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     uint8_t * headerPtr;
     uint8_t * payloadPtr = payload;
     bool useInternBuffer = false;
+    bool useStackBuffer  = false;
     bool ret             = true;
+    uint8_t stackBuffer[WEBSOCKETS_STACK_FRAME_SIZE];
+
+#if defined(WEBSOCKETS_USE_DEFLATE)
+    // complete text and binary messages are compressed if that makes them smaller, RSV1 marks them
+    uint8_t * deflated = NULL;
+    if(client->cDeflate && fin && (opcode == WSop_text || opcode == WSop_binary) && (length >= WEBSOCKETS_DEFLATE_MIN_SIZE)) {
+        deflated = (uint8_t *)ws_malloc(WEBSOCKETS_MAX_HEADER_SIZE + length);
+        if(deflated) {
+            size_t deflatedLength = ws_deflate((payload + (headerToPayload ? WEBSOCKETS_MAX_HEADER_SIZE : 0)), length, (deflated + WEBSOCKETS_MAX_HEADER_SIZE), (length - 1));
+            if(deflatedLength > 0) {
+                DEBUG_WEBSOCKETS("[WS][%d][sendFrame] deflate %u -> %u\n", client->num, length, deflatedLength);
+                payloadPtr      = deflated;
+                length          = deflatedLength;
+                headerToPayload = true;
+            } else {
+                ws_free(deflated);
+                deflated = NULL;
+            }
+        }
+    }
+#endif
 
     // calculate header Size
     if(length < 126) {
@@ -226,12 +248,38 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
         headerSize += 4;
     }
 
+#if defined(WEBSOCKETS_USE_SEND_QUEUE) || defined(WEBSOCKETS_USE_SEND_LIMIT)
+    // never wait for a slow client: the frame is dropped if the socket and the queue can not take it
+    if(!client->cIsClient && !canQueue(client, (headerSize + length))) {
+        DEBUG_WEBSOCKETS("[WS][%d][sendFrame] send queue full, frame dropped!\n", client->num);
+        client->txDropped++;
+        if(!fin || (opcode == WSop_continuation)) {
+            // the rest of a fragmented message can not be sent without this part
+            client->txBroken = true;
+        }
+#if defined(WEBSOCKETS_USE_DEFLATE)
+        ws_free(deflated);
+#endif
+        return false;
+    }
+#endif
+
+    // small frames: copy to the stack to send them in one TCP package without touching the heap
+    // (callers that can reserve WEBSOCKETS_MAX_HEADER_SIZE in front of the payload should use headerToPayload)
+    if(!headerToPayload && (length > 0) && ((length + WEBSOCKETS_MAX_HEADER_SIZE) <= sizeof(stackBuffer))) {
+        memcpy((stackBuffer + WEBSOCKETS_MAX_HEADER_SIZE), payload, length);
+        headerToPayload = true;
+        useInternBuffer = true;
+        useStackBuffer  = true;
+        payloadPtr      = stackBuffer;
+    }
+
 #ifdef WEBSOCKETS_USE_BIG_MEM
     // only for ESP since AVR has less HEAP
     // try to send data in one TCP package (only if some free Heap is there)
     if(!headerToPayload && ((length > 0) && (length < 1400)) && (GET_FREE_HEAP > 6000)) {
         DEBUG_WEBSOCKETS("[WS][%d][sendFrame] pack to one TCP package...\n", client->num);
-        uint8_t * dataPtr = (uint8_t *)malloc(length + WEBSOCKETS_MAX_HEADER_SIZE);
+        uint8_t * dataPtr = (uint8_t *)ws_malloc(length + WEBSOCKETS_MAX_HEADER_SIZE);
         if(dataPtr) {
             memcpy((dataPtr + WEBSOCKETS_MAX_HEADER_SIZE), payload, length);
             headerToPayload = true;
@@ -259,6 +307,12 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
 
     createHeader(headerPtr, opcode, length, client->cIsClient, maskKey, fin);
 
+#if defined(WEBSOCKETS_USE_DEFLATE)
+    if(deflated) {
+        headerPtr[0] |= (1 << 6);    // RSV1
+    }
+#endif
+
     if(client->cIsClient && useInternBuffer) {
         uint8_t * dataMaskPtr;
 
@@ -301,11 +355,15 @@ bool WebSockets::sendFrame(WSclient_t * client, WSopcode_t opcode, uint8_t * pay
     DEBUG_WEBSOCKETS("[WS][%d][sendFrame] sending Frame Done (%luus).\n", client->num, (micros() - start));
 
 #ifdef WEBSOCKETS_USE_BIG_MEM
-    if(useInternBuffer && payloadPtr) {
-        free(payloadPtr);
+    if(useInternBuffer && !useStackBuffer && payloadPtr) {
+        ws_free(payloadPtr);
     }
 #endif
 
+#if defined(WEBSOCKETS_USE_DEFLATE)
+    ws_free(deflated);
+#endif
+
     return ret;
 }
 
@@ -318,7 +376,6 @@ void WebSockets::headerDone(WSclient_t * client) {
     client->cWsRXsize = 0;
     DEBUG_WEBSOCKETS("[WS][%d][headerDone] Header Handling Done.\n", client->num);
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    client->cHttpLine = "";
     handleWebsocket(client);
 #endif
 }
@@ -424,6 +481,14 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
     DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] fin: %u rsv1: %u rsv2: %u rsv3 %u  opCode: %u\n", client->num, header->fin, header->rsv1, header->rsv2, header->rsv3, header->opCode);
     DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] mask: %u payloadLen: %u\n", client->num, header->mask, header->payloadLen);
 
+    // control frames carry at most 125 bytes and are never fragmented (RFC 6455 5.5),
+    // rsv2 and rsv3 have no negotiated meaning
+    if(((header->opCode & 0x08) && (header->payloadLen > 125 || !header->fin)) || header->rsv2 || header->rsv3) {
+        DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] invalid frame header!\n", client->num);
+        clientDisconnect(client, 1002);
+        return;
+    }
+
     if(header->payloadLen > WEBSOCKETS_MAX_DATA_SIZE) {
         DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] payload too big! (%u)\n", client->num, header->payloadLen);
         clientDisconnect(client, 1009);
@@ -441,7 +506,7 @@ void WebSockets::handleWebsocketCb(WSclient_t * client) {
 
     if(header->payloadLen > 0) {
         // if text data we need one more
-        payload = (uint8_t *)malloc(header->payloadLen + 1);
+        payload = (uint8_t *)ws_malloc(header->payloadLen + 1);
 
         if(!payload) {
             DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] to less memory to handle payload %d!\n", client->num, header->payloadLen);
@@ -468,6 +533,34 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
             }
         }
 
+#if defined(WEBSOCKETS_USE_DEFLATE)
+        if(header->rsv1) {
+            // RSV1 is only set on the first frame, compressed messages have to come in one frame
+            uint16_t code = 1002;
+            if(client->cDeflate && header->fin && (header->opCode == WSop_text || header->opCode == WSop_binary)) {
+                uint8_t * inflated     = (uint8_t *)ws_malloc(WEBSOCKETS_INFLATE_SIZE + 1);
+                int32_t inflatedLength = inflated ? ws_inflate(payload, header->payloadLen, inflated, WEBSOCKETS_INFLATE_SIZE) : WS_INFLATE_NO_MEMORY;
+                if(inflatedLength >= 0) {
+                    DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] inflate %u -> %d\n", client->num, header->payloadLen, inflatedLength);
+                    ws_free(payload);
+                    payload                 = inflated;
+                    payload[inflatedLength] = 0x00;
+                    header->payloadLen      = inflatedLength;
+                    code                    = 0;
+                } else {
+                    ws_free(inflated);
+                    code = (inflatedLength == WS_INFLATE_OVERFLOW) ? 1009 : ((inflatedLength == WS_INFLATE_NO_MEMORY) ? 1011 : 1007);
+                }
+            }
+            if(code) {
+                DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] can not inflate message (%u)!\n", client->num, code);
+                ws_free(payload);
+                clientDisconnect(client, code);
+                return;
+            }
+        }
+#endif
+
         switch(header->opCode) {
             case WSop_text:
                 DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] text: %s\n", client->num, payload);
@@ -508,7 +601,7 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
         }
 
         if(payload) {
-            free(payload);
+            ws_free(payload);
         }
 
         // reset input
@@ -520,7 +613,7 @@ void WebSockets::handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t
 
     } else {
         DEBUG_WEBSOCKETS("[WS][%d][handleWebsocket] missing data!\n", client->num);
-        free(payload);
+        ws_free(payload);
         clientDisconnect(client, 1002);
     }
 }
@@ -551,6 +644,41 @@ String WebSockets::acceptKey(String & clientKey) {
     return key;
 }
 
+/**
+ * generate the key for Sec-WebSocket-Accept without heap allocations
+ * @param clientKey const char *  Sec-WebSocket-Key, up to WEBSOCKETS_KEY_SIZE chars
+ * @param accept char *  result, WEBSOCKETS_ACCEPT_SIZE + 1 byte
+ */
+void WebSockets::acceptKey(const char * clientKey, char * accept) {
+    static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    uint8_t sha1HashBin[20]  = { 0 };
+    char data[WEBSOCKETS_KEY_SIZE + sizeof(GUID)];
+    size_t keyLength = strnlen(clientKey, WEBSOCKETS_KEY_SIZE);
+
+    memcpy(&data[0], clientKey, keyLength);
+    memcpy(&data[keyLength], GUID, sizeof(GUID));
+#ifdef ESP8266
+    sha1((const uint8_t *)&data[0], (keyLength + sizeof(GUID) - 1), &sha1HashBin[0]);
+#elif defined(ESP32)
+    esp_sha(SHA1, (unsigned char *)&data[0], (keyLength + sizeof(GUID) - 1), &sha1HashBin[0]);
+#else
+    SHA1_CTX ctx;
+    SHA1Init(&ctx);
+    SHA1Update(&ctx, (const unsigned char *)&data[0], (keyLength + sizeof(GUID) - 1));
+    SHA1Final(&sha1HashBin[0], &ctx);
+#endif
+
+    // 20 byte give 28 chars, some libb64 versions add a line break
+    char buffer[WEBSOCKETS_ACCEPT_SIZE + 4];
+    base64_encodestate _state;
+    base64_init_encodestate(&_state);
+    int len = base64_encode_block((const char *)&sha1HashBin[0], sizeof(sha1HashBin), &buffer[0], &_state);
+    base64_encode_blockend((buffer + len), &_state);
+
+    memcpy(accept, &buffer[0], WEBSOCKETS_ACCEPT_SIZE);
+    accept[WEBSOCKETS_ACCEPT_SIZE] = 0x00;
+}
+
 /**
  * base64_encode
  * @param data uint8_t *
@@ -559,7 +687,7 @@ String WebSockets::acceptKey(String & clientKey) {
  */
 String WebSockets::base64_encode(uint8_t * data, size_t length) {
     size_t size   = ((length * 1.6f) + 1);
-    char * buffer = (char *)malloc(size);
+    char * buffer = (char *)ws_malloc(size);
     if(buffer) {
         base64_encodestate _state;
         base64_init_encodestate(&_state);
@@ -567,7 +695,7 @@ String WebSockets::base64_encode(uint8_t * data, size_t length) {
         len     = base64_encode_blockend((buffer + len), &_state);
 
         String base64 = String(buffer);
-        free(buffer);
+        ws_free(buffer);
         return base64;
     }
     return String("-FAIL-");
@@ -661,6 +789,15 @@ size_t WebSockets::write(WSclient_t * client, uint8_t * out, size_t n) {
         return 0;
     if(client == NULL)
         return 0;
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+    if(!client->cIsClient) {
+        if(client->tcp == NULL || !client->tcp->connected()) {
+            DEBUG_WEBSOCKETS("[write] not connected!\n");
+            return 0;
+        }
+        return queueWrite(client, out, n);
+    }
+#endif
     unsigned long t = millis();
     size_t len      = 0;
     size_t total    = 0;
@@ -706,6 +843,145 @@ size_t WebSockets::write(WSclient_t * client, const char * out) {
     return write(client, (uint8_t *)out, strlen(out));
 }
 
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+/**
+ * check if a frame can be written without waiting for the client
+ * @param client WSclient_t *  ptr to the client struct
+ * @param n size_t  bytes of the frame (header included)
+ * @return true if the socket and the send queue can take it
+ */
+bool WebSockets::canQueue(WSclient_t * client, size_t n) {
+    size_t room = (WEBSOCKETS_SEND_QUEUE_SIZE - client->txLength);
+    if(client->txLength == 0 && client->tcp) {
+        size_t socketRoom = client->tcp->availableForWrite();
+        if(n <= socketRoom) {
+            return true;
+        }
+        room += socketRoom;
+    }
+    if(n > room) {
+        return false;
+    }
+    if(!client->txQueue) {
+        client->txQueue = (uint8_t *)ws_malloc(WEBSOCKETS_SEND_QUEUE_SIZE);
+    }
+    return (client->txQueue != NULL);
+}
+#elif defined(WEBSOCKETS_USE_SEND_LIMIT)
+/**
+ * check if a frame can be written without growing the buffer of AsyncTCPbuffer beyond
+ * WEBSOCKETS_SEND_QUEUE_SIZE. AsyncTCPbuffer refills the TCP send buffer from every ack,
+ * free room there means that nothing of the previous frames is waiting anymore
+ * @param client WSclient_t *  ptr to the client struct
+ * @param n size_t  bytes of the frame (header included)
+ * @return true if the frame can be written
+ */
+bool WebSockets::canQueue(WSclient_t * client, size_t n) {
+    if(!client->asyncTcp) {
+        return true;
+    }
+    size_t room = client->asyncTcp->space();
+    if(room == 0) {
+        return false;
+    }
+    client->txProgress = millis();
+    return (n <= (room + WEBSOCKETS_SEND_QUEUE_SIZE));
+}
+#endif
+
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+/**
+ * write without blocking: what the socket does not take now is queued
+ * behind the data queued before and sent by handleSendQueue
+ * @param client WSclient_t *  ptr to the client struct
+ * @param out uint8_t *
+ * @param n size_t
+ * @return bytes written or queued
+ */
+size_t WebSockets::queueWrite(WSclient_t * client, uint8_t * out, size_t n) {
+    size_t total = 0;
+    if(client->txLength == 0) {
+        size_t room = client->tcp->availableForWrite();
+        if(room) {
+            total = client->tcp->write((const uint8_t *)out, ((n < room) ? n : room));
+        }
+        client->txProgress = millis();
+    }
+    out += total;
+    n -= total;
+    if(n == 0) {
+        return total;
+    }
+
+    if(!client->txQueue) {
+        client->txQueue = (uint8_t *)ws_malloc(WEBSOCKETS_SEND_QUEUE_SIZE);
+    }
+    if(!client->txQueue || (n > (size_t)(WEBSOCKETS_SEND_QUEUE_SIZE - client->txLength))) {
+        DEBUG_WEBSOCKETS("[write] send queue overflow, %zu bytes lost!\n", n);
+        client->txBroken = true;
+        return total;
+    }
+
+    size_t tail = (client->txHead + client->txLength) % WEBSOCKETS_SEND_QUEUE_SIZE;
+    size_t part = (WEBSOCKETS_SEND_QUEUE_SIZE - tail);
+    if(part > n) {
+        part = n;
+    }
+    memcpy(&client->txQueue[tail], out, part);
+    memcpy(&client->txQueue[0], (out + part), (n - part));
+    client->txLength += n;
+    return (total + n);
+}
+
+/**
+ * pass queued data to the socket as far as it takes it, never waits
+ * @param client WSclient_t *  ptr to the client struct
+ * @return false if the client has to be disconnected (stalled or a frame was cut)
+ */
+bool WebSockets::handleSendQueue(WSclient_t * client) {
+    while(client->txLength && client->tcp) {
+        size_t n    = (WEBSOCKETS_SEND_QUEUE_SIZE - client->txHead);
+        size_t room = client->tcp->availableForWrite();
+        if(n > client->txLength) {
+            n = client->txLength;
+        }
+        if(n > room) {
+            n = room;
+        }
+        if(n == 0) {
+            break;
+        }
+        n = client->tcp->write((const uint8_t *)&client->txQueue[client->txHead], n);
+        if(n == 0) {
+            break;
+        }
+        client->txHead = ((client->txHead + n) % WEBSOCKETS_SEND_QUEUE_SIZE);
+        client->txLength -= n;
+        client->txProgress = millis();
+    }
+    if(client->txLength == 0) {
+        client->txHead = 0;
+    }
+    if(client->txBroken) {
+        return false;
+    }
+    return (client->txLength == 0) || ((millis() - client->txProgress) <= WEBSOCKETS_SEND_STALL_TIMEOUT);
+}
+
+/**
+ * drop the queued data and free the queue
+ * @param client WSclient_t *  ptr to the client struct
+ */
+void WebSockets::releaseSendQueue(WSclient_t * client) {
+    ws_free(client->txQueue);
+    client->txQueue   = NULL;
+    client->txHead    = 0;
+    client->txLength  = 0;
+    client->txDropped = 0;
+    client->txBroken  = false;
+}
+#endif
+
 /**
  * enable ping/pong heartbeat process
  * @param client WSclient_t *
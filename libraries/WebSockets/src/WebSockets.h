@@ -40,6 +40,9 @@
 #include <functional>
 #endif
 
+#include "WebSocketsMemory.h"
+#include "WebSocketsDeflate.h"
+
 #ifndef NODEBUG_WEBSOCKETS
 #ifdef DEBUG_ESP_PORT
 #define DEBUG_WEBSOCKETS(...) DEBUG_ESP_PORT.printf(__VA_ARGS__)
@@ -88,10 +91,39 @@
 // max size of the WS Message Header
 #define WEBSOCKETS_MAX_HEADER_SIZE (14)
 
+// frames up to this size (header included) are assembled on the stack
+// instead of the heap to go out in one TCP package
+#ifndef WEBSOCKETS_STACK_FRAME_SIZE
+#define WEBSOCKETS_STACK_FRAME_SIZE (128)
+#endif
+
+// the server parses the upgrade request in place: header lines longer than
+// this are cut (a cut request line is rejected), the url has to fit its buffer
+#ifndef WEBSOCKETS_HEADER_LINE_SIZE
+#define WEBSOCKETS_HEADER_LINE_SIZE (128)
+#endif
+#ifndef WEBSOCKETS_URL_SIZE
+#define WEBSOCKETS_URL_SIZE (64)
+#endif
+// base64 of the 16 byte Sec-WebSocket-Key and of the 20 byte SHA1 for Sec-WebSocket-Accept
+#define WEBSOCKETS_KEY_SIZE (24)
+#define WEBSOCKETS_ACCEPT_SIZE (28)
+// stack buffer for the 101 response, a longer origin or protocol falls back to the heap
+#define WEBSOCKETS_HANDSHAKE_RESPONSE_SIZE (384)
+
 #if !defined(WEBSOCKETS_NETWORK_TYPE)
 // select Network type based
 #if defined(ESP8266) || defined(ESP31B)
+// the event driven server (data is parsed from the TCP callbacks, idle clients
+// cost nothing in loop()) is used when ESPAsyncTCP is part of the build
+#if defined(__has_include) && !defined(WEBSOCKETS_NO_ASYNC)
+#if __has_include(<ESPAsyncTCP.h>) && __has_include(<ESPAsyncTCPbuffer.h>)
+#define WEBSOCKETS_NETWORK_TYPE NETWORK_ESP8266_ASYNC
+#endif
+#endif
+#if !defined(WEBSOCKETS_NETWORK_TYPE)
 #define WEBSOCKETS_NETWORK_TYPE NETWORK_ESP8266
+#endif
 //#define WEBSOCKETS_NETWORK_TYPE NETWORK_ESP8266_ASYNC
 //#define WEBSOCKETS_NETWORK_TYPE NETWORK_W5100
 
@@ -182,6 +214,50 @@
 #define HAS_SSL
 #endif
 
+// server connections send through a bounded queue per client that is drained from loop(),
+// a slow client can not block the caller. frames that do not fit are dropped (WStype_DROPPED
+// is reported once the queue is empty again), a client that does not take any data for
+// WEBSOCKETS_SEND_STALL_TIMEOUT is disconnected. a queue size of 0 restores the blocking write
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
+#ifndef WEBSOCKETS_SEND_QUEUE_SIZE
+#define WEBSOCKETS_SEND_QUEUE_SIZE (1024)
+#endif
+#ifndef WEBSOCKETS_SEND_STALL_TIMEOUT
+#define WEBSOCKETS_SEND_STALL_TIMEOUT (10000)
+#endif
+#if(WEBSOCKETS_SEND_QUEUE_SIZE > 0)
+#define WEBSOCKETS_USE_SEND_QUEUE
+#endif
+#endif
+
+// the async interface has no loop() to drain a queue: AsyncTCPbuffer keeps whatever the TCP send
+// buffer does not take. to bound it a frame is only written while that buffer has room (so nothing
+// is waiting behind it) and the frame fits into the room plus WEBSOCKETS_SEND_QUEUE_SIZE, otherwise
+// it is dropped as above. dropped frames and stalled clients are handled before the next send
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+#ifndef WEBSOCKETS_SEND_QUEUE_SIZE
+#define WEBSOCKETS_SEND_QUEUE_SIZE (1024)
+#endif
+#ifndef WEBSOCKETS_SEND_STALL_TIMEOUT
+#define WEBSOCKETS_SEND_STALL_TIMEOUT (10000)
+#endif
+#define WEBSOCKETS_USE_SEND_LIMIT
+#endif
+
+// permessage-deflate (RFC 7692) can be enabled on the server, text and binary messages of
+// at least WEBSOCKETS_DEFLATE_MIN_SIZE byte are compressed, both sides reset their window
+// after every message. compressed messages of the peer are inflated into a buffer of
+// WEBSOCKETS_INFLATE_SIZE byte, bigger ones close the connection (1009)
+#ifndef WEBSOCKETS_SAVE_RAM
+#define WEBSOCKETS_USE_DEFLATE
+#ifndef WEBSOCKETS_DEFLATE_MIN_SIZE
+#define WEBSOCKETS_DEFLATE_MIN_SIZE (128)
+#endif
+#ifndef WEBSOCKETS_INFLATE_SIZE
+#define WEBSOCKETS_INFLATE_SIZE (1024)
+#endif
+#endif
+
 // moves all Header strings to Flash (~300 Byte)
 #ifdef WEBSOCKETS_SAVE_RAM
 #define WEBSOCKETS_STRING(var) F(var)
@@ -207,6 +283,7 @@ typedef enum {
     WStype_FRAGMENT_FIN,
     WStype_PING,
     WStype_PONG,
+    WStype_DROPPED,    ///< frames were dropped for a slow client, its send queue is empty again
 } WStype_t;
 
 typedef enum {
@@ -234,6 +311,59 @@ typedef struct {
     uint8_t * maskKey;
 } WSMessageHeader_t;
 
+// everything that is only needed until the upgrade is done. the server allocates it
+// per connection and frees it after the WStype_CONNECTED event, the client keeps its own
+typedef struct {
+    String cUrl;       ///< http url
+    uint16_t cCode;    ///< http code
+
+    bool cIsUpgrade;      ///< Connection == Upgrade
+    bool cIsWebsocket;    ///< Upgrade == websocket
+
+    String cSessionId;     ///< client Set-Cookie (session id)
+    String cKey;           ///< client Sec-WebSocket-Key
+    String cAccept;        ///< client Sec-WebSocket-Accept
+    String cProtocol;      ///< client Sec-WebSocket-Protocol
+    String cExtensions;    ///< client Sec-WebSocket-Extensions
+    uint16_t cVersion;     ///< client Sec-WebSocket-Version
+
+    String base64Authorization;    ///< Base64 encoded Auth request
+    String plainAuthorization;     ///< Base64 encoded Auth request
+
+    String extraHeaders;
+
+    bool cHttpHeadersValid;           ///< non-websocket http header validity indicator
+    size_t cMandatoryHeadersCount;    ///< non-websocket mandatory http headers present count
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    String cHttpLine;    ///< HTTP header lines
+#endif
+} WShandshake_t;
+
+// upgrade request of a server connection, filled by the incremental header parser without any String
+typedef struct {
+    char line[WEBSOCKETS_HEADER_LINE_SIZE];    ///< header line being received
+    uint16_t lineLength;
+    bool lineCut;        ///< the line did not fit, the rest is skipped
+    bool requestLine;    ///< the request line has been received
+
+    char url[WEBSOCKETS_URL_SIZE];         ///< http url
+    char key[WEBSOCKETS_KEY_SIZE + 1];     ///< Sec-WebSocket-Key
+    uint8_t version;                       ///< Sec-WebSocket-Version
+    bool isUpgrade;                        ///< Connection == Upgrade
+    bool isWebsocket;                      ///< Upgrade == websocket
+    bool hasProtocol;                      ///< Sec-WebSocket-Protocol is present
+    bool isAuthorized;                     ///< Authorization matches the server credentials
+    bool invalid;                          ///< malformed request
+    bool httpHeadersValid;                 ///< non-websocket http header validity indicator
+    uint8_t mandatoryHeadersCount;         ///< non-websocket mandatory http headers present count
+    bool deflate;                          ///< a permessage-deflate offer was accepted
+
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    String cHttpLine;    ///< HTTP header lines
+#endif
+} WSserverHandshake_t;
+
 typedef struct {
     uint8_t num;    ///< connection number
 
@@ -242,37 +372,23 @@ typedef struct {
     WEBSOCKETS_NETWORK_CLASS * tcp;
 
     bool isSocketIO;    ///< client for socket.io server
+    bool cDeflate;      ///< permessage-deflate is active
 
 #if defined(HAS_SSL)
     bool isSSL;    ///< run in ssl mode
     WEBSOCKETS_NETWORK_SSL_CLASS * ssl;
 #endif
 
-    String cUrl;       ///< http url
-    uint16_t cCode;    ///< http code
-
     bool cIsClient = false;    ///< will be used for masking
-    bool cIsUpgrade;           ///< Connection == Upgrade
-    bool cIsWebsocket;         ///< Upgrade == websocket
-
-    String cSessionId;     ///< client Set-Cookie (session id)
-    String cKey;           ///< client Sec-WebSocket-Key
-    String cAccept;        ///< client Sec-WebSocket-Accept
-    String cProtocol;      ///< client Sec-WebSocket-Protocol
-    String cExtensions;    ///< client Sec-WebSocket-Extensions
-    uint16_t cVersion;     ///< client Sec-WebSocket-Version
 
     uint8_t cWsRXsize;                                ///< State of the RX
     uint8_t cWsHeader[WEBSOCKETS_MAX_HEADER_SIZE];    ///< RX WS Message buffer
     WSMessageHeader_t cWsHeaderDecode;
 
-    String base64Authorization;    ///< Base64 encoded Auth request
-    String plainAuthorization;     ///< Base64 encoded Auth request
-
-    String extraHeaders;
-
-    bool cHttpHeadersValid;           ///< non-websocket http header validity indicator
-    size_t cMandatoryHeadersCount;    ///< non-websocket mandatory http headers present count
+    union {
+        WShandshake_t * hs;            ///< handshake state of WebSocketsClient
+        WSserverHandshake_t * shs;     ///< handshake state of a server connection, NULL once upgraded
+    };
 
     bool pongReceived;
     uint32_t pingInterval;             // how often ping will be sent, 0 means "heartbeat is not active"
@@ -281,8 +397,20 @@ typedef struct {
     uint8_t disconnectTimeoutCount;    // after how many subsequent pong timeouts discconnect will happen, 0 means "do not disconnect"
     uint8_t pongTimeoutCount;          // current pong timeout count
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    String cHttpLine;    ///< HTTP header lines
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+    uint8_t * txQueue;      ///< bytes the socket did not take yet (ring buffer of WEBSOCKETS_SEND_QUEUE_SIZE, allocated on demand)
+    uint16_t txHead;        ///< first queued byte
+    uint16_t txLength;      ///< queued bytes
+    uint32_t txProgress;    ///< millis when the socket last took data
+    uint32_t txDropped;     ///< frames dropped since the queue last ran empty
+    bool txBroken;          ///< a frame was cut, the connection can not be used anymore
+#endif
+
+#if defined(WEBSOCKETS_USE_SEND_LIMIT)
+    AsyncClient * asyncTcp;    ///< connection below tcp, its free TCP send buffer limits the writes
+    uint32_t txProgress;       ///< millis when the TCP send buffer last had room
+    uint32_t txDropped;        ///< frames dropped since the TCP send buffer last had room
+    bool txBroken;             ///< part of a fragmented message was dropped, the connection can not be used anymore
 #endif
 
 } WSclient_t;
@@ -315,12 +443,22 @@ class WebSockets {
     void handleWebsocketPayloadCb(WSclient_t * client, bool ok, uint8_t * payload);
 
     String acceptKey(String & clientKey);
+    void acceptKey(const char * clientKey, char * accept);
     String base64_encode(uint8_t * data, size_t length);
 
     bool readCb(WSclient_t * client, uint8_t * out, size_t n, WSreadWaitCb cb);
     virtual size_t write(WSclient_t * client, uint8_t * out, size_t n);
     size_t write(WSclient_t * client, const char * out);
 
+#if defined(WEBSOCKETS_USE_SEND_QUEUE) || defined(WEBSOCKETS_USE_SEND_LIMIT)
+    bool canQueue(WSclient_t * client, size_t n);
+#endif
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+    size_t queueWrite(WSclient_t * client, uint8_t * out, size_t n);
+    bool handleSendQueue(WSclient_t * client);
+    void releaseSendQueue(WSclient_t * client);
+#endif
+
     void enableHeartbeat(WSclient_t * client, uint32_t pingInterval, uint32_t pongTimeout, uint8_t disconnectTimeoutCount);
     void handleHBTimeout(WSclient_t * client);
 };
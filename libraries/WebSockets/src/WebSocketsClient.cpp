@@ -26,10 +26,12 @@
 #include "WebSocketsClient.h"
 
 WebSocketsClient::WebSocketsClient() {
-    _cbEvent             = NULL;
-    _client.num          = 0;
-    _client.cIsClient    = true;
-    _client.extraHeaders = WEBSOCKETS_STRING("Origin: file://");
+    _cbEvent                 = NULL;
+    _client.num              = 0;
+    _client.cIsClient        = true;
+    _client.cDeflate         = false;
+    _client.hs               = &_handshake;
+    _client.hs->extraHeaders = WEBSOCKETS_STRING("Origin: file://");
 }
 
 WebSocketsClient::~WebSocketsClient() {
@@ -54,18 +56,18 @@ void WebSocketsClient::begin(const char * host, uint16_t port, const char * url,
     _client.isSSL = false;
     _client.ssl   = NULL;
 #endif
-    _client.cUrl                = url;
-    _client.cCode               = 0;
-    _client.cIsUpgrade          = false;
-    _client.cIsWebsocket        = true;
-    _client.cKey                = "";
-    _client.cAccept             = "";
-    _client.cProtocol           = protocol;
-    _client.cExtensions         = "";
-    _client.cVersion            = 0;
-    _client.base64Authorization = "";
-    _client.plainAuthorization  = "";
-    _client.isSocketIO          = false;
+    _client.hs->cUrl                = url;
+    _client.hs->cCode               = 0;
+    _client.hs->cIsUpgrade          = false;
+    _client.hs->cIsWebsocket        = true;
+    _client.hs->cKey                = "";
+    _client.hs->cAccept             = "";
+    _client.hs->cProtocol           = protocol;
+    _client.hs->cExtensions         = "";
+    _client.hs->cVersion            = 0;
+    _client.hs->base64Authorization = "";
+    _client.hs->plainAuthorization  = "";
+    _client.isSocketIO              = false;
 
     _client.lastPing         = 0;
     _client.pongReceived     = false;
@@ -319,7 +321,7 @@ void WebSocketsClient::setAuthorization(const char * user, const char * password
         String auth = user;
         auth += ":";
         auth += password;
-        _client.base64Authorization = base64_encode((uint8_t *)auth.c_str(), auth.length());
+        _client.hs->base64Authorization = base64_encode((uint8_t *)auth.c_str(), auth.length());
     }
 }
 
@@ -329,8 +331,8 @@ void WebSocketsClient::setAuthorization(const char * user, const char * password
  */
 void WebSocketsClient::setAuthorization(const char * auth) {
     if(auth) {
-        //_client.base64Authorization = auth;
-        _client.plainAuthorization = auth;
+        //_client.hs->base64Authorization = auth;
+        _client.hs->plainAuthorization = auth;
     }
 }
 
@@ -340,7 +342,7 @@ void WebSocketsClient::setAuthorization(const char * auth) {
  * @param extraHeaders const char * extraHeaders
  */
 void WebSocketsClient::setExtraHeaders(const char * extraHeaders) {
-    _client.extraHeaders = extraHeaders;
+    _client.hs->extraHeaders = extraHeaders;
 }
 
 /**
@@ -432,13 +434,13 @@ void WebSocketsClient::clientDisconnect(WSclient_t * client) {
         client->tcp = NULL;
     }
 
-    client->cCode        = 0;
-    client->cKey         = "";
-    client->cAccept      = "";
-    client->cVersion     = 0;
-    client->cIsUpgrade   = false;
-    client->cIsWebsocket = false;
-    client->cSessionId   = "";
+    client->hs->cCode        = 0;
+    client->hs->cKey         = "";
+    client->hs->cAccept      = "";
+    client->hs->cVersion     = 0;
+    client->hs->cIsUpgrade   = false;
+    client->hs->cIsWebsocket = false;
+    client->hs->cSessionId   = "";
 
     client->status = WSC_NOT_CONNECTED;
 
@@ -519,7 +521,7 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
         randomKey[i] = random(0xFF);
     }
 
-    client->cKey = base64_encode(&randomKey[0], 16);
+    client->hs->cKey = base64_encode(&randomKey[0], 16);
 
 #ifndef NODEBUG_WEBSOCKETS
     unsigned long start = micros();
@@ -527,15 +529,15 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
 
     String handshake;
     bool ws_header = true;
-    String url     = client->cUrl;
+    String url     = client->hs->cUrl;
 
     if(client->isSocketIO) {
-        if(client->cSessionId.length() == 0) {
+        if(client->hs->cSessionId.length() == 0) {
             url += WEBSOCKETS_STRING("&transport=polling");
             ws_header = false;
         } else {
             url += WEBSOCKETS_STRING("&transport=websocket&sid=");
-            url += client->cSessionId;
+            url += client->hs->cSessionId;
         }
     }
 
@@ -551,36 +553,36 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
             "Upgrade: websocket\r\n"
             "Sec-WebSocket-Version: 13\r\n"
             "Sec-WebSocket-Key: ");
-        handshake += client->cKey + NEW_LINE;
+        handshake += client->hs->cKey + NEW_LINE;
 
-        if(client->cProtocol.length() > 0) {
+        if(client->hs->cProtocol.length() > 0) {
             handshake += WEBSOCKETS_STRING("Sec-WebSocket-Protocol: ");
-            handshake += client->cProtocol + NEW_LINE;
+            handshake += client->hs->cProtocol + NEW_LINE;
         }
 
-        if(client->cExtensions.length() > 0) {
+        if(client->hs->cExtensions.length() > 0) {
             handshake += WEBSOCKETS_STRING("Sec-WebSocket-Extensions: ");
-            handshake += client->cExtensions + NEW_LINE;
+            handshake += client->hs->cExtensions + NEW_LINE;
         }
     } else {
         handshake += WEBSOCKETS_STRING("Connection: keep-alive\r\n");
     }
 
     // add extra headers; by default this includes "Origin: file://"
-    if(client->extraHeaders) {
-        handshake += client->extraHeaders + NEW_LINE;
+    if(client->hs->extraHeaders) {
+        handshake += client->hs->extraHeaders + NEW_LINE;
     }
 
     handshake += WEBSOCKETS_STRING("User-Agent: arduino-WebSocket-Client\r\n");
 
-    if(client->base64Authorization.length() > 0) {
+    if(client->hs->base64Authorization.length() > 0) {
         handshake += WEBSOCKETS_STRING("Authorization: Basic ");
-        handshake += client->base64Authorization + NEW_LINE;
+        handshake += client->hs->base64Authorization + NEW_LINE;
     }
 
-    if(client->plainAuthorization.length() > 0) {
+    if(client->hs->plainAuthorization.length() > 0) {
         handshake += WEBSOCKETS_STRING("Authorization: ");
-        handshake += client->plainAuthorization + NEW_LINE;
+        handshake += client->hs->plainAuthorization + NEW_LINE;
     }
 
     handshake += NEW_LINE;
@@ -589,7 +591,7 @@ void WebSocketsClient::sendHeader(WSclient_t * client) {
     write(client, (uint8_t *)handshake.c_str(), handshake.length());
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->cHttpLine)));
+    client->tcp->readStringUntil('\n', &(client->hs->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->hs->cHttpLine)));
 #endif
 
     DEBUG_WEBSOCKETS("[WS-Client][sendHeader] sending header... Done (%luus).\n", (micros() - start));
@@ -607,7 +609,7 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
 
         if(headerLine->startsWith(WEBSOCKETS_STRING("HTTP/1."))) {
             // "HTTP/1.1 101 Switching Protocols"
-            client->cCode = headerLine->substring(9, headerLine->indexOf(' ', 9)).toInt();
+            client->hs->cCode = headerLine->substring(9, headerLine->indexOf(' ', 9)).toInt();
         } else if(headerLine->indexOf(':') >= 0) {
             String headerName  = headerLine->substring(0, headerLine->indexOf(':'));
             String headerValue = headerLine->substring(headerLine->indexOf(':') + 1);
@@ -619,26 +621,26 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
 
             if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Connection"))) {
                 if(headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("upgrade"))) {
-                    client->cIsUpgrade = true;
+                    client->hs->cIsUpgrade = true;
                 }
             } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Upgrade"))) {
                 if(headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("websocket"))) {
-                    client->cIsWebsocket = true;
+                    client->hs->cIsWebsocket = true;
                 }
             } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Accept"))) {
-                client->cAccept = headerValue;
-                client->cAccept.trim();    // see rfc6455
+                client->hs->cAccept = headerValue;
+                client->hs->cAccept.trim();    // see rfc6455
             } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Protocol"))) {
-                client->cProtocol = headerValue;
+                client->hs->cProtocol = headerValue;
             } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Extensions"))) {
-                client->cExtensions = headerValue;
+                client->hs->cExtensions = headerValue;
             } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Version"))) {
-                client->cVersion = headerValue.toInt();
+                client->hs->cVersion = headerValue.toInt();
             } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Set-Cookie"))) {
                 if(headerValue.indexOf(WEBSOCKETS_STRING("HttpOnly")) > -1) {
-                    client->cSessionId = headerValue.substring(headerValue.indexOf('=') + 1, headerValue.indexOf(";"));
+                    client->hs->cSessionId = headerValue.substring(headerValue.indexOf('=') + 1, headerValue.indexOf(";"));
                 } else {
-                    client->cSessionId = headerValue.substring(headerValue.indexOf('=') + 1);
+                    client->hs->cSessionId = headerValue.substring(headerValue.indexOf('=') + 1);
                 }
             }
         } else {
@@ -647,29 +649,29 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
 
         (*headerLine) = "";
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-        client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->cHttpLine)));
+        client->tcp->readStringUntil('\n', &(client->hs->cHttpLine), std::bind(&WebSocketsClient::handleHeader, this, client, &(client->hs->cHttpLine)));
 #endif
     } else {
         DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header read fin.\n");
         DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Client settings:\n");
 
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cURL: %s\n", client->cUrl.c_str());
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cKey: %s\n", client->cKey.c_str());
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cURL: %s\n", client->hs->cUrl.c_str());
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cKey: %s\n", client->hs->cKey.c_str());
 
         DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Server header:\n");
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cCode: %d\n", client->cCode);
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cIsUpgrade: %d\n", client->cIsUpgrade);
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cIsWebsocket: %d\n", client->cIsWebsocket);
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cAccept: %s\n", client->cAccept.c_str());
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cProtocol: %s\n", client->cProtocol.c_str());
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cExtensions: %s\n", client->cExtensions.c_str());
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cVersion: %d\n", client->cVersion);
-        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cSessionId: %s\n", client->cSessionId.c_str());
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cCode: %d\n", client->hs->cCode);
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cIsUpgrade: %d\n", client->hs->cIsUpgrade);
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cIsWebsocket: %d\n", client->hs->cIsWebsocket);
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cAccept: %s\n", client->hs->cAccept.c_str());
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cProtocol: %s\n", client->hs->cProtocol.c_str());
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cExtensions: %s\n", client->hs->cExtensions.c_str());
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cVersion: %d\n", client->hs->cVersion);
+        DEBUG_WEBSOCKETS("[WS-Client][handleHeader]  - cSessionId: %s\n", client->hs->cSessionId.c_str());
 
-        bool ok = (client->cIsUpgrade && client->cIsWebsocket);
+        bool ok = (client->hs->cIsUpgrade && client->hs->cIsWebsocket);
 
         if(ok) {
-            switch(client->cCode) {
+            switch(client->hs->cCode) {
                 case 101:    ///< Switching Protocols
 
                     break;
@@ -681,7 +683,7 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
                     // todo handle login
                 default:    ///< Server dont unterstand requrst
                     ok = false;
-                    DEBUG_WEBSOCKETS("[WS-Client][handleHeader] serverCode is not 101 (%d)\n", client->cCode);
+                    DEBUG_WEBSOCKETS("[WS-Client][handleHeader] serverCode is not 101 (%d)\n", client->hs->cCode);
                     clientDisconnect(client);
                     _lastConnectionFail = millis();
                     break;
@@ -689,12 +691,12 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
         }
 
         if(ok) {
-            if(client->cAccept.length() == 0) {
+            if(client->hs->cAccept.length() == 0) {
                 ok = false;
             } else {
                 // generate Sec-WebSocket-Accept key for check
-                String sKey = acceptKey(client->cKey);
-                if(sKey != client->cAccept) {
+                String sKey = acceptKey(client->hs->cKey);
+                if(sKey != client->hs->cAccept) {
                     DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Sec-WebSocket-Accept is wrong\n");
                     ok = false;
                 }
@@ -705,8 +707,8 @@ void WebSocketsClient::handleHeader(WSclient_t * client, String * headerLine) {
             DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Websocket connection init done.\n");
             headerDone(client);
 
-            runCbEvent(WStype_CONNECTED, (uint8_t *)client->cUrl.c_str(), client->cUrl.length());
-        } else if(clientIsConnected(client) && client->isSocketIO && client->cSessionId.length() > 0) {
+            runCbEvent(WStype_CONNECTED, (uint8_t *)client->hs->cUrl.c_str(), client->hs->cUrl.length());
+        } else if(clientIsConnected(client) && client->isSocketIO && client->hs->cSessionId.length() > 0) {
             if(_client.tcp->available()) {
                 // read not needed data
                 DEBUG_WEBSOCKETS("[WS-Client][handleHeader] still data in buffer (%d), clean up.\n", _client.tcp->available());
@@ -102,6 +102,7 @@ class WebSocketsClient : protected WebSockets {
     const char * _CA_cert;
 #endif
     WSclient_t _client;
+    WShandshake_t _handshake;    ///< kept for reconnects (url, protocol, auth, extra headers)
 
     WebSocketClientEvent _cbEvent;
 
@@ -0,0 +1,497 @@
+/**
+ * @file WebSocketsDeflate.cpp
+ *
+ * raw DEFLATE (RFC 1951) for the permessage-deflate extension (RFC 7692),
+ * every message is compressed on its own (no context takeover)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <string.h>
+
+#include "WebSocketsDeflate.h"
+#include "WebSocketsMemory.h"
+
+#if(WEBSOCKETS_DEFLATE_WINDOW_BITS < 8) || (WEBSOCKETS_DEFLATE_WINDOW_BITS > 15)
+#error "WEBSOCKETS_DEFLATE_WINDOW_BITS must be 8 .. 15"
+#endif
+
+#define WS_DEFLATE_WINDOW (1UL << WEBSOCKETS_DEFLATE_WINDOW_BITS)
+#define WS_DEFLATE_MIN_MATCH (3)
+#define WS_DEFLATE_MAX_MATCH (258)
+
+#define WS_DEFLATE_END_OF_BLOCK (256)
+#define WS_DEFLATE_LITERALS (288)
+#define WS_DEFLATE_DISTANCES (30)
+
+// the length and distance codes follow a fixed pattern (RFC 1951 3.2.5):
+// 4 length codes and 2 distance codes per extra bit, so the tables are computed instead of stored
+
+static inline uint8_t lengthExtraBits(uint8_t code) {
+    return (code < 8 || code == 28) ? 0 : ((code - 4) >> 2);
+}
+
+static inline uint16_t lengthBase(uint8_t code) {
+    if(code < 8) {
+        return code + WS_DEFLATE_MIN_MATCH;
+    }
+    if(code == 28) {
+        return WS_DEFLATE_MAX_MATCH;
+    }
+    return ((4 + (code & 3)) << lengthExtraBits(code)) + WS_DEFLATE_MIN_MATCH;
+}
+
+static inline uint8_t distanceExtraBits(uint8_t code) {
+    return (code < 4) ? 0 : ((code - 2) >> 1);
+}
+
+static inline uint16_t distanceBase(uint8_t code) {
+    if(code < 4) {
+        return code + 1;
+    }
+    return ((2 + (code & 1)) << distanceExtraBits(code)) + 1;
+}
+
+static inline uint8_t highestBit(uint32_t value) {
+    return 31 - __builtin_clz(value);
+}
+
+/*
+ * compressor
+ */
+
+typedef struct {
+    uint8_t * out;
+    size_t size;
+    size_t pos;
+    uint32_t bits;    ///< pending bits, LSB first
+    uint8_t count;
+} WSbitWriter_t;
+
+static bool putBits(WSbitWriter_t * w, uint32_t value, uint8_t count) {
+    w->bits |= (value << w->count);
+    w->count += count;
+    while(w->count >= 8) {
+        if(w->pos >= w->size) {
+            return false;
+        }
+        w->out[w->pos++] = (uint8_t)w->bits;
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+    return true;
+}
+
+// Huffman codes are stored MSB first
+static bool putCode(WSbitWriter_t * w, uint16_t code, uint8_t length) {
+    uint16_t reversed = 0;
+    for(uint8_t i = 0; i < length; i++) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return putBits(w, reversed, length);
+}
+
+static bool putLiteral(WSbitWriter_t * w, uint16_t symbol) {
+    if(symbol < 144) {
+        return putCode(w, 0x30 + symbol, 8);
+    } else if(symbol < 256) {
+        return putCode(w, 0x190 + (symbol - 144), 9);
+    } else if(symbol < 280) {
+        return putCode(w, (symbol - 256), 7);
+    }
+    return putCode(w, 0xC0 + (symbol - 280), 8);
+}
+
+static bool putMatch(WSbitWriter_t * w, uint16_t length, uint16_t distance) {
+    uint8_t code = 28;
+    if(length < WS_DEFLATE_MAX_MATCH) {
+        uint16_t value = length - WS_DEFLATE_MIN_MATCH;
+        if(value < 8) {
+            code = value;
+        } else {
+            uint8_t extra = highestBit(value) - 2;
+            code          = (extra << 2) + 4 + ((value >> extra) & 3);
+        }
+    }
+    if(!putLiteral(w, 257 + code) || !putBits(w, length - lengthBase(code), lengthExtraBits(code))) {
+        return false;
+    }
+
+    uint16_t value = distance - 1;
+    if(value < 4) {
+        code = value;
+    } else {
+        uint8_t extra = highestBit(value) - 1;
+        code          = (extra << 1) + 2 + ((value >> extra) & 1);
+    }
+    return putCode(w, code, 5) && putBits(w, distance - distanceBase(code), distanceExtraBits(code));
+}
+
+static inline uint16_t hash3(const uint8_t * data) {
+    uint32_t value = data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16);
+    return (uint32_t)(value * 2654435761UL) >> (32 - WEBSOCKETS_DEFLATE_HASH_BITS);
+}
+
+size_t ws_deflate(const uint8_t * data, size_t length, uint8_t * out, size_t size) {
+    if(length > 0xFFFF) {
+        return 0;
+    }
+
+    // position + 1 of the last occurrence of every hash, 0 = none
+    uint16_t head[1 << WEBSOCKETS_DEFLATE_HASH_BITS];
+    memset(&head[0], 0, sizeof(head));
+
+    WSbitWriter_t w = { out, size, 0, 0, 0 };
+
+    // BFINAL 0, BTYPE 01 (fixed Huffman codes)
+    bool ok    = putBits(&w, 0x02, 3);
+    size_t pos = 0;
+
+    while(ok && pos < length) {
+        size_t matchLength   = 0;
+        size_t matchDistance = 0;
+
+        if(pos + WS_DEFLATE_MIN_MATCH <= length) {
+            uint16_t hash    = hash3(&data[pos]);
+            size_t candidate = head[hash];
+            head[hash]       = pos + 1;
+
+            if(candidate > 0 && (pos - (candidate - 1)) <= WS_DEFLATE_WINDOW) {
+                const uint8_t * match = &data[candidate - 1];
+                size_t max            = length - pos;
+                if(max > WS_DEFLATE_MAX_MATCH) {
+                    max = WS_DEFLATE_MAX_MATCH;
+                }
+                while(matchLength < max && match[matchLength] == data[pos + matchLength]) {
+                    matchLength++;
+                }
+                matchDistance = pos - (candidate - 1);
+            }
+        }
+
+        if(matchLength >= WS_DEFLATE_MIN_MATCH) {
+            ok = putMatch(&w, matchLength, matchDistance);
+            // keep the positions inside the match findable
+            for(size_t i = pos + 1; i < (pos + matchLength) && (i + WS_DEFLATE_MIN_MATCH) <= length; i++) {
+                head[hash3(&data[i])] = i + 1;
+            }
+            pos += matchLength;
+        } else {
+            ok = putLiteral(&w, data[pos]);
+            pos++;
+        }
+    }
+
+    // end of block, then the header of an empty stored block (BFINAL 0, BTYPE 00),
+    // its byte aligned 00 00 FF FF length fields are left out
+    ok = ok && putLiteral(&w, WS_DEFLATE_END_OF_BLOCK) && putBits(&w, 0x00, 3);
+    if(ok && w.count > 0) {
+        ok = putBits(&w, 0x00, (8 - w.count));
+    }
+
+    return ok ? w.pos : 0;
+}
+
+/*
+ * decompressor
+ */
+
+typedef struct {
+    uint16_t counts[16];    ///< number of codes per code length
+    uint16_t * symbols;     ///< symbols ordered by code
+} WShuffman_t;
+
+typedef struct {
+    const uint8_t * data;
+    size_t length;
+    size_t pos;
+    uint8_t tail;        ///< bytes of the 00 00 FF FF tail read
+    bool storedHeader;   ///< only the length fields of a stored block may run into the tail
+    bool error;
+    uint32_t bits;
+    uint8_t count;
+
+    WShuffman_t literals;
+    WShuffman_t distances;
+    uint16_t literalSymbols[WS_DEFLATE_LITERALS];
+    uint16_t distanceSymbols[WS_DEFLATE_DISTANCES + 2];
+    uint8_t lengths[WS_DEFLATE_LITERALS + WS_DEFLATE_DISTANCES + 2];
+} WSinflate_t;
+
+static uint8_t nextByte(WSinflate_t * s) {
+    if(s->pos < s->length) {
+        return s->data[s->pos++];
+    }
+    if(s->storedHeader && s->tail < 4) {
+        return (s->tail++ < 2) ? 0x00 : 0xFF;
+    }
+    s->error = true;
+    return 0;
+}
+
+static uint32_t getBits(WSinflate_t * s, uint8_t count) {
+    while(s->count < count) {
+        s->bits |= ((uint32_t)nextByte(s) << s->count);
+        s->count += 8;
+    }
+    uint32_t value = s->bits & ((1UL << count) - 1);
+    s->bits >>= count;
+    s->count -= count;
+    return value;
+}
+
+static bool buildHuffman(WShuffman_t * t, const uint8_t * lengths, uint16_t num) {
+    uint16_t offsets[16];
+    memset(&t->counts[0], 0, sizeof(t->counts));
+
+    for(uint16_t i = 0; i < num; i++) {
+        t->counts[lengths[i]]++;
+    }
+    t->counts[0] = 0;
+
+    // over-subscribed code lengths would make the decoder read outside the table
+    int32_t left = 1;
+    for(uint8_t i = 1; i < 16; i++) {
+        left = (left << 1) - t->counts[i];
+        if(left < 0) {
+            return false;
+        }
+    }
+
+    uint16_t sum = 0;
+    for(uint8_t i = 0; i < 16; i++) {
+        offsets[i] = sum;
+        sum += t->counts[i];
+    }
+    for(uint16_t i = 0; i < num; i++) {
+        if(lengths[i]) {
+            t->symbols[offsets[lengths[i]]++] = i;
+        }
+    }
+    return true;
+}
+
+static int16_t decodeSymbol(WSinflate_t * s, const WShuffman_t * t) {
+    int32_t sum  = 0;
+    int32_t code = 0;
+    for(uint8_t length = 1; length < 16; length++) {
+        code = (code << 1) | getBits(s, 1);
+        sum += t->counts[length];
+        code -= t->counts[length];
+        if(code < 0) {
+            return t->symbols[sum + code];
+        }
+    }
+    s->error = true;
+    return -1;
+}
+
+static int32_t inflateBlock(WSinflate_t * s, uint8_t * out, size_t size, size_t * outLength) {
+    while(true) {
+        int16_t symbol = decodeSymbol(s, &s->literals);
+        if(s->error) {
+            return WS_INFLATE_ERROR;
+        }
+
+        if(symbol < 256) {
+            if(*outLength >= size) {
+                return WS_INFLATE_OVERFLOW;
+            }
+            out[(*outLength)++] = symbol;
+        } else if(symbol == WS_DEFLATE_END_OF_BLOCK) {
+            return 0;
+        } else {
+            uint8_t code = symbol - 257;
+            if(code > 28) {
+                return WS_INFLATE_ERROR;
+            }
+            size_t length = lengthBase(code) + getBits(s, lengthExtraBits(code));
+
+            int16_t distanceCode = decodeSymbol(s, &s->distances);
+            if(s->error || distanceCode < 0 || distanceCode >= WS_DEFLATE_DISTANCES) {
+                return WS_INFLATE_ERROR;
+            }
+            size_t distance = distanceBase(distanceCode) + getBits(s, distanceExtraBits(distanceCode));
+
+            // no context takeover: a match can only refer to this message
+            if(s->error || distance > *outLength) {
+                return WS_INFLATE_ERROR;
+            }
+            if(*outLength + length > size) {
+                return WS_INFLATE_OVERFLOW;
+            }
+            for(size_t i = 0; i < length; i++) {
+                out[*outLength] = out[*outLength - distance];
+                (*outLength)++;
+            }
+        }
+    }
+}
+
+static int32_t inflateStored(WSinflate_t * s, uint8_t * out, size_t size, size_t * outLength) {
+    // skip to the byte boundary
+    s->bits  = 0;
+    s->count = 0;
+
+    s->storedHeader = true;
+    uint16_t length = getBits(s, 16);
+    uint16_t check  = getBits(s, 16);
+    s->storedHeader = false;
+
+    if(s->error || length != (uint16_t)~check) {
+        return WS_INFLATE_ERROR;
+    }
+    if(*outLength + length > size) {
+        return WS_INFLATE_OVERFLOW;
+    }
+    if(s->length - s->pos < length) {
+        return WS_INFLATE_ERROR;
+    }
+    memcpy(&out[*outLength], &s->data[s->pos], length);
+    s->pos += length;
+    *outLength += length;
+    return 0;
+}
+
+static bool inflateFixedTables(WSinflate_t * s) {
+    uint16_t i = 0;
+    for(; i < 144; i++) {
+        s->lengths[i] = 8;
+    }
+    for(; i < 256; i++) {
+        s->lengths[i] = 9;
+    }
+    for(; i < 280; i++) {
+        s->lengths[i] = 7;
+    }
+    for(; i < WS_DEFLATE_LITERALS; i++) {
+        s->lengths[i] = 8;
+    }
+    memset(&s->lengths[WS_DEFLATE_LITERALS], 5, WS_DEFLATE_DISTANCES);
+
+    return buildHuffman(&s->literals, &s->lengths[0], WS_DEFLATE_LITERALS) && buildHuffman(&s->distances, &s->lengths[WS_DEFLATE_LITERALS], WS_DEFLATE_DISTANCES);
+}
+
+static bool inflateDynamicTables(WSinflate_t * s) {
+    static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    uint16_t literalCount  = getBits(s, 5) + 257;
+    uint16_t distanceCount = getBits(s, 5) + 1;
+    uint8_t lengthCount    = getBits(s, 4) + 4;
+
+    if(literalCount > 286 || distanceCount > WS_DEFLATE_DISTANCES) {
+        return false;
+    }
+
+    // the code length code is decoded with the literal table
+    uint8_t codeLengths[19] = { 0 };
+    for(uint8_t i = 0; i < lengthCount; i++) {
+        codeLengths[order[i]] = getBits(s, 3);
+    }
+    if(s->error || !buildHuffman(&s->literals, &codeLengths[0], sizeof(codeLengths))) {
+        return false;
+    }
+
+    uint16_t total = literalCount + distanceCount;
+    uint16_t num   = 0;
+    while(num < total) {
+        int16_t symbol = decodeSymbol(s, &s->literals);
+        if(s->error || symbol < 0 || symbol > 18) {
+            return false;
+        }
+
+        if(symbol < 16) {
+            s->lengths[num++] = symbol;
+            continue;
+        }
+
+        uint8_t value = 0;
+        uint8_t repeat;
+        if(symbol == 16) {
+            if(num == 0) {
+                return false;
+            }
+            value  = s->lengths[num - 1];
+            repeat = 3 + getBits(s, 2);
+        } else if(symbol == 17) {
+            repeat = 3 + getBits(s, 3);
+        } else {
+            repeat = 11 + getBits(s, 7);
+        }
+
+        if(num + repeat > total) {
+            return false;
+        }
+        memset(&s->lengths[num], value, repeat);
+        num += repeat;
+    }
+
+    if(s->error || s->lengths[WS_DEFLATE_END_OF_BLOCK] == 0) {
+        return false;
+    }
+
+    return buildHuffman(&s->literals, &s->lengths[0], literalCount) && buildHuffman(&s->distances, &s->lengths[literalCount], distanceCount);
+}
+
+int32_t ws_inflate(const uint8_t * data, size_t length, uint8_t * out, size_t size) {
+    WSinflate_t * s = (WSinflate_t *)ws_malloc(sizeof(WSinflate_t));
+    if(!s) {
+        return WS_INFLATE_NO_MEMORY;
+    }
+
+    memset(s, 0, sizeof(WSinflate_t));
+    s->data              = data;
+    s->length            = length;
+    s->literals.symbols  = &s->literalSymbols[0];
+    s->distances.symbols = &s->distanceSymbols[0];
+
+    size_t outLength = 0;
+    int32_t ret      = 0;
+    bool final;
+
+    do {
+        final        = getBits(s, 1);
+        uint8_t type = getBits(s, 2);
+        if(s->error) {
+            ret = WS_INFLATE_ERROR;
+            break;
+        }
+
+        switch(type) {
+            case 0:
+                ret = inflateStored(s, out, size, &outLength);
+                break;
+            case 1:
+                ret = inflateFixedTables(s) ? inflateBlock(s, out, size, &outLength) : WS_INFLATE_ERROR;
+                break;
+            case 2:
+                ret = inflateDynamicTables(s) ? inflateBlock(s, out, size, &outLength) : WS_INFLATE_ERROR;
+                break;
+            default:
+                ret = WS_INFLATE_ERROR;
+                break;
+        }
+
+        // the empty stored block made of the tail ends the message
+        if(ret == 0 && s->tail == 4) {
+            break;
+        }
+    } while(ret == 0 && !final);
+
+    ws_free(s);
+    return (ret == 0) ? (int32_t)outLength : ret;
+}
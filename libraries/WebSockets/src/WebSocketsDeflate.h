@@ -0,0 +1,65 @@
+/**
+ * @file WebSocketsDeflate.h
+ *
+ * raw DEFLATE (RFC 1951) for the permessage-deflate extension (RFC 7692),
+ * every message is compressed on its own (no context takeover)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSDEFLATE_H_
+#define WEBSOCKETSDEFLATE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// LZ77 window of the compressor (bits, 8 .. 15), matches never reach further back
+#ifndef WEBSOCKETS_DEFLATE_WINDOW_BITS
+#define WEBSOCKETS_DEFLATE_WINDOW_BITS (12)
+#endif
+
+// hash table of the compressor, 2 byte per entry on the stack
+#ifndef WEBSOCKETS_DEFLATE_HASH_BITS
+#define WEBSOCKETS_DEFLATE_HASH_BITS (8)
+#endif
+
+#define WS_INFLATE_ERROR (-1)       ///< corrupt data
+#define WS_INFLATE_OVERFLOW (-2)    ///< the message does not fit into the output buffer
+#define WS_INFLATE_NO_MEMORY (-3)   ///< no memory for the decoder state (~1 KB)
+
+/**
+ * compress one message with fixed Huffman codes, the output ends with an
+ * empty stored block minus its 00 00 FF FF tail as required by RFC 7692
+ * @param data const uint8_t *
+ * @param length size_t  up to 65535 byte
+ * @param out uint8_t *
+ * @param size size_t  size of out
+ * @return length of the compressed data, 0 if it does not fit into out
+ */
+size_t ws_deflate(const uint8_t * data, size_t length, uint8_t * out, size_t size);
+
+/**
+ * decompress one message (stored, fixed and dynamic blocks), the 00 00 FF FF
+ * tail removed by the sender is added internally
+ * @param data const uint8_t *
+ * @param length size_t
+ * @param out uint8_t *
+ * @param size size_t  size of out
+ * @return length of the message or WS_INFLATE_*
+ */
+int32_t ws_inflate(const uint8_t * data, size_t length, uint8_t * out, size_t size);
+
+#endif /* WEBSOCKETSDEFLATE_H_ */
@@ -0,0 +1,160 @@
+/**
+ * @file WebSocketsMemory.cpp
+ *
+ * Allocation accounting for the WebSockets library and the application,
+ * fixed-size block pools for the library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include "WebSockets.h"
+#include "WebSocketsMemory.h"
+
+#define WS_POOL_HEAP (0xFF)
+#define WS_POOL_MASK(count) ((count) >= 32 ? 0xFFFFFFFFUL : ((1UL << (count)) - 1))
+#define WS_POOL_STORAGE(count, size) (((count) * (sizeof(WSmemHeader_t) + (size))) / sizeof(uint64_t) + 1)
+
+#if(WEBSOCKETS_POOL_SMALL_COUNT > 32) || (WEBSOCKETS_POOL_MEDIUM_COUNT > 32) || (WEBSOCKETS_POOL_LARGE_COUNT > 32)
+#error "a WebSockets pool can hold at most 32 blocks"
+#endif
+
+// every block is prefixed by its size, owner and pool, 8 byte keep the payload aligned
+typedef union {
+    struct {
+        uint32_t size;
+        uint8_t owner;
+        uint8_t pool;
+    } info;
+    uint64_t align;
+} WSmemHeader_t;
+
+typedef struct {
+    uint8_t * storage;
+    uint32_t freeMask;    ///< bit set = block is free
+    WSpoolStats_t stats;
+} WSpool_t;
+
+static uint64_t smallStorage[WS_POOL_STORAGE(WEBSOCKETS_POOL_SMALL_COUNT, WEBSOCKETS_POOL_SMALL_SIZE)];
+static uint64_t mediumStorage[WS_POOL_STORAGE(WEBSOCKETS_POOL_MEDIUM_COUNT, WEBSOCKETS_POOL_MEDIUM_SIZE)];
+static uint64_t largeStorage[WS_POOL_STORAGE(WEBSOCKETS_POOL_LARGE_COUNT, WEBSOCKETS_POOL_LARGE_SIZE)];
+
+static WSpool_t pools[WEBSOCKETS_POOL_COUNT] = {
+    { (uint8_t *)smallStorage, WS_POOL_MASK(WEBSOCKETS_POOL_SMALL_COUNT), { WEBSOCKETS_POOL_SMALL_SIZE, WEBSOCKETS_POOL_SMALL_COUNT, 0, 0, 0, 0 } },
+    { (uint8_t *)mediumStorage, WS_POOL_MASK(WEBSOCKETS_POOL_MEDIUM_COUNT), { WEBSOCKETS_POOL_MEDIUM_SIZE, WEBSOCKETS_POOL_MEDIUM_COUNT, 0, 0, 0, 0 } },
+    { (uint8_t *)largeStorage, WS_POOL_MASK(WEBSOCKETS_POOL_LARGE_COUNT), { WEBSOCKETS_POOL_LARGE_SIZE, WEBSOCKETS_POOL_LARGE_COUNT, 0, 0, 0, 0 } },
+};
+
+static WSmemStats_t memStats[WSmem_MAX];
+static uint32_t poolOversized;
+
+/**
+ * take a block from the smallest pool that fits the size
+ * @param size size_t
+ * @return WSmemHeader_t * or NULL if the heap has to be used
+ */
+static WSmemHeader_t * poolAlloc(size_t size) {
+    uint8_t i = 0;
+    while((i < WEBSOCKETS_POOL_COUNT) && ((pools[i].stats.count == 0) || (size > pools[i].stats.blockSize))) {
+        i++;
+    }
+    if(i == WEBSOCKETS_POOL_COUNT) {
+        poolOversized++;
+        return NULL;
+    }
+    WSpool_t & pool = pools[i];
+    if(!pool.freeMask) {
+        // no fallback to bigger pools, they are reserved for their own size class
+        pool.stats.misses++;
+        return NULL;
+    }
+    uint8_t idx = __builtin_ctz(pool.freeMask);
+    pool.freeMask &= ~(1UL << idx);
+    pool.stats.hits++;
+    pool.stats.used++;
+    if(pool.stats.used > pool.stats.maxUsed) {
+        pool.stats.maxUsed = pool.stats.used;
+    }
+    WSmemHeader_t * header = (WSmemHeader_t *)(pool.storage + idx * (sizeof(WSmemHeader_t) + pool.stats.blockSize));
+    header->info.pool      = i;
+    return header;
+}
+
+void * ws_malloc(size_t size, WSmemOwner_t owner) {
+    WSmemStats_t & stats   = memStats[owner];
+    WSmemHeader_t * header = NULL;
+    if(owner == WSmem_library) {
+        header = poolAlloc(size);
+    }
+    if(!header) {
+        header = (WSmemHeader_t *)malloc(sizeof(WSmemHeader_t) + size);
+        if(!header) {
+            stats.failures++;
+            DEBUG_WEBSOCKETS("[WS-Mem] malloc of %d byte failed, largest free block %d\n", size, ws_largestFreeBlock());
+            return NULL;
+        }
+        header->info.pool = WS_POOL_HEAP;
+    }
+    header->info.size  = size;
+    header->info.owner = owner;
+    stats.allocs++;
+    stats.bytes += size;
+    if(stats.bytes > stats.highWater) {
+        stats.highWater = stats.bytes;
+    }
+    return (header + 1);
+}
+
+void ws_free(void * ptr) {
+    if(!ptr) {
+        return;
+    }
+    WSmemHeader_t * header = ((WSmemHeader_t *)ptr) - 1;
+    WSmemStats_t & stats   = memStats[header->info.owner];
+    stats.frees++;
+    stats.bytes -= header->info.size;
+    if(header->info.pool == WS_POOL_HEAP) {
+        free(header);
+        return;
+    }
+    WSpool_t & pool = pools[header->info.pool];
+    uint8_t idx     = ((uint8_t *)header - pool.storage) / (sizeof(WSmemHeader_t) + pool.stats.blockSize);
+    pool.freeMask |= (1UL << idx);
+    pool.stats.used--;
+}
+
+const WSmemStats_t & ws_memStats(WSmemOwner_t owner) {
+    return memStats[owner];
+}
+
+const WSpoolStats_t & ws_poolStats(uint8_t pool) {
+    return pools[pool].stats;
+}
+
+uint32_t ws_poolOversized(void) {
+    return poolOversized;
+}
+
+size_t ws_largestFreeBlock(void) {
+#if defined(ESP8266)
+    return ESP.getMaxFreeBlockSize();
+#elif defined(ESP32)
+    return ESP.getMaxAllocHeap();
+#elif defined(GET_FREE_HEAP)
+    return GET_FREE_HEAP;
+#else
+    return 0;
+#endif
+}
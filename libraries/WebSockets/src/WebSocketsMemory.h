@@ -0,0 +1,131 @@
+/**
+ * @file WebSocketsMemory.h
+ *
+ * Allocation accounting for the WebSockets library and the application,
+ * fixed-size block pools for the library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef WEBSOCKETSMEMORY_H_
+#define WEBSOCKETSMEMORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+// library allocations are served from fixed-size block pools first, the
+// heap is used only for oversized blocks or when a pool is exhausted.
+// every pool holds up to 32 blocks, a count of 0 disables the pool
+#ifndef WEBSOCKETS_POOL_SMALL_COUNT
+#define WEBSOCKETS_POOL_SMALL_COUNT (8)    // client objects, base64 buffers, short frames
+#endif
+#ifndef WEBSOCKETS_POOL_MEDIUM_COUNT
+#define WEBSOCKETS_POOL_MEDIUM_COUNT (4)
+#endif
+#ifndef WEBSOCKETS_POOL_LARGE_COUNT
+#define WEBSOCKETS_POOL_LARGE_COUNT (2)    // BIG_MEM send buffers (< 1400 byte + header)
+#endif
+
+#define WEBSOCKETS_POOL_SMALL_SIZE (64)
+#define WEBSOCKETS_POOL_MEDIUM_SIZE (256)
+#define WEBSOCKETS_POOL_LARGE_SIZE (1416)
+#define WEBSOCKETS_POOL_COUNT (3)
+
+typedef enum {
+    WSmem_library,    ///< frame buffers and client objects of the WebSockets library
+    WSmem_app,        ///< buffers of the application using the library
+    WSmem_MAX
+} WSmemOwner_t;
+
+typedef struct {
+    uint32_t allocs;      ///< successful allocations
+    uint32_t frees;       ///< released allocations
+    uint32_t failures;    ///< failed allocations
+    size_t bytes;         ///< bytes currently allocated
+    size_t highWater;     ///< maximum of bytes allocated at once
+} WSmemStats_t;
+
+typedef struct {
+    uint16_t blockSize;    ///< usable size of a block
+    uint8_t count;         ///< blocks in the pool
+    uint8_t used;          ///< blocks in use
+    uint8_t maxUsed;       ///< maximum of blocks in use at once
+    uint32_t hits;         ///< allocations served by the pool
+    uint32_t misses;       ///< allocations that fit but found the pool exhausted (heap fallback)
+} WSpoolStats_t;
+
+/**
+ * malloc with accounting, the block must be released with ws_free
+ * @param size size_t
+ * @param owner WSmemOwner_t
+ * @return void * or NULL
+ */
+void * ws_malloc(size_t size, WSmemOwner_t owner = WSmem_library);
+
+/**
+ * free a block allocated by ws_malloc (NULL is ignored)
+ * @param ptr void *
+ */
+void ws_free(void * ptr);
+
+/**
+ * @param owner WSmemOwner_t
+ * @return accounting of the owner
+ */
+const WSmemStats_t & ws_memStats(WSmemOwner_t owner);
+
+/**
+ * @param pool uint8_t index of the pool, 0 .. WEBSOCKETS_POOL_COUNT - 1 (smallest first)
+ * @return counters of the pool
+ */
+const WSpoolStats_t & ws_poolStats(uint8_t pool);
+
+/**
+ * @return library allocations too big for any pool (always from heap)
+ */
+uint32_t ws_poolOversized(void);
+
+/**
+ * @return largest block that can be allocated right now
+ */
+size_t ws_largestFreeBlock(void);
+
+/**
+ * new with accounting, the object must be released with ws_delete
+ * @param owner WSmemOwner_t
+ * @param args constructor arguments
+ * @return T * or NULL
+ */
+template<typename T, typename... Args>
+T * ws_new(WSmemOwner_t owner, Args &&... args) {
+    void * mem = ws_malloc(sizeof(T), owner);
+    return mem ? new(mem) T(static_cast<Args &&>(args)...) : NULL;
+}
+
+/**
+ * delete an object created by ws_new (NULL is ignored)
+ * @param obj T *
+ */
+template<typename T>
+void ws_delete(T * obj) {
+    if(obj) {
+        obj->~T();
+        ws_free(obj);
+    }
+}
+
+#endif /* WEBSOCKETSMEMORY_H_ */
@@ -25,17 +25,18 @@
 #include "WebSockets.h"
 #include "WebSocketsServer.h"
 
-WebSocketsServer::WebSocketsServer(uint16_t port, String origin, String protocol) {
+WebSocketsServer::WebSocketsServer(uint16_t port, String origin, String protocol, uint8_t clientMax) {
     _port     = port;
     _origin   = origin;
     _protocol = protocol;
     _runnning = false;
+    _deflate  = false;
 
     _server = new WEBSOCKETS_NETWORK_SERVER_CLASS(port);
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
     _server->onClient([](void * s, AsyncClient * c) {
-        ((WebSocketsServer *)s)->newClient(new AsyncTCPbuffer(c));
+        ((WebSocketsServer *)s)->newClient(new AsyncTCPbuffer(c), c);
     },
         this);
 #endif
@@ -46,7 +47,13 @@ WebSocketsServer::WebSocketsServer(uint16_t port, String origin, String protocol
     _mandatoryHttpHeaders     = NULL;
     _mandatoryHttpHeaderCount = 0;
 
-    memset(&_clients[0], 0x00, (sizeof(WSclient_t) * WEBSOCKETS_SERVER_CLIENT_MAX));
+    // the client table holds only the connection state, handshake data lives in a
+    // WShandshake_t that exists while the upgrade is in progress
+    _clients   = (WSclient_t *)ws_malloc(sizeof(WSclient_t) * clientMax);
+    _clientMax = _clients ? clientMax : 0;
+    if(_clients) {
+        memset(&_clients[0], 0x00, (sizeof(WSclient_t) * _clientMax));
+    }
 }
 
 WebSocketsServer::~WebSocketsServer() {
@@ -57,6 +64,13 @@ WebSocketsServer::~WebSocketsServer() {
         delete[] _mandatoryHttpHeaders;
 
     _mandatoryHttpHeaderCount = 0;
+
+    delete _server;
+    _server = NULL;
+
+    ws_free(_clients);
+    _clients   = NULL;
+    _clientMax = 0;
 }
 
 /**
@@ -66,7 +80,7 @@ void WebSocketsServer::begin(void) {
     WSclient_t * client;
 
     // init client storage
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
 
         client->num    = i;
@@ -76,20 +90,22 @@ void WebSocketsServer::begin(void) {
         client->isSSL = false;
         client->ssl   = NULL;
 #endif
-        client->cUrl         = "";
-        client->cCode        = 0;
-        client->cKey         = "";
-        client->cProtocol    = "";
-        client->cVersion     = 0;
-        client->cIsUpgrade   = false;
-        client->cIsWebsocket = false;
-
-        client->base64Authorization = "";
+        client->shs = NULL;
 
         client->cWsRXsize = 0;
-
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-        client->cHttpLine = "";
+        client->cDeflate  = false;
+
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+        client->txQueue   = NULL;
+        client->txHead    = 0;
+        client->txLength  = 0;
+        client->txDropped = 0;
+        client->txBroken  = false;
+#endif
+#if defined(WEBSOCKETS_USE_SEND_LIMIT)
+        client->asyncTcp  = NULL;
+        client->txDropped = 0;
+        client->txBroken  = false;
 #endif
     }
 
@@ -174,7 +190,7 @@ void WebSocketsServer::onValidateHttpHeader(
  * @return true if ok
  */
 bool WebSocketsServer::sendTXT(uint8_t num, uint8_t * payload, size_t length, bool headerToPayload) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     if(length == 0) {
@@ -217,7 +233,7 @@ bool WebSocketsServer::broadcastTXT(uint8_t * payload, size_t length, bool heade
         length = strlen((const char *)payload);
     }
 
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
         if(clientIsConnected(client)) {
             if(!sendFrame(client, WSop_text, payload, length, true, headerToPayload)) {
@@ -256,7 +272,7 @@ bool WebSocketsServer::broadcastTXT(String & payload) {
  * @return true if ok
  */
 bool WebSocketsServer::sendBIN(uint8_t num, uint8_t * payload, size_t length, bool headerToPayload) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     WSclient_t * client = &_clients[num];
@@ -280,7 +296,7 @@ bool WebSocketsServer::sendBIN(uint8_t num, const uint8_t * payload, size_t leng
 bool WebSocketsServer::broadcastBIN(uint8_t * payload, size_t length, bool headerToPayload) {
     WSclient_t * client;
     bool ret = true;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
         if(clientIsConnected(client)) {
             if(!sendFrame(client, WSop_binary, payload, length, true, headerToPayload)) {
@@ -306,7 +322,7 @@ bool WebSocketsServer::broadcastBIN(const uint8_t * payload, size_t length) {
  * @return true if ping is send out
  */
 bool WebSocketsServer::sendPing(uint8_t num, uint8_t * payload, size_t length) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return false;
     }
     WSclient_t * client = &_clients[num];
@@ -329,7 +345,7 @@ bool WebSocketsServer::sendPing(uint8_t num, String & payload) {
 bool WebSocketsServer::broadcastPing(uint8_t * payload, size_t length) {
     WSclient_t * client;
     bool ret = true;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
         if(clientIsConnected(client)) {
             if(!sendFrame(client, WSop_ping, payload, length)) {
@@ -352,7 +368,7 @@ bool WebSocketsServer::broadcastPing(String & payload) {
  */
 void WebSocketsServer::disconnect(void) {
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
         if(clientIsConnected(client)) {
             WebSockets::clientDisconnect(client, 1000);
@@ -365,7 +381,7 @@ void WebSocketsServer::disconnect(void) {
  * @param num uint8_t client id
  */
 void WebSocketsServer::disconnect(uint8_t num) {
-    if(num >= WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num >= _clientMax) {
         return;
     }
     WSclient_t * client = &_clients[num];
@@ -398,6 +414,23 @@ void WebSocketsServer::setAuthorization(const char * auth) {
     }
 }
 
+#if defined(WEBSOCKETS_USE_DEFLATE)
+/**
+ * accept permessage-deflate offers of new clients, messages from
+ * WEBSOCKETS_DEFLATE_MIN_SIZE byte on are sent compressed
+ */
+void WebSocketsServer::enableDeflate(void) {
+    _deflate = true;
+}
+
+/**
+ * decline permessage-deflate for new clients, connected clients keep it
+ */
+void WebSocketsServer::disableDeflate(void) {
+    _deflate = false;
+}
+#endif
+
 /**
  * count the connected clients (optional ping them)
  * @param ping bool ping the connected clients
@@ -405,7 +438,7 @@ void WebSocketsServer::setAuthorization(const char * auth) {
 int WebSocketsServer::connectedClients(bool ping) {
     WSclient_t * client;
     int count = 0;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
         if(client->status == WSC_CONNECTED) {
             if(ping != true || sendPing(i)) {
@@ -423,7 +456,7 @@ int WebSocketsServer::connectedClients(bool ping) {
  * @return IPAddress
  */
 IPAddress WebSocketsServer::remoteIP(uint8_t num) {
-    if(num < WEBSOCKETS_SERVER_CLIENT_MAX) {
+    if(num < _clientMax) {
         WSclient_t * client = &_clients[num];
         if(clientIsConnected(client)) {
             return client->tcp->remoteIP();
@@ -442,15 +475,33 @@ IPAddress WebSocketsServer::remoteIP(uint8_t num) {
  * handle new client connection
  * @param client
  */
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+bool WebSocketsServer::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient, AsyncClient * asyncClient) {
+#else
 bool WebSocketsServer::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient) {
+#endif
     WSclient_t * client;
     // search free list entry for client
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
 
         // state is not connected or tcp connection is lost
         if(!clientIsConnected(client)) {
+            // a connection lost during the upgrade may have left its handshake state
+            ws_delete(client->shs);
+            client->shs = ws_new<WSserverHandshake_t>(WSmem_library);
+            if(!client->shs) {
+                DEBUG_WEBSOCKETS("[WS-Server] no memory for the handshake!\n");
+                return false;
+            }
+
             client->tcp = TCPclient;
+#if defined(WEBSOCKETS_USE_SEND_LIMIT)
+            client->asyncTcp   = asyncClient;
+            client->txProgress = millis();
+            client->txDropped  = 0;
+            client->txBroken   = false;
+#endif
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
             client->isSSL = false;
@@ -460,7 +511,8 @@ bool WebSocketsServer::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient) {
             // set Timeout for readBytesUntil and readStringUntil
             client->tcp->setTimeout(WEBSOCKETS_TCP_TIMEOUT);
 #endif
-            client->status = WSC_HEADER;
+            client->status   = WSC_HEADER;
+            client->cDeflate = false;
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
             IPAddress ip = client->tcp->remoteIP();
             DEBUG_WEBSOCKETS("[WS-Server][%d] new client from %d.%d.%d.%d\n", client->num, ip[0], ip[1], ip[2], ip[3]);
@@ -474,14 +526,18 @@ bool WebSocketsServer::newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient) {
 
                 AsyncTCPbuffer ** sl = &server->_clients[client->num].tcp;
                 if(*sl == obj) {
-                    client->status = WSC_NOT_CONNECTED;
-                    *sl            = NULL;
+                    *sl              = NULL;
+                    client->asyncTcp = NULL;
+                    if(client->status != WSC_NOT_CONNECTED) {
+                        // closed by the peer: clean up and report it like a lost client
+                        server->clientDisconnect(client);
+                    }
                 }
                 return true;
             },
                 this, std::placeholders::_1, client));
 
-            client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServer::handleHeader, this, client, &(client->cHttpLine)));
+            client->tcp->readStringUntil('\n', &(client->shs->cHttpLine), std::bind(&WebSocketsServer::handleHeader, this, client, &(client->shs->cHttpLine)));
 #endif
 
             return true;
@@ -542,34 +598,40 @@ void WebSocketsServer::clientDisconnect(WSclient_t * client) {
     }
 #endif
 
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+    // last chance for the close frame, without waiting
+    if(client->tcp && client->tcp->connected()) {
+        handleSendQueue(client);
+    }
+    releaseSendQueue(client);
+#endif
+
     if(client->tcp) {
         if(client->tcp->connected()) {
 #if(WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
             client->tcp->flush();
+#else
+            // stop() runs the disconnect callback, which must not disconnect the client again
+            client->status = WSC_NOT_CONNECTED;
 #endif
             client->tcp->stop();
         }
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
         client->status = WSC_NOT_CONNECTED;
 #else
-        delete client->tcp;
+        ws_delete(client->tcp);
 #endif
         client->tcp = NULL;
     }
+#if defined(WEBSOCKETS_USE_SEND_LIMIT)
+    client->asyncTcp = NULL;
+#endif
 
-    client->cUrl         = "";
-    client->cKey         = "";
-    client->cProtocol    = "";
-    client->cVersion     = 0;
-    client->cIsUpgrade   = false;
-    client->cIsWebsocket = false;
+    ws_delete(client->shs);
+    client->shs = NULL;
 
     client->cWsRXsize = 0;
 
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-    client->cHttpLine = "";
-#endif
-
     client->status = WSC_NOT_CONNECTED;
 
     DEBUG_WEBSOCKETS("[WS-Server][%d] client disconnected.\n", client->num);
@@ -589,7 +651,12 @@ bool WebSocketsServer::clientIsConnected(WSclient_t * client) {
 
     if(client->tcp->connected()) {
         if(client->status != WSC_NOT_CONNECTED) {
+#if defined(WEBSOCKETS_USE_SEND_LIMIT)
+            // every send checks the connection first, the async interface has no loop() for this
+            return handleSendLimit(client);
+#else
             return true;
+#endif
         }
     } else {
         // client lost
@@ -620,9 +687,9 @@ void WebSocketsServer::handleNewClients(void) {
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
         // store new connection
-        WEBSOCKETS_NETWORK_CLASS * tcpClient = new WEBSOCKETS_NETWORK_CLASS(_server->available());
+        WEBSOCKETS_NETWORK_CLASS * tcpClient = ws_new<WEBSOCKETS_NETWORK_CLASS>(WSmem_library, _server->available());
 #else
-    WEBSOCKETS_NETWORK_CLASS * tcpClient = new WEBSOCKETS_NETWORK_CLASS(_server->available());
+    WEBSOCKETS_NETWORK_CLASS * tcpClient = ws_new<WEBSOCKETS_NETWORK_CLASS>(WSmem_library, _server->available());
 #endif
 
         if(!tcpClient) {
@@ -641,6 +708,7 @@ void WebSocketsServer::handleNewClients(void) {
         DEBUG_WEBSOCKETS("[WS-Server] no free space new client\n");
 #endif
             tcpClient->stop();
+            ws_delete(tcpClient);
         }
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
@@ -654,17 +722,20 @@ void WebSocketsServer::handleNewClients(void) {
  */
 void WebSocketsServer::handleClientData(void) {
     WSclient_t * client;
-    for(uint8_t i = 0; i < WEBSOCKETS_SERVER_CLIENT_MAX; i++) {
+    for(uint8_t i = 0; i < _clientMax; i++) {
         client = &_clients[i];
+        // free slots and idle clients cost only this check
+        if(client->tcp == NULL) {
+            continue;
+        }
         if(clientIsConnected(client)) {
             int len = client->tcp->available();
             if(len > 0) {
                 //DEBUG_WEBSOCKETS("[WS-Server][%d][handleClientData] len: %d\n", client->num, len);
                 switch(client->status) {
-                    case WSC_HEADER: {
-                        String headerLine = client->tcp->readStringUntil('\n');
-                        handleHeader(client, &headerLine);
-                    } break;
+                    case WSC_HEADER:
+                        handleHeaderData(client);
+                        break;
                     case WSC_CONNECTED:
                         WebSockets::handleWebsocket(client);
                         break;
@@ -673,129 +744,323 @@ void WebSocketsServer::handleClientData(void) {
                         break;
                 }
             }
-        }
+#if defined(WEBSOCKETS_USE_SEND_QUEUE)
+            if(!handleSendQueue(client)) {
+                DEBUG_WEBSOCKETS("[WS-Server][%d] client does not take data, disconnect.\n", client->num);
+                clientDisconnect(client);
+            } else if(client->txDropped && !client->txLength) {
+                DEBUG_WEBSOCKETS("[WS-Server][%d] %u frames dropped.\n", client->num, client->txDropped);
+                client->txDropped = 0;
+                runCbEvent(client->num, WStype_DROPPED, NULL, 0);
+            }
+#endif
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266)
-        delay(0);
+            // give the WiFi stack time only after real work
+            if(len > 0) {
+                delay(0);
+            }
 #endif
+        }
     }
 }
 #endif
 
 /*
  * returns an indicator whether the given named header exists in the configured _mandatoryHttpHeaders collection
- * @param headerName String ///< the name of the header being checked
+ * @param headerName const char * ///< the name of the header being checked
  */
-bool WebSocketsServer::hasMandatoryHeader(String headerName) {
+bool WebSocketsServer::hasMandatoryHeader(const char * headerName) {
     for(size_t i = 0; i < _mandatoryHttpHeaderCount; i++) {
-        if(_mandatoryHttpHeaders[i].equalsIgnoreCase(headerName))
+        if(strcasecmp(_mandatoryHttpHeaders[i].c_str(), headerName) == 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * check if a comma separated header value contains a token
+ * @param value const char *
+ * @param token const char * ///< lower case
+ * @return true if found (case insensitive)
+ */
+static bool headerHasToken(const char * value, const char * token) {
+    size_t length = strlen(token);
+    for(; *value; value++) {
+        if(strncasecmp(value, token, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if defined(WEBSOCKETS_USE_DEFLATE)
+static bool extensionTokenIs(const char * token, size_t length, const char * name) {
+    return (strlen(name) == length) && (strncasecmp(token, name, length) == 0);
+}
+
+/**
+ * look for a permessage-deflate offer the server can take (RFC 7692 7.1):
+ * both sides reset the window after every message, the client may limit its
+ * window, offers that limit the window of the server are declined
+ * @param value const char *  Sec-WebSocket-Extensions
+ */
+static bool deflateOfferAcceptable(const char * value) {
+    while(*value) {
+        bool deflate    = false;
+        bool acceptable = true;
+        uint8_t index   = 0;
+
+        // extension name and parameters are separated by ';', offers by ','
+        while(*value && *value != ',') {
+            while(*value == ' ' || *value == '\t') {
+                value++;
+            }
+            const char * token = value;
+            while(*value && *value != ';' && *value != ',') {
+                value++;
+            }
+            size_t length = (value - token);
+            while(length > 0 && (token[length - 1] == ' ' || token[length - 1] == '\t')) {
+                length--;
+            }
+
+            if(index == 0) {
+                deflate = extensionTokenIs(token, length, "permessage-deflate");
+            } else if(!extensionTokenIs(token, length, "server_no_context_takeover") && !extensionTokenIs(token, length, "client_no_context_takeover")) {
+                // client_max_window_bits comes with or without a value
+                if(length < 22 || strncasecmp(token, "client_max_window_bits", 22) != 0 || (length > 22 && token[22] != '=' && token[22] != ' ')) {
+                    acceptable = false;
+                }
+            }
+            index++;
+
+            if(*value == ';') {
+                value++;
+            }
+        }
+
+        if(deflate && acceptable) {
             return true;
+        }
+        if(*value == ',') {
+            value++;
+        }
     }
     return false;
 }
+#endif
 
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
 /**
- * handles http header reading for WebSocket upgrade
+ * async interface: one header line was received
  * @param client WSclient_t * ///< pointer to the client struct
  * @param headerLine String ///< the header being read / processed
  */
 void WebSocketsServer::handleHeader(WSclient_t * client, String * headerLine) {
-    static const char * NEW_LINE = "\r\n";
+    WSserverHandshake_t * hs = client->shs;
+    if(!hs) {
+        return;
+    }
+    size_t length = headerLine->length();
+    hs->lineCut   = (length >= sizeof(hs->line));
+    if(hs->lineCut) {
+        length = sizeof(hs->line) - 1;
+    }
+    memcpy(&hs->line[0], headerLine->c_str(), length);
+    hs->lineLength = length;
+    (*headerLine)  = "";
 
-    headerLine->trim();    // remove \r
+    handleHeaderLine(client);
 
-    if(headerLine->length() > 0) {
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] RX: %s\n", client->num, headerLine->c_str());
+    // the handshake state is gone once the connection is upgraded or closed
+    if(client->shs && client->status == WSC_HEADER) {
+        client->tcp->readStringUntil('\n', &(client->shs->cHttpLine), std::bind(&WebSocketsServer::handleHeader, this, client, &(client->shs->cHttpLine)));
+    }
+}
+
+/**
+ * async interface: report dropped frames once the TCP send buffer has room again and
+ * disconnect a client that did not take any data for WEBSOCKETS_SEND_STALL_TIMEOUT
+ * or lost a part of a fragmented message
+ * @param client WSclient_t * ///< pointer to the client struct
+ * @return false if the client was disconnected
+ */
+bool WebSocketsServer::handleSendLimit(WSclient_t * client) {
+    if(client->status != WSC_CONNECTED || !client->asyncTcp) {
+        return true;
+    }
+    if(!client->txBroken && client->asyncTcp->space() > 0) {
+        client->txProgress = millis();
+        if(client->txDropped) {
+            DEBUG_WEBSOCKETS("[WS-Server][%d] %u frames dropped.\n", client->num, client->txDropped);
+            client->txDropped = 0;
+            runCbEvent(client->num, WStype_DROPPED, NULL, 0);
+        }
+        return true;
+    }
+    if(client->txBroken || ((millis() - client->txProgress) > WEBSOCKETS_SEND_STALL_TIMEOUT)) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d] client does not take data, disconnect.\n", client->num);
+        clientDisconnect(client);
+        return false;
+    }
+    return true;
+}
+#else
+/**
+ * feed the received header bytes to the parser, never waits for a complete line.
+ * bytes are taken one by one so that nothing behind the header is consumed
+ * @param client WSclient_t * ///< pointer to the client struct
+ */
+void WebSocketsServer::handleHeaderData(WSclient_t * client) {
+    while(client->shs && (client->status == WSC_HEADER) && (client->tcp->available() > 0)) {
+        WSserverHandshake_t * hs = client->shs;
+        int c                    = client->tcp->read();
+        if(c < 0) {
+            break;
+        }
+        if(c == '\n') {
+            handleHeaderLine(client);
+        } else if(hs->lineLength < (sizeof(hs->line) - 1)) {
+            hs->line[hs->lineLength++] = c;
+        } else {
+            hs->lineCut = true;
+        }
+    }
+}
+#endif
+
+/**
+ * handles one http header line of the WebSocket upgrade, parsed in place
+ * @param client WSclient_t * ///< pointer to the client struct, the line is in client->shs->line
+ */
+void WebSocketsServer::handleHeaderLine(WSclient_t * client) {
+    WSserverHandshake_t * hs = client->shs;
+    char * line              = &hs->line[0];
+    size_t length            = hs->lineLength;
+    bool lineCut             = hs->lineCut;
+
+    // next line starts empty
+    hs->lineLength = 0;
+    hs->lineCut    = false;
+
+    // remove \r and trailing spaces
+    while(length > 0 && (line[length - 1] == '\r' || line[length - 1] == ' ')) {
+        length--;
+    }
+    line[length] = 0x00;
+
+    if(length > 0) {
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] RX: %s\n", client->num, line);
 
         // websocket requests always start with GET see rfc6455
-        if(headerLine->startsWith("GET ")) {
+        if(strncmp(line, "GET ", 4) == 0) {
             // cut URL out
-            client->cUrl = headerLine->substring(4, headerLine->indexOf(' ', 4));
+            char * url = &line[4];
+            char * end = strchr(url, ' ');
+            size_t urlLength = end ? (size_t)(end - url) : strlen(url);
+            if(lineCut || urlLength >= sizeof(hs->url)) {
+                DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] URL too long\n", client->num);
+                hs->invalid = true;
+                urlLength   = 0;
+            }
+            memcpy(&hs->url[0], url, urlLength);
+            hs->url[urlLength] = 0x00;
+            hs->requestLine    = true;
 
             //reset non-websocket http header validation state for this client
-            client->cHttpHeadersValid      = true;
-            client->cMandatoryHeadersCount = 0;
+            hs->httpHeadersValid      = true;
+            hs->mandatoryHeadersCount = 0;
 
-        } else if(headerLine->indexOf(':') >= 0) {
-            String headerName  = headerLine->substring(0, headerLine->indexOf(':'));
-            String headerValue = headerLine->substring(headerLine->indexOf(':') + 1);
+        } else if(char * colon = strchr(line, ':')) {
+            char * headerName  = line;
+            char * headerValue = colon + 1;
+            *colon             = 0x00;
 
             // remove space in the beginning (RFC2616)
-            if(headerValue[0] == ' ') {
-                headerValue.remove(0, 1);
+            while(*headerValue == ' ') {
+                headerValue++;
             }
 
-            if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Connection"))) {
-                headerValue.toLowerCase();
-                if(headerValue.indexOf(WEBSOCKETS_STRING("upgrade")) >= 0) {
-                    client->cIsUpgrade = true;
+            if(strcasecmp(headerName, "Connection") == 0) {
+                if(headerHasToken(headerValue, "upgrade")) {
+                    hs->isUpgrade = true;
+                }
+            } else if(strcasecmp(headerName, "Upgrade") == 0) {
+                if(strcasecmp(headerValue, "websocket") == 0) {
+                    hs->isWebsocket = true;
                 }
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Upgrade"))) {
-                if(headerValue.equalsIgnoreCase(WEBSOCKETS_STRING("websocket"))) {
-                    client->cIsWebsocket = true;
+            } else if(strcasecmp(headerName, "Sec-WebSocket-Version") == 0) {
+                hs->version = atoi(headerValue);
+            } else if(strcasecmp(headerName, "Sec-WebSocket-Key") == 0) {
+                size_t keyLength = strlen(headerValue);
+                if(keyLength > WEBSOCKETS_KEY_SIZE) {
+                    hs->invalid = true;
+                    keyLength   = 0;
                 }
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Version"))) {
-                client->cVersion = headerValue.toInt();
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Key"))) {
-                client->cKey = headerValue;
-                client->cKey.trim();    // see rfc6455
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Protocol"))) {
-                client->cProtocol = headerValue;
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Sec-WebSocket-Extensions"))) {
-                client->cExtensions = headerValue;
-            } else if(headerName.equalsIgnoreCase(WEBSOCKETS_STRING("Authorization"))) {
-                client->base64Authorization = headerValue;
+                memcpy(&hs->key[0], headerValue, keyLength);
+                hs->key[keyLength] = 0x00;
+            } else if(strcasecmp(headerName, "Sec-WebSocket-Protocol") == 0) {
+                hs->hasProtocol = true;
+            } else if(strcasecmp(headerName, "Sec-WebSocket-Extensions") == 0) {
+#if defined(WEBSOCKETS_USE_DEFLATE)
+                // the header may be repeated, a cut line is not trusted
+                if(_deflate && !lineCut && !hs->deflate) {
+                    hs->deflate = deflateOfferAcceptable(headerValue);
+                }
+#endif
+            } else if(strcasecmp(headerName, "Authorization") == 0) {
+                hs->isAuthorized = (strncmp(headerValue, "Basic ", 6) == 0) && (strcmp(&headerValue[6], _base64Authorization.c_str()) == 0);
             } else {
-                client->cHttpHeadersValid &= execHttpHeaderValidation(headerName, headerValue);
+                // the custom validation is the only place that needs Strings
+                if(_httpHeaderValidationFunc) {
+                    hs->httpHeadersValid &= execHttpHeaderValidation(String(headerName), String(headerValue));
+                }
                 if(_mandatoryHttpHeaderCount > 0 && hasMandatoryHeader(headerName)) {
-                    client->cMandatoryHeadersCount++;
+                    hs->mandatoryHeadersCount++;
                 }
             }
 
         } else {
-            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header error (%s)\n", headerLine->c_str());
+            DEBUG_WEBSOCKETS("[WS-Client][handleHeader] Header error (%s)\n", line);
         }
-
-        (*headerLine) = "";
-#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
-        client->tcp->readStringUntil('\n', &(client->cHttpLine), std::bind(&WebSocketsServer::handleHeader, this, client, &(client->cHttpLine)));
-#endif
     } else {
         DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] Header read fin.\n", client->num);
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cURL: %s\n", client->num, client->cUrl.c_str());
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cIsUpgrade: %d\n", client->num, client->cIsUpgrade);
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cIsWebsocket: %d\n", client->num, client->cIsWebsocket);
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cKey: %s\n", client->num, client->cKey.c_str());
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cProtocol: %s\n", client->num, client->cProtocol.c_str());
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cExtensions: %s\n", client->num, client->cExtensions.c_str());
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cVersion: %d\n", client->num, client->cVersion);
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - base64Authorization: %s\n", client->num, client->base64Authorization.c_str());
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cHttpHeadersValid: %d\n", client->num, client->cHttpHeadersValid);
-        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cMandatoryHeadersCount: %d\n", client->num, client->cMandatoryHeadersCount);
-
-        bool ok = (client->cIsUpgrade && client->cIsWebsocket);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cURL: %s\n", client->num, hs->url);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cIsUpgrade: %d\n", client->num, hs->isUpgrade);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cIsWebsocket: %d\n", client->num, hs->isWebsocket);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cKey: %s\n", client->num, hs->key);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cProtocol: %d\n", client->num, hs->hasProtocol);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cVersion: %d\n", client->num, hs->version);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - deflate: %d\n", client->num, hs->deflate);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - isAuthorized: %d\n", client->num, hs->isAuthorized);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cHttpHeadersValid: %d\n", client->num, hs->httpHeadersValid);
+        DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - cMandatoryHeadersCount: %d\n", client->num, hs->mandatoryHeadersCount);
+
+        bool ok = (hs->isUpgrade && hs->isWebsocket);
 
         if(ok) {
-            if(client->cUrl.length() == 0) {
+            if(hs->invalid || !hs->requestLine) {
+                ok = false;
+            }
+            if(hs->url[0] == 0x00) {
                 ok = false;
             }
-            if(client->cKey.length() == 0) {
+            if(hs->key[0] == 0x00) {
                 ok = false;
             }
-            if(client->cVersion != 13) {
+            if(hs->version != 13) {
                 ok = false;
             }
-            if(!client->cHttpHeadersValid) {
+            if(!hs->httpHeadersValid) {
                 ok = false;
             }
-            if(client->cMandatoryHeadersCount != _mandatoryHttpHeaderCount) {
+            if(hs->mandatoryHeadersCount != _mandatoryHttpHeaderCount) {
                 ok = false;
             }
         }
 
         if(_base64Authorization.length() > 0) {
-            String auth = WEBSOCKETS_STRING("Basic ");
-            auth += _base64Authorization;
-            if(auth != client->base64Authorization) {
+            if(!hs->isAuthorized) {
                 DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] HTTP Authorization failed!\n", client->num);
                 handleAuthorizationFailed(client);
                 return;
@@ -806,44 +1071,69 @@ void WebSocketsServer::handleHeader(WSclient_t * client, String * headerLine) {
             DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] Websocket connection incoming.\n", client->num);
 
             // generate Sec-WebSocket-Accept key
-            String sKey = acceptKey(client->cKey);
+            char sKey[WEBSOCKETS_ACCEPT_SIZE + 1];
+            acceptKey(hs->key, &sKey[0]);
 
-            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - sKey: %s\n", client->num, sKey.c_str());
+            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader]  - sKey: %s\n", client->num, sKey);
 
             client->status = WSC_CONNECTED;
 
-            String handshake = WEBSOCKETS_STRING(
+            static const char * HANDSHAKE_FORMAT =
                 "HTTP/1.1 101 Switching Protocols\r\n"
                 "Server: arduino-WebSocketsServer\r\n"
                 "Upgrade: websocket\r\n"
                 "Connection: Upgrade\r\n"
                 "Sec-WebSocket-Version: 13\r\n"
-                "Sec-WebSocket-Accept: ");
-            handshake += sKey + NEW_LINE;
-
-            if(_origin.length() > 0) {
-                handshake += WEBSOCKETS_STRING("Access-Control-Allow-Origin: ");
-                handshake += _origin + NEW_LINE;
+                "Sec-WebSocket-Accept: %s\r\n"
+                "%s%s%s"
+                "%s%s%s"
+                "%s"
+                "\r\n";
+            static const char * DEFLATE_RESPONSE =
+                "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover\r\n";
+            bool origin   = (_origin.length() > 0);
+            bool protocol = hs->hasProtocol;
+            // + names and line ends of the optional lines
+            size_t size = strlen(HANDSHAKE_FORMAT) + WEBSOCKETS_ACCEPT_SIZE + _origin.length() + _protocol.length() + 64 + (hs->deflate ? strlen(DEFLATE_RESPONSE) : 0);
+
+            char stackBuffer[WEBSOCKETS_HANDSHAKE_RESPONSE_SIZE];
+            char * handshake = &stackBuffer[0];
+            if(size > sizeof(stackBuffer)) {
+                handshake = (char *)ws_malloc(size);
+                if(!handshake) {
+                    DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] no memory for the handshake!\n", client->num);
+                    clientDisconnect(client);
+                    return;
+                }
             }
 
-            if(client->cProtocol.length() > 0) {
-                handshake += WEBSOCKETS_STRING("Sec-WebSocket-Protocol: ");
-                handshake += _protocol + NEW_LINE;
+            int len = snprintf(handshake, size, HANDSHAKE_FORMAT, sKey,
+                (origin ? "Access-Control-Allow-Origin: " : ""), (origin ? _origin.c_str() : ""), (origin ? "\r\n" : ""),
+                (protocol ? "Sec-WebSocket-Protocol: " : ""), (protocol ? _protocol.c_str() : ""), (protocol ? "\r\n" : ""),
+                (hs->deflate ? DEFLATE_RESPONSE : ""));
+            if(len >= (int)size) {
+                len = size - 1;
             }
 
-            // header end
-            handshake += NEW_LINE;
+            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] handshake %s", client->num, handshake);
 
-            DEBUG_WEBSOCKETS("[WS-Server][%d][handleHeader] handshake %s", client->num, (uint8_t *)handshake.c_str());
+            write(client, (uint8_t *)handshake, len);
+            client->cDeflate = hs->deflate;
 
-            write(client, (uint8_t *)handshake.c_str(), handshake.length());
+            if(handshake != &stackBuffer[0]) {
+                ws_free(handshake);
+            }
 
             headerDone(client);
 
             // send ping
             WebSockets::sendFrame(client, WSop_ping);
 
-            runCbEvent(client->num, WStype_CONNECTED, (uint8_t *)client->cUrl.c_str(), client->cUrl.length());
+            runCbEvent(client->num, WStype_CONNECTED, (uint8_t *)hs->url, strlen(hs->url));
+
+            // the upgrade is done, only the connection state is kept
+            ws_delete(client->shs);
+            client->shs = NULL;
 
         } else {
             handleNonWebsocketConnection(client);
@@ -41,7 +41,7 @@ class WebSocketsServer : protected WebSockets {
     typedef std::function<bool(String headerName, String headerValue)> WebSocketServerHttpHeaderValFunc;
 #endif
 
-    WebSocketsServer(uint16_t port, String origin = "", String protocol = "arduino");
+    WebSocketsServer(uint16_t port, String origin = "", String protocol = "arduino", uint8_t clientMax = WEBSOCKETS_SERVER_CLIENT_MAX);
     virtual ~WebSocketsServer(void);
 
     void begin(void);
@@ -90,6 +90,11 @@ class WebSocketsServer : protected WebSockets {
     void setAuthorization(const char * user, const char * password);
     void setAuthorization(const char * auth);
 
+#if defined(WEBSOCKETS_USE_DEFLATE)
+    void enableDeflate(void);
+    void disableDeflate(void);
+#endif
+
     int connectedClients(bool ping = false);
 
 #if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC) || (WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP32)
@@ -106,14 +111,20 @@ class WebSocketsServer : protected WebSockets {
 
     WEBSOCKETS_NETWORK_SERVER_CLASS * _server;
 
-    WSclient_t _clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+    WSclient_t * _clients;    ///< client table, allocated for _clientMax entries
+    uint8_t _clientMax;
 
     WebSocketServerEvent _cbEvent;
     WebSocketServerHttpHeaderValFunc _httpHeaderValidationFunc;
 
     bool _runnning;
+    bool _deflate;    ///< accept permessage-deflate offers
 
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
+    bool newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient, AsyncClient * asyncClient);
+#else
     bool newClient(WEBSOCKETS_NETWORK_CLASS * TCPclient);
+#endif
 
     void messageReceived(WSclient_t * client, WSopcode_t opcode, uint8_t * payload, size_t length, bool fin);
 
@@ -125,7 +136,13 @@ class WebSocketsServer : protected WebSockets {
     void handleClientData(void);
 #endif
 
+#if(WEBSOCKETS_NETWORK_TYPE == NETWORK_ESP8266_ASYNC)
     void handleHeader(WSclient_t * client, String * headerLine);
+    bool handleSendLimit(WSclient_t * client);
+#else
+    void handleHeaderData(WSclient_t * client);
+#endif
+    void handleHeaderLine(WSclient_t * client);
 
     /**
          * called if a non Websocket connection is coming in.
@@ -200,7 +217,7 @@ class WebSocketsServer : protected WebSockets {
          * returns an indicator whether the given named header exists in the configured _mandatoryHttpHeaders collection
          * @param headerName String ///< the name of the header being checked
          */
-    bool hasMandatoryHeader(String headerName);
+    bool hasMandatoryHeader(const char * headerName);
 };
 
 #endif /* WEBSOCKETSSERVER_H_ */
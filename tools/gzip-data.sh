@@ -0,0 +1,13 @@
+#!/bin/sh
+# Сжимает статические файлы веб-интерфейса перед загрузкой SPIFFS (Tools -> ESP8266 Sketch Data Upload).
+# Сервер отдает file.gz вместо file браузерам с Accept-Encoding: gzip, исходные файлы нужны только
+# клиентам без gzip и при нехватке места в SPIFFS их можно не загружать.
+# Запускать после каждого изменения этих файлов: -n убирает имя и время из заголовка, ETag не меняется без причины.
+
+cd "$(dirname "$0")/../SmartLED/data" || exit 1
+
+for f in index.html lib/jq.js lib/jqm.js jqm.css jqmt.css
+do
+    gzip -9 -n -c "$f" > "$f.gz" || exit 1
+    echo "$f: $(wc -c < "$f") -> $(wc -c < "$f.gz")"
+done
@@ -0,0 +1,507 @@
+// Перенос ESPAsyncTCP на Linux: AsyncServer/AsyncClient поверх неблокирующих сокетов и epoll, AsyncTCPbuffer.
+
+#include <ESPAsyncTCPbuffer.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <map>
+
+static int epollFd = -1;
+static std::map<int, AsyncClient*> clients;
+static std::map<int, AsyncServer*> servers;
+
+static void watch(int fd)
+{
+    if (epollFd < 0)
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.fd = fd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static void unwatch(int fd)
+{
+    if (epollFd >= 0)
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+AsyncClient::AsyncClient(int f) : fd(f), inFlight(0)
+{
+    if (fd >= 0)
+    {
+        clients[fd] = this;
+        watch(fd);
+    }
+}
+
+AsyncClient::~AsyncClient()
+{
+    if (fd >= 0)
+    {
+        unwatch(fd);
+        clients.erase(fd);
+        ::close(fd);
+    }
+}
+
+bool AsyncClient::connected()
+{
+    return fd >= 0;
+}
+
+void AsyncClient::close(bool now)
+{
+    (void) now;
+    if (fd < 0)
+        return;
+    unwatch(fd);
+    clients.erase(fd);
+    ::close(fd);
+    fd = -1;
+    /// обработчик может удалить этот объект, поэтому вызывается его копия
+    AcConnectHandler cb = disconnectCb;
+    if (cb)
+        cb(disconnectArg, this);
+}
+
+void AsyncClient::stop()
+{
+    close(true);
+}
+
+size_t AsyncClient::unacked()
+{
+    int queued = 0;
+    if ((fd < 0) || (ioctl(fd, SIOCOUTQ, &queued) != 0) || (queued < 0))
+        return 0;
+    return queued;
+}
+
+size_t AsyncClient::space()
+{
+    if (fd < 0)
+        return 0;
+    size_t queued = unacked();
+    return (queued < ASYNC_SND_BUF) ? ASYNC_SND_BUF - queued : 0;
+}
+
+size_t AsyncClient::add(const char* data, size_t size, uint8_t apiflags)
+{
+    (void) apiflags;
+    size_t room = space();
+    if (size > room)
+        size = room;
+    if (size == 0)
+        return 0;
+    ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (sent <= 0)
+        return 0;
+    inFlight += sent;
+    return sent;
+}
+
+bool AsyncClient::send()
+{
+    return fd >= 0;
+}
+
+size_t AsyncClient::write(const char* data)
+{
+    return write(data, strlen(data));
+}
+
+size_t AsyncClient::write(const char* data, size_t size, uint8_t apiflags)
+{
+    size_t added = add(data, size, apiflags);
+    send();
+    return added;
+}
+
+void AsyncClient::onConnect(AcConnectHandler cb, void* arg)
+{
+    connectCb = cb;
+    connectArg = arg;
+}
+
+void AsyncClient::onDisconnect(AcConnectHandler cb, void* arg)
+{
+    disconnectCb = cb;
+    disconnectArg = arg;
+}
+
+void AsyncClient::onAck(AcAckHandler cb, void* arg)
+{
+    ackCb = cb;
+    ackArg = arg;
+}
+
+void AsyncClient::onError(AcErrorHandler cb, void* arg)
+{
+    errorCb = cb;
+    errorArg = arg;
+}
+
+void AsyncClient::onData(AcDataHandler cb, void* arg)
+{
+    dataCb = cb;
+    dataArg = arg;
+}
+
+void AsyncClient::onTimeout(AcTimeoutHandler cb, void* arg)
+{
+    timeoutCb = cb;
+    timeoutArg = arg;
+}
+
+void AsyncClient::onPoll(AcConnectHandler cb, void* arg)
+{
+    pollCb = cb;
+    pollArg = arg;
+}
+
+void AsyncClient::setNoDelay(bool nodelay)
+{
+    int value = nodelay ? 1 : 0;
+    if (fd >= 0)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
+
+IPAddress AsyncClient::remoteIP()
+{
+    struct sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    if ((fd < 0) || (getpeername(fd, (struct sockaddr*) &address, &length) != 0))
+        return IPAddress();
+    return IPAddress((uint32_t) address.sin_addr.s_addr);
+}
+
+uint16_t AsyncClient::remotePort()
+{
+    struct sockaddr_in address = {};
+    socklen_t length = sizeof(address);
+    if ((fd < 0) || (getpeername(fd, (struct sockaddr*) &address, &length) != 0))
+        return 0;
+    return ntohs(address.sin_port);
+}
+
+void AsyncClient::handleReadable()
+{
+    int self = fd;
+    char buffer[ASYNC_RX_CHUNK];
+    while (fd >= 0)
+    {
+        ssize_t length = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return;
+        if (length <= 0)
+        {
+            close(true);
+            return;
+        }
+        AcDataHandler cb = dataCb;
+        if (cb)
+            cb(dataArg, this, buffer, length);
+        /// обработчик мог закрыть и удалить соединение
+        std::map<int, AsyncClient*>::iterator found = clients.find(self);
+        if ((found == clients.end()) || (found->second != this))
+            return;
+    }
+}
+
+void AsyncClient::handleAck()
+{
+    size_t queued = unacked();
+    if (queued >= inFlight)
+        return;
+    size_t acked = inFlight - queued;
+    inFlight = queued;
+    AcAckHandler cb = ackCb;
+    if (cb)
+        cb(ackArg, this, acked, 0);
+}
+
+AsyncServer::AsyncServer(uint16_t port) : requestedPort(port)
+{
+}
+
+AsyncServer::~AsyncServer()
+{
+    end();
+}
+
+void AsyncServer::onClient(AcConnectHandler cb, void* arg)
+{
+    clientCb = cb;
+    clientArg = arg;
+}
+
+void AsyncServer::begin()
+{
+    if (fd >= 0)
+        return;
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int value = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &value, sizeof(value));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if ((bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0) || (listen(fd, 128) != 0) ||
+        (getsockname(fd, (struct sockaddr*) &address, &length) != 0))
+    {
+        perror("AsyncServer::begin");
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+    boundPort = ntohs(address.sin_port);
+    servers[fd] = this;
+    watch(fd);
+}
+
+void AsyncServer::end()
+{
+    if (fd < 0)
+        return;
+    unwatch(fd);
+    servers.erase(fd);
+    ::close(fd);
+    fd = -1;
+    boundPort = 0;
+}
+
+void AsyncServer::setNoDelay(bool nodelay)
+{
+    (void) nodelay;
+}
+
+void AsyncServer::handleAccept()
+{
+    while (fd >= 0)
+    {
+        int client = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0)
+            return;
+        AsyncClient* connection = new AsyncClient(client);
+        connection->setNoDelay(true);
+        if (clientCb)
+            clientCb(clientArg, connection);
+        else
+            delete connection;
+    }
+}
+
+void asyncPoll(int timeoutMs)
+{
+    if (epollFd < 0)
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event events[64];
+    int count = epoll_wait(epollFd, events, 64, timeoutMs);
+    for (int i = 0; i < count; i++)
+    {
+        int fd = events[i].data.fd;
+        std::map<int, AsyncServer*>::iterator server = servers.find(fd);
+        if (server != servers.end())
+        {
+            server->second->handleAccept();
+            continue;
+        }
+        std::map<int, AsyncClient*>::iterator client = clients.find(fd);
+        if (client != clients.end())
+            client->second->handleReadable();
+    }
+    /// подтверждения не будят epoll, их проверяет каждый вызов (обработчик может удалить соединение)
+    std::vector<int> open;
+    for (std::map<int, AsyncClient*>::iterator client = clients.begin(); client != clients.end(); ++client)
+        open.push_back(client->first);
+    for (int fd : open)
+    {
+        std::map<int, AsyncClient*>::iterator client = clients.find(fd);
+        if (client != clients.end())
+            client->second->handleAck();
+    }
+}
+
+uint16_t asyncPort(uint16_t port)
+{
+    for (std::map<int, AsyncServer*>::iterator server = servers.begin(); server != servers.end(); ++server)
+        if (server->second->requestedPort == port)
+            return server->second->boundPort;
+    return 0;
+}
+
+AsyncTCPbuffer::AsyncTCPbuffer(AsyncClient* c) : client(c)
+{
+    client->onData([this](void*, AsyncClient*, void* data, size_t length)
+    {
+        rx.insert(rx.end(), (uint8_t*) data, (uint8_t*) data + length);
+        handleRx();
+    });
+    client->onAck([this](void*, AsyncClient*, size_t, uint32_t)
+    {
+        sendBuffer();
+    });
+    client->onDisconnect([this](void*, AsyncClient*)
+    {
+        disconnected();
+    });
+}
+
+AsyncTCPbuffer::~AsyncTCPbuffer()
+{
+    if (destroyed)
+        *destroyed = true;
+    if (client)
+    {
+        AsyncClient* c = client;
+        client = NULL;
+        c->onDisconnect(NULL);
+        c->onData(NULL);
+        c->onAck(NULL);
+        delete c;
+    }
+}
+
+size_t AsyncTCPbuffer::write(uint8_t data)
+{
+    return write(&data, 1);
+}
+
+size_t AsyncTCPbuffer::write(const uint8_t* data, size_t length)
+{
+    if (!client || !client->connected())
+        return 0;
+    tx.insert(tx.end(), data, data + length);
+    sendBuffer();
+    return length;
+}
+
+void AsyncTCPbuffer::flush()
+{
+    sendBuffer();
+}
+
+void AsyncTCPbuffer::sendBuffer()
+{
+    while (client && !tx.empty())
+    {
+        size_t room = client->space();
+        if (room == 0)
+            return;
+        size_t sent = client->add((const char*) tx.data(), std::min(room, tx.size()));
+        if (sent == 0)
+            return;
+        tx.erase(tx.begin(), tx.begin() + sent);
+    }
+}
+
+void AsyncTCPbuffer::readStringUntil(char end, String* str, AsyncTCPbufferDoneCb cb)
+{
+    mode = RXString;
+    terminator = end;
+    string = str;
+    done = cb;
+    handleRx();
+}
+
+void AsyncTCPbuffer::readBytes(uint8_t* buffer, size_t length, AsyncTCPbufferDoneCb cb)
+{
+    mode = RXBytes;
+    bytes = buffer;
+    wanted = length;
+    received = 0;
+    done = cb;
+    handleRx();
+}
+
+void AsyncTCPbuffer::handleRx()
+{
+    /// done() обычно сразу запрашивает следующее чтение, оно продолжится в этом же цикле
+    if (handling)
+        return;
+    handling = true;
+    bool gone = false;
+    destroyed = &gone;
+    while (mode != RXFree)
+    {
+        if (mode == RXString)
+        {
+            if (rx.empty())
+                break;
+            char c = rx.front();
+            rx.pop_front();
+            if (c != terminator)
+            {
+                *string += c;
+                continue;
+            }
+        } else
+        {
+            size_t length = std::min(wanted - received, rx.size());
+            std::copy(rx.begin(), rx.begin() + length, &bytes[received]);
+            rx.erase(rx.begin(), rx.begin() + length);
+            received += length;
+            if (received < wanted)
+                break;
+        }
+        void* result = (mode == RXString) ? (void*) string : (void*) bytes;
+        AsyncTCPbufferDoneCb cb = done;
+        mode = RXFree;
+        if (cb)
+            cb(true, result);
+        if (gone)
+            return;
+    }
+    destroyed = NULL;
+    handling = false;
+}
+
+void AsyncTCPbuffer::onDisconnect(AsyncTCPbufferDisconnectCb cb)
+{
+    disconnectCb = cb;
+}
+
+IPAddress AsyncTCPbuffer::remoteIP()
+{
+    return client ? client->remoteIP() : IPAddress();
+}
+
+uint16_t AsyncTCPbuffer::remotePort()
+{
+    return client ? client->remotePort() : 0;
+}
+
+bool AsyncTCPbuffer::connected()
+{
+    return client && client->connected();
+}
+
+void AsyncTCPbuffer::stop()
+{
+    if (!client)
+        return;
+    /// close() вызывает disconnected(), который может удалить этот объект
+    client->close(true);
+}
+
+void AsyncTCPbuffer::disconnected()
+{
+    AsyncClient* c = client;
+    client = NULL;
+    bool remove = true;
+    if (disconnectCb)
+        remove = disconnectCb(this);
+    /// соединение удаляется из собственного обработчика, как в ESPAsyncTCPbuffer
+    delete c;
+    if (remove)
+        delete this;
+}
@@ -0,0 +1,106 @@
+// Перенос интерфейса ESPAsyncTCP на Linux (epoll) для сборки событийного сервера вебсокетов на компьютере.
+// Реализована только часть, которой пользуются WebSocketsServer и ESPAsyncTCPbuffer.h: прием соединений,
+// данные, подтверждения, отключение. Сокеты настоящие (TCP на 127.0.0.1), обработчики вызываются из
+// asyncPoll() - на ESP их вызывает lwIP между проходами loop(), здесь asyncPoll() вызывает сама программа.
+// Свободное место для отправки (space()) считается как на ESP8266: ASYNC_SND_BUF минус байты, еще не
+// подтвержденные получателем (SIOCOUTQ), поэтому клиент, который не читает, заполняет его так же, как на ESP.
+
+#ifndef HOST_ESPASYNCTCP_H
+#define HOST_ESPASYNCTCP_H
+
+#include <Arduino.h>
+#include <functional>
+
+#define ASYNC_SND_BUF 2920              ///< TCP_SND_BUF lwIP в ядре ESP8266 (2 * TCP_MSS)
+#define ASYNC_RX_CHUNK 1460             ///< данных за один вызов onData, как один сегмент TCP
+
+class AsyncClient;
+
+typedef std::function<void(void*, AsyncClient*)> AcConnectHandler;
+typedef std::function<void(void*, AsyncClient*, size_t len, uint32_t time)> AcAckHandler;
+typedef std::function<void(void*, AsyncClient*, int8_t error)> AcErrorHandler;
+typedef std::function<void(void*, AsyncClient*, void* data, size_t len)> AcDataHandler;
+typedef std::function<void(void*, AsyncClient*, uint32_t time)> AcTimeoutHandler;
+
+class AsyncClient
+{
+public:
+    /// соединение, принятое AsyncServer (fd - сокет Linux)
+    AsyncClient(int fd = -1);
+    ~AsyncClient();
+
+    bool connected();
+    /// закрыть соединение, onDisconnect вызывается сразу
+    void close(bool now = false);
+    void stop();
+    /// сколько байт можно отправить сейчас
+    size_t space();
+    size_t add(const char* data, size_t size, uint8_t apiflags = 0);
+    bool send();
+    size_t write(const char* data);
+    size_t write(const char* data, size_t size, uint8_t apiflags = 0);
+
+    void onConnect(AcConnectHandler cb, void* arg = NULL);
+    void onDisconnect(AcConnectHandler cb, void* arg = NULL);
+    void onAck(AcAckHandler cb, void* arg = NULL);
+    void onError(AcErrorHandler cb, void* arg = NULL);
+    void onData(AcDataHandler cb, void* arg = NULL);
+    void onTimeout(AcTimeoutHandler cb, void* arg = NULL);
+    void onPoll(AcConnectHandler cb, void* arg = NULL);
+
+    void setNoDelay(bool nodelay);
+    IPAddress remoteIP();
+    uint16_t remotePort();
+
+    /// вызывается из asyncPoll()
+    void handleReadable();
+    void handleAck();
+
+private:
+    int fd;
+    size_t inFlight;                    ///< отправлено, но не подтверждено при последней проверке
+    AcConnectHandler connectCb, disconnectCb, pollCb;
+    void* connectArg = NULL;
+    void* disconnectArg = NULL;
+    void* pollArg = NULL;
+    AcAckHandler ackCb;
+    void* ackArg = NULL;
+    AcErrorHandler errorCb;
+    void* errorArg = NULL;
+    AcDataHandler dataCb;
+    void* dataArg = NULL;
+    AcTimeoutHandler timeoutCb;
+    void* timeoutArg = NULL;
+
+    size_t unacked();
+};
+
+class AsyncServer
+{
+public:
+    AsyncServer(uint16_t port);
+    ~AsyncServer();
+    void onClient(AcConnectHandler cb, void* arg);
+    /// слушает 127.0.0.1 на свободном порту (asyncPort() возвращает его), а не на заданном
+    void begin();
+    void end();
+    void setNoDelay(bool nodelay);
+
+    /// вызывается из asyncPoll()
+    void handleAccept();
+
+    uint16_t requestedPort;
+    uint16_t boundPort = 0;
+
+private:
+    int fd = -1;
+    AcConnectHandler clientCb;
+    void* clientArg = NULL;
+};
+
+/// обработать события сокетов: новые соединения, данные, подтверждения, отключения. Ждет не дольше timeoutMs
+void asyncPoll(int timeoutMs = 0);
+/// порт, на котором слушает AsyncServer, созданный с портом port (0 - сервера нет)
+uint16_t asyncPort(uint16_t port);
+
+#endif /* HOST_ESPASYNCTCP_H */
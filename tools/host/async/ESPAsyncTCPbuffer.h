@@ -0,0 +1,71 @@
+// AsyncTCPbuffer из ESPAsyncTCP поверх переноса AsyncClient (ESPAsyncTCP.h): буфер отправки, который
+// досылается по подтверждениям, и чтение строки до разделителя или заданного числа байт с обработчиком.
+// Семантика как у оригинала: write() принимает все данные сразу, непринятое TCP ждет в буфере;
+// при отключении вызывается onDisconnect, и если он вернул true, объект удаляется.
+
+#ifndef HOST_ESPASYNCTCPBUFFER_H
+#define HOST_ESPASYNCTCPBUFFER_H
+
+#include <ESPAsyncTCP.h>
+#include <deque>
+#include <vector>
+
+class AsyncTCPbuffer;
+
+typedef std::function<void(bool ok, void* ret)> AsyncTCPbufferDoneCb;
+typedef std::function<bool(AsyncTCPbuffer* obj)> AsyncTCPbufferDisconnectCb;
+
+class AsyncTCPbuffer : public Print
+{
+public:
+    AsyncTCPbuffer(AsyncClient* client);
+    virtual ~AsyncTCPbuffer();
+
+    size_t write(uint8_t data) override;
+    size_t write(const uint8_t* data, size_t length) override;
+    size_t write(const char* data, size_t length) { return write((const uint8_t*) data, length); }
+    size_t write(const char* data) { return write((const uint8_t*) data, strlen(data)); }
+    void flush() override;
+
+    /// читать до terminator (он в строку не входит), затем вызвать done(true, str)
+    void readStringUntil(char terminator, String* str, AsyncTCPbufferDoneCb done);
+    /// прочитать length байт в buffer, затем вызвать done(true, buffer)
+    void readBytes(uint8_t* buffer, size_t length, AsyncTCPbufferDoneCb done);
+    void readBytes(char* buffer, size_t length, AsyncTCPbufferDoneCb done) { readBytes((uint8_t*) buffer, length, done); }
+
+    void onDisconnect(AsyncTCPbufferDisconnectCb cb);
+
+    IPAddress remoteIP();
+    uint16_t remotePort();
+    bool connected();
+    void stop();
+    void close() { stop(); }
+
+private:
+    typedef enum
+    {
+        RXFree,
+        RXString,
+        RXBytes
+    } RXMode;
+
+    AsyncClient* client;
+    std::vector<uint8_t> tx;            ///< данные, которые TCP еще не принял
+    std::deque<uint8_t> rx;             ///< принятые данные, которые еще никто не запросил
+    RXMode mode = RXFree;
+    char terminator = 0;
+    String* string = NULL;
+    uint8_t* bytes = NULL;
+    size_t wanted = 0;
+    size_t received = 0;
+    AsyncTCPbufferDoneCb done;
+    AsyncTCPbufferDisconnectCb disconnectCb;
+    bool handling = false;              ///< handleRx() уже выполняется (done может запросить следующее чтение)
+    bool* destroyed = NULL;             ///< флаг выполняющегося handleRx(), объект удален из done
+
+    void sendBuffer();
+    void handleRx();
+    void disconnected();
+};
+
+#endif /* HOST_ESPASYNCTCPBUFFER_H */
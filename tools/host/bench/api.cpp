@@ -0,0 +1,139 @@
+// Замер HTTP API скетча SmartLED.ino (GET /api/state, POST /api/mode, PATCH /api/options): скетч собирается
+// на компьютере, каждый запрос - отдельное соединение с веб-сервером-заглушкой, loop() проходится, пока сервер
+// не закроет его. Печатаются запросов в секунду по времени компьютера (с проходами loop() и кадрами режима) и
+// длина ответа. После BENCH_WARMUP запросов занятая куча (heapBytes) не должна расти за BENCH_REQUESTS
+// запросов, а запись состояния в JsonWriter не должна вызывать malloc вовсе (String не собирается). Рост кучи,
+// вызов malloc или ответ не 200 - код выхода 1. Без санитайзеров, кучу считает heapcount.cpp.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <chrono>
+#include <string>
+#include "../heapcount.h"
+
+#define BENCH_WARMUP 100                ///< запросов до первого отсчета кучи
+#define BENCH_REQUESTS 2000             ///< запросов для замера, четное: POST /api/mode возвращает режим
+#define BENCH_PASSES 100                ///< предел проходов loop() на один запрос
+#define BENCH_LINK_RATE 1000            ///< скорость канала клиента, байт/мс
+
+extern SmartLED* smart;
+void setup();
+void loop();
+
+typedef struct
+{
+    const char* name;
+    std::string (*request)(unsigned i);
+} Endpoint;
+
+static std::string withBody(const char* head, const std::string& body)
+{
+    return std::string(head) + "Host: room.local\r\nContent-Type: application/json\r\nContent-Length: " +
+           std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+static std::string getState(unsigned)
+{
+    return "GET /api/state HTTP/1.1\r\nHost: room.local\r\n\r\n";
+}
+
+/// режимы чередуются, после четного числа запросов выбран тот же режим
+static std::string postMode(unsigned i)
+{
+    return withBody("POST /api/mode HTTP/1.1\r\n", (i & 1) ? "{\"mode\":\"rainbow\"}" : "{\"mode\":\"plasma\"}");
+}
+
+static std::string patchOptions(unsigned i)
+{
+    return withBody("PATCH /api/options HTTP/1.1\r\n", "{\"speed\":" + std::to_string(20 + i % 70) + ",\"palette\":1}");
+}
+
+/**
+ * Один запрос
+ * @return длина ответа, 0 - ответ не 200 или соединение не закрыто
+ */
+static size_t request(const std::string& text)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect(80);
+    socket->rate = BENCH_LINK_RATE;
+    socket->rx.assign(text.begin(), text.end());
+    for (int i = 0; i < BENCH_PASSES; i++)
+    {
+        loop();
+        if (socket.use_count() == 1)
+        {
+            static const char ok[] = "HTTP/1.1 200";
+            bool success = (socket->tx.size() > sizeof(ok)) && std::equal(ok, ok + sizeof(ok) - 1, socket->tx.begin());
+            return success ? socket->tx.size() : 0;
+        }
+    }
+    return 0;
+}
+
+/// Print без выделений памяти: только считает байты
+struct Counter : public Print
+{
+    size_t bytes = 0;
+    size_t write(uint8_t) override { bytes++; return 1; }
+    size_t write(const uint8_t*, size_t size) override { bytes += size; return size; }
+};
+
+int main()
+{
+    static const Endpoint endpoints[] = {
+        {"GET /api/state", getState}, {"POST /api/mode", postMode}, {"PATCH /api/options", patchOptions}};
+    if (!heapCountWorks())
+    {
+        fprintf(stderr, "malloc is not intercepted\n");
+        return 2;
+    }
+    hostDataDir = SKETCH_DATA;
+    setup();
+    smart->selectMode("rainbow");
+
+    int result = 0;
+    printf("%s\n%-20s %10s %14s %14s %16s\n", BENCH_BUILD, "endpoint", "requests", "requests/s", "response", "heap per request");
+    for (const Endpoint& endpoint : endpoints)
+    {
+        for (unsigned i = 0; i < BENCH_WARMUP; i++)
+            request(endpoint.request(i));
+        long heapBefore = heapBytes;
+        size_t response = 0;
+        unsigned failed = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < BENCH_REQUESTS; i++)
+        {
+            size_t length = request(endpoint.request(i));
+            failed += !length;
+            response = std::max(response, length);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double growth = (double) (heapBytes - heapBefore) / BENCH_REQUESTS;
+        printf("%-20s %10u %14.0f %12zu B %14.2f B\n", endpoint.name, BENCH_REQUESTS, BENCH_REQUESTS / seconds, response, growth);
+        if (failed || (heapBytes > heapBefore))
+        {
+            fprintf(stderr, "FAIL: %s: %u failed requests, heap grew by %ld bytes\n", endpoint.name, failed,
+                    heapBytes - heapBefore);
+            result = 1;
+        }
+    }
+
+    /// сам ответ: проход подсчета длины и запись в сокет
+    Counter counter;
+    heapAllocs = 0;
+    heapCounting = true;
+    JsonWriter length(NULL);
+    smart->writeState(length);
+    JsonWriter json(&counter);
+    smart->writeState(json);
+    json.flush();
+    heapCounting = false;
+    printf("writeState: %zu bytes, Content-Length %zu, %lu malloc calls\n", counter.bytes, length.length(), heapAllocs);
+    if (heapAllocs || (counter.bytes != length.length()))
+    {
+        fprintf(stderr, "FAIL: the JSON state allocated or its length does not match Content-Length\n");
+        result = 1;
+    }
+    return result;
+}
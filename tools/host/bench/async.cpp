@@ -0,0 +1,321 @@
+// Замер событийного сервера вебсокетов (NETWORK_ESP8266_ASYNC) на переносе ESPAsyncTCP из async/: SmartLED
+// слушает 127.0.0.1, клиенты - настоящие сокеты в той же программе. Один проход loop() здесь - asyncPoll()
+// (обработчики TCP, на ESP их вызывает lwIP) и SmartLED::process() (очередь отложенных событий и кадр).
+//   - подключений в секунду: подключение, ответ 101, "Connected", закрытие и освобождение клиента сервером;
+//   - задержка сообщения: "$speed:10" -> "setOption done" на одном подключении, медиана, 99% и максимум;
+//   - медленный клиент: не читает, пока TCP не перестанет принимать данные, и шлет пачки команд, которые не
+//     помещаются в очередь событий (WEBSOCKET_QUEUE_SIZE). Сервер пропускает кадры (canQueue()), после чтения
+//     сообщает о пропуске (handleSendLimit(), WStype_DROPPED) и отправляет состояние целиком;
+//   - зависший клиент: не читает совсем, через WEBSOCKETS_SEND_STALL_TIMEOUT (виртуальное время) отключается.
+// Ни один проход не должен ждать клиента дольше BENCH_PASS_LIMIT, иначе программа завершается с кодом 1.
+//
+//   make -C tools/host bench          (make check запускает сборку с санитайзерами: build/check-async --quick)
+
+#include <smartled.h>
+#include <ESPAsyncTCP.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include "../wsclient.h"
+
+#if (WEBSOCKETS_NETWORK_TYPE != NETWORK_ESP8266_ASYNC)
+#error "bench/async.cpp builds with -Iasync only (make -C tools/host bench)"
+#endif
+
+#define BENCH_PIXELS 60
+#define BENCH_CONNECTIONS 2000          ///< подключений для замера (--quick: 50)
+#define BENCH_MESSAGES 20000            ///< сообщений для замера задержки (--quick: 200)
+#define BENCH_TIMEOUT 5.0               ///< секунд на ожидание ответа, дольше - ошибка
+#define BENCH_PASS_LIMIT 0.05           ///< секунд на один проход loop(): больше - сервер ждал клиента
+#define BENCH_RCVBUF 4096               ///< приемный буфер медленного клиента, чтобы TCP быстро перестал принимать
+
+typedef std::chrono::steady_clock Clock;
+
+static SmartLED* led;
+static std::string serial;              ///< вывод Serial программы
+static double worstPass = 0;            ///< самый долгий проход loop(), с
+
+/// проход loop(): события TCP и SmartLED::process()
+static void pass()
+{
+    Clock::time_point start = Clock::now();
+    asyncPoll(0);
+    led->process();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    if (seconds > worstPass)
+        worstPass = seconds;
+}
+
+static double since(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static size_t occurrences(const std::string& text, const char* what)
+{
+    size_t count = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1))
+        count++;
+    return count;
+}
+
+/// клиент на неблокирующем сокете: сервер и клиенты работают в одном потоке по очереди
+typedef struct
+{
+    int fd;
+    std::vector<uint8_t> rx;            ///< принятое и еще не разобранное
+    bool upgraded;                      ///< ответ 101 получен
+    bool closed;                        ///< сервер закрыл соединение
+} Peer;
+
+static bool clientOpen(Peer& client, int rcvbuf = 0)
+{
+    client.rx.clear();
+    client.upgraded = false;
+    client.closed = false;
+    client.fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (rcvbuf)
+        setsockopt(client.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    int value = 1;
+    setsockopt(client.fd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(asyncPort(81));
+    if (connect(client.fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+        return false;
+    fcntl(client.fd, F_SETFL, fcntl(client.fd, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+static void clientClose(Peer& client)
+{
+    close(client.fd);
+    client.fd = -1;
+}
+
+static bool clientSend(Peer& client, const std::string& data)
+{
+    Clock::time_point start = Clock::now();
+    for (size_t sent = 0; sent < data.size(); )
+    {
+        ssize_t length = send(client.fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (length > 0)
+            sent += length;
+        else if ((length < 0) && (errno == EAGAIN) && (since(start) < BENCH_TIMEOUT))
+            pass();
+        else
+            return false;
+    }
+    return true;
+}
+
+static void clientRead(Peer& client)
+{
+    uint8_t buffer[4096];
+    while (!client.closed)
+    {
+        ssize_t length = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (length > 0)
+            client.rx.insert(client.rx.end(), buffer, buffer + length);
+        else if ((length == 0) || (errno != EAGAIN))
+            client.closed = true;
+        else
+            break;
+    }
+}
+
+/// следующее текстовое сообщение сервера из принятого (кадры без маски и сжатия)
+static bool clientMessage(Peer& client, std::string& message)
+{
+    if (!client.upgraded)
+    {
+        static const char end[] = "\r\n\r\n";
+        std::vector<uint8_t>::iterator header = std::search(client.rx.begin(), client.rx.end(), end, end + 4);
+        if (header == client.rx.end())
+            return false;
+        client.rx.erase(client.rx.begin(), header + 4);
+        client.upgraded = true;
+    }
+    while (client.rx.size() >= 2)
+    {
+        size_t length = client.rx[1] & 0x7F;
+        size_t start = 2;
+        if (length == 126)
+        {
+            if (client.rx.size() < 4)
+                return false;
+            length = (client.rx[2] << 8) | client.rx[3];
+            start = 4;
+        }
+        if (client.rx.size() < start + length)
+            return false;
+        bool text = (client.rx[0] & 0x0F) == 0x01;
+        if (text)
+            message.assign(client.rx.begin() + start, client.rx.begin() + start + length);
+        client.rx.erase(client.rx.begin(), client.rx.begin() + start + length);
+        if (text)
+            return true;
+    }
+    return false;
+}
+
+/// проходы loop(), пока сервер не пришлет сообщение, начинающееся с prefix
+static bool waitMessage(Peer& client, const char* prefix)
+{
+    Clock::time_point start = Clock::now();
+    std::string message;
+    while (since(start) < BENCH_TIMEOUT)
+    {
+        pass();
+        clientRead(client);
+        while (clientMessage(client, message))
+            if (message.compare(0, strlen(prefix), prefix) == 0)
+                return true;
+        if (client.closed)
+            return false;
+    }
+    return false;
+}
+
+/// проходы loop(), пока программа не выведет text в Serial; вывод до него отбрасывается
+static bool waitSerial(const char* text)
+{
+    Clock::time_point start = Clock::now();
+    size_t at;
+    while ((at = serial.find(text)) == std::string::npos)
+    {
+        if (since(start) >= BENCH_TIMEOUT)
+            return false;
+        pass();
+    }
+    serial.erase(0, at + strlen(text));
+    return true;
+}
+
+/// проходы loop(), пока клиент не прочитает все, что успел отправить сервер
+static void drain(Peer& client)
+{
+    Clock::time_point last = Clock::now();
+    while (since(last) < 0.05)
+    {
+        size_t before = client.rx.size();
+        pass();
+        clientRead(client);
+        if (client.rx.size() != before)
+            last = Clock::now();
+        std::string message;
+        while (clientMessage(client, message))
+            ;
+    }
+}
+
+static int fail(const char* what)
+{
+    fprintf(stderr, "FAIL: %s\n", what);
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    bool quick = (argc > 1) && (strcmp(argv[1], "--quick") == 0);
+    int connections = quick ? 50 : BENCH_CONNECTIONS;
+    int messages = quick ? 200 : BENCH_MESSAGES;
+    hostSerialLog = &serial;
+    SmartLED smart(BENCH_PIXELS, 2, NEO_GRB, false);
+    led = &smart;
+    if (!asyncPort(81))
+        return fail("async server does not listen");
+
+    /// подключений в секунду
+    Peer client = {};
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < connections; i++)
+    {
+        if (!clientOpen(client) || !clientSend(client, wsUpgradeRequest(false)) || !waitMessage(client, "Connected"))
+            return fail("client not connected");
+        clientClose(client);
+        if (!waitSerial("Disconnected!"))
+            return fail("server did not release the client");
+    }
+    double seconds = since(start);
+    printf("connections   %8d %10.0f conn/s %8.1f us/conn\n", connections, connections / seconds, seconds * 1e6 / connections);
+
+    /// задержка сообщения
+    if (!clientOpen(client) || !clientSend(client, wsUpgradeRequest(false)) || !waitMessage(client, "Connected"))
+        return fail("client not connected");
+    drain(client);
+    std::vector<double> latency;
+    std::string command = wsClientFrame(0x01, "$speed:10");
+    for (int i = 0; i < messages; i++)
+    {
+        Clock::time_point sent = Clock::now();
+        if (!clientSend(client, command) || !waitMessage(client, "setOption done"))
+            return fail("no reply to a command");
+        latency.push_back(since(sent) * 1e6);
+        serial.clear();
+    }
+    clientClose(client);
+    std::sort(latency.begin(), latency.end());
+    printf("latency       %8d %8.1f us p50 %8.1f us p99 %8.1f us max\n", messages,
+           latency[latency.size() / 2], latency[latency.size() * 99 / 100], latency.back());
+
+    /// медленный клиент: пачки команд без чтения, пока сервер не начнет пропускать кадры
+    if (!clientOpen(client, BENCH_RCVBUF) || !clientSend(client, wsUpgradeRequest(false)) || !waitMessage(client, "Connected"))
+        return fail("slow client not connected");
+    std::string burst;
+    for (int i = 0; i < 4 * WEBSOCKET_QUEUE_SIZE; i++)
+        burst += command;
+    serial.clear();
+    worstPass = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        if (!clientSend(client, burst))
+            return fail("slow client can not send");
+        for (int p = 0; p < 10; p++)
+            pass();
+    }
+    size_t resyncs = occurrences(serial, "Command queue overflow");
+    size_t dropped = occurrences(serial, "frame dropped");
+    if (!resyncs)
+        return fail("command burst did not overflow the event queue");
+    if (!dropped)
+        return fail("no frames dropped for the slow client");
+    double stalledPass = worstPass;
+    /// клиент читает снова: следующая отправка сообщает о пропущенных кадрах, и сервер отправляет состояние целиком
+    serial.clear();
+    drain(client);
+    if (!clientSend(client, command) || !waitSerial("Send queue overflow, resync") || !waitMessage(client, "setOption done"))
+        return fail("dropped frames not reported to the slow client");
+    clientClose(client);
+    if (!waitSerial("Disconnected!"))
+        return fail("server did not release the slow client");
+    printf("slow client   %8zu resyncs %5zu frames dropped, worst pass %.2f ms\n", resyncs, dropped, stalledPass * 1e3);
+
+    /// зависший клиент: не читает, после WEBSOCKETS_SEND_STALL_TIMEOUT следующая отправка его отключает
+    if (!clientOpen(client, BENCH_RCVBUF) || !clientSend(client, wsUpgradeRequest(false)) || !waitMessage(client, "Connected"))
+        return fail("stalled client not connected");
+    serial.clear();
+    for (int i = 0; i < 64; i++)
+    {
+        clientSend(client, burst);
+        pass();
+    }
+    if (serial.find("Disconnected!") != std::string::npos)
+        return fail("stalled client disconnected before the timeout");
+    hostAdvance((WEBSOCKETS_SEND_STALL_TIMEOUT + 1) * 1000UL);
+    clientSend(client, command);
+    if (!waitSerial("Disconnected!"))
+        return fail("stalled client not disconnected after WEBSOCKETS_SEND_STALL_TIMEOUT");
+    clientClose(client);
+    printf("stalled client disconnected after %d ms, worst pass %.2f ms\n", WEBSOCKETS_SEND_STALL_TIMEOUT, worstPass * 1e3);
+
+    if ((stalledPass > BENCH_PASS_LIMIT) || (worstPass > BENCH_PASS_LIMIT))
+        return fail("a loop() pass waited for a client");
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Замер анализа звука (AudioAnalyzer) и ввод звука из WAV через push().
+//   build/bench-audio            - время fft() для окон 256 и 512 отсчетов и analyze() для AUDIO_FFT_SIZE на
+//                                  сигнале с тоном и ударами, проверка capture() по виртуальному времени: вызов
+//                                  не дольше AUDIO_CAPTURE_BUDGET и периода отсчета, окна копятся из проходов loop()
+//   build/bench-audio file.wav   - полосы, уровень и удары по файлу: PCM 16 бит, любая частота (приводится к
+//                                  AUDIO_SAMPLE_RATE), каналы смешиваются. Строка на каждый анализ: время, уровень,
+//                                  удар (*) и полосы по 0..f
+//
+//   make -C tools/host bench
+
+#include <audio.h>
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#define BENCH_MIN_TIME 0.05             ///< сколько секунд замерять каждый размер
+#define BENCH_LOOP_REST 3000            ///< остальная часть прохода loop(), мкс
+#define BENCH_ADC_SCALE 6               ///< сдвиг 16-битного отсчета к размаху АЦП ESP8266 (10 бит)
+
+/// тон 440 Гц и удары 60 Гц по 50 мс дважды в секунду, в размахе АЦП
+static int16_t signal(uint32_t n)
+{
+    double t = (double) n / AUDIO_SAMPLE_RATE;
+    double value = 120 * sin(2 * M_PI * 440 * t);
+    if (fmod(t, 0.5) < 0.05)
+        value += 350 * sin(2 * M_PI * 60 * t);
+    return (int16_t) value;
+}
+
+/// мкс на вызов fft() для окна 1 << log2n
+static double fftTime(uint8_t log2n)
+{
+    uint16_t n = 1 << log2n;
+    std::vector<int16_t> source(n), re(n), im(n);
+    for (uint16_t i = 0; i < n; i++)
+        source[i] = signal(i) * 16;
+    unsigned long runs = 0;
+    double seconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            re = source;
+            std::fill(im.begin(), im.end(), 0);
+            AudioAnalyzer::fft(re.data(), im.data(), log2n);
+        }
+        runs += 100;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < BENCH_MIN_TIME);
+    return seconds * 1e6 / runs;
+}
+
+/// мкс на analyze() с новым окном
+static double analyzeTime(AudioAnalyzer& audio)
+{
+    std::vector<int16_t> window(AUDIO_FFT_SIZE);
+    unsigned long runs = 0;
+    uint32_t n = 0;
+    double seconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+        {
+            for (int16_t& sample : window)
+                sample = signal(n++);
+            audio.push(window.data(), window.size());
+            if (!audio.analyze())
+                return -1;
+        }
+        runs += 100;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < BENCH_MIN_TIME);
+    return seconds * 1e6 / runs;
+}
+
+/// проходы loop() с capture(): ни один вызов не длиннее бюджета и периода отсчета, окна анализируются
+static int checkCapture()
+{
+    AudioAnalyzer audio;
+    uint32_t period = 1000000UL / AUDIO_SAMPLE_RATE;
+    uint32_t longest = 0;
+    int windows = 0;
+    int passes = 0;
+    for (; passes < 1000; passes++)
+    {
+        uint32_t start = micros();
+        audio.capture();
+        uint32_t spent = micros() - start;
+        if (spent > longest)
+            longest = spent;
+        if (audio.analyze())
+            windows++;
+        hostAdvance(BENCH_LOOP_REST);
+    }
+    printf("capture() %d passes: longest %u us (budget %u us), %d windows analysed, %u gaps\n",
+           passes, longest, AUDIO_CAPTURE_BUDGET, windows, audio.gaps);
+    if (longest > AUDIO_CAPTURE_BUDGET + period + 10)
+    {
+        fprintf(stderr, "FAIL: capture() took %u us, more than AUDIO_CAPTURE_BUDGET\n", longest);
+        return 1;
+    }
+    /// за проход снимается AUDIO_CAPTURE_BUDGET мкс из AUDIO_CAPTURE_BUDGET + BENCH_LOOP_REST
+    int expected = (int) ((uint64_t) passes * AUDIO_CAPTURE_BUDGET * AUDIO_SAMPLE_RATE / 1000000UL / AUDIO_FFT_SIZE);
+    if (windows < expected - 1)
+    {
+        fprintf(stderr, "FAIL: %d windows analysed, expected %d\n", windows, expected);
+        return 1;
+    }
+    return 0;
+}
+
+static uint32_t le(const uint8_t* p, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--)
+        value = (value << 8) | p[i];
+    return value;
+}
+
+/// полосы по WAV-файлу
+static int replayWav(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        perror(path);
+        return 2;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + length);
+    fclose(file);
+    if ((data.size() < 12) || memcmp(data.data(), "RIFF", 4) || memcmp(data.data() + 8, "WAVE", 4))
+    {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        return 2;
+    }
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    const uint8_t* pcm = NULL;
+    size_t pcmLength = 0;
+    for (size_t at = 12; at + 8 <= data.size(); )
+    {
+        uint32_t size = le(&data[at + 4], 4);
+        const uint8_t* chunk = &data[at + 8];
+        size_t available = std::min((size_t) size, data.size() - at - 8);
+        if (!memcmp(&data[at], "fmt ", 4) && (available >= 16))
+        {
+            format = le(chunk, 2);
+            channels = le(chunk + 2, 2);
+            rate = le(chunk + 4, 4);
+            bits = le(chunk + 14, 2);
+        } else if (!memcmp(&data[at], "data", 4))
+        {
+            pcm = chunk;
+            pcmLength = available;
+        }
+        at += 8 + size + (size & 1);
+    }
+    if ((format != 1) || (bits != 16) || !channels || !rate || !pcm)
+    {
+        fprintf(stderr, "%s: only 16-bit PCM is supported\n", path);
+        return 2;
+    }
+    size_t frames = pcmLength / (2 * channels);
+    AudioAnalyzer audio;
+    std::vector<int16_t> chunk;
+    uint32_t pushed = 0;
+    for (double position = 0; position < frames; position += (double) rate / AUDIO_SAMPLE_RATE)
+    {
+        const uint8_t* frame = pcm + (size_t) position * 2 * channels;
+        int32_t sum = 0;
+        for (uint16_t c = 0; c < channels; c++)
+            sum += (int16_t) le(frame + 2 * c, 2);
+        chunk.push_back((int16_t) ((sum / channels) >> BENCH_ADC_SCALE));
+        if (chunk.size() < AUDIO_FFT_SIZE / 4)
+            continue;
+        audio.push(chunk.data(), chunk.size());
+        pushed += chunk.size();
+        chunk.clear();
+        if (!audio.analyze())
+            continue;
+        printf("%8.3f %3u %c ", (double) pushed / AUDIO_SAMPLE_RATE, audio.level, audio.beat ? '*' : ' ');
+        for (int b = 0; b < AUDIO_BANDS; b++)
+            putchar("0123456789abcdef"[audio.band[b] >> 4]);
+        putchar('\n');
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+        return replayWav(argv[1]);
+    AudioAnalyzer audio;
+    double analyze = analyzeTime(audio);
+    if (analyze < 0)
+    {
+        fprintf(stderr, "FAIL: analyze() did not run on a full window\n");
+        return 1;
+    }
+    printf("fft() 256 samples %8.2f us\n", fftTime(8));
+    printf("fft() 512 samples %8.2f us\n", fftTime(9));
+    printf("analyze() %d samples %8.2f us (window %.0f ms)\n", AUDIO_FFT_SIZE, analyze, AUDIO_FFT_SIZE * 1000.0 / AUDIO_SAMPLE_RATE);
+    return checkCapture();
+}
@@ -0,0 +1,113 @@
+// Замер приема DDP: генератор нагрузки (DdpSender, как у ведущего распределенного вывода) отправляет кадры
+// случайных цветов подряд, без пауз, приемнику - SmartLED в режиме dmx на другом адресе, пакеты идут по UDP
+// внутри программы. Кадр считается доставленным, когда приемник вывел его в ленту (espShow заглушки) и хеш
+// пикселей совпал с отправленным. Печатаются пикселей в секунду и задержка от начала отправки кадра до вывода
+// в ленту по времени компьютера, а также счетчики приемника. Несовпавший или не показанный кадр - код выхода 1.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#define BENCH_MIN_TIME 0.2              ///< сколько секунд замерять каждую длину ленты
+
+/// хеш пикселей так, как их выводит espShow ленты NEO_GRB
+static uint32_t grbDigest(const std::vector<uint8_t>& rgb)
+{
+    uint32_t digest = 2166136261u;
+    for (size_t i = 0; i < rgb.size(); i += 3)
+    {
+        const uint8_t grb[3] = {rgb[i + 1], rgb[i], rgb[i + 2]};
+        for (uint8_t c : grb)
+            digest = (digest ^ c) * 16777619u;
+    }
+    return digest;
+}
+
+/// значение счетчика секции dmx из состояния SmartLED
+static long dmxCounter(SmartLED& led, const char* name)
+{
+    struct Text : public Print
+    {
+        std::string text;
+        size_t write(uint8_t c) override { text += (char) c; return 1; }
+        using Print::write;
+    } text;
+    JsonWriter json(&text);
+    led.writeState(json);
+    json.flush();
+    size_t at = text.text.find("\"dmx\"");
+    at = (at == std::string::npos) ? at : text.text.find(std::string("\"") + name + "\":", at);
+    return (at == std::string::npos) ? -1 : strtol(text.text.c_str() + at + strlen(name) + 3, NULL, 10);
+}
+
+int main()
+{
+    /// 170 - один универс sACN; до 31 пакета данных на кадр (очередь сокета HOST_UDP_QUEUE)
+    static const uint16_t lengths[] = {170, 480, 1500, 4800, 14400};
+    HostDevice generator = {IPAddress(192, 168, 1, 10), 0, 0};
+    HostDevice receiver = {IPAddress(192, 168, 1, 51), 0, 0};
+    std::minstd_rand random;
+    int result = 0;
+    printf("%s\n%6s %8s %14s %12s %12s %8s %8s %8s\n", BENCH_BUILD, "pixels", "packets", "pixels/s", "latency p50",
+           "latency max", "frames", "dropped", "late");
+    for (uint16_t pixels : lengths)
+    {
+        hostDevice = &receiver;
+        SmartLED led(pixels, 2, NEO_GRB, false);
+        led.selectMode("dmx");
+        hostDevice = &generator;
+        DdpSender sender;
+        RelayTarget target = {receiver.ip, pixels, 0};
+        hostDevice = NULL;
+
+        std::vector<uint8_t> frame(pixels * 3);
+        std::vector<HostShow> shows;
+        std::vector<double> latencies;
+        double busy = 0;
+        uint32_t frames = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < BENCH_MIN_TIME)
+        {
+            for (uint8_t& value : frame)
+                value = random();
+            frames++;
+            shows.clear();
+            auto sent = std::chrono::steady_clock::now();
+            hostDevice = &generator;
+            sender.send(target, frame.data(), frames);
+            sender.push(&target, 1, frames);
+            hostDevice = &receiver;
+            hostShows = &shows;
+            led.process();
+            hostShows = NULL;
+            hostDevice = NULL;
+            auto shown = std::chrono::steady_clock::now();
+            double latency = std::chrono::duration<double>(shown - sent).count();
+            busy += latency;
+            latencies.push_back(latency * 1e6);
+            if (shows.empty() || (shows.back().digest != grbDigest(frame)))
+            {
+                fprintf(stderr, "FAIL: %u pixels: frame %u was not shown as sent\n", pixels, frames);
+                result = 1;
+                break;
+            }
+            /// виртуальное время идет, как между кадрами на ESP, иначе приемник счел бы источник пропавшим
+            hostAdvance(20000);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        hostDevice = &receiver;
+        printf("%6u %8u %14.0f %9.1f us %9.1f us %8u %8ld %8ld\n", pixels, sender.packets / sender.frames,
+               frames * (double) pixels / busy, latencies[latencies.size() / 2], latencies.back(), frames,
+               dmxCounter(led, "dropped"), dmxCounter(led, "late"));
+        if (dmxCounter(led, "dropped") || dmxCounter(led, "late") || (dmxCounter(led, "frames") != (long) frames))
+        {
+            fprintf(stderr, "FAIL: %u pixels: the receiver counted dropped or late packets\n", pixels);
+            result = 1;
+        }
+        hostDevice = NULL;
+    }
+    return result;
+}
@@ -0,0 +1,137 @@
+// Замер сжатия permessage-deflate (ws_deflate) на сообщениях SmartLED для выбора порога
+// WEBSOCKETS_DEFLATE_MIN_SIZE. Сообщения снимаются с SmartLED на компьютере: состояние, которое получает
+// новый клиент (строки sendCurrentValues, склеенные через '\n', как при пакетной отправке), одно значение
+// ("rainbow:color3:0;0;0"), кадр-градиент плазмы команды "!" (frame:plasma:...) и строка контрольных сумм;
+// случайные байты - несжимаемый предел. Для каждого размера (начало сообщения) выводятся длина после сжатия,
+// степень сжатия и время процессора компьютера на 1 КБ: на ESP8266 оно в десятки раз больше, но соотношение
+// между размерами и видами сообщений сохраняется. "-" - сжатие не уменьшило сообщение, оно уйдет как есть.
+// Итог по каждому виду: с какого размера сжатие выгодно вообще и с какого экономит четверть.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <WebSocketsDeflate.h>
+#include <chrono>
+#include "../wsclient.h"
+
+#define BENCH_PIXELS 300                ///< длина ленты: кадр-градиент 1800 символов
+#define BENCH_MIN_TIME 0.02             ///< сколько секунд сжимать каждый размер
+
+typedef struct
+{
+    const char* name;
+    std::string data;
+} Payload;
+
+/// сообщения, которые SmartLED отправляет клиенту, подключившемуся с командами commands
+static std::vector<std::string> capture(SmartLED& led, const std::vector<std::string>& commands)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect();
+    std::string request = wsUpgradeRequest(false);
+    for (const std::string& command : commands)
+        request += wsClientFrame(0x01, command);
+    socket->rx.assign(request.begin(), request.end());
+    std::vector<uint8_t> received;
+    for (int pass = 0; pass < 200; pass++)
+    {
+        led.process();
+        received.insert(received.end(), socket->tx.begin(), socket->tx.end());
+        socket->tx.clear();
+        socket->room = 2920;
+        hostAdvance(1000);
+    }
+    socket->open = false;
+    for (int pass = 0; (pass < 10000) && (socket.use_count() > 1); pass++)
+    {
+        led.process();
+        hostAdvance(1000);
+    }
+    return wsServerMessages(received);
+}
+
+static std::string find(const std::vector<std::string>& messages, const char* prefix)
+{
+    for (const std::string& message : messages)
+        if (message.compare(0, strlen(prefix), prefix) == 0)
+            return message;
+    return std::string();
+}
+
+/// мкс на 1 КБ исходных данных
+static double deflateTime(const std::string& data, size_t length, std::vector<uint8_t>& out)
+{
+    unsigned long runs = 0;
+    double seconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (int i = 0; i < 100; i++)
+            ws_deflate((const uint8_t*) data.data(), length, out.data(), length - 1);
+        runs += 100;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < BENCH_MIN_TIME);
+    return seconds * 1e6 / runs * 1024 / length;
+}
+
+int main()
+{
+    SmartLED led(BENCH_PIXELS, 2, NEO_GRB, false);
+    std::vector<std::string> connected = capture(led, {});
+    std::vector<std::string> dump = capture(led, {"!8:plasma:5"});
+    std::string state;
+    for (const std::string& message : connected)
+        if (message.find(':') != std::string::npos)
+            state += (state.empty() ? "" : "\n") + message;
+    std::string random;
+    randomSeed(DIGEST_SEED);
+    for (size_t i = 0; i < 2048; i++)
+        random += (char) ::random(256);
+    const Payload payloads[] = {
+        {"state", state},
+        {"value", find(connected, "rainbow:color3:")},
+        {"frame", find(dump, "frame:")},
+        {"digest", find(dump, "digest:plasma:")},
+        {"random", random}
+    };
+    static const size_t sizes[] = {32, 64, 96, 128, 192, 256, 384, 512, 1024, 2048, 4096};
+    printf("%-7s %6s %10s %6s %8s\n", "message", "bytes", "deflated", "ratio", "us/KB");
+    for (const Payload& payload : payloads)
+    {
+        if (payload.data.empty())
+        {
+            fprintf(stderr, "%s: message not captured\n", payload.name);
+            return 2;
+        }
+        std::vector<uint8_t> out(payload.data.size());
+        size_t smallest = 0;            ///< первый размер, сжатие которого меньше исходного
+        size_t quarter = 0;             ///< первый размер, сжатый на четверть и больше
+        /// начала сообщения стандартных размеров и сообщение целиком
+        std::vector<size_t> lengths;
+        for (size_t size : sizes)
+            if (size < payload.data.size())
+                lengths.push_back(size);
+        lengths.push_back(payload.data.size());
+        for (size_t length : lengths)
+        {
+            size_t deflated = ws_deflate((const uint8_t*) payload.data.data(), length, out.data(), length - 1);
+            double cost = deflateTime(payload.data, length, out);
+            if (deflated)
+            {
+                printf("%-7s %6zu %10zu %6.2f %8.1f\n", payload.name, length, deflated, (double) deflated / length, cost);
+                if (!smallest)
+                    smallest = length;
+                if (!quarter && (deflated * 4 <= length * 3))
+                    quarter = length;
+            } else
+                printf("%-7s %6zu %10s %6s %8.1f\n", payload.name, length, "-", "-", cost);
+        }
+        if (quarter)
+            printf("%-7s smaller after deflate from %zu bytes, by a quarter from %zu bytes\n", payload.name, smallest, quarter);
+        else if (smallest)
+            printf("%-7s smaller after deflate from %zu bytes, never by a quarter\n", payload.name, smallest);
+        else
+            printf("%-7s never smaller after deflate\n", payload.name);
+    }
+    printf("WEBSOCKETS_DEFLATE_MIN_SIZE = %d\n", WEBSOCKETS_DEFLATE_MIN_SIZE);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Замер подключения к WebSocketsServer: сколько запросов на подключение в секунду разбирает сервер
+// (реальное время компьютера, не ESP) и сколько раз за подключение вызывается malloc. Собирается без
+// санитайзеров (они перехватывают malloc сами), вызовы malloc считает heapcount.cpp. Буфер ответа fake TCP
+// резервируется заранее, поэтому учитываются только выделения сервера.
+// Разбор запроса и ответ должны обходиться без кучи: блоки ws_malloc берутся из пулов (хиты пулов выводятся),
+// при ненулевом числе malloc на подключение замер завершается с кодом 1.
+//
+//   make -C tools/host bench
+
+#include <WebSocketsServer.h>
+#include <chrono>
+#include "../heapcount.h"
+#include "../wsclient.h"
+
+#define BENCH_HANDSHAKES 20000          ///< подключений на каждый запрос
+
+typedef struct
+{
+    const char* name;
+    std::string request;
+} Request;
+
+static bool connected;
+
+static void event(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
+{
+    (void) num;
+    (void) payload;
+    (void) length;
+    if (type == WStype_CONNECTED)
+        connected = true;
+}
+
+/// ответ сервера получен целиком (за ним могут идти кадры)
+static bool responded(const HostSocket& socket)
+{
+    static const char end[] = "\r\n\r\n";
+    return std::search(socket.tx.begin(), socket.tx.end(), end, end + 4) != socket.tx.end();
+}
+
+int main()
+{
+    if (!heapCountWorks())
+    {
+        fprintf(stderr, "malloc is not intercepted\n");
+        return 2;
+    }
+    /// заголовки браузера длиннее строки разбора (WEBSOCKETS_HEADER_LINE_SIZE) и пропускаются
+    std::string browser =
+        "GET / HTTP/1.1\r\n"
+        "Host: 192.168.1.10:81\r\n"
+        "Connection: Upgrade\r\n"
+        "Pragma: no-cache\r\n"
+        "Cache-Control: no-cache\r\n"
+        "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Upgrade: websocket\r\n"
+        "Origin: http://192.168.1.10\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Accept-Language: ru-RU,ru;q=0.9,en-US;q=0.8,en;q=0.7\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+        "Sec-WebSocket-Protocol: arduino\r\n"
+        "\r\n";
+    const Request requests[] = {
+        {"minimal", wsUpgradeRequest(false)},
+        {"deflate", wsUpgradeRequest(true)},
+        {"browser", browser}
+    };
+    WebSocketsServer server(81, "", "arduino");
+    server.enableDeflate();
+    server.begin();
+    server.onEvent(event);
+    int result = 0;
+    printf("%-8s %7s %12s %12s %10s %10s\n", "request", "bytes", "handshakes/s", "us/handshake", "malloc", "pool hits");
+    for (const Request& request : requests)
+    {
+        unsigned long allocs = 0;
+        uint32_t hits = 0, misses = 0;
+        double seconds = 0;
+        for (int i = 0; i < BENCH_HANDSHAKES; i++)
+        {
+            std::shared_ptr<HostSocket> socket = hostConnect();
+            socket->rx.assign(request.request.begin(), request.request.end());
+            socket->tx.reserve(1024);
+            uint32_t poolHits = 0, poolMisses = 0;
+            for (uint8_t p = 0; p < WEBSOCKETS_POOL_COUNT; p++)
+            {
+                poolHits -= ws_poolStats(p).hits;
+                poolMisses -= ws_poolStats(p).misses;
+            }
+            connected = false;
+            heapAllocs = 0;
+            auto start = std::chrono::steady_clock::now();
+            heapCounting = true;
+            for (int pass = 0; (pass < 100) && !(connected && responded(*socket)); pass++)
+                server.loop();
+            heapCounting = false;
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!connected || !responded(*socket))
+            {
+                fprintf(stderr, "%s: no handshake response\n", request.name);
+                return 2;
+            }
+            for (uint8_t p = 0; p < WEBSOCKETS_POOL_COUNT; p++)
+            {
+                poolHits += ws_poolStats(p).hits;
+                poolMisses += ws_poolStats(p).misses;
+            }
+            allocs += heapAllocs;
+            hits += poolHits;
+            misses += poolMisses;
+            /// отключение клиента в замер не входит
+            socket->open = false;
+            for (int pass = 0; (pass < 10000) && (socket.use_count() > 1); pass++)
+            {
+                server.loop();
+                hostAdvance(1000);
+            }
+            if (socket.use_count() > 1)
+            {
+                fprintf(stderr, "%s: the server keeps a closed connection\n", request.name);
+                return 2;
+            }
+        }
+        printf("%-8s %7zu %12.0f %12.2f %10.2f %10.2f\n", request.name, request.request.size(), BENCH_HANDSHAKES / seconds,
+               seconds * 1e6 / BENCH_HANDSHAKES, (double) allocs / BENCH_HANDSHAKES, (double) hits / BENCH_HANDSHAKES);
+        if (allocs || misses)
+        {
+            fprintf(stderr, "%s: %lu heap allocations, %u pool misses in %d handshakes\n", request.name, allocs, misses, BENCH_HANDSHAKES);
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,121 @@
+// Замер генератора эффектов FastRandom (prng.h) против прежнего random() Arduino (в заглушке, как в newlib:
+// линейный конгруэнтный генератор и остаток от деления): время на вызов для границ, которые используют эффекты
+// (направление, процент, компонента цвета, позиция на ленте, шаг змейки), chance() и заполнение буфера.
+// Граница читается из volatile, чтобы компилятор не заменил деление умножением, как не может и ESP8266
+// без аппаратного деления. Перед замером проверяются равномерность range() (хи-квадрат по корзинам) и
+// повторяемость последовательности с одним зерном; нарушение или FastRandom медленнее random() - код выхода 1.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <chrono>
+#include <vector>
+
+#define BENCH_CALLS 20000000            ///< вызовов на каждый замер
+#define BENCH_BUCKETS 245               ///< корзин проверки равномерности (range(10, 255) цвета снежинки)
+#define BENCH_SAMPLES 2450000           ///< чисел для проверки равномерности
+/// хи-квадрат для 244 степеней свободы с уровнем значимости около 0,001
+#define BENCH_CHI_LIMIT 320.0
+
+static volatile uint32_t sink;
+
+/**
+ * Время одного вызова
+ * @param call замеряемый вызов
+ * @param size сколько чисел дает один вызов: время делится на них, вызовов в size раз меньше
+ */
+template<typename F> static double nsPerCall(F call, size_t size = 1)
+{
+    uint32_t sum = 0;
+    int calls = BENCH_CALLS / size;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; i++)
+        sum += call();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sink = sum;
+    return seconds * 1e9 / calls / size;
+}
+
+static bool uniform()
+{
+    FastRandom rng(12345);
+    std::vector<uint32_t> buckets(BENCH_BUCKETS);
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+        buckets[rng.range(10, 10 + BENCH_BUCKETS) - 10]++;
+    double expected = (double) BENCH_SAMPLES / BENCH_BUCKETS;
+    double chi = 0;
+    for (uint32_t count : buckets)
+        chi += (count - expected) * (count - expected) / expected;
+    printf("prng: range(10, 255) chi-square %.1f over %d buckets (limit %.0f)\n", chi, BENCH_BUCKETS, BENCH_CHI_LIMIT);
+    return chi < BENCH_CHI_LIMIT;
+}
+
+static bool replayable()
+{
+    FastRandom a(777);
+    FastRandom b(1);
+    b.seed(777);
+    uint8_t bytesA[61];
+    uint8_t bytesB[61];
+    for (int i = 0; i < 1000; i++)
+        if (a.range(-5, 300) != b.range(-5, 300))
+            return false;
+    a.fill(bytesA, sizeof(bytesA));
+    b.fill(bytesB, sizeof(bytesB));
+    return memcmp(bytesA, bytesB, sizeof(bytesA)) == 0;
+}
+
+int main()
+{
+    static const int32_t bounds[] = {2, 100, 245, 300, 5000};
+    static volatile int32_t bound;
+    int result = 0;
+    printf("%s\n", BENCH_BUILD);
+    if (!uniform() || !replayable())
+    {
+        fprintf(stderr, "FAIL: range() is not uniform or the sequence does not repeat with the same seed\n");
+        return 1;
+    }
+    printf("%-22s %14s %14s %8s\n", "call", "random() ns", "FastRandom ns", "ratio");
+    FastRandom rng(1);
+    randomSeed(1);
+    for (int32_t value : bounds)
+    {
+        bound = value;
+        double before = nsPerCall([&]() { return (uint32_t) random(bound); });
+        double after = nsPerCall([&]() { return (uint32_t) rng.range(bound); });
+        char name[32];
+        snprintf(name, sizeof(name), "range(%d)", value);
+        printf("%-22s %14.2f %14.2f %7.1fx\n", name, before, after, before / after);
+        if (after >= before)
+            result = 1;
+    }
+    bound = 100;
+    double before = nsPerCall([&]() { return (uint32_t) (random(bound) < 2); });
+    double after = nsPerCall([&]() { return (uint32_t) rng.chance(2); });
+    printf("%-22s %14.2f %14.2f %7.1fx\n", "chance(2)", before, after, before / after);
+    result |= after >= before;
+
+    /// байты цвета: random(10, 255) на каждый против fill() диапазона и fill() без диапазона
+    uint8_t colors[300 * 3];
+    bound = 255;
+    before = nsPerCall([&]() {
+        for (uint8_t& c : colors)
+            c = random(10, bound);
+        return (uint32_t) colors[0];
+    }, sizeof(colors));
+    after = nsPerCall([&]() {
+        rng.fill(colors, sizeof(colors), 10, bound);
+        return (uint32_t) colors[0];
+    }, sizeof(colors));
+    printf("%-22s %14.2f %14.2f %7.1fx\n", "fill 10..254 per byte", before, after, before / after);
+    result |= after >= before;
+    double raw = nsPerCall([&]() {
+        rng.fill(colors, sizeof(colors));
+        return (uint32_t) colors[0];
+    }, sizeof(colors));
+    printf("%-22s %14s %14.2f\n", "fill raw per byte", "-", raw);
+    if (result)
+        fprintf(stderr, "FAIL: FastRandom is not faster than random()\n");
+    return result;
+}
@@ -0,0 +1,93 @@
+// Замер затрат профилировщика (LoopProfiler): скетч SmartLED.ino собирается на компьютере и рисует радугу,
+// loop() проходится BENCH_PASSES раз. Количество пар begin()/end() на кадр (по счетчикам участков) от
+// платформы не зависит, из него и периода кадра получается бюджет пары в тактах ESP: BENCH_MAX_SHARE
+// процента кадра. Время пары измеряется на компьютере и переводится в такты ESP с запасом BENCH_ESP_FACTOR;
+// оценка больше бюджета - код выхода 1. Настоящие затраты на устройстве - overheadCycles в /stats.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <chrono>
+#include <vector>
+
+#define BENCH_PASSES 20000              ///< проходов loop() для замера
+#define BENCH_PAIRS 2000000             ///< пар begin()/end() для замера их времени
+#define BENCH_SPEED "80"                ///< скорость радуги: шаг около 21 мс
+#define BENCH_MAX_SHARE 1.0             ///< допустимая доля профилировщика в кадре, %
+/// во сколько раз ESP8266 на 80 МГц медленнее компьютера на этом коде (порядок и запас на промахи кэша флеш)
+#define BENCH_ESP_FACTOR 150
+
+extern SmartLED* smart;
+void setup();
+void loop();
+
+static void option(const char* name, const char* value)
+{
+    char optionName[16];
+    char optionValue[16];
+    strncpy(optionName, name, sizeof(optionName));
+    strncpy(optionValue, value, sizeof(optionValue));
+    smart->setOption(optionName, optionValue);
+}
+
+/// сумма счетчиков измерений всех участков из LoopProfiler::toJson
+static unsigned long measurements()
+{
+    char json[768];
+    profiler.toJson(json, sizeof(json));
+    unsigned long total = 0;
+    for (const char* at = strstr(json, "\"count\":"); at; at = strstr(at + 1, "\"count\":"))
+        total += strtoul(at + 8, NULL, 10);
+    return total;
+}
+
+int main()
+{
+    hostDataDir = SKETCH_DATA;
+    setup();
+    smart->selectMode("rainbow");
+    option("speed", BENCH_SPEED);
+    /// своя палитра по умолчанию черная
+    option("palette", "1");
+    for (int i = 0; i < 500; i++)
+        loop();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_PAIRS; i++)
+        profiler.end(PPAutosave, profiler.begin());
+    double pairTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / BENCH_PAIRS;
+
+    profiler.reset();
+    std::vector<HostShow> shows;
+    hostShows = &shows;
+    for (int i = 0; i < BENCH_PASSES; i++)
+        loop();
+    hostShows = NULL;
+    unsigned long pairs = measurements();
+    if (shows.size() < 10)
+    {
+        fprintf(stderr, "FAIL: %zu frames\n", shows.size());
+        return 1;
+    }
+    std::vector<uint32_t> intervals;
+    for (size_t i = 1; i < shows.size(); i++)
+        intervals.push_back(shows[i].time - shows[i - 1].time);
+    std::sort(intervals.begin(), intervals.end());
+    uint32_t frame = intervals[intervals.size() / 2];
+
+    double pairsPerFrame = (double) pairs / shows.size();
+    double espPair = pairTime * BENCH_ESP_FACTOR * ESP.getCpuFreqMHz() * 1e6;
+    double budget = frame * ESP.getCpuFreqMHz() * BENCH_MAX_SHARE / 100 / pairsPerFrame;
+    printf("%s\n", BENCH_BUILD);
+    printf("profiler: %.1f measurements per pass, %.1f per frame (%zu frames of %u us in %d passes)\n",
+           (double) pairs / BENCH_PASSES, pairsPerFrame, shows.size(), frame, BENCH_PASSES);
+    printf("profiler: %.1f ns per begin()/end() here, about %.0f ESP cycles; %.1f%% of a frame is %.0f cycles per pair\n",
+           pairTime * 1e9, espPair, BENCH_MAX_SHARE, budget);
+    printf("profiler: about %.3f%% of a frame on the ESP\n", espPair * pairsPerFrame * 100 / (frame * ESP.getCpuFreqMHz()));
+    if (espPair >= budget)
+    {
+        fprintf(stderr, "FAIL: a begin()/end() pair costs about %.0f ESP cycles, the budget is %.0f\n", espPair, budget);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Замер распределенного вывода: ведущий SmartLED считает радугу на виртуальную ленту (своя лента
+// BENCH_LOCAL пикселей и участки ведомых) и отправляет участки по DDP (beginRelay), ведомые - SmartLED в
+// режиме dmx со своими адресами и часами, пакеты идут по UDP внутри программы. Все проходят loop() по
+// BENCH_PASS мкс виртуального времени. Проверяется, что каждый кадр ведущего выведен каждым ведомым на том же
+// проходе (одновременное переключение по push), без потерянных и опоздавших пакетов. Печатаются
+// пикселей в секунду по всем ведомым (relay.pixelsPerSecond ведущего, виртуальное время), время прохода
+// ведущего и ведомого на кадр и суммарная скорость по времени компьютера.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#define BENCH_LOCAL 150                 ///< пикселей своей ленты ведущего
+#define BENCH_FOLLOWER 300              ///< пикселей каждого ведомого
+#define BENCH_TIME 5000                 ///< виртуальное время замера, мс
+#define BENCH_PASS 2000                 ///< проход loop(), мкс (delay(2) в SmartLED.ino)
+#define BENCH_SPEED "80"                ///< скорость радуги: шаг около 21 мс
+
+typedef struct
+{
+    HostDevice device;
+    std::unique_ptr<SmartLED> led;
+    std::vector<HostShow> shows;
+    double busy;                        ///< время компьютера в process(), с
+} Controller;
+
+/// числовое поле секции section из состояния SmartLED
+static long stateValue(SmartLED& led, const char* section, const char* name)
+{
+    struct Text : public Print
+    {
+        std::string text;
+        size_t write(uint8_t c) override { text += (char) c; return 1; }
+        using Print::write;
+    } text;
+    JsonWriter json(&text);
+    led.writeState(json);
+    json.flush();
+    size_t at = text.text.find(std::string("\"") + section + "\"");
+    at = (at == std::string::npos) ? at : text.text.find(std::string("\"") + name + "\":", at);
+    return (at == std::string::npos) ? -1 : strtol(text.text.c_str() + at + strlen(name) + 3, NULL, 10);
+}
+
+static void process(Controller& controller)
+{
+    hostDevice = &controller.device;
+    hostShows = &controller.shows;
+    auto start = std::chrono::steady_clock::now();
+    controller.led->process();
+    controller.busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    hostShows = NULL;
+    hostDevice = NULL;
+}
+
+int main()
+{
+    static const uint8_t followerCounts[] = {1, 2, 4, 8};
+    int result = 0;
+    printf("%s\n%9s %8s %7s %16s %13s %14s %16s %8s\n", BENCH_BUILD, "followers", "pixels", "frames", "relay pixels/s",
+           "leader us/fr", "follower us/fr", "host pixels/s", "skew");
+    for (uint8_t count : followerCounts)
+    {
+        std::vector<RelayTarget> targets(count);
+        std::vector<Controller> followers(count);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            Controller& follower = followers[i];
+            follower.device = {IPAddress(192, 168, 1, 51 + i), 1000000u * i, (int32_t) (i * 300) - 1000};
+            follower.busy = 0;
+            hostDevice = &follower.device;
+            follower.led.reset(new SmartLED(BENCH_FOLLOWER, 2, NEO_GRB, false));
+            follower.led->selectMode("dmx");
+            targets[i] = {follower.device.ip, BENCH_FOLLOWER, 0};
+        }
+        Controller leader;
+        leader.device = {IPAddress(192, 168, 1, 10), 0, 0};
+        leader.busy = 0;
+        hostDevice = &leader.device;
+        uint16_t pixels = BENCH_LOCAL + count * BENCH_FOLLOWER;
+        leader.led.reset(new SmartLED(pixels, 2, NEO_GRB, false));
+        leader.led->beginRelay(BENCH_LOCAL, targets.data(), count);
+        leader.led->selectMode("rainbow");
+        char speedOption[] = "speed";
+        char speed[] = BENCH_SPEED;
+        leader.led->setOption(speedOption, speed);
+        /// своя палитра по умолчанию черная
+        char paletteOption[] = "palette";
+        char palette[] = "1";
+        leader.led->setOption(paletteOption, palette);
+        hostDevice = NULL;
+
+        uint64_t end = hostTime() + BENCH_TIME * 1000ULL;
+        uint32_t skew = 0;
+        size_t missed = 0;
+        while (hostTime() < end)
+        {
+            size_t leaderShows = leader.shows.size();
+            process(leader);
+            bool relayed = leader.shows.size() > leaderShows;
+            for (Controller& follower : followers)
+            {
+                size_t followerShows = follower.shows.size();
+                process(follower);
+                /// ведомый выводит кадр на том же проходе, что и ведущий, и только его
+                if ((follower.shows.size() - followerShows) != (relayed ? 1u : 0u))
+                    missed++;
+                else if (relayed)
+                    skew = std::max(skew, follower.shows.back().time - leader.shows.back().time);
+            }
+            hostAdvance(BENCH_PASS);
+        }
+        size_t frames = leader.shows.size();
+        double followerBusy = 0;
+        long dropped = 0;
+        for (Controller& follower : followers)
+        {
+            followerBusy += follower.busy;
+            hostDevice = &follower.device;
+            dropped += stateValue(*follower.led, "dmx", "dropped") + stateValue(*follower.led, "dmx", "late");
+        }
+        hostDevice = &leader.device;
+        long relayRate = stateValue(*leader.led, "relay", "pixelsPerSecond");
+        hostDevice = NULL;
+        printf("%9u %8u %7zu %16ld %13.1f %14.1f %16.0f %5u us\n", count, pixels, frames, relayRate,
+               leader.busy * 1e6 / frames, followerBusy * 1e6 / frames / count,
+               frames * (double) count * BENCH_FOLLOWER / (leader.busy + followerBusy), skew);
+        if (missed || dropped || (frames < BENCH_TIME / 50))
+        {
+            fprintf(stderr, "FAIL: %u followers: %zu passes without a simultaneous frame, %ld dropped or late packets, %zu frames\n",
+                    count, missed, dropped, frames);
+            result = 1;
+        }
+    }
+    return result;
+}
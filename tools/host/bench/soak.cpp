@@ -0,0 +1,165 @@
+// Ускоренный суточный прогон (soak) скетча SmartLED.ino: SOAK_HOURS часов виртуального времени, раз в
+// SOAK_SESSION мс - сеанс управления: клиент вебсокета (по очереди со сжатием и без) выбирает следующий режим,
+// меняет параметры, запрашивает статистику, состояние и контрольные суммы кадров и закрывает соединение,
+// затем запросы HTTP: GET /api/state, PATCH /api/options, /stats, /capture и статический файл. Между сеансами
+// проход loop() длится SOAK_IDLE мс вместо 2 мс. Каждый сеанс заканчивается радугой, поэтому в конце каждого
+// часа состояние одинаково: занятая память вебсокетов (ws_memStats библиотеки и приложения) и куча компьютера
+// (heapcount.cpp) не должны быть больше, чем в конце первого часа. Рост - код выхода 1.
+//
+//   make -C tools/host soak                (SOAK_HOURS=2 - короткий прогон)
+
+#include <smartled.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../heapcount.h"
+#include "../wsclient.h"
+
+#define SOAK_SESSION 60000              ///< период сеансов управления, мс
+#define SOAK_IDLE 50                    ///< проход loop() между сеансами, мс
+#define SOAK_PASSES 5000                ///< предел проходов на одно соединение
+#define SOAK_LINK_RATE 1000             ///< скорость канала клиентов, байт/мс
+
+extern SmartLED* smart;
+void setup();
+void loop();
+
+static const char* const modeNames[] = {"off", "waves", "rainbow", "lines", "snowflake", "stroboscope", "snake",
+                                        "pulse", "plasma", "fire", "text", "audio", "dmx", "cycle"};
+
+typedef struct
+{
+    size_t library;                     ///< ws_memStats(WSmem_library).bytes
+    size_t app;                         ///< ws_memStats(WSmem_app).bytes
+    long heap;                          ///< heapBytes
+} Sample;
+
+static unsigned long passes;
+
+/// проходы loop(), пока программа не закроет соединение
+static bool serve(std::shared_ptr<HostSocket>& socket)
+{
+    for (int i = 0; i < SOAK_PASSES; i++)
+    {
+        loop();
+        passes++;
+        socket->tx.clear();
+        if (socket.use_count() == 1)
+        {
+            socket.reset();
+            return true;
+        }
+    }
+    fprintf(stderr, "FAIL: the connection was not closed in %d passes\n", SOAK_PASSES);
+    socket.reset();
+    return false;
+}
+
+static bool webSocketSession(unsigned session)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect();
+    socket->rate = SOAK_LINK_RATE;
+    const char* mode = modeNames[session % (sizeof(modeNames) / sizeof(modeNames[0]))];
+    std::string speed = std::to_string(10 + session % 90);
+    std::string data = wsUpgradeRequest(session & 1);
+    for (const std::string& command : {std::string("#") + mode, "$speed:" + speed, std::string("%"), std::string("?"),
+                                       std::string("!4"), std::string("#rainbow")})
+        data += wsClientFrame(0x01, command);
+    data += wsClientFrame(0x08, std::string("\x03\xe8", 2));
+    socket->rx.assign(data.begin(), data.end());
+    return serve(socket);
+}
+
+static bool httpRequest(const std::string& request)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect(80);
+    socket->rate = SOAK_LINK_RATE;
+    socket->rx.assign(request.begin(), request.end());
+    return serve(socket);
+}
+
+static bool httpSession(unsigned session)
+{
+    std::string body = "{\"speed\":" + std::to_string(20 + session % 70) + "}";
+    return httpRequest("GET /api/state HTTP/1.1\r\nHost: room.local\r\n\r\n") &&
+           httpRequest("PATCH /api/options HTTP/1.1\r\nHost: room.local\r\nContent-Type: application/json\r\nContent-Length: " +
+                       std::to_string(body.size()) + "\r\n\r\n" + body) &&
+           httpRequest("GET /stats HTTP/1.1\r\nHost: room.local\r\n\r\n") &&
+           httpRequest("GET /capture HTTP/1.1\r\nHost: room.local\r\n\r\n") &&
+           httpRequest("GET /index.html HTTP/1.1\r\nHost: room.local\r\n\r\n");
+}
+
+static Sample sample()
+{
+    return {ws_memStats(WSmem_library).bytes, ws_memStats(WSmem_app).bytes, heapBytes};
+}
+
+int main()
+{
+    const char* hoursText = getenv("SOAK_HOURS");
+    unsigned hours = hoursText ? atoi(hoursText) : 24;
+    if ((hours < 2) || !heapCountWorks())
+    {
+        fprintf(stderr, "SOAK_HOURS must be at least 2, or malloc is not intercepted\n");
+        return 2;
+    }
+    hostDataDir = SKETCH_DATA;
+    setup();
+    smart->selectMode("rainbow");
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Sample> samples;
+    /// отсчеты не должны сами занимать кучу во время прогона
+    samples.reserve(hours);
+    unsigned session = 0;
+    uint32_t hourStart = millis();
+    uint32_t nextSession = millis();
+    while (samples.size() < hours)
+    {
+        if ((int32_t) (millis() - nextSession) >= 0)
+        {
+            if (!webSocketSession(session) || !httpSession(session))
+                return 1;
+            session++;
+            nextSession += SOAK_SESSION;
+        }
+        if (millis() - hourStart >= 3600000UL)
+        {
+            samples.push_back(sample());
+            hourStart += 3600000UL;
+        }
+        loop();
+        passes++;
+        hostAdvance((SOAK_IDLE - 2) * 1000);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int result = 0;
+    Sample peak = samples[0];
+    for (size_t h = 1; h < samples.size(); h++)
+    {
+        peak.library = std::max(peak.library, samples[h].library);
+        peak.app = std::max(peak.app, samples[h].app);
+        peak.heap = std::max(peak.heap, samples[h].heap);
+    }
+    printf("soak: %u h in %.1f s, %u sessions, %lu loop() passes\n", hours, seconds, session, passes);
+    printf("soak: %-10s %10s %10s %10s %10s\n", "", "hour 1", "last hour", "max", "high water");
+    printf("soak: %-10s %10zu %10zu %10zu %10zu\n", "library", samples[0].library, samples.back().library, peak.library,
+           ws_memStats(WSmem_library).highWater);
+    printf("soak: %-10s %10zu %10zu %10zu %10zu\n", "app", samples[0].app, samples.back().app, peak.app,
+           ws_memStats(WSmem_app).highWater);
+    printf("soak: %-10s %10ld %10ld %10ld %10s\n", "host heap", samples[0].heap, samples.back().heap, peak.heap, "-");
+    if ((peak.library > samples[0].library) || (peak.app > samples[0].app) || (peak.heap > samples[0].heap))
+    {
+        fprintf(stderr, "FAIL: memory grew after the first hour\n");
+        result = 1;
+    }
+    WSmemStats_t library = ws_memStats(WSmem_library);
+    WSmemStats_t app = ws_memStats(WSmem_app);
+    if (library.failures || app.failures)
+    {
+        fprintf(stderr, "FAIL: %u library and %u app allocations failed\n", library.failures, app.failures);
+        result = 1;
+    }
+    return result;
+}
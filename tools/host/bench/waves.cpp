@@ -0,0 +1,145 @@
+// Замер ядра волн на пиксель: до - палитра из двух точек (compilePalette) и чтение канала палитры с
+// шагом sizeof (RGBColor) в readyLeds (копия прежнего кода makeWaves), после - SmartLED::renderChannel в
+// плоскости каналов по WAVE_TILE пикселей и SmartLED::interleaveChannels, как в makeWaves. Перед замером
+// кадры обоих вариантов сравниваются на случайных цветах, смещениях и шагах: различие - код выхода 1.
+// Векторизацию ядра проверяет make -C tools/host vec.
+//
+//   make -C tools/host bench
+
+#include <smartled.h>
+#include <chrono>
+#include <vector>
+
+#define BENCH_MIN_TIME 0.05             ///< сколько секунд замерять каждый вариант
+#define BENCH_COMPARE 2000              ///< случайных волн для сравнения на каждой длине ленты
+
+typedef struct
+{
+    RGBColor low, high;
+    uint16_t phase[3];
+    uint16_t step[3];
+} Wave;
+
+/// копия прежнего кода: палитра compilePalette(keys, 2) и fillGradient
+static void compileWavePalette(RGBColor* palette, RGBColor low, RGBColor high)
+{
+    RGBColor keys[2] = {low, high};
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        uint8_t from = ((uint16_t) i << 8) / 2;
+        uint8_t to = (i == 1) ? 255 : (((uint16_t) (i + 1) << 8) / 2) - 1;
+        RGBColor c1 = keys[i];
+        RGBColor next = keys[(i + 1) % 2];
+        RGBColor c2;
+        c2.r = c1.r + ((int16_t) (next.r - c1.r) * (to - from)) / (to - from + 1);
+        c2.g = c1.g + ((int16_t) (next.g - c1.g) * (to - from)) / (to - from + 1);
+        c2.b = c1.b + ((int16_t) (next.b - c1.b) * (to - from)) / (to - from + 1);
+        uint16_t length = to - from;
+        for (uint16_t n = 0; n <= length; n++)
+        {
+            palette[from + n].r = c1.r + ((int16_t) (c2.r - c1.r) * (int16_t) n) / (int16_t) length;
+            palette[from + n].g = c1.g + ((int16_t) (c2.g - c1.g) * (int16_t) n) / (int16_t) length;
+            palette[from + n].b = c1.b + ((int16_t) (c2.b - c1.b) * (int16_t) n) / (int16_t) length;
+        }
+    }
+}
+
+/// копия прежнего кода: канал палитры в канал readyLeds с шагом sizeof (RGBColor)
+static void renderBefore(RGBColor* leds, uint16_t pixels, const RGBColor* palette, const Wave& wave)
+{
+    for (uint8_t channel = 0; channel < 3; channel++)
+    {
+        const uint8_t* source = &palette[0].r + channel;
+        uint8_t* target = &leds[0].r + channel;
+        uint16_t phase = wave.phase[channel];
+        for (uint16_t i = pixels; i > 0; i--)
+        {
+            *target = source[(phase >> 8) * sizeof (RGBColor)];
+            target += sizeof (RGBColor);
+            phase += wave.step[channel];
+        }
+    }
+}
+
+/// как в makeWaves
+static void renderAfter(RGBColor* leds, uint16_t pixels, const Wave& wave)
+{
+    uint8_t planes[3][WAVE_TILE];
+    const uint8_t* low = &wave.low.r;
+    const uint8_t* high = &wave.high.r;
+    for (uint16_t first = 0; first < pixels; first += WAVE_TILE)
+    {
+        uint8_t count = (pixels - first < WAVE_TILE) ? pixels - first : WAVE_TILE;
+        for (uint8_t c = 0; c < 3; c++)
+            SmartLED::renderChannel(planes[c], wave.phase[c] + first * wave.step[c], wave.step[c], low[c], high[c], count);
+        SmartLED::interleaveChannels(&leds[first], planes[0], planes[1], planes[2], count);
+    }
+}
+
+static Wave randomWave(uint16_t pixels)
+{
+    Wave wave;
+    uint8_t* colors = &wave.low.r;
+    for (int i = 0; i < 6; i++)
+        colors[i] = random(256);
+    for (int c = 0; c < 3; c++)
+    {
+        wave.phase[c] = random(65536);
+        wave.step[c] = (uint16_t) ((65536UL * (1 + random(20))) / pixels);
+    }
+    return wave;
+}
+
+/// нс на пиксель
+template <typename Render>
+static double pixelTime(uint16_t pixels, Render render)
+{
+    unsigned long frames = 0;
+    double seconds = 0;
+    auto start = std::chrono::steady_clock::now();
+    do
+    {
+        for (int i = 0; i < 20; i++)
+            render(i);
+        frames += 20;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (seconds < BENCH_MIN_TIME);
+    return seconds * 1e9 / frames / pixels;
+}
+
+int main()
+{
+    static const uint16_t lengths[] = {60, 300, 1000, 60000};
+    RGBColor palette[256];
+    printf("%s\n%6s %12s %12s\n", BENCH_BUILD, "pixels", "before ns/px", "after ns/px");
+    randomSeed(DIGEST_SEED);
+    for (uint16_t pixels : lengths)
+    {
+        std::vector<RGBColor> before(pixels), after(pixels);
+        for (int n = 0; n < BENCH_COMPARE; n++)
+        {
+            Wave wave = randomWave(pixels);
+            compileWavePalette(palette, wave.low, wave.high);
+            renderBefore(before.data(), pixels, palette, wave);
+            renderAfter(after.data(), pixels, wave);
+            if (memcmp(before.data(), after.data(), pixels * sizeof (RGBColor)))
+            {
+                fprintf(stderr, "FAIL: %u pixels: frames differ\n", pixels);
+                return 1;
+            }
+        }
+        Wave wave = randomWave(pixels);
+        compileWavePalette(palette, wave.low, wave.high);
+        /// смещения меняются на каждом кадре, как в makeWaves
+        double beforeTime = pixelTime(pixels, [&](int i) {
+            wave.phase[0] += i;
+            renderBefore(before.data(), pixels, palette, wave);
+        });
+        double afterTime = pixelTime(pixels, [&](int i) {
+            wave.phase[0] += i;
+            renderAfter(after.data(), pixels, wave);
+        });
+        printf("%6u %12.2f %12.2f\n", pixels, beforeTime, afterTime);
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+// Фаззинг разбора команд SmartLED (webSocketEvent, setOption, разбор цветов и значений): каждая строка
+// данных фаззера уходит отдельным текстовым сообщением подключенного клиента, как из веб-интерфейса
+// ("*rainbow", "$speed:10", "#", "!4:waves:1", ...), затем соединение закрывается.
+
+#include <smartled.h>
+#include "../wsclient.h"
+
+static SmartLED* smart;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (!smart)
+        smart = new SmartLED(30, 2, NEO_GRB, false);
+    std::string input = wsUpgradeRequest(false);
+    const char* text = (const char*) data;
+    size_t start = 0;
+    for (size_t i = 0; i <= size; i++)
+        if ((i == size) || (text[i] == '\n'))
+        {
+            input += wsClientFrame(0x01, std::string(&text[start], i - start));
+            start = i + 1;
+        }
+    if (!wsPump(input, []() { smart->process(); }))
+        abort();
+    return 0;
+}
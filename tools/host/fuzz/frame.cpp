@@ -0,0 +1,35 @@
+// Фаззинг декодера кадров вебсокета: после корректного подключения с permessage-deflate серверу приходят
+// данные фаззера (заголовки кадров, маски, длины, фрагменты, управляющие кадры, сжатые сообщения).
+// Сервер не должен выходить за границы буферов и не должен зависать на незаконченном кадре.
+
+#include <WebSocketsServer.h>
+#include "../wsclient.h"
+
+static WebSocketsServer* server;
+
+/// данные события читаются целиком, чтобы AddressSanitizer проверил их длину
+static void event(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
+{
+    (void) num;
+    volatile uint8_t sum = 0;
+    for (size_t i = 0; payload && (i < length); i++)
+        sum += payload[i];
+    /// текстовое сообщение заканчивается нулем, SmartLED разбирает его как строку
+    if ((type == WStype_TEXT) && payload && (payload[length] != 0))
+        abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (!server)
+    {
+        server = new WebSocketsServer(81, "", "arduino");
+        server->enableDeflate();
+        server->begin();
+        server->onEvent(event);
+    }
+    std::string input = wsUpgradeRequest(true) + std::string((const char*) data, size);
+    if (!wsPump(input, []() { server->loop(); }))
+        abort();
+    return 0;
+}
@@ -0,0 +1,30 @@
+// Фаззинг разбора запроса на подключение (построчный разбор заголовков в буфере клиента без String):
+// данные фаззера - весь запрос. Сервер должен ответить или закрыть соединение, не выходя за границы буферов.
+
+#include <WebSocketsServer.h>
+#include "../wsclient.h"
+
+static WebSocketsServer* server;
+
+static void event(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
+{
+    (void) num;
+    (void) type;
+    volatile uint8_t sum = 0;
+    for (size_t i = 0; payload && (i < length); i++)
+        sum += payload[i];
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (!server)
+    {
+        server = new WebSocketsServer(81, "", "arduino");
+        server->enableDeflate();
+        server->begin();
+        server->onEvent(event);
+    }
+    if (!wsPump(std::string((const char*) data, size), []() { server->loop(); }))
+        abort();
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Запуск фаззера без libFuzzer (g++): каждый файл корпуса прогоняется через LLVMFuzzerTestOneInput,
+// затем -runs=N случайных мутаций корпуса (зерно -seed=S, прогон воспроизводим). Входные данные, на которых
+// сработал санитайзер, сохраняются в crash-<номер>, повторить: <фаззер> crash-<номер>.
+// С clang те же цели собираются с настоящим libFuzzer (make FUZZ_ENGINE=libfuzzer CXX=clang++ CC=clang).
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <algorithm>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+extern "C" void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+#define FUZZ_MAX_SIZE 4096              ///< предел длины мутированных данных
+
+static std::vector<uint8_t> current;    ///< данные выполняемого прогона
+static unsigned long runNumber;
+
+static void saveCrash()
+{
+    char name[32];
+    snprintf(name, sizeof(name), "crash-%lu", runNumber);
+    FILE* file = fopen(name, "wb");
+    if (file)
+    {
+        fwrite(current.data(), 1, current.size(), file);
+        fclose(file);
+        fprintf(stderr, "input saved to %s\n", name);
+    }
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    data.clear();
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        data.insert(data.end(), buffer, buffer + length);
+    fclose(file);
+    return true;
+}
+
+static void collect(const std::string& path, std::vector<std::vector<uint8_t> >& corpus)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+    {
+        fprintf(stderr, "%s: not found\n", path.c_str());
+        exit(2);
+    }
+    if (!S_ISDIR(info.st_mode))
+    {
+        std::vector<uint8_t> data;
+        if (readFile(path, data))
+            corpus.push_back(data);
+        return;
+    }
+    DIR* directory = opendir(path.c_str());
+    std::vector<std::string> names;
+    while (struct dirent* entry = readdir(directory))
+        if (entry->d_name[0] != '.')
+            names.push_back(entry->d_name);
+    closedir(directory);
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names)
+        collect(path + "/" + name, corpus);
+}
+
+static uint32_t state;
+
+static uint32_t next(uint32_t bound)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return bound ? state % bound : 0;
+}
+
+/// одна-четыре случайные правки: замена, вставка и удаление байтов, граничные значения, вставка куска другого входа
+static void mutate(std::vector<uint8_t>& data, const std::vector<std::vector<uint8_t> >& corpus)
+{
+    static const uint8_t interesting[] = {0x00, 0x01, 0x7e, 0x7f, 0x80, 0xff, ':', ';', '\n', 0x81, 0x88, 0x89, 0xc1};
+    for (uint32_t edits = 1 + next(4); edits > 0; edits--)
+    {
+        size_t position = next(data.size() + 1);
+        switch (next(6))
+        {
+            case 0:
+                if (!data.empty())
+                    data[next(data.size())] ^= 1 << next(8);
+                break;
+            case 1:
+                if (!data.empty())
+                    data[next(data.size())] = interesting[next(sizeof(interesting))];
+                break;
+            case 2:
+                data.insert(data.begin() + position, 1 + next(8), (uint8_t) next(256));
+                break;
+            case 3:
+                if (position < data.size())
+                    data.erase(data.begin() + position, data.begin() + std::min(data.size(), position + 1 + next(16)));
+                break;
+            case 4:
+            {
+                const std::vector<uint8_t>& other = corpus[next(corpus.size())];
+                if (other.empty())
+                    break;
+                size_t from = next(other.size());
+                size_t length = 1 + next(other.size() - from);
+                data.insert(data.begin() + position, other.begin() + from, other.begin() + from + length);
+                break;
+            }
+            default:
+                if (position < data.size())
+                    data.resize(position);
+                break;
+        }
+    }
+    if (data.size() > FUZZ_MAX_SIZE)
+        data.resize(FUZZ_MAX_SIZE);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned long runs = 0;
+    state = 1;
+    std::vector<std::vector<uint8_t> > corpus;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+            runs = strtoul(&argv[i][6], NULL, 10);
+        else if (strncmp(argv[i], "-seed=", 6) == 0)
+            state = strtoul(&argv[i][6], NULL, 10) | 1;
+        else if (argv[i][0] != '-')
+            collect(argv[i], corpus);
+    }
+    if (corpus.empty())
+        corpus.push_back(std::vector<uint8_t>());
+    if (__sanitizer_set_death_callback)
+        __sanitizer_set_death_callback(saveCrash);
+    for (const std::vector<uint8_t>& input : corpus)
+    {
+        current = input;
+        runNumber++;
+        LLVMFuzzerTestOneInput(current.data(), current.size());
+    }
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        current = corpus[next(corpus.size())];
+        mutate(current, corpus);
+        runNumber++;
+        LLVMFuzzerTestOneInput(current.data(), current.size());
+    }
+    printf("%s: %zu corpus inputs and %lu mutations passed\n", argv[0], corpus.size(), runs);
+    return 0;
+}
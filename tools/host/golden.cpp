@@ -0,0 +1,225 @@
+// Тест эталонных кадров: каждый эффект, не зависящий от внешних данных (режимы до audio), и модификаторы
+// (змейка - сдвиг и разворот, цикл - затухание) рассчитываются на нескольких длинах ленты и на матрице
+// так же, как команда "!" вебсокета (SmartLED::resetDigest/stepDigest, зерно DIGEST_SEED), и сравниваются
+// с кадрами из golden/<раскладка>.txt. Строка эталона: "сценарий кадр хеш RRGGBB...".
+// Для каждого сценария с расхождением выводится первый отличающийся кадр и пиксель.
+//
+//   make -C tools/host check     - сравнить с эталоном
+//   make -C tools/host golden    - записать эталон заново (только после намеренного изменения эффектов)
+
+#include <smartled.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define GOLDEN_FRAME_TIME 20000         ///< виртуальное время между кадрами, мкс (refreshRate)
+
+typedef struct
+{
+    const char* name;                   ///< имя сценария в эталоне
+    const char* mode;                   ///< режим (имя из modes[])
+    uint16_t frames;                    ///< количество кадров
+    const char* options[3][2];          ///< параметры режима после запуска, как в setOption
+} Scenario;
+
+const Scenario scenarios[] = {
+    {"off", "off", 24, {}},
+    {"waves", "waves", 24, {}},
+    {"rainbow", "rainbow", 24, {}},
+    {"lines", "lines", 24, {}},
+    {"snowflake", "snowflake", 24, {}},
+    {"stroboscope", "stroboscope", 24, {}},
+    {"snake", "snake", 24, {}},
+    {"pulse", "pulse", 24, {}},
+    {"plasma", "plasma", 24, {}},
+    {"fire", "fire", 24, {}},
+    {"text", "text", 24, {}},
+    /// цвета линий по умолчанию черные
+    {"lines-colors", "lines", 48, {{"color0", "255;80;0"}, {"color1", "0;40;255"}, {"linesRev", "1"}}},
+    {"lines-multicolor", "lines", 48, {{"linesMC", "1"}}},
+    /// разворот змейки (modifierInvert) между сдвигами (modifierMoving)
+    {"snake-reverse", "snake", 96, {{"snakeRev", "1"}, {"snakeMC", "1"}}},
+    /// смена режима цикла через затухание (modifierFading), следующий режим выбирает random()
+    {"cycle-fading", "cycle", 300, {{"period", "1"}, {"isRandom", "1"}, {"fading", "1"}}}
+};
+
+typedef struct
+{
+    const char* name;                   ///< имя файла эталона
+    MatrixLayout layout;
+} Layout;
+
+const Layout layouts[] = {
+    {"strip-1", {1, 1, 0, 0, LayoutRows}},
+    {"strip-10", {10, 1, 0, 0, LayoutRows}},
+    {"strip-30", {30, 1, 0, 0, LayoutRows}},
+    {"matrix-8x5", {8, 5, 0, 0, LayoutSerpentine | LayoutRotate90}}
+};
+
+typedef struct
+{
+    uint32_t hash;
+    std::string pixels;
+} Frame;
+
+typedef std::map<std::string, std::vector<Frame> > Golden;
+
+static std::string hexFrame(SmartLED& led)
+{
+    std::string text;
+    char color[8];
+    const RGBColor* frame = led.frame();
+    for (uint16_t i = 0; i < led.pixels(); i++)
+    {
+        snprintf(color, sizeof(color), "%02x%02x%02x", frame[i].r, frame[i].g, frame[i].b);
+        text += color;
+    }
+    return text;
+}
+
+static bool readGolden(const std::string& path, Golden& golden)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+        return false;
+    char name[64];
+    unsigned frame;
+    unsigned long hash;
+    char pixels[8192];
+    char line[sizeof(pixels) + 128];
+    while (fgets(line, sizeof(line), file))
+    {
+        if ((line[0] == '#') || (sscanf(line, "%63s %u %lx %8191s", name, &frame, &hash, pixels) != 4))
+            continue;
+        std::vector<Frame>& frames = golden[name];
+        if (frame == frames.size())
+            frames.push_back({(uint32_t) hash, pixels});
+    }
+    fclose(file);
+    return true;
+}
+
+/// первый отличающийся пиксель кадра (кадры разной длины расходятся на конце более короткого)
+static int firstDivergentPixel(const std::string& expected, const std::string& actual)
+{
+    size_t i = 0;
+    while ((i < expected.size()) && (i < actual.size()) && (expected.compare(i, 6, actual, i, 6) == 0))
+        i += 6;
+    return i / 6;
+}
+
+/// координаты пикселя на матрице (для ленты y = 0)
+static void pixelPosition(SmartLED& led, int pixel, uint16_t& x, uint16_t& y)
+{
+    for (y = 0; y < led.height(); y++)
+        for (x = 0; x < led.width(); x++)
+            if (led.XY(x, y) == pixel)
+                return;
+    x = y = 0;
+}
+
+static bool checkCoverage(SmartLED& led)
+{
+    bool covered[MIAudio] = {};
+    for (const Scenario& scenario : scenarios)
+    {
+        ModeID mode = led.findMode(scenario.mode);
+        if (mode == MIMAX)
+        {
+            fprintf(stderr, "scenario %s: unknown mode %s\n", scenario.name, scenario.mode);
+            return false;
+        }
+        if (mode < MIAudio)
+            covered[mode] = true;
+    }
+    bool result = true;
+    for (int m = MIOff; m < MIAudio; m++)
+        if (!covered[m])
+        {
+            fprintf(stderr, "mode %d has no golden scenario\n", m);
+            result = false;
+        }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    /// golden [--update] [каталог эталона]
+    bool update = (argc > 1) && (strcmp(argv[1], "--update") == 0);
+    std::string directory = (argc > (update ? 2 : 1)) ? argv[update ? 2 : 1] : "golden";
+    int divergent = 0;
+    for (const Layout& layout : layouts)
+    {
+        SmartLED led(layout.layout, 2, NEO_GRB, false);
+        if (!checkCoverage(led))
+            return 2;
+        std::string path = directory + "/" + layout.name + ".txt";
+        Golden golden;
+        FILE* output = NULL;
+        if (update)
+        {
+            output = fopen(path.c_str(), "w");
+            if (!output)
+            {
+                perror(path.c_str());
+                return 2;
+            }
+            fprintf(output, "# %s, %u pixels: scenario frame hash RRGGBB... (tools/host/golden.cpp)\n", layout.name, led.pixels());
+        } else if (!readGolden(path, golden))
+        {
+            fprintf(stderr, "%s: no golden file, run 'make golden'\n", path.c_str());
+            return 2;
+        }
+        for (const Scenario& scenario : scenarios)
+        {
+            randomSeed(DIGEST_SEED);
+            led.resetDigest(led.findMode(scenario.mode));
+            for (int i = 0; (i < 3) && scenario.options[i][0]; i++)
+            {
+                char option[32], value[32];
+                snprintf(option, sizeof(option), "%s", scenario.options[i][0]);
+                snprintf(value, sizeof(value), "%s", scenario.options[i][1]);
+                led.setOption(option, value);
+            }
+            const std::vector<Frame>& expected = golden[scenario.name];
+            for (uint16_t frame = 0; frame < scenario.frames; frame++)
+            {
+                hostAdvance(GOLDEN_FRAME_TIME);
+                uint32_t hash = led.stepDigest();
+                std::string pixels = hexFrame(led);
+                if (output)
+                {
+                    fprintf(output, "%s %u %08x %s\n", scenario.name, frame, hash, pixels.c_str());
+                    continue;
+                }
+                if (frame >= expected.size())
+                {
+                    fprintf(stderr, "%s %s: frame %u missing from golden file\n", layout.name, scenario.name, frame);
+                    divergent++;
+                    break;
+                }
+                if ((hash != expected[frame].hash) || (pixels != expected[frame].pixels))
+                {
+                    int pixel = firstDivergentPixel(expected[frame].pixels, pixels);
+                    uint16_t x, y;
+                    pixelPosition(led, pixel, x, y);
+                    fprintf(stderr, "%s %s: first divergent frame %u, pixel %d (x %u, y %u): expected %s, got %s\n",
+                            layout.name, scenario.name, frame, pixel, x, y,
+                            expected[frame].pixels.substr(pixel * 6, 6).c_str(), pixels.substr(pixel * 6, 6).c_str());
+                    divergent++;
+                    break;
+                }
+            }
+        }
+        if (output)
+            fclose(output);
+        else
+            printf("%s: %u pixels, %zu scenarios checked\n", layout.name, led.pixels(), sizeof(scenarios) / sizeof(scenarios[0]));
+    }
+    if (divergent > 0)
+    {
+        fprintf(stderr, "%d scenario(s) diverge from the golden frames\n", divergent);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "heapcount.h"
+#include <stddef.h>
+#include <malloc.h>
+
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+extern "C" void __libc_free(void* ptr);
+
+bool heapCounting;
+unsigned long heapAllocs;
+long heapBytes;
+
+extern "C" void* malloc(size_t size)
+{
+    if (heapCounting)
+        heapAllocs++;
+    void* ptr = __libc_malloc(size);
+    heapBytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    if (heapCounting)
+        heapAllocs++;
+    void* ptr = __libc_calloc(count, size);
+    heapBytes += malloc_usable_size(ptr);
+    return ptr;
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    if (heapCounting)
+        heapAllocs++;
+    size_t before = malloc_usable_size(ptr);
+    void* resized = __libc_realloc(ptr, size);
+    /// при неудаче старый блок остается занятым
+    if (resized || !size)
+        heapBytes += (long) malloc_usable_size(resized) - (long) before;
+    return resized;
+}
+
+extern "C" void free(void* ptr)
+{
+    heapBytes -= malloc_usable_size(ptr);
+    __libc_free(ptr);
+}
+
+bool heapCountWorks()
+{
+    unsigned long before = heapAllocs;
+    bool counting = heapCounting;
+    heapCounting = true;
+    void* volatile probe = malloc(16);
+    heapCounting = counting;
+    free(probe);
+    return heapAllocs == before + 1;
+}
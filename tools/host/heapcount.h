@@ -0,0 +1,21 @@
+// Счетчик вызовов malloc/calloc/realloc для замеров и тестов без санитайзеров (они перехватывают malloc сами):
+// heapcount.cpp подменяет эти функции счетчиками поверх функций glibc. Вызовы считаются, пока heapCounting
+// == true, занятые байты (heapBytes) - всегда.
+
+#ifndef HOST_HEAPCOUNT_H
+#define HOST_HEAPCOUNT_H
+
+/// считать вызовы
+extern bool heapCounting;
+/// вызовов malloc, calloc и realloc при heapCounting
+extern unsigned long heapAllocs;
+/// занято в куче сейчас, байт (malloc_usable_size выделенных блоков)
+extern long heapBytes;
+
+/**
+ * Проверить, что подмена действует: иначе ноль выделений ничего не значит
+ * @return true, если вызов malloc был посчитан
+ */
+bool heapCountWorks();
+
+#endif /* HOST_HEAPCOUNT_H */
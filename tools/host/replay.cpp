@@ -0,0 +1,162 @@
+// Воспроизведение записи команд вебсокета (GET /capture, CommandCapture) на скетче SmartLED.ino, собранном на
+// компьютере: каждому клиенту записи - свое соединение, команды приходят в исходные моменты записи, интервалы
+// делятся на --speed. Время виртуальное, поэтому запись любой длины проходит за секунды и одинаково на любом
+// компьютере. Печатаются интервалы кадров по виртуальному времени (p50, p99, самый длинный - зависание ленты)
+// и время прохода loop() по времени компьютера (p50, p99, худший, отдельно для проходов с командами).
+// Код выхода 1: скетч записал не все команды (capture.recorded), соединение закрылось или между кадрами
+// прошло больше REPLAY_FREEZE мс.
+//
+//   make -C tools/host replay                   (все записи captures/, REPLAY_SPEED=1)
+//   build/replay capture.txt --speed 4
+
+#include <smartled.h>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "wsclient.h"
+
+#define REPLAY_TAIL 1000                ///< проходить loop() после последней команды, мс
+#define REPLAY_FREEZE 500               ///< самый длинный допустимый интервал между кадрами, мс
+#define REPLAY_LINK_RATE 1000           ///< скорость канала клиентов, байт/мс
+
+extern SmartLED* smart;
+void setup();
+void loop();
+
+typedef struct
+{
+    uint32_t time;                      ///< время записи, мс
+    uint8_t client;                     ///< номер клиента в записи
+    std::string text;
+} Command;
+
+/// обратное экранирование CommandCapture::write: \t, \n, \r и \\ в команде
+static std::string unescape(const std::string& text)
+{
+    std::string result;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if ((text[i] == '\\') && (i + 1 < text.size()))
+        {
+            char c = text[++i];
+            result += (c == 't') ? '\t' : (c == 'n') ? '\n' : (c == 'r') ? '\r' : c;
+        } else
+            result += text[i];
+    }
+    return result;
+}
+
+static bool readCapture(const char* path, std::vector<Command>& commands)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t first = line.find('\t');
+        size_t second = (first == std::string::npos) ? first : line.find('\t', first + 1);
+        if (second == std::string::npos)
+            continue;
+        commands.push_back({(uint32_t) strtoul(line.c_str(), NULL, 10), (uint8_t) atoi(line.c_str() + first + 1),
+                            unescape(line.substr(second + 1))});
+    }
+    return !commands.empty();
+}
+
+static double percentile(std::vector<double>& values, double share)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t) (values.size() * share))];
+}
+
+int main(int argc, char** argv)
+{
+    double speed = 1;
+    const char* path = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--speed") == 0) && (i + 1 < argc))
+            speed = atof(argv[++i]);
+        else
+            path = argv[i];
+    }
+    std::vector<Command> commands;
+    if (!path || (speed <= 0) || !readCapture(path, commands))
+    {
+        fprintf(stderr, "usage: %s capture.txt [--speed N]\n", argv[0]);
+        return 2;
+    }
+
+    hostDataDir = SKETCH_DATA;
+    setup();
+    /// клиенты подключаются до первой команды, номера соединений сервера не обязаны совпадать с записью
+    std::map<uint8_t, std::shared_ptr<HostSocket>> sockets;
+    for (const Command& command : commands)
+        if (!sockets.count(command.client))
+        {
+            std::shared_ptr<HostSocket> socket = hostConnect();
+            socket->rate = REPLAY_LINK_RATE;
+            std::string request = wsUpgradeRequest(false);
+            socket->rx.assign(request.begin(), request.end());
+            sockets[command.client] = socket;
+        }
+    for (int i = 0; i < 100; i++)
+        loop();
+    uint32_t recordedBefore = smart->capture.recorded;
+
+    std::vector<HostShow> shows;
+    std::vector<double> passes;
+    std::vector<double> commandPasses;
+    hostShows = &shows;
+    uint32_t start = millis();
+    uint32_t first = commands[0].time;
+    uint32_t end = start + (uint32_t) ((commands.back().time - first) / speed) + REPLAY_TAIL;
+    size_t next = 0;
+    while ((int32_t) (millis() - end) < 0)
+    {
+        bool delivered = false;
+        while ((next < commands.size()) && ((int32_t) (millis() - start - (uint32_t) ((commands[next].time - first) / speed)) >= 0))
+        {
+            std::string frame = wsClientFrame(0x01, commands[next].text);
+            std::shared_ptr<HostSocket>& socket = sockets[commands[next].client];
+            socket->rx.insert(socket->rx.end(), frame.begin(), frame.end());
+            delivered = true;
+            next++;
+        }
+        auto passStart = std::chrono::steady_clock::now();
+        loop();
+        double pass = std::chrono::duration<double>(std::chrono::steady_clock::now() - passStart).count() * 1e6;
+        (delivered ? commandPasses : passes).push_back(pass);
+        for (auto& client : sockets)
+            client.second->tx.clear();
+    }
+    hostShows = NULL;
+
+    std::vector<double> intervals;
+    for (size_t i = 1; i < shows.size(); i++)
+        intervals.push_back((shows[i].time - shows[i - 1].time) / 1000.0);
+    double longest = intervals.empty() ? (end - start) : percentile(intervals, 1);
+    uint32_t recorded = smart->capture.recorded - recordedBefore;
+    size_t closed = 0;
+    for (auto& client : sockets)
+        closed += client.second.use_count() == 1;
+    printf("replay: %s at %gx: %zu commands from %zu clients, %u ms of capture in %u ms\n", path, speed,
+           commands.size(), sockets.size(), commands.back().time - first, end - start);
+    printf("replay: %zu frames, interval p50 %.1f ms, p99 %.1f ms, longest %.1f ms\n", shows.size(),
+           percentile(intervals, 0.5), percentile(intervals, 0.99), longest);
+    printf("replay: loop() p50 %.1f us, p99 %.1f us, worst %.1f us; with commands p50 %.1f us, p99 %.1f us, worst %.1f us\n",
+           percentile(passes, 0.5), percentile(passes, 0.99), percentile(passes, 1), percentile(commandPasses, 0.5),
+           percentile(commandPasses, 0.99), percentile(commandPasses, 1));
+    if ((recorded != commands.size()) || closed || (longest > REPLAY_FREEZE))
+    {
+        fprintf(stderr, "FAIL: %u of %zu commands recorded, %zu connections closed, longest frame interval %.1f ms\n",
+                recorded, commands.size(), closed, longest);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+// Минимальное окружение Arduino/ESP8266 для сборки SmartLED и библиотеки вебсокетов на компьютере
+// (тесты эталонных кадров, фаззинг, замеры). Время виртуальное: идет только по hostAdvance()
+// и на 1 мкс за каждое чтение часов, чтобы ожидающие циклы (Adafruit_NeoPixel::canShow) завершались.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+#define ARDUINO_ARCH_ESP8266
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*) (addr))
+#define pgm_read_word(addr) (*(const uint16_t*) (addr))
+#define pgm_read_dword(addr) (*(const uint32_t*) (addr))
+#define pgm_read_ptr(addr) (*(void* const*) (addr))
+#define memcpy_P memcpy
+#define memcmp_P memcmp
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define A0 17
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bit(b) (1UL << (b))
+#define _min(a, b) ((a) < (b) ? (a) : (b))
+#define _max(a, b) ((a) > (b) ? (a) : (b))
+using std::min;
+using std::max;
+using std::abs;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return LOW; }
+inline void noInterrupts() {}
+inline void interrupts() {}
+int analogRead(uint8_t pin);
+
+class String
+{
+public:
+    String(const char* text = "") : data(text ? text : "") {}
+    String(const std::string& text) : data(text) {}
+    String(char c) : data(1, c) {}
+    String(int value) : data(std::to_string(value)) {}
+    String(unsigned int value) : data(std::to_string(value)) {}
+    String(long value) : data(std::to_string(value)) {}
+    String(unsigned long value) : data(std::to_string(value)) {}
+    const char* c_str() const { return data.c_str(); }
+    unsigned int length() const { return data.length(); }
+    bool reserve(unsigned int size) { data.reserve(size); return true; }
+    char charAt(unsigned int index) const { return (index < data.length()) ? data[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    int indexOf(const char* text, unsigned int from = 0) const
+    {
+        size_t found = data.find(text, from);
+        return (found == std::string::npos) ? -1 : (int) found;
+    }
+    int indexOf(const String& text, unsigned int from = 0) const { return indexOf(text.c_str(), from); }
+    int indexOf(char c, unsigned int from = 0) const
+    {
+        size_t found = data.find(c, from);
+        return (found == std::string::npos) ? -1 : (int) found;
+    }
+    String substring(unsigned int from) const { return (from < data.length()) ? String(data.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        return (from < to && from < data.length()) ? String(data.substr(from, to - from)) : String();
+    }
+    bool startsWith(const String& prefix) const { return data.compare(0, prefix.data.length(), prefix.data) == 0; }
+    bool endsWith(const String& suffix) const
+    {
+        return (data.length() >= suffix.data.length()) && (data.compare(data.length() - suffix.data.length(), suffix.data.length(), suffix.data) == 0);
+    }
+    bool equalsIgnoreCase(const String& other) const { return strcasecmp(c_str(), other.c_str()) == 0; }
+    void toLowerCase() { for (char& c : data) c = tolower(c); }
+    void trim()
+    {
+        size_t first = data.find_first_not_of(" \t\r\n");
+        size_t last = data.find_last_not_of(" \t\r\n");
+        data = (first == std::string::npos) ? std::string() : data.substr(first, last - first + 1);
+    }
+    long toInt() const { return atol(c_str()); }
+    void toCharArray(char* buffer, unsigned int size) const
+    {
+        if (size == 0)
+            return;
+        size_t length = std::min((size_t) size - 1, data.length());
+        memcpy(buffer, data.c_str(), length);
+        buffer[length] = 0;
+    }
+    String& operator+=(const String& other) { data += other.data; return *this; }
+    String& operator+=(const char* other) { data += other; return *this; }
+    String& operator+=(char c) { data += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.data + b.data); }
+    friend String operator+(const String& a, const char* b) { return String(a.data + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.data); }
+    bool operator==(const String& other) const { return data == other.data; }
+    bool operator==(const char* other) const { return data == other; }
+    bool operator!=(const String& other) const { return data != other.data; }
+    bool operator!=(const char* other) const { return data != other; }
+
+private:
+    std::string data;
+};
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size)
+    {
+        size_t n = 0;
+        while ((n < size) && write(buffer[n]))
+            n++;
+        return n;
+    }
+    size_t write(const char* text) { return write((const uint8_t*) text, strlen(text)); }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*) buffer, size); }
+    size_t printf(const char* format, ...) __attribute__ ((format (printf, 2, 3)))
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length < 0)
+            return 0;
+        return write((const uint8_t*) buffer, std::min((size_t) length, sizeof(buffer) - 1));
+    }
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(int value) { return print((long) value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(unsigned int value) { return print((unsigned long) value); }
+    size_t print(double value) { return printf("%.2f", value); }
+    template<typename T> size_t println(const T& value) { return print(value) + println(); }
+    size_t println() { return write("\r\n"); }
+    virtual void flush() {}
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout(unsigned long timeout) { streamTimeout = timeout; }
+
+protected:
+    unsigned long streamTimeout = 1000;
+};
+
+/// вывод Serial уходит в stderr только при hostVerbose, чтобы не мешать отчетам тестов
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+#define DEBUG_ESP_PORT Serial
+
+class EspClass
+{
+public:
+    uint32_t getCycleCount();
+    uint8_t getCpuFreqMHz() { return 80; }
+    uint32_t getFreeHeap() { return 40000; }
+    uint32_t getMaxFreeBlockSize() { return 30000; }
+    uint32_t getMaxAllocHeap() { return 30000; }
+    uint32_t random();
+    void restart() {}
+};
+
+extern EspClass ESP;
+#define RANDOM_REG32 (ESP.random())
+
+#include "IPAddress.h"
+#include "host.h"
+
+#endif /* HOST_ARDUINO_H */
@@ -0,0 +1,26 @@
+#ifndef HOST_EEPROM_H
+#define HOST_EEPROM_H
+
+#include <Arduino.h>
+
+/// пустая (стертая) память: сохраненные настройки не читаются, запись не сохраняется между запусками
+class EEPROMClass
+{
+public:
+    void begin(size_t size) { (void) size; }
+    uint8_t read(int address) { return (address >= 0 && address < (int) sizeof(data)) ? data[address] : 0xFF; }
+    void write(int address, uint8_t value)
+    {
+        if (address >= 0 && address < (int) sizeof(data))
+            data[address] = value;
+    }
+    bool commit() { return true; }
+    void end() {}
+
+private:
+    uint8_t data[4096] = {};
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* HOST_EEPROM_H */
@@ -0,0 +1,209 @@
+#include <ESP8266WebServer.h>
+
+static const struct
+{
+    HTTPMethod method;
+    const char* name;
+} methodNames[] = {
+    {HTTP_GET, "GET"}, {HTTP_HEAD, "HEAD"}, {HTTP_POST, "POST"}, {HTTP_PUT, "PUT"},
+    {HTTP_PATCH, "PATCH"}, {HTTP_DELETE, "DELETE"}, {HTTP_OPTIONS, "OPTIONS"}
+};
+
+static std::string urlDecode(const std::string& text)
+{
+    std::string decoded;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        if ((text[i] == '%') && (i + 2 < text.size()))
+        {
+            decoded += (char) strtol(text.substr(i + 1, 2).c_str(), NULL, 16);
+            i += 2;
+        } else
+            decoded += (text[i] == '+') ? ' ' : text[i];
+    }
+    return decoded;
+}
+
+static const char* statusText(int code)
+{
+    switch (code)
+    {
+        case 200: return "OK";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        default: return "";
+    }
+}
+
+void ESP8266WebServer::handleClient()
+{
+    if (!current)
+    {
+        current = listener.available();
+        if (!current)
+            return;
+        request.clear();
+    }
+    uint8_t buffer[1024];
+    int length;
+    while ((length = current.read(buffer, sizeof(buffer))) > 0)
+        request.append((const char*) buffer, length);
+    if (!parseRequest())
+    {
+        /// запрос еще не пришел целиком
+        if (!current.connected())
+            current = WiFiClient();
+        return;
+    }
+    const Route* route = NULL;
+    for (const Route& candidate : routes)
+    {
+        if ((candidate.uri == requestUri) && ((candidate.method == HTTP_ANY) || (candidate.method == requestMethod)))
+        {
+            route = &candidate;
+            break;
+        }
+    }
+    if (route)
+        route->handler();
+    else if (notFound)
+        notFound();
+    else
+        send(404, "text/plain", "Not found");
+    current = WiFiClient();
+    request.clear();
+}
+
+bool ESP8266WebServer::parseRequest()
+{
+    size_t end = request.find("\r\n\r\n");
+    if (end == std::string::npos)
+        return false;
+    size_t lineEnd = request.find("\r\n");
+    std::string line = request.substr(0, lineEnd);
+    size_t space = line.find(' ');
+    size_t uriEnd = line.find(' ', space + 1);
+    if ((space == std::string::npos) || (uriEnd == std::string::npos))
+        return false;
+    std::string method = line.substr(0, space);
+    std::string target = line.substr(space + 1, uriEnd - space - 1);
+    requestMethod = HTTP_ANY;
+    for (const auto& name : methodNames)
+        if (method == name.name)
+            requestMethod = name.method;
+    headers.clear();
+    arguments.clear();
+    responseHeaders = String();
+    contentLength = CONTENT_LENGTH_NOT_SET;
+    size_t bodyLength = 0;
+    std::string contentType;
+    for (size_t at = lineEnd + 2; at < end; )
+    {
+        size_t next = request.find("\r\n", at);
+        std::string header = request.substr(at, next - at);
+        at = next + 2;
+        size_t colon = header.find(':');
+        if (colon == std::string::npos)
+            continue;
+        String name = header.substr(0, colon);
+        String value = header.substr(colon + 1);
+        value.trim();
+        if (name.equalsIgnoreCase("Content-Length"))
+            bodyLength = value.toInt();
+        if (name.equalsIgnoreCase("Content-Type"))
+            contentType = value.c_str();
+        for (const String& key : collected)
+            if (name.equalsIgnoreCase(key))
+                headers.push_back({key, value});
+    }
+    if (request.size() < end + 4 + bodyLength)
+        return false;
+    std::string body = request.substr(end + 4, bodyLength);
+    size_t query = target.find('?');
+    requestUri = urlDecode(target.substr(0, query)).c_str();
+    if (query != std::string::npos)
+        parseArguments(target.substr(query + 1));
+    if (contentType.compare(0, 33, "application/x-www-form-urlencoded") == 0)
+        parseArguments(body);
+    else if (bodyLength)
+        arguments.push_back({"plain", body});
+    return true;
+}
+
+void ESP8266WebServer::parseArguments(const std::string& query)
+{
+    for (size_t at = 0; at < query.size(); )
+    {
+        size_t next = query.find('&', at);
+        if (next == std::string::npos)
+            next = query.size();
+        std::string pair = query.substr(at, next - at);
+        size_t equals = pair.find('=');
+        if (!pair.empty())
+            arguments.push_back({urlDecode(pair.substr(0, equals)),
+                                 (equals == std::string::npos) ? std::string() : urlDecode(pair.substr(equals + 1))});
+        at = next + 1;
+    }
+}
+
+void ESP8266WebServer::collectHeaders(const char* headerKeys[], const size_t headerKeysCount)
+{
+    collected.clear();
+    for (size_t i = 0; i < headerKeysCount; i++)
+        collected.push_back(headerKeys[i]);
+}
+
+String ESP8266WebServer::arg(const String& name)
+{
+    for (const auto& argument : arguments)
+        if (argument.first == name)
+            return argument.second;
+    return String();
+}
+
+bool ESP8266WebServer::hasArg(const String& name)
+{
+    for (const auto& argument : arguments)
+        if (argument.first == name)
+            return true;
+    return false;
+}
+
+String ESP8266WebServer::header(const String& name)
+{
+    for (const auto& header : headers)
+        if (header.first.equalsIgnoreCase(name))
+            return header.second;
+    return String();
+}
+
+bool ESP8266WebServer::hasHeader(const String& name)
+{
+    for (const auto& header : headers)
+        if (header.first.equalsIgnoreCase(name))
+            return true;
+    return false;
+}
+
+void ESP8266WebServer::sendHeader(const String& name, const String& value, bool first)
+{
+    String line = name + ": " + value + "\r\n";
+    responseHeaders = first ? (line + responseHeaders) : (responseHeaders + line);
+}
+
+void ESP8266WebServer::send(int code, const char* contentType, const String& content)
+{
+    String response = String("HTTP/1.1 ") + String(code) + " " + statusText(code) + "\r\n";
+    if (contentType && contentType[0])
+        response += String("Content-Type: ") + contentType + "\r\n";
+    size_t length = (contentLength == CONTENT_LENGTH_NOT_SET) ? content.length() : contentLength;
+    if (length != CONTENT_LENGTH_UNKNOWN)
+        response += String("Content-Length: ") + String((unsigned long) length) + "\r\n";
+    response += responseHeaders;
+    response += "Connection: close\r\n\r\n";
+    response += content;
+    current.write((const uint8_t*) response.c_str(), response.length());
+    responseHeaders = String();
+    contentLength = CONTENT_LENGTH_NOT_SET;
+}
@@ -0,0 +1,103 @@
+#ifndef HOST_ESP8266WEBSERVER_H
+#define HOST_ESP8266WEBSERVER_H
+
+#include <ESP8266WiFi.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef enum
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+} HTTPMethod;
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+
+/// HTTP-сервер ESP8266 в объеме SmartLED.ino: один запрос на соединение (Connection: close), запрос целиком
+/// (заголовки и тело по Content-Length) разбирается за один вызов handleClient(), ответ пишется в сокет,
+/// write() которого ждет места так же, как на ESP (модель канала HostSocket::rate)
+class ESP8266WebServer
+{
+public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    ESP8266WebServer(uint16_t port = 80) : listener(port) {}
+    void begin() { listener.begin(); }
+    void handleClient();
+    void on(const String& uri, THandlerFunction handler) { on(uri, HTTP_ANY, handler); }
+    void on(const String& uri, HTTPMethod method, THandlerFunction handler) { routes.push_back({uri, method, handler}); }
+    void onNotFound(THandlerFunction handler) { notFound = handler; }
+    void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+
+    String uri() { return requestUri; }
+    HTTPMethod method() { return requestMethod; }
+    WiFiClient client() { return current; }
+    String arg(const String& name);
+    String arg(int i) { return ((i >= 0) && (i < args())) ? arguments[i].second : String(); }
+    String argName(int i) { return ((i >= 0) && (i < args())) ? arguments[i].first : String(); }
+    int args() { return arguments.size(); }
+    bool hasArg(const String& name);
+    String header(const String& name);
+    bool hasHeader(const String& name);
+
+    void send(int code, const char* contentType = NULL, const String& content = String());
+    void send(int code, const String& contentType, const String& content) { send(code, contentType.c_str(), content); }
+    void sendHeader(const String& name, const String& value, bool first = false);
+    void setContentLength(size_t length) { contentLength = length; }
+    void sendContent(const String& content) { current.write((const uint8_t*) content.c_str(), content.length()); }
+
+    /// файл целиком, write() ждет, пока сокет примет все
+    template<typename T> size_t streamFile(T& file, const String& contentType)
+    {
+        setContentLength(file.size());
+        if (String(file.name()).endsWith(".gz") && (contentType != "application/x-gzip") && (contentType != "application/octet-stream"))
+            sendHeader("Content-Encoding", "gzip");
+        send(200, contentType, "");
+        uint8_t buffer[1460];
+        size_t sent = 0;
+        size_t length;
+        while ((length = file.read(buffer, sizeof(buffer))) > 0)
+        {
+            size_t written = current.write(buffer, length);
+            sent += written;
+            if (written < length)
+                break;
+        }
+        return sent;
+    }
+
+private:
+    typedef struct
+    {
+        String uri;
+        HTTPMethod method;
+        THandlerFunction handler;
+    } Route;
+
+    WiFiServer listener;
+    WiFiClient current;
+    std::string request;                ///< принятая часть запроса current
+    std::vector<Route> routes;
+    THandlerFunction notFound;
+    std::vector<String> collected;      ///< имена заголовков, которые сохраняет разбор
+    String requestUri;
+    HTTPMethod requestMethod = HTTP_ANY;
+    std::vector<std::pair<String, String>> arguments;
+    std::vector<std::pair<String, String>> headers;
+    String responseHeaders;
+    size_t contentLength = CONTENT_LENGTH_NOT_SET;
+
+    bool parseRequest();
+    void parseArguments(const std::string& query);
+};
+
+#endif /* HOST_ESP8266WEBSERVER_H */
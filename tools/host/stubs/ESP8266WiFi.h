@@ -0,0 +1,176 @@
+#ifndef HOST_ESP8266WIFI_H
+#define HOST_ESP8266WIFI_H
+
+#include <Arduino.h>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/// соединение, видимое с двух сторон: программа читает rx и пишет в tx, тест - наоборот
+struct HostSocket
+{
+    std::deque<uint8_t> rx;             ///< данные от удаленной стороны, еще не прочитанные программой
+    std::vector<uint8_t> tx;            ///< данные, отправленные программой
+    size_t room = 2920;                 ///< сколько TCP примет без ожидания (availableForWrite)
+    /// модель канала: удаленная сторона забирает rate байт за мс виртуального времени, room растет до window,
+    /// а write() ждет места, как WiFiClient ESP8266 (0 - room освобождает только тест, write() не ждет)
+    uint32_t rate = 0;
+    size_t window = 2920;
+    uint32_t drainedAt = 0;             ///< время последнего освобождения room по rate, мкс
+    unsigned writes = 0;                ///< вызовов write() программы (каждый - отдельный пакет TCP без Nagle)
+    bool open = true;                   ///< удаленная сторона не закрыла соединение (после rx больше ничего не придет)
+    IPAddress remote = IPAddress(192, 168, 1, 100);
+    /// освободить room по модели канала
+    void drain()
+    {
+        if (!rate)
+            return;
+        uint32_t now = micros();
+        if (!drainedAt)
+            drainedAt = now;
+        uint64_t bytes = (uint64_t) (now - drainedAt) * rate / 1000;
+        if (bytes)
+        {
+            room = std::min(window, room + (size_t) std::min(bytes, (uint64_t) window));
+            drainedAt = now;
+        }
+    }
+};
+
+/// как долго write() ждет места по модели канала, мс
+#define HOST_WRITE_TIMEOUT 5000
+
+class Client : public Stream
+{
+};
+
+class WiFiClient : public Client
+{
+public:
+    WiFiClient() {}
+    WiFiClient(const std::shared_ptr<HostSocket>& s) : socket(s) {}
+    int connect(IPAddress ip, uint16_t port);
+    int connect(const char* host, uint16_t port);
+    uint8_t connected() { return socket && (socket->open || !socket->rx.empty()); }
+    operator bool() { return (bool) socket; }
+    int available() override { return socket ? socket->rx.size() : 0; }
+    int read() override
+    {
+        if (!socket || socket->rx.empty())
+            return -1;
+        uint8_t c = socket->rx.front();
+        socket->rx.pop_front();
+        return c;
+    }
+    int read(uint8_t* buffer, size_t size)
+    {
+        size_t n = 0;
+        while ((n < size) && socket && !socket->rx.empty())
+        {
+            buffer[n++] = socket->rx.front();
+            socket->rx.pop_front();
+        }
+        return n;
+    }
+    int peek() override { return (socket && !socket->rx.empty()) ? socket->rx.front() : -1; }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        if (!socket)
+            return 0;
+        socket->writes++;
+        size_t total = 0;
+        uint32_t progress = millis();
+        while (true)
+        {
+            socket->drain();
+            size_t n = std::min(size - total, socket->room);
+            socket->tx.insert(socket->tx.end(), buffer + total, buffer + total + n);
+            socket->room -= n;
+            total += n;
+            if (n)
+                progress = millis();
+            if ((total == size) || !socket->rate || !socket->open || (millis() - progress > HOST_WRITE_TIMEOUT))
+                return total;
+            delay(1);
+        }
+    }
+    using Print::write;
+    size_t availableForWrite()
+    {
+        if (!socket)
+            return 0;
+        socket->drain();
+        return socket->room;
+    }
+    void flush() override {}
+    void stop()
+    {
+        if (socket)
+            socket->open = false;
+        socket.reset();
+    }
+    void setNoDelay(bool) {}
+    IPAddress remoteIP() { return socket ? socket->remote : IPAddress(); }
+    std::shared_ptr<HostSocket> socket;
+};
+
+/// TLS на компьютере не проверяется
+class WiFiClientSecure : public WiFiClient
+{
+};
+
+class WiFiServer
+{
+public:
+    WiFiServer(uint16_t p) : port(p) {}
+    void begin() {}
+    void begin(uint16_t p) { port = p; }
+    void close() {}
+    void stop() {}
+    void setNoDelay(bool) {}
+    bool hasClient();
+    WiFiClient available();
+    uint16_t port;
+};
+
+#define WIFI_STA 1
+#define WL_CONNECTED 3
+
+class ESP8266WiFiClass
+{
+public:
+    bool mode(int) { return true; }
+    int begin(const char*, const char* = NULL) { return WL_CONNECTED; }
+    uint8_t status() { return WL_CONNECTED; }
+    bool disconnect(bool = false) { return true; }
+    IPAddress localIP() { return hostDevice ? hostDevice->ip : IPAddress(192, 168, 1, 10); }
+    int hostByName(const char* host, IPAddress& result, uint32_t timeout = 10000)
+    {
+        (void) timeout;
+        return result.fromString(host) ? 1 : 0;
+    }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+/// новое входящее соединение, WiFiServer::available() сервера на порту port отдаст его при следующем опросе
+std::shared_ptr<HostSocket> hostConnect(uint16_t port = 81);
+
+/// удаленный сервер для исходящих соединений (WiFiClient::connect): пока up, соединения к ip:port принимаются
+/// и их сокеты (со стороны программы) попадают в accepted; выключенный сервер не отвечает, connect() ждет
+/// setTimeout() и не соединяется
+struct HostListener
+{
+    IPAddress ip;
+    uint16_t port;
+    bool up = true;
+    std::vector<std::shared_ptr<HostSocket>> accepted;
+};
+
+/// начать принимать исходящие соединения программы, listener должен существовать, пока идут вызовы connect()
+void hostListen(HostListener* listener);
+/// перестать принимать соединения listener
+void hostUnlisten(HostListener* listener);
+
+#endif /* HOST_ESP8266WIFI_H */
@@ -0,0 +1,13 @@
+#ifndef HOST_ESP8266MDNS_H
+#define HOST_ESP8266MDNS_H
+
+#include <ESP8266WiFi.h>
+
+class MDNSResponder
+{
+public:
+    bool begin(const char*, IPAddress = IPAddress()) { return true; }
+    void update() {}
+};
+
+#endif /* HOST_ESP8266MDNS_H */
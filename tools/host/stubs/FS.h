@@ -0,0 +1,67 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <Arduino.h>
+#include <memory>
+#include <vector>
+
+typedef enum
+{
+    SeekSet,
+    SeekCur,
+    SeekEnd
+} SeekMode;
+
+/// файл SPIFFS: содержимое читается с диска целиком при открытии, запись не поддерживается
+class File : public Stream
+{
+public:
+    File() {}
+    File(const String& path, const std::shared_ptr<std::vector<uint8_t>>& content) : path(path), data(content) {}
+    size_t read(uint8_t* buffer, size_t size)
+    {
+        size_t n = data ? std::min(size, data->size() - offset) : 0;
+        if (n)
+            memcpy(buffer, data->data() + offset, n);
+        offset += n;
+        return n;
+    }
+    int read() override { return (data && (offset < data->size())) ? (*data)[offset++] : -1; }
+    int peek() override { return (data && (offset < data->size())) ? (*data)[offset] : -1; }
+    int available() override { return data ? data->size() - offset : 0; }
+    size_t write(uint8_t) override { return 0; }
+    using Print::write;
+    bool seek(uint32_t position, SeekMode mode = SeekSet)
+    {
+        if (!data)
+            return false;
+        size_t base = (mode == SeekSet) ? 0 : (mode == SeekCur) ? offset : data->size();
+        if (base + position > data->size())
+            return false;
+        offset = base + position;
+        return true;
+    }
+    size_t position() const { return offset; }
+    size_t size() const { return data ? data->size() : 0; }
+    const char* name() const { return path.c_str(); }
+    void close() { data.reset(); }
+    operator bool() const { return (bool) data; }
+
+private:
+    String path;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t offset = 0;
+};
+
+/// SPIFFS поверх каталога компьютера hostDataDir: путь "/lib/jq.js" - файл hostDataDir/lib/jq.js
+class FS
+{
+public:
+    bool begin() { return true; }
+    bool exists(const String& path);
+    File open(const String& path, const char* mode);
+};
+
+extern FS SPIFFS;
+
+#endif /* HOST_FS_H */
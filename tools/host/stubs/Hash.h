@@ -0,0 +1,10 @@
+#ifndef HOST_HASH_H
+#define HOST_HASH_H
+
+#include <Arduino.h>
+
+/// как Hash.h ядра ESP8266, реализация - libsha1 из библиотеки вебсокетов
+void sha1(const uint8_t* data, uint32_t size, uint8_t hash[20]);
+void sha1(const String& data, uint8_t hash[20]);
+
+#endif /* HOST_HASH_H */
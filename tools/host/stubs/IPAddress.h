@@ -0,0 +1,32 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+class IPAddress
+{
+public:
+    IPAddress() : address(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | (b << 8) | (c << 16) | ((uint32_t) d << 24)) {}
+    IPAddress(uint32_t value) : address(value) {}
+    operator uint32_t() const { return address; }
+    uint8_t operator[](int index) const { return (address >> (index * 8)) & 0xFF; }
+    bool operator==(const IPAddress& other) const { return address == other.address; }
+    bool operator!=(const IPAddress& other) const { return address != other.address; }
+    bool isSet() const { return address != 0; }
+    bool fromString(const char* text)
+    {
+        unsigned a, b, c, d;
+        char tail;
+        if ((sscanf(text, "%u.%u.%u.%u%c", &a, &b, &c, &d, &tail) != 4) || (a > 255) || (b > 255) || (c > 255) || (d > 255))
+            return false;
+        *this = IPAddress(a, b, c, d);
+        return true;
+    }
+
+private:
+    uint32_t address;
+};
+
+#endif /* HOST_IPADDRESS_H */
@@ -0,0 +1,6 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include <ESP8266WiFi.h>
+
+#endif /* HOST_WIFICLIENT_H */
@@ -0,0 +1,50 @@
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+/// пакетов в очереди сокета, лишние отбрасываются (как при нехватке буферов lwIP)
+#define HOST_UDP_QUEUE 32
+
+/// UDP внутри программы: пакет доставляется открытым сокетам с портом получателя - адресный сокетам устройства
+/// с адресом получателя (WiFi.localIP() при открытии), мультикаст - сокетам, подключенным к группе. Доставка
+/// мгновенная, сокет читает пакеты при следующем опросе
+class WiFiUDP
+{
+public:
+    WiFiUDP() {}
+    WiFiUDP(const WiFiUDP&) = delete;
+    WiFiUDP& operator=(const WiFiUDP&) = delete;
+    ~WiFiUDP() { stop(); }
+    uint8_t begin(uint16_t port);
+    uint8_t beginMulticast(IPAddress, IPAddress group, uint16_t port);
+    void stop();
+    int beginPacket(IPAddress ip, uint16_t port);
+    int beginPacketMulticast(IPAddress group, uint16_t port, IPAddress, int = 1) { return beginPacket(group, port); }
+    size_t write(const uint8_t* buffer, size_t size);
+    int endPacket();
+    int parsePacket();
+    int read(uint8_t* buffer, size_t size);
+    IPAddress remoteIP() { return current.source; }
+
+private:
+    typedef struct
+    {
+        IPAddress source;
+        std::vector<uint8_t> data;
+    } Packet;
+
+    uint16_t localPort = 0;             ///< 0 - сокет закрыт
+    IPAddress owner;                    ///< адрес устройства
+    IPAddress group;                    ///< мультикаст-группа или 0
+    std::deque<Packet> queue;           ///< принятые пакеты
+    Packet current;                     ///< пакет, который читает read()
+    size_t offset = 0;
+    IPAddress destination;
+    uint16_t destinationPort = 0;
+    std::vector<uint8_t> outgoing;
+};
+
+#endif /* HOST_WIFIUDP_H */
@@ -0,0 +1 @@
+// ядро ESP8266 без собственной libb64
@@ -0,0 +1,307 @@
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <EEPROM.h>
+#include <FS.h>
+#include <WiFiUdp.h>
+#include <Hash.h>
+#include <map>
+#include <sys/stat.h>
+
+extern "C" {
+#undef ESP8266
+#include "libsha1/libsha1.h"
+}
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+EEPROMClass EEPROM;
+FS SPIFFS;
+bool hostVerbose = false;
+std::string* hostSerialLog = NULL;
+int hostAnalogValue = 512;
+std::vector<HostShow>* hostShows = NULL;
+HostDevice* hostDevice = NULL;
+std::string hostDataDir = "data";
+
+static uint64_t hostClock = 1000000;    ///< виртуальное время, мкс
+static uint32_t hostRandom = 1;         ///< состояние random(), как rand() в newlib
+static uint32_t hostHardwareRandom = 0x12345678;
+static std::map<uint16_t, std::deque<std::shared_ptr<HostSocket>>> pendingConnections;
+static std::vector<HostListener*> hostListeners;
+static std::vector<WiFiUDP*> udpSockets;    ///< открытые сокеты UDP
+
+void hostAdvance(uint32_t us)
+{
+    hostClock += us;
+}
+
+uint64_t hostTime()
+{
+    return hostClock;
+}
+
+/// часы устройства hostDevice
+static uint64_t deviceClock()
+{
+    uint64_t now = hostClock++;
+    if (hostDevice)
+        now += (int64_t) now * hostDevice->ppm / 1000000 + hostDevice->offset;
+    return now;
+}
+
+uint32_t micros()
+{
+    return (uint32_t) deviceClock();
+}
+
+uint32_t millis()
+{
+    return (uint32_t) (deviceClock() / 1000);
+}
+
+void delay(uint32_t ms)
+{
+    hostClock += (uint64_t) ms * 1000;
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    hostClock += us;
+}
+
+void yield()
+{
+}
+
+void randomSeed(unsigned long seed)
+{
+    if (seed != 0)
+        hostRandom = seed;
+}
+
+long random(long howbig)
+{
+    if (howbig <= 0)
+        return 0;
+    hostRandom = hostRandom * 1103515245UL + 12345;
+    return ((hostRandom >> 16) & 0x7FFF) % howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+    if (howsmall >= howbig)
+        return howsmall;
+    return random(howbig - howsmall) + howsmall;
+}
+
+int analogRead(uint8_t pin)
+{
+    (void) pin;
+    return hostAnalogValue;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size)
+{
+    if (hostVerbose)
+        fwrite(buffer, 1, size, stderr);
+    if (hostSerialLog)
+        hostSerialLog->append((const char*) buffer, size);
+    return size;
+}
+
+uint32_t EspClass::getCycleCount()
+{
+    return (uint32_t) (deviceClock() * 80);
+}
+
+uint32_t EspClass::random()
+{
+    hostHardwareRandom ^= hostHardwareRandom << 13;
+    hostHardwareRandom ^= hostHardwareRandom >> 17;
+    hostHardwareRandom ^= hostHardwareRandom << 5;
+    return hostHardwareRandom;
+}
+
+void sha1(const uint8_t* data, uint32_t size, uint8_t hash[20])
+{
+    SHA1_CTX context;
+    SHA1Init(&context);
+    SHA1Update(&context, data, size);
+    SHA1Final(hash, &context);
+}
+
+void sha1(const String& data, uint8_t hash[20])
+{
+    sha1((const uint8_t*) data.c_str(), data.length(), hash);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+    socket.reset();
+    for (HostListener* listener : hostListeners)
+    {
+        if (!(listener->ip == ip) || (listener->port != port))
+            continue;
+        if (!listener->up)
+            break;
+        socket = std::make_shared<HostSocket>();
+        socket->remote = ip;
+        listener->accepted.push_back(socket);
+        return 1;
+    }
+    /// ответа нет: connect() на ESP ждет до таймаута
+    delay(streamTimeout);
+    return 0;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port)
+{
+    IPAddress ip;
+    if (!WiFi.hostByName(host, ip))
+        return 0;
+    return connect(ip, port);
+}
+
+void hostListen(HostListener* listener)
+{
+    hostListeners.push_back(listener);
+}
+
+void hostUnlisten(HostListener* listener)
+{
+    hostListeners.erase(std::remove(hostListeners.begin(), hostListeners.end(), listener), hostListeners.end());
+}
+
+bool WiFiServer::hasClient()
+{
+    return !pendingConnections[port].empty();
+}
+
+WiFiClient WiFiServer::available()
+{
+    std::deque<std::shared_ptr<HostSocket>>& pending = pendingConnections[port];
+    if (pending.empty())
+        return WiFiClient();
+    WiFiClient client(pending.front());
+    pending.pop_front();
+    return client;
+}
+
+std::shared_ptr<HostSocket> hostConnect(uint16_t port)
+{
+    std::shared_ptr<HostSocket> socket = std::make_shared<HostSocket>();
+    pendingConnections[port].push_back(socket);
+    return socket;
+}
+
+extern "C" void espShow(uint16_t pin, uint8_t* pixels, uint32_t numBytes, uint8_t type)
+{
+    (void) pin;
+    (void) type;
+    if (!hostShows)
+        return;
+    uint32_t digest = 2166136261u;
+    for (uint32_t i = 0; i < numBytes; i++)
+        digest = (digest ^ pixels[i]) * 16777619u;
+    hostShows->push_back({(uint32_t) hostClock, digest});
+}
+
+bool FS::exists(const String& path)
+{
+    struct stat info;
+    return !stat((hostDataDir + path.c_str()).c_str(), &info) && S_ISREG(info.st_mode);
+}
+
+File FS::open(const String& path, const char* mode)
+{
+    if (strcmp(mode, "r") || !exists(path))
+        return File();
+    FILE* file = fopen((hostDataDir + path.c_str()).c_str(), "rb");
+    if (!file)
+        return File();
+    std::shared_ptr<std::vector<uint8_t>> content = std::make_shared<std::vector<uint8_t>>();
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        content->insert(content->end(), buffer, buffer + length);
+    fclose(file);
+    return File(path, content);
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+    stop();
+    localPort = port;
+    owner = WiFi.localIP();
+    group = IPAddress();
+    udpSockets.push_back(this);
+    return 1;
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress, IPAddress multicast, uint16_t port)
+{
+    begin(port);
+    group = multicast;
+    return 1;
+}
+
+void WiFiUDP::stop()
+{
+    if (!localPort)
+        return;
+    udpSockets.erase(std::find(udpSockets.begin(), udpSockets.end(), this));
+    localPort = 0;
+    queue.clear();
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+    destination = ip;
+    destinationPort = port;
+    outgoing.clear();
+    return 1;
+}
+
+size_t WiFiUDP::write(const uint8_t* buffer, size_t size)
+{
+    outgoing.insert(outgoing.end(), buffer, buffer + size);
+    return size;
+}
+
+int WiFiUDP::endPacket()
+{
+    bool multicast = (destination[0] >= 224) && (destination[0] <= 239);
+    for (WiFiUDP* socket : udpSockets)
+    {
+        if ((socket->localPort != destinationPort) || (multicast ? (socket->group != destination) : (socket->owner != destination)))
+            continue;
+        if (socket->queue.size() < HOST_UDP_QUEUE)
+            socket->queue.push_back({WiFi.localIP(), outgoing});
+    }
+    outgoing.clear();
+    return 1;
+}
+
+int WiFiUDP::parsePacket()
+{
+    if (queue.empty())
+        return 0;
+    current = queue.front();
+    queue.pop_front();
+    offset = 0;
+    return current.data.size();
+}
+
+int WiFiUDP::read(uint8_t* buffer, size_t size)
+{
+    size_t n = std::min(size, current.data.size() - offset);
+    memcpy(buffer, current.data.data() + offset, n);
+    offset += n;
+    return n;
+}
@@ -0,0 +1,42 @@
+#ifndef HOST_HOST_H
+#define HOST_HOST_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "IPAddress.h"
+
+/// вывод на ленту
+typedef struct
+{
+    uint32_t time;                      ///< виртуальное время (без часов устройства), мкс
+    uint32_t digest;                    ///< FNV-1a байтов пикселей
+} HostShow;
+
+/// устройство в программе с несколькими SmartLED (синхронизация, распределенный вывод): свои часы и адрес
+typedef struct
+{
+    IPAddress ip;                       ///< WiFi.localIP(), адрес сокетов UDP устройства
+    uint32_t offset;                    ///< смещение часов от виртуального времени, мкс
+    int32_t ppm;                        ///< уход часов, миллионные доли
+} HostDevice;
+
+/// продвинуть виртуальное время
+void hostAdvance(uint32_t us);
+/// виртуальное время без часов устройства и без продвижения, мкс
+uint64_t hostTime();
+/// печатать вывод Serial в stderr
+extern bool hostVerbose;
+/// если не NULL, вывод Serial дописывается сюда (проверки того, что программа сообщила)
+extern std::string* hostSerialLog;
+/// значение, которое возвращает analogRead()
+extern int hostAnalogValue;
+/// если не NULL, сюда записывается каждый вывод на ленту
+extern std::vector<HostShow>* hostShows;
+/// устройство, от имени которого выполняется код: micros(), millis(), getCycleCount() идут по его часам, WiFi.localIP() -
+/// его адрес (NULL - единственное устройство 192.168.1.10 с часами без ухода)
+extern HostDevice* hostDevice;
+/// каталог, который SPIFFS отдает как корень файловой системы
+extern std::string hostDataDir;
+
+#endif /* HOST_HOST_H */
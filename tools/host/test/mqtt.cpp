@@ -0,0 +1,488 @@
+// Тест MQTT SmartLED.ino с брокером-заглушкой (MQTT 3.1.1, QoS 0) на исходящих соединениях HostListener. Скетч
+// собирается на компьютере и подключается к брокеру TEST_BROKER. Проверяется:
+//   - CONNECT (версия, clean session, keep alive, завещание "offline" с retain) и SUBSCRIBE на smartled/room/set/+;
+//   - публикации состояния: только retained, серия изменений дает не больше двух сообщений, последнее совпадает
+//     с текущим состоянием (writeState), без изменений ничего не публикуется;
+//   - PINGREQ молчащему брокеру, пока состояние публикуется непрерывно (не реже раза в половину keep alive,
+//     сессия не рвется), и обрыв с повторным подключением, если брокер перестал отвечать;
+//   - задержка от команды set/palette до кадра с другим хешем пикселей (печатается).
+// Время виртуальное: loop() стоит delay(2), как на ESP, вычисления времени не занимают, поэтому задержка команды -
+// ожидание ближайшего прохода loop().
+//
+//   make -C tools/host check
+
+#include <smartled.h>
+#include <mqtt.h>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#define TEST_BROKER "192.168.1.2"
+#define TEST_SPEED "80"                 ///< скорость радуги: шаг около 21 мс
+#define TEST_BURST 20                   ///< изменений в серии
+#define TEST_BURST_STEP 10              ///< пауза между изменениями серии, мс
+#define TEST_PUBLISHING 30000           ///< время непрерывной публикации состояния без входящих пакетов, мс
+#define TEST_COMMANDS 20                ///< команд для замера задержки
+#define TEST_PUBLISH_INTERVAL 250       ///< как MQTT_PUBLISH_INTERVAL в SmartLED.ino, мс
+#define TEST_LOOP_DELAY 2               ///< delay() в конце loop() SmartLED.ino, мс
+
+extern const char* mqttBroker;
+extern SmartLED* smart;
+void setup();
+void loop();
+
+/// пакет, принятый брокером
+typedef struct
+{
+    uint8_t header;
+    std::string body;
+    uint64_t time;                      ///< виртуальное время, мкс
+} Packet;
+
+/// брокер-заглушка: одна сессия, retained-сообщения, подписки клиента, ответы на CONNECT, SUBSCRIBE и PINGREQ
+class Broker
+{
+public:
+    HostListener listener;
+    bool answerPings = true;            ///< false - брокер молчит и на PINGREQ
+    std::shared_ptr<HostSocket> socket; ///< сокет текущей сессии
+    std::map<std::string, std::string> retained;
+    std::vector<std::string> filters;   ///< подписки текущей сессии
+    std::vector<Packet> packets;        ///< все пакеты клиента
+    std::vector<std::string> errors;
+    std::string willTopic;
+    std::string willMessage;
+    unsigned connects = 0;
+    unsigned closed = 0;                ///< сессий, закрытых клиентом
+    uint64_t lastSent = 0;              ///< время последнего пакета брокера, мкс
+
+    /// принять новые соединения, разобрать пакеты клиента и ответить
+    void poll()
+    {
+        while (!listener.accepted.empty())
+        {
+            if (socket)
+                error("a new connection while the previous one is open");
+            socket = listener.accepted.front();
+            /// канал быстрее, чем MQTT успевает писать, write() не упирается в room
+            socket->rate = 1000;
+            listener.accepted.erase(listener.accepted.begin());
+            filters.clear();
+        }
+        if (!socket)
+            return;
+        size_t used;
+        while ((used = parse()) > 0)
+            socket->tx.erase(socket->tx.begin(), socket->tx.begin() + used);
+        if (!socket->open)
+        {
+            /// обрыв без DISCONNECT: брокер публикует завещание
+            if (!willTopic.empty())
+                retained[willTopic] = willMessage;
+            closed++;
+            socket.reset();
+        }
+    }
+
+    /// отправить PUBLISH клиенту, если топик подходит под его подписку
+    bool publish(const std::string& topic, const std::string& payload)
+    {
+        bool subscribed = false;
+        for (const std::string& filter : filters)
+            subscribed = subscribed || matches(filter, topic);
+        if (!socket || !subscribed)
+            return false;
+        std::string body = string(topic) + payload;
+        send(0x30, body);
+        return true;
+    }
+
+    /// публикации состояния с номера пакета from
+    std::vector<const Packet*> statePublishes(size_t from = 0)
+    {
+        std::vector<const Packet*> publishes;
+        for (size_t i = from; i < packets.size(); i++)
+            if (((packets[i].header & 0xF0) == 0x30) && (topic(packets[i]) == "smartled/room/state"))
+                publishes.push_back(&packets[i]);
+        return publishes;
+    }
+
+    /// времена PINGREQ с номера пакета from
+    std::vector<uint64_t> pings(size_t from = 0)
+    {
+        std::vector<uint64_t> times;
+        for (size_t i = from; i < packets.size(); i++)
+            if (packets[i].header == 0xC0)
+                times.push_back(packets[i].time);
+        return times;
+    }
+
+    static std::string topic(const Packet& packet)
+    {
+        size_t length = ((uint8_t) packet.body[0] << 8) | (uint8_t) packet.body[1];
+        return packet.body.substr(2, length);
+    }
+
+    static std::string payload(const Packet& packet)
+    {
+        size_t length = ((uint8_t) packet.body[0] << 8) | (uint8_t) packet.body[1];
+        return packet.body.substr(2 + length);
+    }
+
+private:
+    void error(const std::string& text)
+    {
+        errors.push_back(text);
+    }
+
+    /// строка с двухбайтовой длиной
+    static std::string string(const std::string& text)
+    {
+        return std::string(1, (char) (text.size() >> 8)) + (char) (text.size() & 0xFF) + text;
+    }
+
+    /// фильтр подписки: + - один уровень, # - остаток топика
+    static bool matches(const std::string& filter, const std::string& topic)
+    {
+        size_t f = 0;
+        size_t t = 0;
+        while (f < filter.size())
+        {
+            if (filter[f] == '#')
+                return true;
+            if (filter[f] == '+')
+            {
+                while ((t < topic.size()) && (topic[t] != '/'))
+                    t++;
+                f++;
+                continue;
+            }
+            if ((t >= topic.size()) || (filter[f] != topic[t]))
+                return false;
+            f++;
+            t++;
+        }
+        return t == topic.size();
+    }
+
+    void send(uint8_t header, const std::string& body)
+    {
+        std::string packet(1, (char) header);
+        size_t length = body.size();
+        do
+        {
+            uint8_t lengthByte = length & 0x7F;
+            length >>= 7;
+            packet += (char) (lengthByte | ((length > 0) ? 0x80 : 0));
+        } while (length > 0);
+        packet += body;
+        socket->rx.insert(socket->rx.end(), packet.begin(), packet.end());
+        lastSent = hostTime();
+    }
+
+    /// разобрать один пакет в начале tx
+    /// @return длина пакета, 0 - пакет еще не пришел целиком
+    size_t parse()
+    {
+        const std::vector<uint8_t>& tx = socket->tx;
+        size_t at = 1;
+        size_t length = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            if (at >= tx.size())
+                return 0;
+            length |= (size_t) (tx[at] & 0x7F) << shift;
+            if (!(tx[at++] & 0x80))
+                break;
+        }
+        if (tx.size() < at + length)
+            return 0;
+        Packet packet = {tx[0], std::string(tx.begin() + at, tx.begin() + at + length), hostTime()};
+        packets.push_back(packet);
+        handle(packet);
+        return at + length;
+    }
+
+    void handle(const Packet& packet)
+    {
+        const std::string& body = packet.body;
+        switch (packet.header & 0xF0)
+        {
+            case 0x10:
+            {
+                connects++;
+                /// "MQTT", уровень 4, флаги, keep alive, идентификатор, топик и сообщение завещания
+                if ((body.compare(0, 6, std::string("\0\4MQTT", 6)) != 0) || (body.size() < 12) || (body[6] != 4))
+                {
+                    error("CONNECT: not MQTT 3.1.1");
+                    break;
+                }
+                uint8_t flags = body[7];
+                uint16_t keepAlive = ((uint8_t) body[8] << 8) | (uint8_t) body[9];
+                if (flags != 0x26)
+                    error("CONNECT: flags " + std::to_string(flags) + ", expected clean session and a retained QoS 0 will");
+                if (keepAlive != MQTT_KEEPALIVE)
+                    error("CONNECT: keep alive " + std::to_string(keepAlive));
+                std::vector<std::string> fields;
+                for (size_t at = 10; at + 2 <= body.size(); )
+                {
+                    size_t length = ((uint8_t) body[at] << 8) | (uint8_t) body[at + 1];
+                    fields.push_back(body.substr(at + 2, length));
+                    at += 2 + length;
+                }
+                if ((fields.size() != 3) || (fields[0] != "room") || (fields[1] != "smartled/room/status") || (fields[2] != "offline"))
+                {
+                    error("CONNECT: expected client id room and the will smartled/room/status offline");
+                    break;
+                }
+                willTopic = fields[1];
+                willMessage = fields[2];
+                send(0x20, std::string("\0\0", 2));
+                break;
+            }
+            case 0x80:
+            {
+                if ((packet.header != 0x82) || (body.size() < 5))
+                {
+                    error("SUBSCRIBE: malformed");
+                    break;
+                }
+                std::string granted;
+                for (size_t at = 2; at + 3 <= body.size(); )
+                {
+                    size_t length = ((uint8_t) body[at] << 8) | (uint8_t) body[at + 1];
+                    filters.push_back(body.substr(at + 2, length));
+                    if (body[at + 2 + length] != 0)
+                        error("SUBSCRIBE: QoS above 0");
+                    granted += '\0';
+                    at += 3 + length;
+                }
+                send(0x90, body.substr(0, 2) + granted);
+                break;
+            }
+            case 0x30:
+                if (packet.header & 0x06)
+                    error("PUBLISH: QoS above 0");
+                else if (packet.header & 0x01)
+                    retained[topic(packet)] = payload(packet);
+                else if (topic(packet).compare(0, 13, "smartled/room") == 0)
+                    error("PUBLISH: " + topic(packet) + " is not retained");
+                break;
+            case 0xC0:
+                if (answerPings)
+                    send(0xD0, std::string());
+                break;
+            default:
+                error("unexpected packet " + std::to_string(packet.header));
+        }
+    }
+};
+
+static Broker broker;
+
+/// проходы loop() с брокером в течение ms, each - перед каждым проходом
+static void run(uint32_t ms, const std::function<void()>& each = nullptr)
+{
+    uint32_t start = millis();
+    while (millis() - start < ms)
+    {
+        if (each)
+            each();
+        loop();
+        broker.poll();
+    }
+}
+
+/// текущее состояние в том виде, в каком его публикует скетч
+static std::string state()
+{
+    struct Text : public Print
+    {
+        std::string text;
+        size_t write(uint8_t c) override { text += (char) c; return 1; }
+        using Print::write;
+    } text;
+    JsonWriter json(&text);
+    smart->writeState(json);
+    json.flush();
+    return text.text;
+}
+
+static void option(const char* name, const char* value)
+{
+    char optionName[16];
+    char optionValue[16];
+    strncpy(optionName, name, sizeof(optionName));
+    strncpy(optionValue, value, sizeof(optionValue));
+    smart->setOption(optionName, optionValue);
+}
+
+static int result = 0;
+
+static void check(bool condition, const char* format, ...) __attribute__ ((format (printf, 2, 3)));
+static void check(bool condition, const char* format, ...)
+{
+    if (condition)
+        return;
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    result = 1;
+}
+
+/// сессия: CONNECT, SUBSCRIBE, статус и состояние после подключения
+static void testSession()
+{
+    run(1000);
+    check(broker.connects == 1, "%u CONNECT packets", broker.connects);
+    check((broker.filters.size() == 1) && (broker.filters[0] == "smartled/room/set/+"), "the client did not subscribe to smartled/room/set/+");
+    check(broker.retained["smartled/room/status"] == "online", "the status is not online");
+    check(broker.retained["smartled/room/state"] == state(), "the retained state is not the current state");
+}
+
+/// серия изменений дает не больше двух публикаций, без изменений публикаций нет
+static void testCoalescing()
+{
+    size_t from = broker.packets.size();
+    run(1000);
+    check(broker.statePublishes(from).empty(), "the state was published without changes");
+    from = broker.packets.size();
+    for (int i = 0; i < TEST_BURST; i++)
+    {
+        option("speed", std::to_string(50 + i).c_str());
+        run(TEST_BURST_STEP);
+    }
+    run(1000);
+    size_t publishes = broker.statePublishes(from).size();
+    check((publishes >= 1) && (publishes <= 2), "%d changes in %d ms gave %zu state messages", TEST_BURST,
+          TEST_BURST * TEST_BURST_STEP, publishes);
+    check(broker.retained["smartled/room/state"] == state(), "the retained state is not the last change");
+    printf("mqtt: %d changes in %d ms, %zu retained state messages\n", TEST_BURST, TEST_BURST * TEST_BURST_STEP, publishes);
+}
+
+/// брокер молчит (отвечает только на PINGREQ), а состояние публикуется непрерывно: клиент опрашивает брокер
+/// не реже раза в половину keep alive и не рвет сессию
+static void testPingWhilePublishing()
+{
+    size_t from = broker.packets.size();
+    uint64_t start = hostTime();
+    uint32_t lastChange = 0;
+    int value = 0;
+    run(TEST_PUBLISHING, [&]()
+    {
+        if (millis() - lastChange >= 100)
+        {
+            option("speed", std::to_string(50 + (value++ % 20)).c_str());
+            lastChange = millis();
+        }
+    });
+    std::vector<uint64_t> pings = broker.pings(from);
+    uint64_t longest = 0;
+    uint64_t previous = start;
+    for (uint64_t ping : pings)
+    {
+        longest = std::max(longest, ping - previous);
+        previous = ping;
+    }
+    longest = std::max(longest, hostTime() - previous);
+    size_t publishes = broker.statePublishes(from).size();
+    check(broker.connects == 1, "the session was torn down while publishing (%u CONNECT packets)", broker.connects);
+    check(publishes >= TEST_PUBLISHING / TEST_PUBLISH_INTERVAL / 2, "only %zu state messages in %d ms", publishes, TEST_PUBLISHING);
+    check(longest <= MQTT_KEEPALIVE * 500000ULL + 100000, "%llu ms without PINGREQ", (unsigned long long) longest / 1000);
+    printf("mqtt: %zu state messages in %d ms, %zu PINGREQ, longest gap %llu ms\n", publishes, TEST_PUBLISHING,
+           pings.size(), (unsigned long long) longest / 1000);
+}
+
+/// задержка от публикации set/palette до кадра с другим хешем: палитра 0 (своя) черная, 1 - цветная
+static void testCommandLatency()
+{
+    option("speed", TEST_SPEED);
+    std::vector<HostShow> shows;
+    hostShows = &shows;
+    run(500);
+    uint32_t black = shows.back().digest;
+    std::vector<uint32_t> latencies;
+    std::minstd_rand random;
+    for (int i = 0; i < TEST_COMMANDS; i++)
+    {
+        bool colored = !(i & 1);
+        shows.clear();
+        /// пакет приходит в случайный момент delay(2) прошлого прохода loop(), разбирается на следующем
+        uint32_t published = (uint32_t) hostTime() - random() % (TEST_LOOP_DELAY * 1000);
+        check(broker.publish("smartled/room/set/palette", colored ? "1" : "0"), "no subscription for set/palette");
+        uint32_t start = millis();
+        size_t seen = 0;
+        bool changed = false;
+        while (!changed && (millis() - start < 1000))
+        {
+            run(1);
+            for (; seen < shows.size(); seen++)
+            {
+                if ((shows[seen].digest != black) == colored)
+                {
+                    latencies.push_back(shows[seen].time - published);
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        check(changed, "set/palette %s did not change the frame", colored ? "1" : "0");
+        run(200);
+    }
+    hostShows = NULL;
+    if (latencies.empty())
+        return;
+    std::sort(latencies.begin(), latencies.end());
+    /// команда выводится на ближайшем проходе, а не на следующем шаге эффекта
+    check(latencies.back() < (TEST_LOOP_DELAY + 1) * 1000, "a command took %u us to reach the pixels", latencies.back());
+    printf("mqtt: command to changed frame %u us median, %u us max (%zu commands)\n",
+           latencies[latencies.size() / 2], latencies.back(), latencies.size());
+}
+
+/// брокер перестал отвечать: клиент рвет сессию через полтора keep alive, брокер публикует завещание,
+/// после восстановления клиент подключается снова и снова публикует статус
+static void testDeadBroker()
+{
+    broker.answerPings = false;
+    uint64_t silentFrom = broker.lastSent;
+    uint32_t start = millis();
+    while (!broker.closed && (millis() - start < MQTT_KEEPALIVE * 3000))
+        run(10);
+    uint64_t silence = hostTime() - silentFrom;
+    check(broker.closed == 1, "the client kept the session with a dead broker");
+    check((silence >= MQTT_KEEPALIVE * 1500000ULL) && (silence <= MQTT_KEEPALIVE * 1500000ULL + 100000),
+          "the session was dropped after %llu ms of silence", (unsigned long long) silence / 1000);
+    check(broker.retained["smartled/room/status"] == "offline", "no will after the session was dropped");
+    broker.answerPings = true;
+    run(MQTT_RECONNECT_INTERVAL + 1000);
+    check(broker.connects == 2, "%u CONNECT packets after the broker came back", broker.connects);
+    check(broker.retained["smartled/room/status"] == "online", "the status is not online after reconnecting");
+    check(broker.retained["smartled/room/state"] == state(), "the state was not published after reconnecting");
+    printf("mqtt: session dropped after %llu ms of silence, reconnected\n", (unsigned long long) silence / 1000);
+}
+
+int main()
+{
+    broker.listener.ip.fromString(TEST_BROKER);
+    broker.listener.port = MQTT_PORT;
+    hostListen(&broker.listener);
+    mqttBroker = TEST_BROKER;
+    setup();
+    smart->selectMode("rainbow");
+    option("speed", TEST_SPEED);
+
+    testSession();
+    testCoalescing();
+    testPingWhilePublishing();
+    testCommandLatency();
+    testDeadBroker();
+    for (const std::string& error : broker.errors)
+        check(false, "broker: %s", error.c_str());
+    hostUnlisten(&broker.listener);
+    return result;
+}
@@ -0,0 +1,104 @@
+// Тест отправки значений SmartLED::sendValue: каждое значение уходит клиенту одним вызовом write() (заголовок
+// пишется перед текстом в запас WEBSOCKETS_MAX_HEADER_SIZE, headerToPayload) без malloc и без ws_malloc, и
+// при рассылке всем клиентам (allClients) - по одному write() на клиента. Проверяются все перегрузки,
+// клиент без сжатия и клиент с permessage-deflate (значения короче WEBSOCKETS_DEFLATE_MIN_SIZE не сжимаются).
+// Собирается без санитайзеров, вызовы malloc считает heapcount.cpp.
+//
+//   make -C tools/host check
+
+#include <smartled.h>
+#include "../heapcount.h"
+#include "../wsclient.h"
+
+/// подключенный клиент после того, как сервер отправил ему состояние
+static std::shared_ptr<HostSocket> connect(SmartLED& led, bool deflate)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect();
+    std::string request = wsUpgradeRequest(deflate);
+    socket->rx.assign(request.begin(), request.end());
+    for (int pass = 0; pass < 200; pass++)
+    {
+        led.process();
+        socket->tx.clear();
+        socket->room = 2920;
+        hostAdvance(1000);
+    }
+    return socket;
+}
+
+typedef struct
+{
+    const char* name;
+    std::function<void(uint8_t num)> send;
+    const char* expected;               ///< сообщение, которое должен получить клиент
+} Value;
+
+int main()
+{
+    if (!heapCountWorks())
+    {
+        fprintf(stderr, "malloc is not intercepted\n");
+        return 2;
+    }
+    SmartLED led(30, 2, NEO_GRB, false);
+    std::shared_ptr<HostSocket> sockets[] = {connect(led, false), connect(led, true)};
+    RGBValue rgb = {1, 2, 3};
+    RGBFloat rgbFloat;
+    rgbFloat.r[0] = 40;
+    rgbFloat.g[0] = 50;
+    rgbFloat.b[0] = 60;
+    std::string longText(100, 'x');
+    const Value values[] = {
+        {"int32_t", [&](uint8_t num) { led.sendValue(num, "memory", "heap", (int32_t) -12345); }, "memory:heap:-12345"},
+        {"bool", [&](uint8_t num) { led.sendValue(num, "waves", "isRandom", true); }, "waves:isRandom:true"},
+        {"RGBColor", [&](uint8_t num) { led.sendValue(num, "rainbow", "color3", RGBColor {255, 128, 0}); }, "rainbow:color3:255;128;0"},
+        {"RGBValue", [&](uint8_t num) { led.sendValue(num, "waves", "low", rgb); }, "waves:low:1;2;3"},
+        {"RGBFloat", [&](uint8_t num) { led.sendValue(num, "plasma", "color", rgbFloat); }, "plasma:color:40;50;60"},
+        {"text", [&](uint8_t num) { led.sendValue(num, "text", "text", "Hello"); }, "text:text:Hello"},
+        /// длинное значение обрезается до 79 символов, но уходит тем же путем
+        {"long", [&](uint8_t num) { led.sendValue(num, "text", "text", longText.c_str()); }, NULL}
+    };
+    int result = 0;
+    for (const Value& value : values)
+    {
+        for (uint8_t num = 0; num <= 2; num++)
+        {
+            /// 0 и 1 - клиенты без сжатия и со сжатием, 2 - рассылка всем
+            uint8_t target = (num < 2) ? num : SmartLED::allClients;
+            for (std::shared_ptr<HostSocket>& socket : sockets)
+            {
+                socket->tx.clear();
+                socket->writes = 0;
+            }
+            WSmemStats_t before = ws_memStats(WSmem_library);
+            heapAllocs = 0;
+            heapCounting = true;
+            value.send(target);
+            heapCounting = false;
+            WSmemStats_t after = ws_memStats(WSmem_library);
+            unsigned long wsAllocs = (after.allocs - before.allocs) + (after.failures - before.failures);
+            for (uint8_t s = 0; s < 2; s++)
+            {
+                bool addressed = (target == SmartLED::allClients) || (target == s);
+                unsigned expectedWrites = addressed ? 1 : 0;
+                std::vector<std::string> messages = wsServerMessages(sockets[s]->tx, false);
+                bool received = addressed ? ((messages.size() == 1) && (!value.expected || (messages[0] == value.expected)))
+                                          : messages.empty();
+                if ((sockets[s]->writes != expectedWrites) || !received)
+                {
+                    fprintf(stderr, "FAIL: %s to %u: client %u got %u writes, %zu messages\n", value.name, target, s,
+                            sockets[s]->writes, messages.size());
+                    result = 1;
+                }
+            }
+            if (heapAllocs || wsAllocs)
+            {
+                fprintf(stderr, "FAIL: %s to %u: %lu malloc, %lu ws_malloc\n", value.name, target, heapAllocs, wsAllocs);
+                result = 1;
+            }
+        }
+    }
+    if (!result)
+        printf("sendValue: %zu values, one write() per client, no malloc or ws_malloc\n", sizeof(values) / sizeof(values[0]));
+    return result;
+}
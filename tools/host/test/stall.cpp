@@ -0,0 +1,174 @@
+// Тест очереди отправки WebSocketsServer (WEBSOCKETS_USE_SEND_QUEUE, опрос WiFiServer) с зависшим клиентом:
+// сокет не принимает ни байта (availableForWrite() == 0). Проверяется, что loop() не ждет сокет (ни одного
+// прохода дольше TEST_PASS_LIMIT виртуального времени), кадры сверх очереди отбрасываются и считаются в
+// txDropped, потерянная часть фрагментированного сообщения ставит txBroken и отключает клиента, клиент,
+// который не принимает данные WEBSOCKETS_SEND_STALL_TIMEOUT мс, отключается, а после освобождения сокета
+// очередь досылается и приложение получает WStype_DROPPED.
+//
+//   make -C tools/host check
+
+#include <WebSocketsServer.h>
+#include "../wsclient.h"
+
+#define TEST_PASS_LIMIT 1000            ///< самый долгий допустимый проход loop(), мкс виртуального времени
+#define TEST_MESSAGE 200                ///< длина сообщения, байт
+#define TEST_STEP 100                   ///< шаг виртуального времени между проходами, мс
+
+/// доступ к таблице клиентов и к отправке фрагментов
+class Server : public WebSocketsServer
+{
+public:
+    Server() : WebSocketsServer(81, "", "arduino") {}
+    using WebSocketsServer::clientIsConnected;
+    WSclient_t* client(uint8_t num) { return &_clients[num]; }
+    bool sendFragment(uint8_t num, WSopcode_t opcode, const std::string& payload, bool fin)
+    {
+        return sendFrame(&_clients[num], opcode, (uint8_t*) payload.data(), payload.size(), fin);
+    }
+};
+
+static Server* server;
+static int connects, disconnects, drops;
+static uint8_t lastNum;
+static uint32_t longestPass;
+
+static void event(uint8_t num, WStype_t type, uint8_t* payload, size_t length)
+{
+    (void) payload;
+    (void) length;
+    lastNum = num;
+    if (type == WStype_CONNECTED)
+        connects++;
+    else if (type == WStype_DISCONNECTED)
+        disconnects++;
+    else if (type == WStype_DROPPED)
+        drops++;
+}
+
+/// проход loop() с замером виртуального времени
+static void pass()
+{
+    uint32_t start = micros();
+    server->loop();
+    uint32_t spent = micros() - start;
+    if (spent > longestPass)
+        longestPass = spent;
+}
+
+#define CHECK(condition, ...) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "FAIL: " __VA_ARGS__); \
+            fputc('\n', stderr); \
+            return 1; \
+        } \
+    } while (0)
+
+/// подключенный клиент, после ответа сервера (он остается в tx) сокет перестает принимать данные
+static std::shared_ptr<HostSocket> stalledClient(uint8_t& num)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect();
+    std::string request = wsUpgradeRequest(false);
+    socket->rx.assign(request.begin(), request.end());
+    int before = connects;
+    for (int i = 0; (i < 100) && (connects == before); i++)
+        pass();
+    if (connects == before)
+        return NULL;
+    num = lastNum;
+    socket->room = 0;
+    return socket;
+}
+
+/// сообщения сверх очереди отбрасываются и считаются, клиент остается подключенным
+static int testDropped()
+{
+    uint8_t num;
+    std::shared_ptr<HostSocket> socket = stalledClient(num);
+    CHECK(socket, "no connection");
+    WSclient_t* client = server->client(num);
+    size_t response = socket->tx.size();
+    std::string message(TEST_MESSAGE, 'x');
+    int queued = 0, dropped = 0;
+    for (int i = 0; i < 20; i++)
+    {
+        if (server->sendTXT(num, message.c_str(), message.size()))
+            queued++;
+        else
+            dropped++;
+        pass();
+    }
+    CHECK(queued == WEBSOCKETS_SEND_QUEUE_SIZE / (TEST_MESSAGE + 4), "%d messages queued", queued);
+    CHECK(dropped && (client->txDropped == (uint32_t) dropped), "%d messages dropped, txDropped %u", dropped, client->txDropped);
+    CHECK(!client->txBroken, "txBroken set by whole messages");
+    CHECK(socket->tx.size() == response, "the stalled socket took data");
+    CHECK(!disconnects && server->clientIsConnected(client), "the client was disconnected before the stall timeout");
+    /// клиент снова принимает: очередь досылается, приложение узнает о потерях
+    socket->room = 65536;
+    for (int i = 0; (i < 10) && !drops; i++)
+        pass();
+    CHECK(drops == 1, "no WStype_DROPPED after the queue drained");
+    CHECK(!client->txDropped && !client->txLength, "txDropped %u, %u bytes queued after draining", client->txDropped, client->txLength);
+    CHECK(socket->tx.size() - response == (size_t) queued * (TEST_MESSAGE + 4), "%zu bytes sent, %d messages queued", socket->tx.size() - response, queued);
+    CHECK(wsServerMessages(socket->tx).size() == (size_t) queued, "the queued messages are damaged");
+    server->disconnect(num);
+    disconnects = 0;
+    return 0;
+}
+
+/// потерянная часть фрагментированного сообщения ставит txBroken, клиент отключается на следующем проходе
+static int testBroken()
+{
+    uint8_t num;
+    std::shared_ptr<HostSocket> socket = stalledClient(num);
+    CHECK(socket, "no connection");
+    WSclient_t* client = server->client(num);
+    std::string part(WEBSOCKETS_SEND_QUEUE_SIZE / 2, 'x');
+    CHECK(server->sendFragment(num, WSop_text, part, false), "the first fragment was not queued");
+    CHECK(!client->txBroken, "txBroken set by a queued fragment");
+    CHECK(!server->sendFragment(num, WSop_continuation, part, false), "the second fragment fits the queue");
+    CHECK(client->txBroken && (client->txDropped == 1), "txBroken %d, txDropped %u after a dropped fragment", client->txBroken, client->txDropped);
+    pass();
+    CHECK(disconnects == 1, "the client with a broken message was not disconnected");
+    CHECK(socket.use_count() == 1, "the server keeps the socket of a broken client");
+    disconnects = 0;
+    return 0;
+}
+
+/// клиент, который не принимает данные WEBSOCKETS_SEND_STALL_TIMEOUT, отключается, но не раньше
+static int testStallTimeout()
+{
+    uint8_t num;
+    std::shared_ptr<HostSocket> socket = stalledClient(num);
+    CHECK(socket, "no connection");
+    CHECK(server->sendTXT(num, "stalled"), "the message was not queued");
+    uint32_t start = millis();
+    uint32_t elapsed = 0;
+    while (!disconnects && (elapsed <= 2 * WEBSOCKETS_SEND_STALL_TIMEOUT))
+    {
+        pass();
+        hostAdvance(TEST_STEP * 1000);
+        elapsed = millis() - start;
+    }
+    CHECK(disconnects == 1, "the stalled client is still connected after %u ms", elapsed);
+    CHECK(elapsed > WEBSOCKETS_SEND_STALL_TIMEOUT, "the stalled client was disconnected after %u ms", elapsed);
+    CHECK(elapsed <= WEBSOCKETS_SEND_STALL_TIMEOUT + 2 * TEST_STEP, "the stalled client was disconnected after %u ms", elapsed);
+    CHECK(socket.use_count() == 1, "the server keeps the socket of a stalled client");
+    disconnects = 0;
+    return 0;
+}
+
+int main()
+{
+    Server instance;
+    server = &instance;
+    server->begin();
+    server->onEvent(event);
+    if (testDropped() || testBroken() || testStallTimeout())
+        return 1;
+    CHECK(longestPass <= TEST_PASS_LIMIT, "loop() took %u us", longestPass);
+    printf("send queue: dropped frames, broken fragments and the stall timeout OK, longest loop() %u us\n", longestPass);
+    return 0;
+}
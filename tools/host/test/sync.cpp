@@ -0,0 +1,161 @@
+// Тест синхронизации кадров (FrameSync): ведущий и три ведомых SmartLED в одной программе, у каждого свой адрес
+// и свои часы (смещение и уход до TEST_MAX_PPM, HostDevice), пакеты ходят по UDP внутри программы. Все рисуют
+// радугу с одной скоростью; после TEST_LOCK мс каждый кадр ведущего ищется среди кадров ведомого (по хешу
+// пикселей) и ошибка фазы - разница во времени вывода одинаковых кадров - должна быть меньше кадра. Без
+// синхронизации те же часы расходятся больше чем на кадр, иначе тест ничего бы не проверял.
+//
+//   make -C tools/host check
+
+#include <smartled.h>
+#include <memory>
+#include <random>
+
+#define TEST_PIXELS 30
+#define TEST_SPEED "80"                 ///< скорость радуги: шаг около 21 мс
+#define TEST_PALETTE "1"                ///< встроенная палитра радуги (кадры различаются по хешу)
+#define TEST_LOCK 3000                  ///< время на захват, мс
+#define TEST_TIME 20000                 ///< время проверки после захвата, мс
+#define TEST_LOOP 2000                  ///< проход loop(), мкс (delay(2) в SmartLED.ino)
+#define TEST_LOOP_JITTER 1500           ///< случайная добавка к проходу (веб-сервер, MQTT), мкс
+#define TEST_MAX_PPM 2500               ///< наибольший уход часов ведомого
+
+typedef struct
+{
+    HostDevice device;
+    std::unique_ptr<SmartLED> led;
+    std::vector<HostShow> shows;
+    uint64_t next;                      ///< время следующего прохода loop()
+} Controller;
+
+/// ошибки фазы ведомого относительно ведущего: для каждого кадра ведущего после from - ближайший по времени
+/// такой же кадр ведомого (в пределах window), кадры без пары считаются в missing
+static uint32_t phaseError(const Controller& leader, const Controller& follower, uint32_t from, uint32_t window, int& missing)
+{
+    uint32_t worst = 0;
+    missing = 0;
+    size_t j = 0;
+    for (const HostShow& show : leader.shows)
+    {
+        if (show.time < from)
+            continue;
+        while ((j < follower.shows.size()) && (follower.shows[j].time + window < show.time))
+            j++;
+        uint32_t best = UINT32_MAX;
+        for (size_t k = j; (k < follower.shows.size()) && (follower.shows[k].time <= show.time + window); k++)
+        {
+            if (follower.shows[k].digest != show.digest)
+                continue;
+            uint32_t error = (follower.shows[k].time > show.time) ? follower.shows[k].time - show.time : show.time - follower.shows[k].time;
+            best = std::min(best, error);
+        }
+        if (best == UINT32_MAX)
+            missing++;
+        else
+            worst = std::max(worst, best);
+    }
+    return worst;
+}
+
+/// ведущий и ведомые с ушедшими часами, frame - обычный кадр ведущего
+static bool run(bool sync, std::vector<Controller>& controllers, uint32_t& frame)
+{
+    const HostDevice devices[] = {
+        {IPAddress(192, 168, 1, 11), 0, 0},
+        {IPAddress(192, 168, 1, 12), 3700000, TEST_MAX_PPM},
+        {IPAddress(192, 168, 1, 13), 91234567, -TEST_MAX_PPM * 3 / 5},
+        {IPAddress(192, 168, 1, 14), 1234, TEST_MAX_PPM / 4}
+    };
+    controllers.clear();
+    controllers.resize(sizeof(devices) / sizeof(devices[0]));
+    for (size_t i = 0; i < controllers.size(); i++)
+    {
+        Controller& controller = controllers[i];
+        controller.device = devices[i];
+        hostDevice = &controller.device;
+        controller.led.reset(new SmartLED(TEST_PIXELS, 2, NEO_GRB, false));
+        controller.led->selectMode("rainbow");
+        char speedOption[] = "speed";
+        char speed[] = TEST_SPEED;
+        controller.led->setOption(speedOption, speed);
+        /// своя палитра по умолчанию черная, все кадры были бы одинаковы
+        char paletteOption[] = "palette";
+        char palette[] = TEST_PALETTE;
+        controller.led->setOption(paletteOption, palette);
+        if (sync)
+            controller.led->beginSync((i == 0) ? SRLeader : SRFollower);
+        /// ведомые включаются позже ведущего
+        hostDevice = NULL;
+        hostAdvance(137000);
+    }
+    /// у каждого контроллера свой ритм loop(): проходы разной длины, поэтому шаги разных часов не совпадают
+    std::minstd_rand random(sync ? 1 : 2);
+    uint64_t end = hostTime() + (TEST_LOCK + TEST_TIME) * 1000ULL;
+    for (Controller& controller : controllers)
+        controller.next = hostTime() + random() % TEST_LOOP;
+    while (true)
+    {
+        Controller* controller = &controllers[0];
+        for (Controller& candidate : controllers)
+            if (candidate.next < controller->next)
+                controller = &candidate;
+        if (controller->next >= end)
+            break;
+        if (controller->next > hostTime())
+            hostAdvance(controller->next - hostTime());
+        hostDevice = &controller->device;
+        hostShows = &controller->shows;
+        controller->led->process();
+        hostDevice = NULL;
+        hostShows = NULL;
+        controller->next = hostTime() + TEST_LOOP + random() % TEST_LOOP_JITTER;
+    }
+    const std::vector<HostShow>& shows = controllers[0].shows;
+    if (shows.size() < 100)
+        return false;
+    std::vector<uint32_t> intervals;
+    for (size_t i = 1; i < shows.size(); i++)
+        intervals.push_back(shows[i].time - shows[i - 1].time);
+    std::sort(intervals.begin(), intervals.end());
+    frame = intervals[intervals.size() / 2];
+    return true;
+}
+
+int main()
+{
+    std::vector<Controller> controllers;
+    uint32_t frame;
+    int result = 0;
+    for (int sync = 1; sync >= 0; sync--)
+    {
+        if (!run(sync, controllers, frame))
+        {
+            fprintf(stderr, "FAIL: the leader shows no frames\n");
+            return 1;
+        }
+        uint32_t from = controllers[0].shows.front().time + TEST_LOCK * 1000UL;
+        uint32_t worst = 0;
+        int missing = 0;
+        for (size_t i = 1; i < controllers.size(); i++)
+        {
+            int followerMissing;
+            uint32_t error = phaseError(controllers[0], controllers[i], from, 8 * frame, followerMissing);
+            printf("%s follower %d.%d.%d.%d (%+d ppm): %zu frames, phase error %u us, %d frames without a match\n",
+                   sync ? "sync   " : "no sync", controllers[i].device.ip[0], controllers[i].device.ip[1], controllers[i].device.ip[2],
+                   controllers[i].device.ip[3], controllers[i].device.ppm, controllers[i].shows.size(), error, followerMissing);
+            worst = std::max(worst, error);
+            missing += followerMissing;
+        }
+        if (sync && (missing || (worst >= frame)))
+        {
+            fprintf(stderr, "FAIL: phase error %u us, %d frames without a match, frame %u us\n", worst, missing, frame);
+            result = 1;
+        }
+        if (!sync && !missing && (worst < frame))
+        {
+            fprintf(stderr, "FAIL: the clocks stay within a frame (%u us) without sync, the test proves nothing\n", worst);
+            result = 1;
+        }
+    }
+    printf("frame sync: leader frame %u us\n", frame);
+    return result;
+}
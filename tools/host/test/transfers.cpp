@@ -0,0 +1,226 @@
+// Тест отдачи статических файлов SmartLED.ino по частям (handleFileTransfers): скетч собирается на компьютере
+// (setup() и loop() как на ESP, SPIFFS - каталог SmartLED/data) и по очереди отдает все файлы data по два
+// одновременно (TEST_PARALLEL) клиентам с каналом TEST_LINK_RATE байт/мс, пока рисуется эффект. Проверяется,
+// что клиенты получили файлы без искажений и что ни один интервал между кадрами за время загрузки не длиннее
+// обычного (медианы до загрузок) больше чем на кадр. Время виртуальное: loop() стоит delay(2), ожидание места
+// в сокете - delay(1) в write(), как на ESP. Затем корень запрашивается с Accept-Encoding: gzip: ответ -
+// index.html.gz с ETag и проверкой при каждой загрузке, повторный запрос с If-None-Match - 304 без тела.
+//
+//   make -C tools/host check
+
+#include <smartled.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#define TEST_LINK_RATE 200              ///< скорость канала клиента, байт/мс (1.6 Мбит/с)
+#define TEST_WARMUP 500                 ///< проходов loop() до первого запроса (по ним определяется обычный кадр)
+#define TEST_SPEED "80"                 ///< скорость радуги: шаг около 21 мс, кадр на каждый refreshRate
+#define TEST_PARALLEL 2                 ///< одновременных загрузок, как FILE_TRANSFERS в SmartLED.ino
+
+extern SmartLED* smart;
+void setup();
+void loop();
+
+typedef struct
+{
+    std::string path;                   ///< путь запроса
+    std::vector<uint8_t> content;       ///< содержимое файла
+    std::shared_ptr<HostSocket> socket;
+} Download;
+
+/// файлы каталога и подкаталогов, пути от корня data
+static void listFiles(const std::string& root, const std::string& path, std::vector<std::string>& files)
+{
+    DIR* dir = opendir((root + path).c_str());
+    if (!dir)
+        return;
+    while (struct dirent* entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if ((name == ".") || (name == ".."))
+            continue;
+        struct stat info;
+        std::string child = path + "/" + name;
+        if (stat((root + child).c_str(), &info))
+            continue;
+        if (S_ISDIR(info.st_mode))
+            listFiles(root, child, files);
+        else if (S_ISREG(info.st_mode))
+            files.push_back(child);
+    }
+    closedir(dir);
+}
+
+static std::vector<uint8_t> readFile(const std::string& path)
+{
+    std::vector<uint8_t> content;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return content;
+    uint8_t buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        content.insert(content.end(), buffer, buffer + length);
+    fclose(file);
+    return content;
+}
+
+static void request(Download& download, const std::string& headers = "")
+{
+    download.socket = hostConnect(80);
+    download.socket->rate = TEST_LINK_RATE;
+    download.socket->room = 0;
+    std::string text = "GET " + download.path + " HTTP/1.1\r\nHost: room.local\r\n" + headers + "\r\n";
+    download.socket->rx.assign(text.begin(), text.end());
+}
+
+/// ответ получен целиком (по Content-Length), тело в body
+static bool received(const Download& download, std::vector<uint8_t>& body)
+{
+    const std::vector<uint8_t>& tx = download.socket->tx;
+    static const char end[] = "\r\n\r\n";
+    std::vector<uint8_t>::const_iterator header = std::search(tx.begin(), tx.end(), end, end + 4);
+    if (header == tx.end())
+        return false;
+    std::string headers(tx.begin(), header);
+    size_t at = headers.find("Content-Length: ");
+    if (at == std::string::npos)
+        return false;
+    size_t length = strtoul(headers.c_str() + at + 16, NULL, 10);
+    if ((size_t) (tx.end() - header) < 4 + length)
+        return false;
+    body.assign(header + 4, header + 4 + length);
+    return true;
+}
+
+/// заголовки ответа до пустой строки
+static std::string responseHeaders(const Download& download)
+{
+    static const char end[] = "\r\n\r\n";
+    const std::vector<uint8_t>& tx = download.socket->tx;
+    return std::string(tx.begin(), std::search(tx.begin(), tx.end(), end, end + 4));
+}
+
+/// корень со сжатием: index.html.gz, ETag, проверка при каждой загрузке и 304 на If-None-Match
+static int cachedRoot()
+{
+    Download page = {"/", readFile(hostDataDir + "/index.html.gz"), NULL};
+    std::vector<uint8_t> body;
+    request(page, "Accept-Encoding: gzip, deflate\r\n");
+    for (int i = 0; (i < 5000) && !received(page, body); i++)
+        loop();
+    std::string headers = responseHeaders(page);
+    size_t at = headers.find("ETag: ");
+    std::string etag = (at == std::string::npos) ? "" : headers.substr(at + 6, headers.find("\r\n", at) - at - 6);
+    if (page.content.empty() || (body != page.content) || etag.empty() ||
+        (headers.find("Content-Encoding: gzip") == std::string::npos) || (headers.find("Cache-Control: no-cache") == std::string::npos))
+    {
+        fprintf(stderr, "FAIL: /: %zu bytes received, index.html.gz has %zu, headers:\n%s\n", body.size(), page.content.size(),
+                headers.c_str());
+        return 1;
+    }
+    Download again = {"/", {}, NULL};
+    request(again, "Accept-Encoding: gzip\r\nIf-None-Match: " + etag + "\r\n");
+    for (int i = 0; (i < 5000) && !received(again, body); i++)
+        loop();
+    headers = responseHeaders(again);
+    if ((headers.compare(0, 12, "HTTP/1.1 304") != 0) || !body.empty())
+    {
+        fprintf(stderr, "FAIL: / with If-None-Match: %zu bytes, headers:\n%s\n", body.size(), headers.c_str());
+        return 1;
+    }
+    printf("file transfers: / is index.html.gz (%zu bytes, ETag %s), revalidation is 304 without a body\n",
+           page.content.size(), etag.c_str());
+    return 0;
+}
+
+int main()
+{
+    std::vector<HostShow> shows;
+    hostDataDir = SKETCH_DATA;
+    setup();
+    smart->selectMode("rainbow");
+    char option[] = "speed";
+    char speed[] = TEST_SPEED;
+    smart->setOption(option, speed);
+    hostShows = &shows;
+    for (int i = 0; i < TEST_WARMUP; i++)
+        loop();
+
+    std::vector<std::string> files;
+    listFiles(hostDataDir, "", files);
+    std::vector<Download> downloads;
+    size_t bytes = 0;
+    for (const std::string& file : files)
+    {
+        downloads.push_back({file, readFile(hostDataDir + file), NULL});
+        bytes += downloads.back().content.size();
+    }
+    /// корень отдает handleRoot
+    downloads.push_back({"/", readFile(hostDataDir + "/index.html"), NULL});
+    bytes += downloads.back().content.size();
+
+    size_t firstShow = shows.size();
+    uint32_t start = millis();
+    size_t next = 0;
+    std::vector<Download*> active;
+    int result = 0;
+    while ((next < downloads.size()) || !active.empty())
+    {
+        while ((active.size() < TEST_PARALLEL) && (next < downloads.size()))
+        {
+            request(downloads[next]);
+            active.push_back(&downloads[next++]);
+        }
+        loop();
+        for (size_t i = 0; i < active.size(); )
+        {
+            std::vector<uint8_t> body;
+            Download& download = *active[i];
+            if (!received(download, body))
+            {
+                if (millis() - start > 600000)
+                {
+                    fprintf(stderr, "FAIL: %s: no complete response\n", download.path.c_str());
+                    return 1;
+                }
+                i++;
+                continue;
+            }
+            if (body != download.content)
+            {
+                fprintf(stderr, "FAIL: %s: %zu bytes received, the file has %zu\n", download.path.c_str(), body.size(), download.content.size());
+                result = 1;
+            }
+            active.erase(active.begin() + i);
+        }
+    }
+    uint32_t elapsed = millis() - start;
+    hostShows = NULL;
+
+    /// обычный кадр - медиана интервалов до загрузок
+    std::vector<uint32_t> warmup;
+    for (size_t i = 1; i < firstShow; i++)
+        warmup.push_back(shows[i].time - shows[i - 1].time);
+    uint32_t longest = 0;
+    for (size_t i = firstShow; i < shows.size(); i++)
+        longest = std::max(longest, shows[i].time - shows[i - 1].time);
+    if ((warmup.size() < 10) || (shows.size() - firstShow < 10))
+    {
+        fprintf(stderr, "FAIL: %zu frames before and %zu during the downloads\n", warmup.size(), shows.size() - firstShow);
+        return 1;
+    }
+    std::sort(warmup.begin(), warmup.end());
+    uint32_t frame = warmup[warmup.size() / 2];
+    printf("file transfers: %zu files, %zu bytes in %u ms at %u bytes/ms, %zu frames, interval %u us, longest %u us\n",
+           downloads.size(), bytes, elapsed, TEST_LINK_RATE, shows.size() - firstShow, frame, longest);
+    if (longest > 2 * frame)
+    {
+        fprintf(stderr, "FAIL: a frame came %u us late, more than one frame (%u us)\n", longest - frame, frame);
+        result = 1;
+    }
+    result |= cachedRoot();
+    return result;
+}
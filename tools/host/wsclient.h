@@ -0,0 +1,111 @@
+// Клиент вебсокета для тестов на компьютере: запрос на подключение, кадры с маской, прокачка сервера
+// до закрытия соединения. Используется фаззерами и замерами.
+
+#ifndef HOST_WSCLIENT_H
+#define HOST_WSCLIENT_H
+
+#include <ESP8266WiFi.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/// запрос на подключение, как его отправляет браузер (ключ из примера RFC 6455)
+inline std::string wsUpgradeRequest(bool deflate)
+{
+    std::string request =
+        "GET / HTTP/1.1\r\n"
+        "Host: 192.168.1.10:81\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n"
+        "Sec-WebSocket-Protocol: arduino\r\n";
+    if (deflate)
+        request += "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n";
+    return request + "\r\n";
+}
+
+/// кадр от клиента (с маской, как требует RFC 6455)
+inline std::string wsClientFrame(uint8_t opcode, const std::string& payload, bool fin = true)
+{
+    std::string frame;
+    frame += (char) ((fin ? 0x80 : 0x00) | opcode);
+    size_t length = payload.size();
+    if (length < 126)
+        frame += (char) (0x80 | length);
+    else if (length < 65536)
+    {
+        frame += (char) (0x80 | 126);
+        frame += (char) (length >> 8);
+        frame += (char) (length & 0xFF);
+    } else
+    {
+        frame += (char) (0x80 | 127);
+        for (int i = 7; i >= 0; i--)
+            frame += (char) ((uint64_t) length >> (i * 8));
+    }
+    const uint8_t mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+    frame.append((const char*) mask, sizeof(mask));
+    for (size_t i = 0; i < length; i++)
+        frame += (char) (payload[i] ^ mask[i % 4]);
+    return frame;
+}
+
+/// сообщения сервера (кадры без маски и без сжатия) после ответа на запрос подключения (response == false - tx
+/// начинается с кадра)
+inline std::vector<std::string> wsServerMessages(const std::vector<uint8_t>& tx, bool response = true)
+{
+    static const char end[] = "\r\n\r\n";
+    std::vector<std::string> messages;
+    size_t i = 0;
+    if (response)
+    {
+        std::vector<uint8_t>::const_iterator header = std::search(tx.begin(), tx.end(), end, end + 4);
+        i = (header == tx.end()) ? tx.size() : (header - tx.begin()) + 4;
+    }
+    while (i + 2 <= tx.size())
+    {
+        size_t length = tx[i + 1] & 0x7F;
+        size_t start = i + 2;
+        if (length == 126)
+        {
+            if (start + 2 > tx.size())
+                break;
+            length = (tx[start] << 8) | tx[start + 1];
+            start += 2;
+        } else if (length == 127)
+            break;
+        if (start + length > tx.size())
+            break;
+        if ((tx[i] & 0x0F) == 0x01)
+            messages.push_back(std::string(tx.begin() + start, tx.begin() + start + length));
+        i = start + length;
+    }
+    return messages;
+}
+
+/**
+ * Передать серверу данные клиента и вызывать poll, пока сервер не закроет соединение (или не исчерпается
+ * лимит проходов). Клиент после данных закрывает свою сторону, поэтому незаконченный кадр не ждет
+ * таймаута. Отправленное сервером сразу "принимается" клиентом
+ * @return true, если сервер закрыл соединение
+ */
+inline bool wsPump(const std::string& data, const std::function<void()>& poll, int passes = 10000)
+{
+    std::shared_ptr<HostSocket> socket = hostConnect();
+    socket->rx.assign(data.begin(), data.end());
+    socket->open = false;
+    for (int i = 0; i < passes; i++)
+    {
+        poll();
+        socket->tx.clear();
+        socket->room = 2920;
+        hostAdvance(1000);
+        if (socket.use_count() == 1)
+            return true;
+    }
+    return false;
+}
+
+#endif /* HOST_WSCLIENT_H */
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+# Воспроизводит запись команд вебсокета (GET /capture) на контроллере для нагрузочной проверки.
+# Каждому клиенту из записи соответствует свое соединение, команды отправляются с исходными
+# интервалами, деленными на --speed. Во время воспроизведения раз в секунду читается /stats,
+# в конце выводятся худшие fps, прирост пропущенных кадров и p99 фаз цикла.
+#
+#   curl -o capture.txt http://smartled.local/capture
+#   tools/replay-capture.py smartled.local capture.txt --speed 4
+#
+# Без контроллера ту же запись воспроизводит скетч, собранный на компьютере (виртуальное время):
+#   make -C tools/host build/replay && tools/host/build/replay capture.txt --speed 4
+
+import argparse
+import base64
+import json
+import os
+import select
+import socket
+import struct
+import sys
+import time
+import urllib.request
+
+
+def unescape(text):
+    result = []
+    i = 0
+    while i < len(text):
+        if text[i] == '\\' and i + 1 < len(text):
+            result.append({'t': '\t', 'n': '\n', 'r': '\r'}.get(text[i + 1], text[i + 1]))
+            i += 2
+        else:
+            result.append(text[i])
+            i += 1
+    return ''.join(result)
+
+
+def read_capture(path):
+    commands = []
+    with open(path, encoding='utf-8', errors='replace') as f:
+        for line in f:
+            line = line.rstrip('\n')
+            if not line:
+                continue
+            stamp, client, command = line.split('\t', 2)
+            commands.append((int(stamp), int(client), unescape(command)))
+    return commands
+
+
+class Client:
+    """Минимальный клиент вебсокета: текстовые кадры от клиента, входящие данные отбрасываются."""
+
+    def __init__(self, host, port):
+        self.sock = socket.create_connection((host, port), timeout=5)
+        key = base64.b64encode(os.urandom(16)).decode()
+        request = ('GET / HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n'
+                   'Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\nSec-WebSocket-Protocol: arduino\r\n\r\n'
+                   % (host, port, key))
+        self.sock.sendall(request.encode())
+        response = b''
+        while b'\r\n\r\n' not in response:
+            chunk = self.sock.recv(1024)
+            if not chunk:
+                raise IOError('connection closed during handshake')
+            response += chunk
+        if b' 101 ' not in response.split(b'\r\n', 1)[0]:
+            raise IOError('handshake failed: %r' % response.split(b'\r\n', 1)[0])
+        self.sock.setblocking(False)
+
+    def send(self, text):
+        payload = text.encode()
+        header = bytearray([0x81])
+        if len(payload) < 126:
+            header.append(0x80 | len(payload))
+        else:
+            header.append(0x80 | 126)
+            header += struct.pack('>H', len(payload))
+        mask = os.urandom(4)
+        header += mask
+        masked = bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.setblocking(True)
+        self.sock.sendall(bytes(header) + masked)
+        self.sock.setblocking(False)
+
+    def drain(self):
+        try:
+            while self.sock.recv(4096):
+                pass
+        except (BlockingIOError, socket.timeout):
+            pass
+
+    def close(self):
+        self.sock.close()
+
+
+def read_stats(host):
+    with urllib.request.urlopen('http://%s/stats' % host, timeout=2) as response:
+        return json.loads(response.read().decode())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replay a SmartLED WebSocket capture against a controller')
+    parser.add_argument('host', help='controller address')
+    parser.add_argument('capture', help='file downloaded from /capture')
+    parser.add_argument('--speed', type=float, default=1.0, help='replay speed factor, 1 = original timing')
+    parser.add_argument('--port', type=int, default=81, help='WebSocket port')
+    args = parser.parse_args()
+
+    commands = read_capture(args.capture)
+    if not commands:
+        sys.exit('capture is empty')
+    clients = {}
+    for _, num, _ in commands:
+        if num not in clients:
+            clients[num] = Client(args.host, args.port)
+
+    first = read_stats(args.host)
+    samples = [first]
+    start = time.monotonic()
+    origin = commands[0][0]
+    next_stats = start + 1
+    for stamp, num, command in commands:
+        due = start + (stamp - origin) / 1000.0 / args.speed
+        while True:
+            now = time.monotonic()
+            if now >= due:
+                break
+            select.select([c.sock for c in clients.values()], [], [], min(due, next_stats) - now)
+            for c in clients.values():
+                c.drain()
+            if time.monotonic() >= next_stats:
+                samples.append(read_stats(args.host))
+                next_stats += 1
+        clients[num].send(command)
+    samples.append(read_stats(args.host))
+    elapsed = time.monotonic() - start
+    for c in clients.values():
+        c.close()
+
+    print('%d commands from %d clients in %.1f s (x%g)' % (len(commands), len(clients), elapsed, args.speed))
+    print('fps min %d, missed frames +%d' % (min(s['fps'] for s in samples[1:]),
+                                             samples[-1]['missed'] - first['missed']))
+    for phase in first['phases']:
+        print('%-10s p99 max %6d us, max %6d us' % (phase, max(s['phases'][phase]['p99'] for s in samples),
+                                                   samples[-1]['phases'][phase]['max']))
+
+
+if __name__ == '__main__':
+    main()